@@ -0,0 +1,155 @@
+// Accumulator/flag transition tables.
+//
+// 59 of the 394 opcodes read and write nothing but A and F: ALU A,A and
+// ALU A,n, INC/DEC A, the accumulator rotates, DAA, CPL, SCF, CCF, NEG, the
+// CB shifts on A, and BIT/RES/SET n,A. Each is a function (A,F) -> (A',F'),
+// so it is tabulated once and h_exec_instruction replaces the branchy flag
+// arithmetic with one load (see HAfLut in z80_common.h).
+//
+// A dense 64K-entry table per op (128 KB, 8.4 MB in all) is 2.5x faster than
+// the branchy path while it stays in L2, but a search touches a different op
+// on nearly every step and the misses made it slower end to end. Most of F is
+// either ignored or passed through, so each table is indexed by only the F
+// bits the op reads (none, carry, or C/H/N for DAA); that leaves 0.5-10 KB per
+// op, plus 128-256 KB for each ALU A,n table, which covers every immediate.
+//
+// The read and pass-through masks are derived by probing
+// h_exec_instruction_ref, and the tables are filled from it; aflut_verify
+// checks the result bit-for-bit over every (A, F, n) input.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "z80_common.h"
+
+#define AFLUT_ALIGN 64
+
+// True if op reads and writes only A and F.
+static bool aflut_covers(uint16_t op) {
+    if (op >= OP_ALU_START && op < OP_INC_START) return (op - OP_ALU_START) % 8 >= 6;  // ALU A,A / A,n
+    if (op == OP_INC_START || op == OP_DEC_START) return true;                         // INC A, DEC A
+    if (op >= OP_RLCA && op <= OP_NEG) return true;
+    if (op >= OP_CB_START && op <= 192) return (op - OP_CB_START) % 7 == 0;            // CB shifts on A
+    if (op == OP_SLL_A) return true;
+    if (op >= OP_BIT_START && op < OP_16INC_START) return (op - OP_BIT_START) % 7 == 0; // BIT/RES/SET n,A
+    return false;
+}
+
+static inline bool aflut_imm_op(uint16_t op) {
+    return op >= OP_ALU_START && op < OP_INC_START && (op - OP_ALU_START) % 8 == 7;
+}
+
+// Derive which F bits op reads and which it passes through unchanged, from
+// the reference executor over all (A, F) and a spread of immediates.
+static void aflut_probe(uint16_t op, uint8_t* read, uint8_t* keep) {
+    static const uint8_t imm_probe[] = {0x00, 0x0F, 0x10, 0x7F, 0x80, 0xFF};
+    int nimm = aflut_imm_op(op) ? (int)sizeof(imm_probe) : 1;
+    std::vector<uint16_t> out(65536);
+    uint16_t flips[8] = {};   // output bits that change when F bit b is toggled
+    uint16_t moved = 0;       // F bits whose output differs from the input
+    for (int ii = 0; ii < nimm; ii++) {
+        for (uint32_t x = 0; x < 65536; x++) {
+            Z80State s = {};
+            s.r[REG_A] = (uint8_t)(x >> 8); s.r[REG_F] = (uint8_t)x;
+            h_exec_instruction_ref(s, op, imm_probe[ii]);
+            out[x] = (uint16_t)((s.r[REG_A] << 8) | s.r[REG_F]);
+            moved |= (uint16_t)((out[x] ^ x) & 0xFF);
+        }
+        for (int b = 0; b < 8; b++)
+            for (uint32_t x = 0; x < 65536; x++) flips[b] |= out[x] ^ out[x ^ (1u << b)];
+    }
+    uint8_t rd = 0, kp = 0;
+    for (int b = 0; b < 8; b++) {
+        uint16_t bit = (uint16_t)(1u << b);
+        if (flips[b]) rd |= bit;
+        if (!(moved & bit) && !(flips[b] & ~bit)) kp |= bit;   // F'_b = F_b, affects nothing else
+    }
+    *keep = kp;
+    *read = rd & (uint8_t)~kp;
+}
+
+// Tables built by aflut_init, installed into h_af_lut by aflut_install.
+static uint16_t* aflut_blob = nullptr;
+static size_t aflut_bytes = 0;
+static HAfLut aflut_tables[OP_COUNT];
+
+// Derive masks, size and fill every table into one aligned blob.
+static bool aflut_build() {
+    uint32_t offs[OP_COUNT];
+    size_t total = 0;
+    for (uint16_t op = 0; op < OP_COUNT; op++) {
+        HAfLut &l = aflut_tables[op];
+        l = HAfLut{nullptr, 0, 0, 0, 0};
+        if (!aflut_covers(op)) continue;
+        aflut_probe(op, &l.read, &l.keep);
+        l.imm_mask = aflut_imm_op(op) ? 0xFF : 0;
+        l.stride = ((uint32_t)l.read + 1) << 8;
+        offs[op] = (uint32_t)total;
+        total += (size_t)l.stride * (l.imm_mask + 1u);  // multiple of 256 entries, so aligned
+    }
+    size_t bytes = total * sizeof(uint16_t);
+    uint16_t* blob = (uint16_t*)aligned_alloc(AFLUT_ALIGN, bytes);
+    if (!blob) return false;
+    memset(blob, 0, bytes);
+    for (uint16_t op = 0; op < OP_COUNT; op++) {
+        HAfLut &l = aflut_tables[op];
+        if (!aflut_covers(op)) continue;
+        uint16_t* t = blob + offs[op];
+        for (uint32_t imm = 0; imm <= l.imm_mask; imm++)
+            for (uint32_t f = 0; f < 256; f++) {
+                if (f & ~(uint32_t)l.read) continue;   // unread bits: never indexed
+                for (uint32_t a = 0; a < 256; a++) {
+                    Z80State s = {};
+                    s.r[REG_A] = (uint8_t)a; s.r[REG_F] = (uint8_t)f;
+                    h_exec_instruction_ref(s, op, (uint16_t)imm);
+                    t[h_af_lut_index(l, (uint8_t)a, (uint8_t)f, (uint16_t)imm)] =
+                        (uint16_t)((s.r[REG_A] << 8) | (s.r[REG_F] & ~l.keep));
+                }
+            }
+        l.t = t;
+    }
+    aflut_blob = blob;
+    aflut_bytes = bytes;
+    return true;
+}
+
+static void aflut_install() { memcpy(h_af_lut, aflut_tables, sizeof(h_af_lut)); }
+static void aflut_uninstall() { memset(h_af_lut, 0, sizeof(h_af_lut)); }
+
+// Build once and install (call after init_tables).
+static bool aflut_init() {
+    if (!aflut_blob && !aflut_build()) {
+        fprintf(stderr, "af-lut: out of memory, using the branchy executor\n");
+        return false;
+    }
+    aflut_install();
+    return true;
+}
+
+// Compare every installed table against h_exec_instruction_ref over all
+// (A, F) inputs, and all immediates for ALU A,n. Returns the mismatch count.
+static long aflut_verify() {
+    long bad = 0;
+    for (uint16_t op = 0; op < OP_COUNT; op++) {
+        const HAfLut &l = h_af_lut[op];
+        if (!l.t) continue;
+        for (uint32_t imm = 0; imm <= l.imm_mask; imm++)
+            for (uint32_t x = 0; x < 65536; x++) {
+                Z80State s = {}, ref;
+                s.r[REG_A] = (uint8_t)(x >> 8); s.r[REG_F] = (uint8_t)x;
+                ref = s;
+                h_exec_instruction(s, op, (uint16_t)imm);
+                h_exec_instruction_ref(ref, op, (uint16_t)imm);
+                if (s.r[REG_A] != ref.r[REG_A] || s.r[REG_F] != ref.r[REG_F]) {
+                    if (bad++ < 10)
+                        fprintf(stderr, "af-lut: op %u imm %u A=%02X F=%02X: table %02X/%02X, ref %02X/%02X\n",
+                                op, imm, x >> 8, x & 0xFF, s.r[REG_A], s.r[REG_F], ref.r[REG_A], ref.r[REG_F]);
+                }
+            }
+    }
+    return bad;
+}
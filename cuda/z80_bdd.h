@@ -0,0 +1,321 @@
+// Reduced ordered BDD engine and symbolic ExhaustiveCheck.
+//
+// ExhaustiveCheck sweeps 3+ extra registers or SP over 32 representative
+// values each (h_rep_values / h_rep_sp): sampling, not proof. Here every
+// input bit of the sweep domain is a BDD variable instead, and the target and
+// candidate are run through the bit-sliced executor (z80_bitslice.h) with BDD
+// nodes as planes, so both programs' output bits become canonical functions of
+// the inputs. Two programs are equivalent iff every live output bit is the
+// same node. Shallow sequences stay at a few thousand nodes, so a proof over
+// 2^40+ inputs takes well under a millisecond.
+//
+// Domain (same as ExhaustiveCheck, but complete): A and carry free, every
+// register the pair reads free, SP free if read; other registers and the
+// other F bits are 0.
+//
+// Variable order interleaves bit k of every register (carry first), which
+// keeps ripple-carry adders linear in size.
+//
+// bdd_prove_symbolic also makes immediate operands free (IMM_SYM operands,
+// z80_symimm.h) and reports for which of their values the pair is equivalent.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_bitslice.h"
+
+#define BDD_FALSE 0u
+#define BDD_TRUE  1u
+#define BDD_TERM_VAR 0xFFFFu
+#define BDD_NODE_LIMIT (1u << 22)   // per proof; over budget -> caller falls back
+
+struct BddMgr {
+    struct Node { uint32_t var, lo, hi; };
+    struct CacheEnt { uint32_t f, g, h, r; };
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unique;     // node id, 0 = empty (terminals never stored)
+    std::vector<CacheEnt> cache;      // direct-mapped ITE cache, f == 0 = empty
+    uint32_t node_limit = BDD_NODE_LIMIT;
+    bool overflow = false;
+
+    BddMgr() { reset(); }
+
+    void reset() {
+        nodes.clear();
+        nodes.push_back({BDD_TERM_VAR, 0, 0});
+        nodes.push_back({BDD_TERM_VAR, 1, 1});
+        if (unique.size() != (1u << 14)) unique.assign(1u << 14, 0); else std::fill(unique.begin(), unique.end(), 0);
+        if (cache.size() != (1u << 14)) cache.assign(1u << 14, CacheEnt{0, 0, 0, 0});
+        else std::fill(cache.begin(), cache.end(), CacheEnt{0, 0, 0, 0});
+        overflow = false;
+    }
+
+    static uint32_t mix(uint32_t a, uint32_t b, uint32_t c) {
+        uint64_t h = ((uint64_t)a * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)b * 0xC2B2AE3D27D4EB4Full) ^
+                     ((uint64_t)c * 0x165667B19E3779F9ull);
+        return (uint32_t)(h ^ (h >> 29));
+    }
+
+    uint32_t var(uint32_t f) const { return nodes[f].var; }
+
+    void grow_unique() {
+        std::vector<uint32_t> old;
+        old.swap(unique);
+        unique.assign(old.size() * 2, 0);
+        uint32_t m = (uint32_t)unique.size() - 1;
+        for (uint32_t id : old) {
+            if (!id) continue;
+            const Node &n = nodes[id];
+            uint32_t s = mix(n.var, n.lo, n.hi) & m;
+            while (unique[s]) s = (s + 1) & m;
+            unique[s] = id;
+        }
+        if (cache.size() < unique.size()) cache.assign(unique.size(), CacheEnt{0, 0, 0, 0});
+    }
+
+    uint32_t mk(uint32_t v, uint32_t lo, uint32_t hi) {
+        if (lo == hi) return lo;
+        uint32_t m = (uint32_t)unique.size() - 1;
+        uint32_t s = mix(v, lo, hi) & m;
+        for (; unique[s]; s = (s + 1) & m) {
+            const Node &n = nodes[unique[s]];
+            if (n.var == v && n.lo == lo && n.hi == hi) return unique[s];
+        }
+        if (nodes.size() >= node_limit) { overflow = true; return BDD_FALSE; }
+        uint32_t id = (uint32_t)nodes.size();
+        nodes.push_back({v, lo, hi});
+        unique[s] = id;
+        if (nodes.size() * 2 > unique.size()) grow_unique();
+        return id;
+    }
+
+    uint32_t ithvar(uint32_t v) { return mk(v, BDD_FALSE, BDD_TRUE); }
+
+    uint32_t ite(uint32_t f, uint32_t g, uint32_t h) {
+        if (overflow) return BDD_FALSE;
+        if (f == BDD_TRUE) return g;
+        if (f == BDD_FALSE) return h;
+        if (g == h) return g;
+        if (g == BDD_TRUE && h == BDD_FALSE) return f;
+        uint32_t ci = mix(f, g, h) & ((uint32_t)cache.size() - 1);
+        const CacheEnt &ce = cache[ci];
+        if (ce.f == f && ce.g == g && ce.h == h) return ce.r;
+        uint32_t v = var(f);
+        if (var(g) < v) v = var(g);
+        if (var(h) < v) v = var(h);
+        auto lo = [&](uint32_t x) { return var(x) == v ? nodes[x].lo : x; };
+        auto hi = [&](uint32_t x) { return var(x) == v ? nodes[x].hi : x; };
+        uint32_t fl = lo(f), gl = lo(g), hl = lo(h), fh = hi(f), gh = hi(g), hh = hi(h);
+        uint32_t t = ite(fh, gh, hh);
+        uint32_t e = ite(fl, gl, hl);
+        uint32_t r = mk(v, e, t);
+        cache[mix(f, g, h) & ((uint32_t)cache.size() - 1)] = CacheEnt{f, g, h, r};
+        return r;
+    }
+
+    // One satisfying assignment of f (f != FALSE): vals[var] = 0/1, others untouched.
+    void any_sat(uint32_t f, uint8_t* vals) const {
+        while (f > BDD_TRUE) {
+            const Node &n = nodes[f];
+            if (n.lo != BDD_FALSE) { vals[n.var] = 0; f = n.lo; }
+            else { vals[n.var] = 1; f = n.hi; }
+        }
+    }
+};
+
+// Plane type for the bit-sliced executor: a node in the thread's manager.
+struct BddRef { uint32_t id; };
+static thread_local BddMgr* bdd_cur = nullptr;
+
+static inline BddRef operator&(BddRef a, BddRef b) { return {bdd_cur->ite(a.id, b.id, BDD_FALSE)}; }
+static inline BddRef operator|(BddRef a, BddRef b) { return {bdd_cur->ite(a.id, BDD_TRUE, b.id)}; }
+static inline BddRef operator~(BddRef a) { return {bdd_cur->ite(a.id, BDD_FALSE, BDD_TRUE)}; }
+static inline BddRef operator^(BddRef a, BddRef b) { return {bdd_cur->ite(a.id, (~b).id, b.id)}; }
+static inline BddRef bs_mux(BddRef s, BddRef a, BddRef b) { return {bdd_cur->ite(s.id, a.id, b.id)}; }
+static inline BddRef bs_maj(BddRef a, BddRef b, BddRef c) { return {bdd_cur->ite(a.id, (b | c).id, (b & c).id)}; }
+static inline BddRef bs_xor3(BddRef a, BddRef b, BddRef c) { return a ^ b ^ c; }
+template<> inline BddRef bs_k<BddRef>(bool one) { return {one ? BDD_TRUE : BDD_FALSE}; }
+
+// Variable numbering: carry, then for each bit k: A B C D E H L SP[k] SP[k+8]
+// and, for symbolic immediates, S0[k] S0[k+8] S1[k] S1[k+8] S2[k] S2[k+8].
+#define BDD_VAR_CARRY 0
+#define BDD_VARS_PER_BIT 15
+static inline uint32_t bdd_reg_var(int reg, int k) {   // reg = REG_A or REG_B..REG_L
+    int slot = reg == REG_A ? 0 : reg - 1;            // A=0, B=1 .. L=6
+    return 1 + (uint32_t)k * BDD_VARS_PER_BIT + slot;
+}
+static inline uint32_t bdd_sp_var(int k) {
+    return 1 + (uint32_t)(k & 7) * BDD_VARS_PER_BIT + 7 + (k >> 3);
+}
+static inline uint32_t bdd_imm_var(int sym, int k) {
+    return 1 + (uint32_t)(k & 7) * BDD_VARS_PER_BIT + 9 + 2 * sym + (k >> 3);
+}
+static inline bool bdd_is_imm_var(uint32_t v) { return v > 0 && (v - 1) % BDD_VARS_PER_BIT >= 9; }
+#define BDD_NUM_VARS (1 + 8 * BDD_VARS_PER_BIT)
+
+// Symbolic input state for the sweep domain.
+static void bdd_input_state(BddMgr &m, BsStateT<BddRef> &s, const int* extra, int nextra, bool sweep_sp) {
+    for (int r = 0; r < 8; r++) bs_set_const8(s.r[r], 0);
+    for (int k = 0; k < 16; k++) s.sp[k] = bs_k<BddRef>(false);
+    for (int k = 0; k < 8; k++) s.r[REG_A][k] = {m.ithvar(bdd_reg_var(REG_A, k))};
+    s.r[REG_F][0] = {m.ithvar(BDD_VAR_CARRY)};
+    for (int e = 0; e < nextra; e++)
+        for (int k = 0; k < 8; k++) s.r[extra[e]][k] = {m.ithvar(bdd_reg_var(extra[e], k))};
+    if (sweep_sp)
+        for (int k = 0; k < 16; k++) s.sp[k] = {m.ithvar(bdd_sp_var(k))};
+}
+
+// Decode a satisfying assignment into a concrete input state.
+static Z80State bdd_assignment_state(const uint8_t* vals) {
+    Z80State z = {};
+    z.r[REG_F] = vals[BDD_VAR_CARRY] & 1;
+    for (int k = 0; k < 8; k++) {
+        for (int reg = REG_B; reg <= REG_L; reg++)
+            z.r[reg] |= (uint8_t)((vals[bdd_reg_var(reg, k)] & 1) << k);
+        z.r[REG_A] |= (uint8_t)((vals[bdd_reg_var(REG_A, k)] & 1) << k);
+    }
+    for (int k = 0; k < 16; k++) z.sp |= (uint16_t)((vals[bdd_sp_var(k)] & 1) << k);
+    return z;
+}
+
+// Prove or refute equivalence over the whole domain.
+// Returns 1 = equivalent, 0 = not (a differing input goes to *cex if given),
+// -1 = node budget exceeded (no verdict).
+static int bdd_prove_equivalent(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags, const int* extra, int nextra, bool sweep_sp,
+    Z80State* cex = nullptr
+) {
+    static thread_local BddMgr mgr;
+    mgr.reset();
+    BddMgr* saved = bdd_cur;
+    bdd_cur = &mgr;
+
+    // Flag BDDs nobody observes (dead at the end, never read) are not built.
+    uint8_t t_need[BS_MAX_DEMAND], c_need[BS_MAX_DEMAND];
+    bool demand = t_n <= BS_MAX_DEMAND && c_n <= BS_MAX_DEMAND;
+    if (demand) {
+        h_flag_demand(t_ops, t_n, (uint8_t)~dead_flags, t_need);
+        h_flag_demand(c_ops, c_n, (uint8_t)~dead_flags, c_need);
+    }
+
+    BsStateT<BddRef> st, sc;
+    bdd_input_state(mgr, st, extra, nextra, sweep_sp);
+    sc = st;
+    bs_exec_seq(st, t_ops, t_imms, t_n, demand ? t_need : nullptr);
+    bs_exec_seq(sc, c_ops, c_imms, c_n, demand ? c_need : nullptr);
+
+    int verdict = 1;
+    BddRef diff = {BDD_FALSE};
+    for (int r = 0; r < 8 && verdict == 1; r++)
+        for (int k = 0; k < 8; k++) {
+            if (r == REG_F && ((dead_flags >> k) & 1)) continue;
+            if (st.r[r][k].id != sc.r[r][k].id) { verdict = 0; diff = st.r[r][k] ^ sc.r[r][k]; break; }
+        }
+    for (int k = 0; k < 16 && verdict == 1; k++)
+        if (st.sp[k].id != sc.sp[k].id) { verdict = 0; diff = st.sp[k] ^ sc.sp[k]; }
+    if (mgr.overflow) verdict = -1;
+    else if (verdict == 0 && cex) {
+        uint8_t vals[BDD_NUM_VARS];
+        memset(vals, 0, sizeof(vals));
+        mgr.any_sat(diff.id, vals);
+        *cex = bdd_assignment_state(vals);
+    }
+    bdd_cur = saved;
+    return verdict;
+}
+
+// ============================================================
+// Symbolic immediates
+// ============================================================
+// An immediate operand IMM_SYM + i is symbol i of the sequence pair rather
+// than a value: 16 free bits (8-bit instructions read the low 8).
+#define IMM_SYM 0x100
+#define IMM_SYMS 3
+
+// For all values of the non-immediate variables: quantifies the machine state
+// out of f, leaving a function of the immediates. memo covers f's nodes.
+static uint32_t bdd_forall_state(BddMgr &m, uint32_t f, std::vector<uint32_t> &memo) {
+    if (f <= BDD_TRUE) return f;
+    if (memo[f] != UINT32_MAX) return memo[f];
+    BddMgr::Node n = m.nodes[f];
+    uint32_t lo = bdd_forall_state(m, n.lo, memo), r;
+    if (bdd_is_imm_var(n.var)) r = m.mk(n.var, lo, bdd_forall_state(m, n.hi, memo));
+    else r = lo == BDD_FALSE ? BDD_FALSE : m.ite(lo, bdd_forall_state(m, n.hi, memo), BDD_FALSE);
+    return memo[f] = r;
+}
+
+static bool bdd_eval(const BddMgr &m, uint32_t f, const uint8_t* vals) {
+    while (f > BDD_TRUE) f = vals[m.nodes[f].var] ? m.nodes[f].hi : m.nodes[f].lo;
+    return f == BDD_TRUE;
+}
+
+// bdd_prove_equivalent with symbolic immediates. Returns 1 = equivalent for
+// every value of the symbols, 2 = for some, 0 = for none, -1 = over budget.
+// cond (if given) gets, for each of the 1 << cond_bits values of symbol 0
+// with the other symbols 0, whether the pair is equivalent.
+static int bdd_prove_symbolic(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags, const int* extra, int nextra, bool sweep_sp,
+    int cond_bits = 0, uint8_t* cond = nullptr
+) {
+    static thread_local BddMgr mgr;
+    mgr.reset();
+    BddMgr* saved = bdd_cur;
+    bdd_cur = &mgr;
+
+    uint8_t t_need[BS_MAX_DEMAND], c_need[BS_MAX_DEMAND];
+    bool demand = t_n <= BS_MAX_DEMAND && c_n <= BS_MAX_DEMAND;
+    if (demand) {
+        h_flag_demand(t_ops, t_n, (uint8_t)~dead_flags, t_need);
+        h_flag_demand(c_ops, c_n, (uint8_t)~dead_flags, c_need);
+    }
+    BddRef sym[IMM_SYMS][16];
+    for (int i = 0; i < IMM_SYMS; i++)
+        for (int k = 0; k < 16; k++) sym[i][k] = {mgr.ithvar(bdd_imm_var(i, k))};
+
+    BsStateT<BddRef> st, sc;
+    bdd_input_state(mgr, st, extra, nextra, sweep_sp);
+    sc = st;
+    for (int i = 0; i < t_n; i++)
+        bs_exec_instruction(st, t_ops[i], t_imms[i], demand ? t_need[i] : (uint8_t)0xFF,
+                            t_imms[i] >= IMM_SYM ? sym[t_imms[i] - IMM_SYM] : nullptr);
+    for (int i = 0; i < c_n; i++)
+        bs_exec_instruction(sc, c_ops[i], c_imms[i], demand ? c_need[i] : (uint8_t)0xFF,
+                            c_imms[i] >= IMM_SYM ? sym[c_imms[i] - IMM_SYM] : nullptr);
+
+    BddRef diff = {BDD_FALSE};
+    for (int r = 0; r < 8; r++)
+        for (int k = 0; k < 8; k++) {
+            if (r == REG_F && ((dead_flags >> k) & 1)) continue;
+            if (st.r[r][k].id != sc.r[r][k].id) diff = diff | (st.r[r][k] ^ sc.r[r][k]);
+        }
+    for (int k = 0; k < 16; k++)
+        if (st.sp[k].id != sc.sp[k].id) diff = diff | (st.sp[k] ^ sc.sp[k]);
+
+    BddRef same = ~diff;
+    int verdict = -1;
+    if (!mgr.overflow) {
+        std::vector<uint32_t> memo(mgr.nodes.size(), UINT32_MAX);
+        uint32_t valid = bdd_forall_state(mgr, same.id, memo);
+        if (!mgr.overflow) {
+            verdict = valid == BDD_TRUE ? 1 : valid == BDD_FALSE ? 0 : 2;
+            if (cond) {
+                uint8_t vals[BDD_NUM_VARS];
+                memset(vals, 0, sizeof(vals));
+                for (uint32_t x = 0; x < (1u << cond_bits); x++) {
+                    for (int k = 0; k < cond_bits; k++) vals[bdd_imm_var(0, k)] = (uint8_t)((x >> k) & 1);
+                    cond[x] = bdd_eval(mgr, valid, vals);
+                }
+            }
+        }
+    }
+    bdd_cur = saved;
+    return verdict;
+}
@@ -0,0 +1,501 @@
+// Bit-sliced 256-lane Z80 executor for host-side ExhaustiveCheck.
+//
+// Every register bit is a 256-bit plane; lane i of a plane is that bit in the
+// i-th of 256 independent machine states. ExhaustiveCheck loads A = lane
+// index, so one pass executes a sequence for all 256 A values at once and an
+// instruction costs a few dozen plane operations instead of 256 calls to
+// h_exec_instruction. All 394 opcodes are written as boolean logic over the
+// planes (ripple adders for arithmetic, plane moves for shifts and loads) and
+// are checked bit-exact against h_exec_instruction by z80search_cpu --test.
+//
+// Planes are __m256i under AVX2 (three-input ops fold into vpternlog with
+// AVX-512VL) and four uint64_t otherwise, so the header builds anywhere.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "z80_common.h"
+
+#define BS_LANES 256
+
+// ============================================================
+// 256-bit plane
+// ============================================================
+#if defined(__AVX2__)
+struct BsLane { __m256i v; };
+static inline BsLane operator&(BsLane a, BsLane b) { return {_mm256_and_si256(a.v, b.v)}; }
+static inline BsLane operator|(BsLane a, BsLane b) { return {_mm256_or_si256(a.v, b.v)}; }
+static inline BsLane operator^(BsLane a, BsLane b) { return {_mm256_xor_si256(a.v, b.v)}; }
+static inline BsLane operator~(BsLane a) { return {_mm256_xor_si256(a.v, _mm256_set1_epi64x(-1))}; }
+static inline BsLane bs_const(bool one) { return {_mm256_set1_epi64x(one ? -1 : 0)}; }
+static inline bool bs_any(BsLane a) { return !_mm256_testz_si256(a.v, a.v); }
+static inline BsLane bs_load(const uint64_t w[4]) { return {_mm256_loadu_si256((const __m256i*)w)}; }
+static inline void bs_store(BsLane a, uint64_t w[4]) { _mm256_storeu_si256((__m256i*)w, a.v); }
+#if defined(__AVX512VL__)
+static inline BsLane bs_mux(BsLane s, BsLane a, BsLane b) { return {_mm256_ternarylogic_epi64(s.v, a.v, b.v, 0xCA)}; }
+static inline BsLane bs_maj(BsLane a, BsLane b, BsLane c) { return {_mm256_ternarylogic_epi64(a.v, b.v, c.v, 0xE8)}; }
+static inline BsLane bs_xor3(BsLane a, BsLane b, BsLane c) { return {_mm256_ternarylogic_epi64(a.v, b.v, c.v, 0x96)}; }
+#endif
+#else
+struct BsLane { uint64_t w[4]; };
+#define BS_MAP2(expr) BsLane r; for (int i = 0; i < 4; i++) r.w[i] = (expr); return r
+static inline BsLane operator&(BsLane a, BsLane b) { BS_MAP2(a.w[i] & b.w[i]); }
+static inline BsLane operator|(BsLane a, BsLane b) { BS_MAP2(a.w[i] | b.w[i]); }
+static inline BsLane operator^(BsLane a, BsLane b) { BS_MAP2(a.w[i] ^ b.w[i]); }
+static inline BsLane operator~(BsLane a) { BS_MAP2(~a.w[i]); }
+static inline BsLane bs_const(bool one) { BS_MAP2(one ? ~0ull : 0ull); }
+#undef BS_MAP2
+static inline bool bs_any(BsLane a) { return (a.w[0] | a.w[1] | a.w[2] | a.w[3]) != 0; }
+static inline BsLane bs_load(const uint64_t w[4]) { BsLane r; memcpy(r.w, w, 32); return r; }
+static inline void bs_store(BsLane a, uint64_t w[4]) { memcpy(w, a.w, 32); }
+#endif
+
+#if !defined(__AVX2__) || !defined(__AVX512VL__)
+static inline BsLane bs_mux(BsLane s, BsLane a, BsLane b) { return (s & a) | (~s & b); }
+static inline BsLane bs_maj(BsLane a, BsLane b, BsLane c) { return (a & b) | (c & (a | b)); }
+static inline BsLane bs_xor3(BsLane a, BsLane b, BsLane c) { return a ^ b ^ c; }
+#endif
+
+// Constant plane of any plane type (the executor below is also run over
+// BDD nodes by z80_bdd.h, which specialises this).
+template<class L> L bs_k(bool one);
+template<> inline BsLane bs_k<BsLane>(bool one) { return bs_const(one); }
+
+// ============================================================
+// Bit-sliced state: r[reg][bit], sp[bit]
+// ============================================================
+template<class L> struct BsStateT {
+    L r[8][8];
+    L sp[16];
+};
+typedef BsStateT<BsLane> BsState;
+
+// Plane k of the lane index (lane i has bit k of i set), i.e. A = lane.
+static BsLane bs_lane_index_plane(int k) {
+    static const uint64_t pat[6] = {
+        0xAAAAAAAAAAAAAAAAull, 0xCCCCCCCCCCCCCCCCull, 0xF0F0F0F0F0F0F0F0ull,
+        0xFF00FF00FF00FF00ull, 0xFFFF0000FFFF0000ull, 0xFFFFFFFF00000000ull,
+    };
+    uint64_t w[4];
+    for (int i = 0; i < 4; i++)
+        w[i] = k < 6 ? pat[k] : (((i >> (k - 6)) & 1) ? ~0ull : 0ull);
+    return bs_load(w);
+}
+
+template<class L> static inline void bs_set_const8(L p[8], uint8_t v) {
+    for (int k = 0; k < 8; k++) p[k] = bs_k<L>((v >> k) & 1);
+}
+
+// Broadcast one scalar state to every lane.
+static void bs_broadcast(BsState &s, const Z80State &z) {
+    for (int r = 0; r < 8; r++) bs_set_const8(s.r[r], z.r[r]);
+    for (int k = 0; k < 16; k++) s.sp[k] = bs_const((z.sp >> k) & 1);
+}
+
+// Load 256 arbitrary scalar states, one per lane (tests and diagnostics).
+static void bs_set_lanes(BsState &s, const Z80State* z) {
+    uint64_t w[4];
+    for (int r = 0; r < 8; r++)
+        for (int k = 0; k < 8; k++) {
+            memset(w, 0, sizeof(w));
+            for (int l = 0; l < BS_LANES; l++) w[l >> 6] |= (uint64_t)((z[l].r[r] >> k) & 1) << (l & 63);
+            s.r[r][k] = bs_load(w);
+        }
+    for (int k = 0; k < 16; k++) {
+        memset(w, 0, sizeof(w));
+        for (int l = 0; l < BS_LANES; l++) w[l >> 6] |= (uint64_t)((z[l].sp >> k) & 1) << (l & 63);
+        s.sp[k] = bs_load(w);
+    }
+}
+
+// Extract one lane as a scalar state (tests and diagnostics).
+static Z80State bs_get_lane(const BsState &s, int lane) {
+    Z80State z = {};
+    uint64_t w[4];
+    for (int r = 0; r < 8; r++)
+        for (int k = 0; k < 8; k++) {
+            bs_store(s.r[r][k], w);
+            if ((w[lane >> 6] >> (lane & 63)) & 1) z.r[r] |= (uint8_t)(1 << k);
+        }
+    for (int k = 0; k < 16; k++) {
+        bs_store(s.sp[k], w);
+        if ((w[lane >> 6] >> (lane & 63)) & 1) z.sp |= (uint16_t)(1 << k);
+    }
+    return z;
+}
+
+// ============================================================
+// Arithmetic building blocks
+// ============================================================
+
+// out = a + b + cin over n bits; cy[i] = carry out of bit i.
+template<class L> static inline void bs_add(const L* a, const L* b, L cin, int n, L* out, L* cy) {
+    L c = cin;
+    for (int i = 0; i < n; i++) {
+        out[i] = bs_xor3(a[i], b[i], c);
+        c = bs_maj(a[i], b[i], c);
+        cy[i] = c;
+    }
+}
+
+// out = a - b - bin over n bits; bw[i] = borrow out of bit i.
+template<class L> static inline void bs_sub(const L* a, const L* b, L bin, int n, L* out, L* bw) {
+    L c = bin;
+    for (int i = 0; i < n; i++) {
+        out[i] = bs_xor3(a[i], b[i], c);
+        c = bs_maj(~a[i], b[i], c);
+        bw[i] = c;
+    }
+}
+
+template<class L> static inline L bs_is_zero8(const L* v) {
+    return ~(v[0] | v[1] | v[2] | v[3] | v[4] | v[5] | v[6] | v[7]);
+}
+
+template<class L> static inline L bs_parity8(const L* v) {  // FLAG_P: set on even parity
+    return ~(v[0] ^ v[1] ^ v[2] ^ v[3] ^ v[4] ^ v[5] ^ v[6] ^ v[7]);
+}
+
+// F = sz53(v) (| parity when with_p); other flag planes left to the caller.
+// Z and P are only formed when in need (see h_flag_demand).
+template<class L> static inline void bs_flags_sz53(L f[8], const L* v, bool with_p, uint8_t need) {
+    f[7] = v[7]; f[5] = v[5]; f[3] = v[3];
+    if (need & FLAG_Z) f[6] = bs_is_zero8(v);
+    if (with_p && (need & FLAG_P)) f[2] = bs_parity8(v);
+}
+
+template<class L> static void bs_alu_addsub(BsStateT<L> &s, const L* val, bool sub, bool use_carry, bool store,
+                                            uint8_t need) {
+    L* a = s.r[REG_A];
+    L* f = s.r[REG_F];
+    L cin = use_carry ? f[0] : bs_k<L>(false);
+    L res[8], cy[8];
+    if (sub) bs_sub(a, val, cin, 8, res, cy); else bs_add(a, val, cin, 8, res, cy);
+    f[0] = cy[7];
+    f[1] = bs_k<L>(sub);
+    if (need & FLAG_V) f[2] = cy[6] ^ cy[7];
+    f[4] = cy[3];
+    if (store) {
+        for (int k = 0; k < 8; k++) a[k] = res[k];
+        bs_flags_sz53(f, res, false, need);
+    } else {  // CP: S and Z from the result, 3 and 5 from the operand
+        f[7] = res[7]; f[5] = val[5]; f[3] = val[3];
+        if (need & FLAG_Z) f[6] = bs_is_zero8(res);
+    }
+}
+
+template<class L> static void bs_alu_logic(BsStateT<L> &s, const L* val, int kind, uint8_t need) {  // 0=AND 1=XOR 2=OR
+    L* a = s.r[REG_A];
+    L* f = s.r[REG_F];
+    for (int k = 0; k < 8; k++)
+        a[k] = kind == 0 ? (a[k] & val[k]) : kind == 1 ? (a[k] ^ val[k]) : (a[k] | val[k]);
+    f[0] = bs_k<L>(false); f[1] = bs_k<L>(false); f[4] = bs_k<L>(kind == 0);
+    bs_flags_sz53(f, a, true, need);
+}
+
+template<class L> static void bs_inc8(BsStateT<L> &s, int reg, uint8_t need) {
+    L* v = s.r[reg];
+    L* f = s.r[REG_F];
+    L c = bs_k<L>(true);
+    for (int k = 0; k < 8; k++) { L t = v[k] & c; v[k] = v[k] ^ c; c = t; }
+    f[1] = bs_k<L>(false);
+    if (need & FLAG_V) f[2] = v[7] & ~(v[6] | v[5] | v[4] | v[3] | v[2] | v[1] | v[0]);  // == 0x80
+    if (need & FLAG_H) f[4] = ~(v[3] | v[2] | v[1] | v[0]);                              // low nibble wrapped
+    bs_flags_sz53(f, v, false, need);
+}
+
+template<class L> static void bs_dec8(BsStateT<L> &s, int reg, uint8_t need) {
+    L* v = s.r[reg];
+    L* f = s.r[REG_F];
+    if (need & FLAG_H) f[4] = ~(v[3] | v[2] | v[1] | v[0]);          // old low nibble was 0
+    L b = bs_k<L>(true);
+    for (int k = 0; k < 8; k++) { L t = ~v[k] & b; v[k] = v[k] ^ b; b = t; }
+    f[1] = bs_k<L>(true);
+    if (need & FLAG_V) f[2] = ~v[7] & v[6] & v[5] & v[4] & v[3] & v[2] & v[1] & v[0];    // == 0x7F
+    bs_flags_sz53(f, v, false, need);
+}
+
+// CB rotate/shift group on one register. kind: 0 RLC 1 RRC 2 RL 3 RR 4 SLA 5 SRA 6 SRL 7 SLL
+template<class L> static void bs_cb_shift(BsStateT<L> &s, int reg, int kind, uint8_t need) {
+    L* v = s.r[reg];
+    L* f = s.r[REG_F];
+    L o[8];
+    for (int k = 0; k < 8; k++) o[k] = v[k];
+    bool left = kind == 0 || kind == 2 || kind == 4 || kind == 7;
+    L fill;
+    switch (kind) {
+        case 0: fill = o[7]; break;
+        case 1: fill = o[0]; break;
+        case 2: case 3: fill = f[0]; break;
+        case 5: fill = o[7]; break;
+        case 7: fill = bs_k<L>(true); break;
+        default: fill = bs_k<L>(false); break;
+    }
+    if (left) { for (int k = 7; k > 0; k--) v[k] = o[k-1]; v[0] = fill; f[0] = o[7]; }
+    else      { for (int k = 0; k < 7; k++) v[k] = o[k+1]; v[7] = fill; f[0] = o[0]; }
+    f[1] = bs_k<L>(false); f[4] = bs_k<L>(false);
+    bs_flags_sz53(f, v, true, need);
+}
+
+// 16-bit register pair as 16 plane pointers (low byte first).
+template<class L> static inline void bs_pair_ptrs(BsStateT<L> &s, int pair, L* p[16]) {
+    if (pair == 3) { for (int k = 0; k < 16; k++) p[k] = &s.sp[k]; return; }
+    static const int hi[3] = {REG_B, REG_D, REG_H}, lo[3] = {REG_C, REG_E, REG_L};
+    for (int k = 0; k < 8; k++) { p[k] = &s.r[lo[pair]][k]; p[k+8] = &s.r[hi[pair]][k]; }
+}
+
+// ADD/ADC/SBC HL,rr. kind: 0 ADD 1 ADC 2 SBC
+template<class L> static void bs_hl_arith(BsStateT<L> &s, int pair, int kind, uint8_t need) {
+    L *hp[16], *vp[16];
+    bs_pair_ptrs(s, 2, hp);
+    bs_pair_ptrs(s, pair, vp);
+    L hl[16], val[16], res[16], cy[16];
+    for (int k = 0; k < 16; k++) { hl[k] = *hp[k]; val[k] = *vp[k]; }
+    L* f = s.r[REG_F];
+    L cin = kind == 0 ? bs_k<L>(false) : f[0];
+    if (kind == 2) bs_sub(hl, val, cin, 16, res, cy); else bs_add(hl, val, cin, 16, res, cy);
+    for (int k = 0; k < 16; k++) *hp[k] = res[k];
+    f[0] = cy[15];
+    f[1] = bs_k<L>(kind == 2);
+    f[3] = res[11];
+    f[4] = cy[11];
+    f[5] = res[13];
+    if (kind != 0) {  // ADD HL keeps S, Z, P/V
+        if (need & FLAG_V) f[2] = cy[14] ^ cy[15];
+        if (need & FLAG_Z) f[6] = ~(res[0] | res[1] | res[2] | res[3] | res[4] | res[5] | res[6] | res[7]) & bs_is_zero8(res + 8);
+        f[7] = res[15];
+    }
+}
+
+template<class L> static void bs_exec_daa(BsStateT<L> &s, uint8_t need) {
+    L* a = s.r[REG_A];
+    L* f = s.r[REG_F];
+    L low_gt9 = a[3] & (a[2] | a[1]);
+    L a_gt99 = (a[7] & (a[6] | a[5])) | (a[7] & a[4] & low_gt9);
+    L add_lo = f[4] | low_gt9;           // + 0x06
+    L add_hi = f[0] | a_gt99;            // + 0x60
+    L carry = f[0] | a_gt99;
+    L z = bs_k<L>(false);
+    L adj[8] = {z, add_lo, add_lo, z, z, add_hi, add_hi, z};
+    L ra[8], ca[8], rs[8], cs[8];
+    bs_add(a, adj, z, 8, ra, ca);
+    bs_sub(a, adj, z, 8, rs, cs);
+    L n = f[1];
+    for (int k = 0; k < 8; k++) a[k] = bs_mux(n, rs[k], ra[k]);
+    f[4] = bs_mux(n, cs[3], ca[3]);
+    f[0] = carry;
+    bs_flags_sz53(f, a, true, need);
+}
+
+// ============================================================
+// Instruction executor (mirrors h_exec_instruction)
+// Flag planes outside `need` may be left stale instead of computed; pass the
+// h_flag_demand mask only when nothing later reads them. imm_bits, if given,
+// are the immediate's planes (low 8 for imm8) in place of the constant imm.
+// ============================================================
+template<class L> static void bs_exec_instruction(BsStateT<L> &s, uint16_t op, uint16_t imm, uint8_t need = 0xFF,
+                                                  const L* imm_bits = nullptr) {
+    L* f = s.r[REG_F];
+    if (op < 49) {
+        int d = LD_DST_H[op / 7], src = LD_FULL_SRC_H[op];
+        if (d != src) for (int k = 0; k < 8; k++) s.r[d][k] = s.r[src][k];
+        return;
+    }
+    if (op < 56) {
+        if (imm_bits) for (int k = 0; k < 8; k++) s.r[IMM_REG_H[op - 49]][k] = imm_bits[k];
+        else bs_set_const8(s.r[IMM_REG_H[op - 49]], (uint8_t)imm);
+        return;
+    }
+    if (op < 120) {
+        int alu_op = (op - 56) / 8, src_idx = (op - 56) % 8;
+        L val[8];
+        if (src_idx < 7) for (int k = 0; k < 8; k++) val[k] = s.r[ALU_SRC_H[src_idx]][k];
+        else if (imm_bits) for (int k = 0; k < 8; k++) val[k] = imm_bits[k];
+        else bs_set_const8(val, (uint8_t)imm);
+        switch (alu_op) {
+            case 0: bs_alu_addsub(s, val, false, false, true, need); break;
+            case 1: bs_alu_addsub(s, val, false, true, true, need); break;
+            case 2: bs_alu_addsub(s, val, true, false, true, need); break;
+            case 3: bs_alu_addsub(s, val, true, true, true, need); break;
+            case 4: bs_alu_logic(s, val, 0, need); break;
+            case 5: bs_alu_logic(s, val, 1, need); break;
+            case 6: bs_alu_logic(s, val, 2, need); break;
+            case 7: bs_alu_addsub(s, val, true, false, false, need); break;
+        }
+        return;
+    }
+    if (op < 127) { bs_inc8(s, INCDEC_REG_H[op - 120], need); return; }
+    if (op < 134) { bs_dec8(s, INCDEC_REG_H[op - 127], need); return; }
+    if (op >= OP_RLCA && op <= OP_RRA) {
+        // Accumulator rotates: S, Z, P/V kept; H = N = 0; 3, 5 from the new A.
+        L* a = s.r[REG_A];
+        L o[8];
+        for (int k = 0; k < 8; k++) o[k] = a[k];
+        if (op == OP_RLCA || op == OP_RLA) {
+            for (int k = 7; k > 0; k--) a[k] = o[k-1];
+            a[0] = op == OP_RLCA ? o[7] : f[0];
+            f[0] = o[7];
+        } else {
+            for (int k = 0; k < 7; k++) a[k] = o[k+1];
+            a[7] = op == OP_RRCA ? o[0] : f[0];
+            f[0] = o[0];
+        }
+        f[1] = bs_k<L>(false); f[4] = bs_k<L>(false);
+        f[3] = a[3]; f[5] = a[5];
+        return;
+    }
+    if (op == OP_DAA) { bs_exec_daa(s, need); return; }
+    if (op == OP_CPL) {
+        L* a = s.r[REG_A];
+        for (int k = 0; k < 8; k++) a[k] = ~a[k];
+        f[1] = bs_k<L>(true); f[4] = bs_k<L>(true); f[3] = a[3]; f[5] = a[5];
+        return;
+    }
+    if (op == OP_SCF) {
+        f[0] = bs_k<L>(true); f[1] = bs_k<L>(false); f[4] = bs_k<L>(false);
+        f[3] = s.r[REG_A][3]; f[5] = s.r[REG_A][5];
+        return;
+    }
+    if (op == OP_CCF) {
+        L c = f[0];
+        f[0] = ~c; f[1] = bs_k<L>(false); f[4] = c;
+        f[3] = s.r[REG_A][3]; f[5] = s.r[REG_A][5];
+        return;
+    }
+    if (op == OP_NEG) {
+        L zero[8], val[8];
+        for (int k = 0; k < 8; k++) { val[k] = s.r[REG_A][k]; zero[k] = bs_k<L>(false); }
+        for (int k = 0; k < 8; k++) s.r[REG_A][k] = zero[k];
+        bs_alu_addsub(s, val, true, false, true, need);
+        return;
+    }
+    if (op == OP_NOP) return;
+    if (op >= OP_CB_START && op <= 192) {
+        int idx = op - OP_CB_START;
+        bs_cb_shift(s, CB_REG_H[idx % 7], idx / 7, need);
+        return;
+    }
+    if (op == OP_SLL_A) { bs_cb_shift(s, REG_A, 7, need); return; }
+    if (op >= OP_SLL_B_START && op < OP_BIT_START) { bs_cb_shift(s, CB_REG_H[(op - OP_SLL_B_START) + 1], 7, need); return; }
+    if (op >= OP_BIT_START && op < OP_RES_START) {
+        int idx = op - OP_BIT_START, bit = idx / 7;
+        L* v = s.r[CB_REG_H[idx % 7]];
+        L clear = ~v[bit];
+        f[1] = bs_k<L>(false); f[4] = bs_k<L>(true);
+        f[3] = v[3]; f[5] = v[5];
+        f[2] = clear; f[6] = clear;
+        f[7] = bit == 7 ? v[7] : bs_k<L>(false);
+        return;
+    }
+    if (op >= OP_RES_START && op < OP_SET_START) { int idx = op - OP_RES_START; s.r[CB_REG_H[idx % 7]][idx / 7] = bs_k<L>(false); return; }
+    if (op >= OP_SET_START && op < OP_16INC_START) { int idx = op - OP_SET_START; s.r[CB_REG_H[idx % 7]][idx / 7] = bs_k<L>(true); return; }
+    if (op >= OP_16INC_START && op < OP_ADD_HL_START) {
+        int idx = op - OP_16INC_START;
+        bool dec = idx >= 4;
+        L* p[16];
+        bs_pair_ptrs(s, idx % 4, p);
+        L c = bs_k<L>(true);
+        for (int k = 0; k < 16; k++) {
+            L t = (dec ? ~*p[k] : *p[k]) & c;
+            *p[k] = *p[k] ^ c;
+            c = t;
+        }
+        return;
+    }
+    if (op >= OP_ADD_HL_START && op < OP_EX_DE_HL) { bs_hl_arith(s, op - OP_ADD_HL_START, 0, need); return; }
+    if (op == OP_EX_DE_HL) {
+        for (int k = 0; k < 8; k++) {
+            L t = s.r[REG_D][k]; s.r[REG_D][k] = s.r[REG_H][k]; s.r[REG_H][k] = t;
+            t = s.r[REG_E][k]; s.r[REG_E][k] = s.r[REG_L][k]; s.r[REG_L][k] = t;
+        }
+        return;
+    }
+    if (op == OP_LD_SP_HL) {
+        for (int k = 0; k < 8; k++) { s.sp[k] = s.r[REG_L][k]; s.sp[k+8] = s.r[REG_H][k]; }
+        return;
+    }
+    if (op >= OP_LD_RR_NN_START && op < OP_ADC_HL_START) {
+        L* p[16];
+        bs_pair_ptrs(s, op - OP_LD_RR_NN_START, p);
+        for (int k = 0; k < 16; k++) *p[k] = imm_bits ? imm_bits[k] : bs_k<L>((imm >> k) & 1);
+        return;
+    }
+    if (op >= OP_ADC_HL_START && op < OP_SBC_HL_START) { bs_hl_arith(s, op - OP_ADC_HL_START, 1, need); return; }
+    if (op >= OP_SBC_HL_START && op < OP_COUNT) { bs_hl_arith(s, op - OP_SBC_HL_START, 2, need); return; }
+}
+
+#define BS_MAX_DEMAND 8   // longest sequence given a flag-demand plan
+
+// need: per-instruction flag demand (h_flag_demand), or null for every flag.
+template<class L> static void bs_exec_seq(BsStateT<L> &s, const uint16_t* ops, const uint16_t* imms, int n,
+                                          const uint8_t* need = nullptr) {
+    for (int i = 0; i < n; i++) bs_exec_instruction(s, ops[i], imms[i], need ? need[i] : (uint8_t)0xFF);
+}
+
+// Lanes where the two states differ (dead flag bits ignored).
+static inline BsLane bs_diff(const BsState &a, const BsState &b, uint8_t dead_flags) {
+    BsLane d = bs_const(false);
+    for (int r = 0; r < 8; r++)
+        for (int k = 0; k < 8; k++) {
+            if (r == REG_F && ((dead_flags >> k) & 1)) continue;
+            d = d | (a.r[r][k] ^ b.r[r][k]);
+        }
+    for (int k = 0; k < 16; k++) d = d | (a.sp[k] ^ b.sp[k]);
+    return d;
+}
+
+// ============================================================
+// ExhaustiveCheck sweep, 256 A values per pass
+// The caller decodes the input domain exactly as the scalar checks do:
+// extra[] are the other registers read (REG_B..REG_L), swept over all 256
+// values when there are at most two and SP is not read, otherwise over
+// rep_values (and SP over rep_sp). A and carry are always swept in full.
+// ============================================================
+static bool bs_exhaustive_sweep(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags, const int* extra, int nextra, bool sweep_sp,
+    const uint8_t rep_values[32], const uint16_t rep_sp[16]
+) {
+    bool full = nextra <= 2 && !sweep_sp;
+    int per_reg = full ? 256 : 32;
+    int nsp = sweep_sp ? 16 : 1;
+
+    BsState base;
+    Z80State zero = {};
+    bs_broadcast(base, zero);
+    for (int k = 0; k < 8; k++) base.r[REG_A][k] = bs_lane_index_plane(k);
+
+    // Only the live flags, and the flags read on the way to them, are formed.
+    uint8_t t_need[BS_MAX_DEMAND], c_need[BS_MAX_DEMAND];
+    bool demand = t_n <= BS_MAX_DEMAND && c_n <= BS_MAX_DEMAND;
+    if (demand) {
+        h_flag_demand(t_ops, t_n, (uint8_t)~dead_flags, t_need);
+        h_flag_demand(c_ops, c_n, (uint8_t)~dead_flags, c_need);
+    }
+
+    int vi[6] = {0, 0, 0, 0, 0, 0};
+    for (int carry = 0; carry <= 1; carry++) {
+        base.r[REG_F][0] = bs_const(carry);
+        for (;;) {
+            for (int e = 0; e < nextra; e++)
+                bs_set_const8(base.r[extra[e]], full ? (uint8_t)vi[e] : rep_values[vi[e]]);
+            for (int si = 0; si < nsp; si++) {
+                if (sweep_sp) for (int k = 0; k < 16; k++) base.sp[k] = bs_const((rep_sp[si] >> k) & 1);
+                BsState st = base, sc = base;
+                bs_exec_seq(st, t_ops, t_imms, t_n, demand ? t_need : nullptr);
+                bs_exec_seq(sc, c_ops, c_imms, c_n, demand ? c_need : nullptr);
+                if (bs_any(bs_diff(st, sc, dead_flags))) return false;
+            }
+            int e = 0;  // odometer over the extra registers
+            while (e < nextra && ++vi[e] == per_reg) vi[e++] = 0;
+            if (e == nextra) break;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+// Crash-safe sweep checkpoints for the standalone search drivers.
+//
+// A checkpoint is taken at a batch boundary, right after a flush, so the
+// pending batch is empty and the whole search state is the enumeration
+// cursor (the next target to enumerate), the counters, and how many bytes of
+// results stdout held at that point. Saving flushes and fsyncs stdout first,
+// then writes the checkpoint to FILE.tmp, fsyncs it and renames it over
+// FILE, so FILE is always either the old or the new checkpoint, never a torn
+// one, and never ahead of the results it accounts for.
+//
+// On resume the driver truncates stdout back to the recorded size (dropping
+// results emitted after the checkpoint, which will be found again) and
+// continues from the cursor, so every result is written exactly once. That
+// needs stdout to be a regular file opened for append (">> out.jsonl").
+//
+// Used by z80_search_v2.cu (--resume FILE).
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "z80_common.h"
+
+#define CKPT_MAGIC   "Z80CKPT"
+#define CKPT_VERSION 4
+
+struct SweepCheckpoint {
+    char     magic[8];
+    uint32_t version;
+    uint32_t size;            // sizeof(SweepCheckpoint)
+    uint64_t vectors_hash;    // QuickCheck vectors of the run
+
+    // Run configuration; a resume must match it exactly.
+    int32_t  max_target;
+    int32_t  first_op_start, first_op_end;
+    uint32_t cand_count;
+    uint8_t  dead_flags;
+    uint8_t  no_exhaust;
+    uint8_t  done;            // sweep finished; resuming does nothing
+    uint8_t  binary;          // stdout holds ResultRecords (z80_results.h)
+
+    // Next target to enumerate: all_insts[i0], [i1], [i2] at target_len.
+    int32_t  target_len;
+    int32_t  i0, i1, i2;
+    uint8_t  symmetry;        // --symmetry (z80_symmetry.h)
+    uint8_t  subsume;         // --known-rules without --keep-subsumed (z80_subsume.h)
+    uint8_t  _pad1[2];
+
+    // Bytes of stdout covered by this checkpoint (absolute file offset).
+    uint64_t out_bytes;
+
+    // Counters, so progress and the final summary read as one run.
+    uint64_t total_found, total_targets, total_qc_hits, total_mid_hits;
+    uint64_t total_exhaust, total_cpu_exhaust, total_batches;
+    uint64_t targets_this, found_before;   // for the current target length
+    int64_t  elapsed, len_elapsed;         // seconds at checkpoint time
+    uint64_t known_hash;                   // loaded rule set when subsume is set
+    uint64_t total_subsumed;
+    uint64_t total_pruned[8];              // per PruneReason (z80_search_host.h)
+};
+
+static_assert(sizeof(SweepCheckpoint) == 240, "SweepCheckpoint layout");
+
+static inline void ckpt_init(SweepCheckpoint &c) {
+    memset(&c, 0, sizeof(c));
+    memcpy(c.magic, CKPT_MAGIC, 8);
+    c.version = CKPT_VERSION;
+    c.size = sizeof(SweepCheckpoint);
+    c.vectors_hash = h_test_vectors_hash();
+}
+
+// Flush and fsync out, then atomically replace path with c.
+static bool ckpt_save(const char* path, const SweepCheckpoint &c, FILE* out) {
+    if (fflush(out) != 0) return false;
+    fsync(fileno(out));   // EINVAL on pipes and ttys; nothing to make durable there
+    std::string tmp = std::string(path) + ".tmp";
+    int fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, &c, sizeof(c)) == (ssize_t)sizeof(c) && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) { remove(tmp.c_str()); return false; }
+    return true;
+}
+
+// 1 = loaded, 0 = no checkpoint yet, -1 = unreadable or from another build.
+static int ckpt_load(const char* path, SweepCheckpoint &c) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t n = fread(&c, 1, sizeof(c), f);
+    fclose(f);
+    const char* err = nullptr;
+    if (n != sizeof(c)) err = "truncated";
+    else if (memcmp(c.magic, CKPT_MAGIC, 8) != 0) err = "bad magic";
+    else if (c.version != CKPT_VERSION || c.size != sizeof(c)) err = "unsupported version";
+    else if (c.vectors_hash != h_test_vectors_hash()) err = "taken with different QuickCheck vectors";
+    if (err) { fprintf(stderr, "checkpoint: '%s': %s\n", path, err); return -1; }
+    return 1;
+}
+
+// Size of out if it is a regular file, else -1.
+static int64_t ckpt_output_size(FILE* out) {
+    struct stat st;
+    if (fstat(fileno(out), &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    return (int64_t)st.st_size;
+}
+
+// Cut out back to the checkpointed size so results after it are not repeated.
+static bool ckpt_rewind_output(FILE* out, uint64_t bytes) {
+    int64_t size = ckpt_output_size(out);
+    if (size < 0) {
+        fprintf(stderr, "checkpoint: stdout is not a regular file; results after the checkpoint "
+                        "(byte %llu) will be emitted again\n", (unsigned long long)bytes);
+        return true;
+    }
+    if ((uint64_t)size < bytes) {
+        fprintf(stderr, "checkpoint: stdout has %lld bytes but the checkpoint covers %llu "
+                        "(resume with '>>' onto the same output file)\n",
+                (long long)size, (unsigned long long)bytes);
+        return false;
+    }
+    fflush(out);
+    if (ftruncate(fileno(out), (off_t)bytes) != 0) return false;
+    return fseek(out, 0, SEEK_END) == 0;
+}
@@ -4,6 +4,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 // ============================================================
@@ -90,6 +91,17 @@ static const Z80State h_test_vectors[8] = {
     {{0x7F, 0x01, 0x80, 0x7F, 0x80, 0x7F, 0x80, 0x7F}, 0x7FFF},
 };
 
+// FNV-1a over the QuickCheck vectors, stamped into files whose contents
+// depend on them (len2 database, sweep checkpoints).
+static inline uint64_t h_test_vectors_hash() {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (int v = 0; v < NUM_VECTORS; v++) {
+        for (int r = 0; r < 8; r++) { h ^= h_test_vectors[v].r[r]; h *= 0x100000001B3ull; }
+        h ^= h_test_vectors[v].sp; h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
 // ============================================================
 // Flag tables (host)
 // ============================================================
@@ -283,8 +295,8 @@ static void h_set_pair(Z80State &s, int pair, uint16_t val) {
     }
 }
 
-// Full host-side instruction executor.
-static void h_exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
+// Full host-side instruction executor (branchy reference path).
+static void h_exec_instruction_ref(Z80State &s, uint16_t op, uint16_t imm) {
     if (op < 49) { s.r[LD_DST_H[op / 7]] = s.r[LD_FULL_SRC_H[op]]; return; }
     if (op < 56) { s.r[IMM_REG_H[op - 49]] = (uint8_t)imm; return; }
     if (op < 120) {
@@ -335,23 +347,391 @@ static void h_exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
     if (op >= OP_SBC_HL_START && op < OP_COUNT) { h_exec_sbc_hl(s, h_get_pair(s, op - OP_SBC_HL_START)); return; }
 }
 
+// (A,F) -> (A',F') transition tables for ops that only touch A and F, built
+// and installed by z80_aflut.h; t == nullptr means no table. Only the F bits
+// the op reads index the table, bits it passes through unchanged are OR'd
+// back from the input, and ALU A,n tables cover every immediate:
+//   e = t[(imm & imm_mask) * stride + (F & read) << 8 | A]
+//   A' = e >> 8, F' = (F & keep) | (e & 0xFF)
+// With h_af_lut_check set every lookup is also run through
+// h_exec_instruction_ref and a mismatch aborts.
+struct HAfLut {
+    const uint16_t* t;
+    uint32_t stride;
+    uint8_t read, keep, imm_mask;
+};
+static HAfLut h_af_lut[OP_COUNT];
+static bool h_af_lut_check = false;
+
+static inline uint32_t h_af_lut_index(const HAfLut &l, uint8_t a, uint8_t f, uint16_t imm) {
+    return (imm & l.imm_mask) * l.stride + ((uint32_t)(f & l.read) << 8) + a;
+}
+
+// Full host-side instruction executor: table fast path, else h_exec_instruction_ref.
+static void h_exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
+    const HAfLut &l = h_af_lut[op];
+    if (l.t) {
+        uint16_t e = l.t[h_af_lut_index(l, s.r[REG_A], s.r[REG_F], imm)];
+        uint8_t a = (uint8_t)(e >> 8), f = (uint8_t)((s.r[REG_F] & l.keep) | (e & 0xFF));
+        if (h_af_lut_check) {
+            Z80State ref = s;
+            h_exec_instruction_ref(ref, op, imm);
+            if (ref.r[REG_A] != a || ref.r[REG_F] != f) {
+                fprintf(stderr, "af-lut mismatch: op %u imm %u A=%02X F=%02X -> table %02X/%02X, ref %02X/%02X\n",
+                        op, imm, s.r[REG_A], s.r[REG_F], a, f, ref.r[REG_A], ref.r[REG_F]);
+                abort();
+            }
+        }
+        s.r[REG_A] = a;
+        s.r[REG_F] = f;
+        return;
+    }
+    h_exec_instruction_ref(s, op, imm);
+}
+
 // Execute a sequence of instructions.
 static void h_exec_seq(Z80State &s, const uint16_t* ops, const uint16_t* imms, int n) {
     for (int i = 0; i < n; i++) h_exec_instruction(s, ops[i], imms[i]);
 }
 
+// ============================================================
+// Structure-of-arrays state batches
+// N states stored as one lane array per register, so an instruction runs
+// across all of them as straight-line byte arithmetic that the compiler
+// vectorises: 8 lanes fill half an SSE register, 32 one AVX2 register. Flags
+// come from bit arithmetic, not the h_sz53p/h_halfcarry_* tables, since byte
+// table lookups cannot be vectorised. The results are bit-exact with
+// h_exec_instruction_ref; DAA is the only op still run lane by lane.
+// ============================================================
+template<int N>
+struct Z80StateBatch {
+    alignas(32) uint8_t r[8][N];    // r[REG_x][lane]
+    alignas(32) uint16_t sp[N];
+
+    void set(int l, const Z80State &s) { for (int k = 0; k < 8; k++) r[k][l] = s.r[k]; sp[l] = s.sp; }
+    Z80State get(int l) const { Z80State s; for (int k = 0; k < 8; k++) s.r[k] = r[k][l]; s.sp = sp[l]; return s; }
+    void load(const Z80State* s) { for (int l = 0; l < N; l++) set(l, s[l]); }
+};
+
+static inline uint8_t hb_sz53(uint8_t v) { return (uint8_t)((v & (FLAG_S | FLAG_3 | FLAG_5)) | (v == 0 ? FLAG_Z : 0)); }
+static inline uint8_t hb_parity(uint8_t v) { v ^= v >> 4; v ^= v >> 2; v ^= v >> 1; return (uint8_t)((~v & 1) << 2); }
+
+// Carry/borrow out of the top bit of a +/- b (+/- carry in) = r.
+static inline uint8_t hb_carry8(uint8_t a, uint8_t b, uint8_t r)  { return (uint8_t)(((a & b) | ((a | b) & ~r)) >> 7) & FLAG_C; }
+static inline uint8_t hb_borrow8(uint8_t a, uint8_t b, uint8_t r) { return (uint8_t)(((~a & b) | ((~a | b) & r)) >> 7) & FLAG_C; }
+static inline uint8_t hb_carry16(uint16_t a, uint16_t b, uint16_t r)  { return (uint8_t)((((a & b) | ((a | b) & ~r)) >> 15) & FLAG_C); }
+static inline uint8_t hb_borrow16(uint16_t a, uint16_t b, uint16_t r) { return (uint8_t)((((~a & b) | ((~a | b) & r)) >> 15) & FLAG_C); }
+
+template<int N>
+static void hb_get_pair(const Z80StateBatch<N> &b, int pair, uint16_t* out) {
+    if (pair == 3) { memcpy(out, b.sp, sizeof(b.sp)); return; }
+    const uint8_t *hi = b.r[REG_B + 2 * pair], *lo = b.r[REG_C + 2 * pair];
+    for (int l = 0; l < N; l++) { out[l] = (uint16_t)(hi[l] << 8 | lo[l]); }
+}
+
+template<int N>
+static void hb_set_pair(Z80StateBatch<N> &b, int pair, const uint16_t* in) {
+    if (pair == 3) { memcpy(b.sp, in, sizeof(b.sp)); return; }
+    uint8_t *hi = b.r[REG_B + 2 * pair], *lo = b.r[REG_C + 2 * pair];
+    for (int l = 0; l < N; l++) { hi[l] = (uint8_t)(in[l] >> 8); lo[l] = (uint8_t)in[l]; }
+}
+
+// 8-bit ALU op on A with operand lanes v (a copy, so v never aliases A).
+template<int N>
+static void hb_alu(Z80StateBatch<N> &b, int alu_op, const uint8_t* v) {
+    uint8_t *A = b.r[REG_A], *F = b.r[REG_F];
+    switch (alu_op) {
+        case 0: case 1: {
+            uint8_t cmask = alu_op == 1 ? FLAG_C : 0;
+            for (int l = 0; l < N; l++) {
+                uint8_t a = A[l], x = v[l], r = (uint8_t)(a + x + (F[l] & cmask));
+                F[l] = (uint8_t)(hb_carry8(a, x, r) | ((a ^ x ^ r) & FLAG_H) |
+                                 (((~(a ^ x) & (a ^ r)) >> 5) & FLAG_V) | hb_sz53(r));
+                A[l] = r;
+            }
+            break;
+        }
+        case 2: case 3: {
+            uint8_t cmask = alu_op == 3 ? FLAG_C : 0;
+            for (int l = 0; l < N; l++) {
+                uint8_t a = A[l], x = v[l], r = (uint8_t)(a - x - (F[l] & cmask));
+                F[l] = (uint8_t)(hb_borrow8(a, x, r) | FLAG_N | ((a ^ x ^ r) & FLAG_H) |
+                                 ((((a ^ x) & (a ^ r)) >> 5) & FLAG_V) | hb_sz53(r));
+                A[l] = r;
+            }
+            break;
+        }
+        case 4: for (int l = 0; l < N; l++) { uint8_t r = A[l] & v[l]; A[l] = r; F[l] = (uint8_t)(FLAG_H | hb_sz53(r) | hb_parity(r)); } break;
+        case 5: for (int l = 0; l < N; l++) { uint8_t r = A[l] ^ v[l]; A[l] = r; F[l] = (uint8_t)(hb_sz53(r) | hb_parity(r)); } break;
+        case 6: for (int l = 0; l < N; l++) { uint8_t r = A[l] | v[l]; A[l] = r; F[l] = (uint8_t)(hb_sz53(r) | hb_parity(r)); } break;
+        case 7:
+            for (int l = 0; l < N; l++) {
+                uint8_t a = A[l], x = v[l], r = (uint8_t)(a - x);
+                F[l] = (uint8_t)(hb_borrow8(a, x, r) | FLAG_N | ((a ^ x ^ r) & FLAG_H) |
+                                 ((((a ^ x) & (a ^ r)) >> 5) & FLAG_V) | (x & (FLAG_3 | FLAG_5)) |
+                                 (r & FLAG_S) | (r == 0 ? FLAG_Z : 0));
+            }
+            break;
+    }
+}
+
+// CB rotate/shift (cb_op 0-6 as in h_exec_instruction_ref, 7 = SLL) of row R.
+template<int N>
+static void hb_cb(Z80StateBatch<N> &b, int cb_op, int reg) {
+    uint8_t *R = b.r[reg], *F = b.r[REG_F];
+    // o = old value, expr = new value, cout = bit shifted out into C
+    #define HB_CB(expr, cout) \
+        for (int l = 0; l < N; l++) { \
+            uint8_t o = R[l], v = (uint8_t)(expr); \
+            F[l] = (uint8_t)(((cout) & FLAG_C) | hb_sz53(v) | hb_parity(v)); \
+            R[l] = v; \
+        }
+    switch (cb_op) {
+        case 0: HB_CB(o << 1 | o >> 7, o >> 7) break;
+        case 1: HB_CB(o >> 1 | o << 7, o) break;
+        case 2: HB_CB(o << 1 | (F[l] & FLAG_C), o >> 7) break;
+        case 3: HB_CB(o >> 1 | F[l] << 7, o) break;
+        case 4: HB_CB(o << 1, o >> 7) break;
+        case 5: HB_CB((o & 0x80) | o >> 1, o) break;
+        case 6: HB_CB(o >> 1, o) break;
+        case 7: HB_CB(o << 1 | 1, o >> 7) break;
+    }
+    #undef HB_CB
+}
+
+// 16-bit HL arithmetic: 0 = ADD, 1 = ADC, 2 = SBC HL,rr.
+template<int N>
+static void hb_hl_arith(Z80StateBatch<N> &b, int kind, int pair) {
+    uint16_t hl[N], v[N];
+    hb_get_pair(b, 2, hl);
+    hb_get_pair(b, pair, v);
+    uint8_t* F = b.r[REG_F];
+    if (kind == 0) {
+        for (int l = 0; l < N; l++) {
+            uint16_t r = (uint16_t)(hl[l] + v[l]);
+            F[l] = (uint8_t)((F[l] & (FLAG_S | FLAG_Z | FLAG_P)) | (((hl[l] ^ v[l] ^ r) >> 8) & FLAG_H) |
+                             hb_carry16(hl[l], v[l], r) | ((r >> 8) & (FLAG_3 | FLAG_5)));
+            hl[l] = r;
+        }
+    } else if (kind == 1) {
+        for (int l = 0; l < N; l++) {
+            uint16_t r = (uint16_t)(hl[l] + v[l] + (F[l] & FLAG_C));
+            F[l] = (uint8_t)(hb_carry16(hl[l], v[l], r) | (((~(hl[l] ^ v[l]) & (hl[l] ^ r)) >> 13) & FLAG_V) |
+                             ((r >> 8) & (FLAG_S | FLAG_3 | FLAG_5)) | (((hl[l] ^ v[l] ^ r) >> 8) & FLAG_H) |
+                             (r == 0 ? FLAG_Z : 0));
+            hl[l] = r;
+        }
+    } else {
+        for (int l = 0; l < N; l++) {
+            uint16_t r = (uint16_t)(hl[l] - v[l] - (F[l] & FLAG_C));
+            F[l] = (uint8_t)(hb_borrow16(hl[l], v[l], r) | FLAG_N | ((((hl[l] ^ v[l]) & (hl[l] ^ r)) >> 13) & FLAG_V) |
+                             ((r >> 8) & (FLAG_S | FLAG_3 | FLAG_5)) | (((hl[l] ^ v[l] ^ r) >> 8) & FLAG_H) |
+                             (r == 0 ? FLAG_Z : 0));
+            hl[l] = r;
+        }
+    }
+    hb_set_pair(b, 2, hl);
+}
+
+// Run one instruction on every lane of the batch.
+template<int N>
+static void exec_batch(uint16_t op, uint16_t imm, Z80StateBatch<N> &b) {
+    uint8_t *A = b.r[REG_A], *F = b.r[REG_F];
+    if (op < 49) { memmove(b.r[LD_DST_H[op / 7]], b.r[LD_FULL_SRC_H[op]], N); return; }
+    if (op < 56) { memset(b.r[IMM_REG_H[op - 49]], (uint8_t)imm, N); return; }
+    if (op < 120) {
+        int src_idx = (op - 56) % 8;
+        uint8_t v[N];
+        if (src_idx < 7) memcpy(v, b.r[ALU_SRC_H[src_idx]], N); else memset(v, (uint8_t)imm, N);
+        hb_alu(b, (op - 56) / 8, v);
+        return;
+    }
+    if (op < 127) {
+        uint8_t* R = b.r[INCDEC_REG_H[op - 120]];
+        for (int l = 0; l < N; l++) {
+            uint8_t r = (uint8_t)(R[l] + 1); R[l] = r;
+            F[l] = (uint8_t)((F[l] & FLAG_C) | (r == 0x80 ? FLAG_V : 0) | ((r & 0x0F) == 0 ? FLAG_H : 0) | hb_sz53(r));
+        }
+        return;
+    }
+    if (op < 134) {
+        uint8_t* R = b.r[INCDEC_REG_H[op - 127]];
+        for (int l = 0; l < N; l++) {
+            uint8_t o = R[l], r = (uint8_t)(o - 1); R[l] = r;
+            F[l] = (uint8_t)((F[l] & FLAG_C) | ((o & 0x0F) == 0 ? FLAG_H : 0) | FLAG_N |
+                             (r == 0x7F ? FLAG_V : 0) | hb_sz53(r));
+        }
+        return;
+    }
+    const uint8_t PZS = FLAG_P | FLAG_Z | FLAG_S, F35 = FLAG_3 | FLAG_5;
+    switch (op) {
+        case OP_RLCA: for (int l = 0; l < N; l++) { uint8_t a = (uint8_t)(A[l] << 1 | A[l] >> 7); A[l] = a; F[l] = (uint8_t)((F[l] & PZS) | (a & (FLAG_C | F35))); } return;
+        case OP_RRCA: for (int l = 0; l < N; l++) { uint8_t o = A[l], a = (uint8_t)(o >> 1 | o << 7); A[l] = a; F[l] = (uint8_t)((F[l] & PZS) | (o & FLAG_C) | (a & F35)); } return;
+        case OP_RLA:  for (int l = 0; l < N; l++) { uint8_t o = A[l], a = (uint8_t)(o << 1 | (F[l] & FLAG_C)); A[l] = a; F[l] = (uint8_t)((F[l] & PZS) | (a & F35) | o >> 7); } return;
+        case OP_RRA:  for (int l = 0; l < N; l++) { uint8_t o = A[l], a = (uint8_t)(o >> 1 | F[l] << 7); A[l] = a; F[l] = (uint8_t)((F[l] & PZS) | (a & F35) | (o & FLAG_C)); } return;
+        case OP_DAA:
+            for (int l = 0; l < N; l++) {
+                Z80State s; s.r[REG_A] = A[l]; s.r[REG_F] = F[l];
+                h_exec_daa(s);
+                A[l] = s.r[REG_A]; F[l] = s.r[REG_F];
+            }
+            return;
+        case OP_CPL: for (int l = 0; l < N; l++) { uint8_t a = (uint8_t)~A[l]; A[l] = a; F[l] = (uint8_t)((F[l] & (FLAG_C | PZS)) | (a & F35) | FLAG_N | FLAG_H); } return;
+        case OP_SCF: for (int l = 0; l < N; l++) { F[l] = (uint8_t)((F[l] & PZS) | (A[l] & F35) | FLAG_C); } return;
+        case OP_CCF: for (int l = 0; l < N; l++) { uint8_t c = F[l] & FLAG_C; F[l] = (uint8_t)((F[l] & PZS) | (A[l] & F35) | (c ? FLAG_H : FLAG_C)); } return;
+        case OP_NEG: {
+            uint8_t v[N];
+            memcpy(v, A, N);
+            memset(A, 0, N);
+            hb_alu(b, 2, v);
+            return;
+        }
+        case OP_NOP: return;
+    }
+    if (op >= OP_CB_START && op <= 192) { hb_cb(b, (op - OP_CB_START) / 7, CB_REG_H[(op - OP_CB_START) % 7]); return; }
+    if (op == OP_SLL_A) { hb_cb(b, 7, REG_A); return; }
+    if (op >= OP_SLL_B_START && op < 200) { hb_cb(b, 7, CB_REG_H[(op - OP_SLL_B_START) + 1]); return; }
+    if (op >= OP_BIT_START && op < OP_RES_START) {
+        int idx = op - OP_BIT_START, bit = idx / 7;
+        const uint8_t* R = b.r[CB_REG_H[idx % 7]];
+        uint8_t m = (uint8_t)(1u << bit), s7 = bit == 7 ? FLAG_S : 0;
+        for (int l = 0; l < N; l++) {
+            uint8_t v = R[l];
+            F[l] = (uint8_t)((F[l] & FLAG_C) | FLAG_H | (v & F35) | ((v & m) == 0 ? FLAG_P | FLAG_Z : 0) | (v & s7));
+        }
+        return;
+    }
+    if (op >= OP_RES_START && op < OP_SET_START) {
+        int idx = op - OP_RES_START;
+        uint8_t* R = b.r[CB_REG_H[idx % 7]];
+        uint8_t m = (uint8_t)~(1u << (idx / 7));
+        for (int l = 0; l < N; l++) { R[l] &= m; }
+        return;
+    }
+    if (op >= OP_SET_START && op < OP_16INC_START) {
+        int idx = op - OP_SET_START;
+        uint8_t* R = b.r[CB_REG_H[idx % 7]];
+        uint8_t m = (uint8_t)(1u << (idx / 7));
+        for (int l = 0; l < N; l++) { R[l] |= m; }
+        return;
+    }
+    if (op >= OP_16INC_START && op < OP_ADD_HL_START) {
+        int idx = op - OP_16INC_START, pair = idx % 4;
+        uint16_t d = idx >= 4 ? 0xFFFF : 1, v[N];
+        hb_get_pair(b, pair, v);
+        for (int l = 0; l < N; l++) { v[l] = (uint16_t)(v[l] + d); }
+        hb_set_pair(b, pair, v);
+        return;
+    }
+    if (op >= OP_ADD_HL_START && op < OP_EX_DE_HL) { hb_hl_arith(b, 0, op - OP_ADD_HL_START); return; }
+    if (op == OP_EX_DE_HL) {
+        uint8_t t[N];
+        memcpy(t, b.r[REG_D], N); memcpy(b.r[REG_D], b.r[REG_H], N); memcpy(b.r[REG_H], t, N);
+        memcpy(t, b.r[REG_E], N); memcpy(b.r[REG_E], b.r[REG_L], N); memcpy(b.r[REG_L], t, N);
+        return;
+    }
+    if (op == OP_LD_SP_HL) { hb_get_pair(b, 2, b.sp); return; }
+    if (op >= OP_LD_RR_NN_START && op < OP_ADC_HL_START) {
+        uint16_t v[N];
+        for (int l = 0; l < N; l++) { v[l] = imm; }
+        hb_set_pair(b, op - OP_LD_RR_NN_START, v);
+        return;
+    }
+    if (op >= OP_ADC_HL_START && op < OP_SBC_HL_START) { hb_hl_arith(b, 1, op - OP_ADC_HL_START); return; }
+    if (op >= OP_SBC_HL_START && op < OP_COUNT) { hb_hl_arith(b, 2, op - OP_SBC_HL_START); return; }
+}
+
+
+template<int N>
+static void exec_batch_seq(const uint16_t* ops, const uint16_t* imms, int n, Z80StateBatch<N> &b) {
+    for (int i = 0; i < n; i++) exec_batch(ops[i], imms[i], b);
+}
+
+// Fingerprint bytes of every lane: A F B C D E H L SPhi SPlo, FP_SIZE per lane
+// (FP_SIZE == MID_FP_SIZE).
+template<int N>
+static void batch_fingerprint(const Z80StateBatch<N> &b, uint8_t* out) {
+    for (int l = 0; l < N; l++) {
+        uint8_t* o = out + l * FP_SIZE;
+        for (int k = 0; k < 8; k++) o[k] = b.r[k][l];
+        o[8] = (uint8_t)(b.sp[l] >> 8); o[9] = (uint8_t)b.sp[l];
+    }
+}
+
+// h_states_equal on every lane pair.
+template<int N>
+static bool batch_states_equal(const Z80StateBatch<N> &a, const Z80StateBatch<N> &b, uint8_t dead_flags) {
+    uint8_t diff = 0;
+    uint16_t spd = 0;
+    for (int k = 0; k < 8; k++) {
+        uint8_t m = k == REG_F ? (uint8_t)~dead_flags : 0xFF;
+        for (int l = 0; l < N; l++) diff |= (uint8_t)((a.r[k][l] ^ b.r[k][l]) & m);
+    }
+    for (int l = 0; l < N; l++) spd |= (uint16_t)(a.sp[l] ^ b.sp[l]);
+    return diff == 0 && spd == 0;
+}
+
+// ============================================================
+// Flag demand
+// F bits each op writes (the rest pass through) and the F bits whose input
+// value it reads. Walking a sequence backwards from the flags that are live
+// at its end gives, per instruction, the written flags anyone will look at;
+// the others need not be computed.
+// ============================================================
+static uint8_t h_flags_written(uint16_t op) {
+    if (op < OP_ALU_START) return 0;
+    if (op < OP_INC_START) return 0xFF;
+    if (op < OP_RLCA) return (uint8_t)~FLAG_C;                                      // INC/DEC r
+    if (op <= OP_RRA || op == OP_SCF || op == OP_CCF) return FLAG_C | FLAG_N | FLAG_H | FLAG_3 | FLAG_5;
+    if (op == OP_CPL) return FLAG_N | FLAG_H | FLAG_3 | FLAG_5;
+    if (op == OP_DAA || op == OP_NEG) return 0xFF;
+    if (op == OP_NOP) return 0;
+    if (op < OP_BIT_START) return 0xFF;                                             // CB shifts, SLL
+    if (op < OP_RES_START) return (uint8_t)~FLAG_C;                                 // BIT
+    if (op < OP_ADD_HL_START) return 0;                                             // RES/SET, INC/DEC rr
+    if (op < OP_EX_DE_HL) return FLAG_C | FLAG_N | FLAG_H | FLAG_3 | FLAG_5;        // ADD HL,rr
+    if (op < OP_ADC_HL_START) return 0;
+    return 0xFF;                                                                    // ADC/SBC HL,rr
+}
+
+static uint8_t h_flags_read(uint16_t op) {
+    if (op >= OP_ALU_START && op < OP_INC_START) {
+        int alu_op = (op - OP_ALU_START) / 8;
+        return alu_op == 1 || alu_op == 3 ? FLAG_C : 0;                             // ADC/SBC
+    }
+    if (op == OP_RLA || op == OP_RRA || op == OP_CCF) return FLAG_C;
+    if (op == OP_DAA) return FLAG_C | FLAG_H | FLAG_N;
+    if (op >= OP_CB_START && op <= 192) {
+        int cb_op = (op - OP_CB_START) / 7;
+        return cb_op == 2 || cb_op == 3 ? FLAG_C : 0;                               // RL/RR
+    }
+    if (op >= OP_ADC_HL_START && op < OP_COUNT) return FLAG_C;
+    return 0;
+}
+
+// need[i] = flags instruction i must produce when live_out is live after the
+// sequence. Returns the flags live on entry.
+static uint8_t h_flag_demand(const uint16_t* ops, int n, uint8_t live_out, uint8_t* need) {
+    uint8_t live = live_out;
+    for (int i = n - 1; i >= 0; i--) {
+        uint8_t w = h_flags_written(ops[i]);
+        need[i] = live & w;
+        live = (uint8_t)((live & ~w) | h_flags_read(ops[i]));
+    }
+    return live;
+}
+
+// QuickCheck vectors as a batch.
+static const Z80StateBatch<NUM_VECTORS> &h_test_batch() {
+    static const Z80StateBatch<NUM_VECTORS> b = [] { Z80StateBatch<NUM_VECTORS> t; t.load(h_test_vectors); return t; }();
+    return b;
+}
+
 // Compute fingerprint for a sequence.
 static void h_fingerprint(const uint16_t* ops, const uint16_t* imms, int n, uint8_t fp[FP_LEN]) {
-    for (int v = 0; v < NUM_VECTORS; v++) {
-        Z80State s = h_test_vectors[v];
-        h_exec_seq(s, ops, imms, n);
-        int off = v * FP_SIZE;
-        fp[off+0] = s.r[REG_A]; fp[off+1] = s.r[REG_F];
-        fp[off+2] = s.r[REG_B]; fp[off+3] = s.r[REG_C];
-        fp[off+4] = s.r[REG_D]; fp[off+5] = s.r[REG_E];
-        fp[off+6] = s.r[REG_H]; fp[off+7] = s.r[REG_L];
-        fp[off+8] = (uint8_t)(s.sp >> 8); fp[off+9] = (uint8_t)s.sp;
-    }
+    Z80StateBatch<NUM_VECTORS> b = h_test_batch();
+    exec_batch_seq(ops, imms, n, b);
+    batch_fingerprint(b, fp);
 }
 
 // ============================================================
@@ -402,18 +782,16 @@ static const Z80State h_mid_vectors[MID_VECTORS] = {
     {{0xBF, 0x01, 0x7F, 0xFE, 0x01, 0x80, 0xDF, 0x20}, 0xFEFF},
 };
 
+static const Z80StateBatch<MID_VECTORS> &h_mid_batch() {
+    static const Z80StateBatch<MID_VECTORS> b = [] { Z80StateBatch<MID_VECTORS> t; t.load(h_mid_vectors); return t; }();
+    return b;
+}
+
 // Compute MidCheck fingerprint for a sequence (24 vectors).
 static void h_mid_fingerprint(const uint16_t* ops, const uint16_t* imms, int n, uint8_t mfp[MID_FP_LEN]) {
-    for (int v = 0; v < MID_VECTORS; v++) {
-        Z80State s = h_mid_vectors[v];
-        h_exec_seq(s, ops, imms, n);
-        int off = v * MID_FP_SIZE;
-        mfp[off+0] = s.r[REG_A]; mfp[off+1] = s.r[REG_F];
-        mfp[off+2] = s.r[REG_B]; mfp[off+3] = s.r[REG_C];
-        mfp[off+4] = s.r[REG_D]; mfp[off+5] = s.r[REG_E];
-        mfp[off+6] = s.r[REG_H]; mfp[off+7] = s.r[REG_L];
-        mfp[off+8] = (uint8_t)(s.sp >> 8); mfp[off+9] = (uint8_t)s.sp;
-    }
+    Z80StateBatch<MID_VECTORS> b = h_mid_batch();
+    exec_batch_seq(ops, imms, n, b);
+    batch_fingerprint(b, mfp);
 }
 
 // Compare states, optionally masking dead flags.
@@ -433,11 +811,66 @@ static bool h_midcheck(
     const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
     uint8_t dead_flags
 ) {
-    for (int v = 0; v < MID_VECTORS; v++) {
-        Z80State st = h_mid_vectors[v], sc = h_mid_vectors[v];
-        h_exec_seq(st, t_ops, t_imms, t_n);
-        h_exec_seq(sc, c_ops, c_imms, c_n);
-        if (!h_states_equal(st, sc, dead_flags)) return false;
-    }
-    return true;
+    Z80StateBatch<MID_VECTORS> st = h_mid_batch(), sc = h_mid_batch();
+    exec_batch_seq(t_ops, t_imms, t_n, st);
+    exec_batch_seq(c_ops, c_imms, c_n, sc);
+    return batch_states_equal(st, sc, dead_flags);
 }
+
+// ============================================================
+// Prefix-state cache for depth-first target enumeration
+// Targets arrive in enumeration order, so consecutive targets share all but
+// their last instruction. The state of every QuickCheck and MidCheck vector
+// after each prefix is kept on a small stack, and a new target re-executes
+// only from its first differing instruction: one instruction per vector in
+// steady state instead of the whole sequence. MidCheck levels are filled on
+// demand, so targets without a QuickCheck hit never touch the 24 vectors.
+// ============================================================
+#define PREFIX_MAX_LEN 4
+
+struct PrefixCache {
+    uint16_t ops[PREFIX_MAX_LEN], imms[PREFIX_MAX_LEN];
+    int n = 0;              // current target length
+    int qc_depth = 0;       // levels of qc[] valid beyond the vectors themselves
+    int mid_depth = 0;
+    Z80StateBatch<NUM_VECTORS> qc[PREFIX_MAX_LEN + 1];
+    Z80StateBatch<MID_VECTORS> mid[PREFIX_MAX_LEN + 1];
+
+    PrefixCache() {
+        qc[0] = h_test_batch();
+        mid[0] = h_mid_batch();
+    }
+
+    // Make (o, im, len) the current target; len <= PREFIX_MAX_LEN.
+    void set(const uint16_t* o, const uint16_t* im, int len) {
+        int p = 0;
+        while (p < len && p < n && ops[p] == o[p] && imms[p] == im[p]) p++;
+        if (qc_depth > p) qc_depth = p;
+        if (mid_depth > p) mid_depth = p;
+        for (int i = p; i < len; i++) { ops[i] = o[i]; imms[i] = im[i]; }
+        n = len;
+    }
+
+    template<int NV>
+    void extend(Z80StateBatch<NV>* lv, int &depth) {
+        for (; depth < n; depth++) {
+            lv[depth + 1] = lv[depth];
+            exec_batch(ops[depth], imms[depth], lv[depth + 1]);
+        }
+    }
+
+    // Output states of the current target.
+    const Z80StateBatch<NUM_VECTORS> &qc_states() { extend(qc, qc_depth); return qc[n]; }
+    const Z80StateBatch<MID_VECTORS> &mid_states() { extend(mid, mid_depth); return mid[n]; }
+
+    // Same bytes as h_fingerprint / h_mid_fingerprint of the current target.
+    void fingerprint(uint8_t fp[FP_LEN]) { batch_fingerprint(qc_states(), fp); }
+    void mid_fingerprint(uint8_t mfp[MID_FP_LEN]) { batch_fingerprint(mid_states(), mfp); }
+
+    // h_midcheck with the current target's MidCheck states.
+    bool midcheck(const uint16_t* c_ops, const uint16_t* c_imms, int c_n, uint8_t dead_flags) {
+        Z80StateBatch<MID_VECTORS> sc = h_mid_batch();
+        exec_batch_seq(c_ops, c_imms, c_n, sc);
+        return batch_states_equal(mid_states(), sc, dead_flags);
+    }
+};
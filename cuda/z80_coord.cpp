@@ -0,0 +1,450 @@
+// Z80 Search Shard Coordinator — dynamic load balancing over local workers
+//
+// Static --first-op-start/--first-op-end shards balance badly (a shard of
+// imm8 first ops holds 256x the targets of its neighbours). The coordinator
+// instead owns the whole (length, i0, i1) queue and serves small units to any
+// number of z80search_v2 / z80search_cpu processes started with
+// --coordinator SOCKET, refilling each worker as it reports back. Units held
+// by a worker that dies are reassigned; results are merged to stdout in unit
+// order (protocol and unit layout: z80_coord.h).
+//
+// Units: one per first instruction for length 2, and one per (i0, --chunk
+// second instructions) for length 3. Output is deterministic for a given
+// --chunk, whatever the worker count, mix or timing.
+//
+// Build: g++ -O3 -march=native -pthread -o z80coord z80_coord.cpp
+// Usage: ./z80coord --socket /tmp/z80.sock --max-target 3 [--dead-flags 0x28]
+//                   [--first-op-start M] [--first-op-end N] [--chunk 16]
+//                   [--window 4096] [--no-exhaust] [--len2-join] [--binary] [--symmetry] [--subsume]
+//                   [--spawn N -- ./z80search_cpu --threads 16]
+//        ./z80search_v2 --coordinator /tmp/z80.sock --gpu-id 1   (from anywhere)
+//        ./z80coord --test   (fake workers, one killed mid-unit)
+//
+// Output: merged JSONL to stdout (--binary: z80_results.h records)
+// Progress: stderr
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_coord.h"
+#include "z80_results.h"
+
+#define MAX_ATTEMPTS 3   // workers a unit may take down before the run gives up
+
+struct CoordOpts {
+    const char* socket_path = nullptr;
+    int max_target = 2;
+    uint8_t dead_flags = 0;
+    bool no_exhaust = false;
+    bool binary = false;
+    bool symmetry = false;   // workers search orbit representatives only (z80_symmetry.h)
+    uint32_t features = 0;
+    int first_op_start = 0, first_op_end = -1;
+    int chunk = 16;          // second instructions per length-3 unit
+    int window = 4096;       // units handed out ahead of the oldest unwritten one
+    int spawn = 0;
+    std::vector<const char*> worker_argv;
+};
+
+struct Conn {
+    int fd;
+    bool ready = false;      // handshake done
+    uint32_t slots = 1;
+    std::set<uint64_t> assigned;
+    std::string name;
+};
+
+struct Coordinator {
+    const CoordOpts &o;
+    FILE* out;
+    int listen_fd = -1;
+    uint32_t cand_count = 0;
+    std::vector<CoordUnit> units;
+    std::vector<uint8_t> attempts;
+    size_t next_unit = 0, next_emit = 0;
+    std::set<uint64_t> requeue;
+    std::map<uint64_t, std::string> pending_out;
+    std::vector<Conn> conns;
+    std::vector<pid_t> children;
+    int respawns = 0;
+    uint64_t total_targets=0, total_batches=0, total_qc_hits=0, total_mid_hits=0, total_exhaust=0, total_found=0;
+    uint64_t reassigned = 0;
+    int peak_workers = 0;
+
+    Coordinator(const CoordOpts &opts, FILE* f) : o(opts), out(f) {}
+
+    void build_units(const std::vector<Inst> &all_insts) {
+        int n = (int)all_insts.size();
+        cand_count = (uint32_t)n;
+        int end = o.first_op_end < 0 || o.first_op_end > n ? n : o.first_op_end;
+        int chunk = o.chunk > 0 ? o.chunk : n;
+        for (int len = 2; len <= o.max_target && len <= 3; len++)
+            for (int i0 = o.first_op_start; i0 < end; i0++) {
+                int step = len == 2 ? n : chunk;
+                for (int i1 = 0; i1 < n; i1 += step)
+                    units.push_back({(uint64_t)units.size(), len, i0, i1, i1 + step < n ? i1 + step : n});
+            }
+        attempts.assign(units.size(), 0);
+    }
+
+    bool listen_on(const char* path) {
+        sockaddr_un a = coord_addr(path);
+        unlink(path);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, (sockaddr*)&a, sizeof(a)) != 0 || listen(listen_fd, 64) != 0) {
+            fprintf(stderr, "coordinator: cannot listen on '%s': %s\n", path, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    void spawn_worker() {
+        pid_t pid = fork();
+        if (pid == 0) {
+            std::vector<char*> argv;
+            for (const char* s : o.worker_argv) argv.push_back((char*)s);
+            argv.push_back((char*)"--coordinator");
+            argv.push_back((char*)o.socket_path);
+            argv.push_back(nullptr);
+            int devnull = open("/dev/null", O_WRONLY);
+            if (devnull >= 0) { dup2(devnull, 1); close(devnull); }   // results come back over the socket
+            execvp(argv[0], argv.data());
+            fprintf(stderr, "coordinator: cannot run '%s': %s\n", argv[0], strerror(errno));
+            _exit(127);
+        }
+        if (pid > 0) children.push_back(pid);
+    }
+
+    // Replace spawned workers that died while work remains.
+    void reap_children() {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (size_t k = 0; k < children.size(); k++)
+                if (children[k] == pid) { children.erase(children.begin() + k); break; }
+            bool crashed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            if (!crashed || next_emit >= units.size()) continue;
+            if (respawns >= o.spawn * MAX_ATTEMPTS) {
+                if (respawns++ == o.spawn * MAX_ATTEMPTS)
+                    fprintf(stderr, "coordinator: workers keep failing; not respawning any more\n");
+                continue;
+            }
+            respawns++;
+            fprintf(stderr, "coordinator: worker pid %d died (%s %d), respawning\n", (int)pid,
+                    WIFSIGNALED(status) ? "signal" : "exit", WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+            spawn_worker();
+        }
+    }
+
+    // Hand units to c until its slots are full; lowest reassigned unit first.
+    bool feed(Conn &c) {
+        while (c.ready && c.assigned.size() < c.slots) {
+            uint64_t seq;
+            if (!requeue.empty()) { seq = *requeue.begin(); requeue.erase(requeue.begin()); }
+            else if (next_unit < units.size() && next_unit < next_emit + (size_t)o.window) seq = next_unit++;
+            else break;
+            c.assigned.insert(seq);
+            if (!coord_send(c.fd, COORD_UNIT, &units[seq], sizeof(CoordUnit))) return false;
+        }
+        return true;
+    }
+
+    // Returns false if the run must stop (a unit keeps killing workers).
+    bool drop(size_t k, const char* why) {
+        Conn &c = conns[k];
+        if (c.ready || !c.assigned.empty())
+            fprintf(stderr, "coordinator: worker %s %s, reassigning %zu unit(s)\n",
+                    c.name.c_str(), why, c.assigned.size());
+        bool ok = true;
+        for (uint64_t seq : c.assigned) {
+            requeue.insert(seq);
+            reassigned++;
+            if (++attempts[seq] >= MAX_ATTEMPTS) {
+                const CoordUnit &u = units[seq];
+                fprintf(stderr, "coordinator: unit %lu (len %d, i0 %d, i1 [%d,%d)) failed on %d workers, giving up\n",
+                        (unsigned long)seq, u.len, u.i0, u.i1_begin, u.i1_end, MAX_ATTEMPTS);
+                ok = false;
+            }
+        }
+        close(c.fd);
+        conns.erase(conns.begin() + k);
+        return ok;
+    }
+
+    bool handle_hello(Conn &c, const std::string &body) {
+        char why[160] = "";
+        CoordHello h;
+        if (body.size() != sizeof(h)) snprintf(why, sizeof(why), "bad hello");
+        else {
+            memcpy(&h, body.data(), sizeof(h));
+            h.backend[sizeof(h.backend) - 1] = 0;
+            if (h.version != COORD_VERSION) snprintf(why, sizeof(why), "protocol version %u, coordinator speaks %d", h.version, COORD_VERSION);
+            else if (h.vectors_hash != h_test_vectors_hash()) snprintf(why, sizeof(why), "built with different QuickCheck vectors");
+            else if (h.cand_count != cand_count) snprintf(why, sizeof(why), "%u instructions, coordinator has %u", h.cand_count, cand_count);
+            else if ((h.features ^ o.features) & COORD_FEAT_LEN2_JOIN)
+                snprintf(why, sizeof(why), (o.features & COORD_FEAT_LEN2_JOIN) ? "run needs --len2-db on every worker"
+                                                                               : "--len2-db is set but the run has no --len2-join");
+            else if ((h.features ^ o.features) & COORD_FEAT_SUBSUME)
+                snprintf(why, sizeof(why), (o.features & COORD_FEAT_SUBSUME) ? "run needs --known-rules on every worker"
+                                                                             : "--known-rules is set but the run has no --subsume");
+            else if (h.features != o.features) snprintf(why, sizeof(why), "features 0x%x, coordinator runs 0x%x", h.features, o.features);
+        }
+        if (why[0]) {
+            coord_send(c.fd, COORD_REJECT, why, strlen(why) + 1);
+            fprintf(stderr, "coordinator: rejected worker: %s\n", why);
+            return false;
+        }
+        CoordConfig cfg = {};
+        cfg.dead_flags = o.dead_flags; cfg.no_exhaust = o.no_exhaust; cfg.binary = o.binary;
+        cfg.symmetry = o.symmetry;
+        if (!coord_send(c.fd, COORD_WELCOME, &cfg, sizeof(cfg))) return false;
+        char name[64];
+        snprintf(name, sizeof(name), "%s/%d", h.backend, (int)h.pid);
+        c.name = name; c.slots = h.slots ? h.slots : 1; c.ready = true;
+        fprintf(stderr, "coordinator: worker %s joined (%u slots)\n", c.name.c_str(), c.slots);
+        return true;
+    }
+
+    bool handle_result(Conn &c, const std::string &body) {
+        CoordResult r;
+        if (body.size() < sizeof(r)) return false;
+        memcpy(&r, body.data(), sizeof(r));
+        if (!c.assigned.erase(r.seq)) return false;   // not this worker's unit
+        total_targets += r.targets; total_batches += r.batches;
+        total_qc_hits += r.qc_hits; total_mid_hits += r.mid_hits;
+        total_exhaust += r.exhaust; total_found += r.found;
+        pending_out[r.seq] = body.substr(sizeof(r));
+        return true;
+    }
+
+    // Write every result whose predecessors are all written.
+    void emit_ready() {
+        auto it = pending_out.begin();
+        while (it != pending_out.end() && it->first == next_emit) {
+            if (!it->second.empty()) { fwrite(it->second.data(), 1, it->second.size(), out); fflush(out); }
+            it = pending_out.erase(it);
+            next_emit++;
+        }
+    }
+
+    int run() {
+        signal(SIGPIPE, SIG_IGN);
+        if (o.binary) {
+            ResultFileHeader rh;
+            result_header_init(rh, "z80coord", o.dead_flags);
+            fwrite(&rh, 1, sizeof(rh), out);
+        }
+        for (int k = 0; k < o.spawn; k++) spawn_worker();
+        time_t start = time(NULL), last_report = start;
+        bool failed = false;
+        while (next_emit < units.size() && !failed) {
+            std::vector<pollfd> pfds;
+            pfds.push_back({listen_fd, POLLIN, 0});
+            for (auto &c : conns) pfds.push_back({c.fd, POLLIN, 0});
+            int pr = poll(pfds.data(), pfds.size(), 1000);
+            if (pr < 0 && errno != EINTR) { perror("coordinator: poll"); return 1; }
+            if (o.spawn) reap_children();
+
+            // Walk back to front so drop() keeps the remaining indices valid.
+            for (size_t k = conns.size(); k-- > 0; ) {
+                short re = pfds[k + 1].revents;
+                if (!re) continue;
+                Conn &c = conns[k];
+                uint32_t type; std::string body;
+                bool ok = coord_recv(c.fd, type, body);
+                if (ok && type == COORD_HELLO && !c.ready) ok = handle_hello(c, body);
+                else if (ok && type == COORD_RESULT && c.ready) ok = handle_result(c, body);
+                else if (ok) ok = false;
+                if (!ok && !drop(k, "disconnected")) failed = true;
+            }
+            if (pfds[0].revents & POLLIN) {
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if (fd >= 0) { Conn c; c.fd = fd; c.name = "?"; conns.push_back(c); }
+            }
+
+            emit_ready();
+            for (size_t k = conns.size(); k-- > 0; )
+                if (!feed(conns[k]) && !drop(k, "unreachable")) failed = true;
+            int nworkers = 0;
+            for (auto &c : conns) nworkers += c.ready;
+            if (nworkers > peak_workers) peak_workers = nworkers;
+
+            time_t now = time(NULL);
+            if (now - last_report >= 10) {
+                last_report = now;
+                double pct = units.empty() ? 100.0 : 100.0 * next_emit / units.size();
+                double el = difftime(now, start), eta = (pct > 0.1) ? el * (100.0 / pct - 1.0) : 0;
+                fprintf(stderr, "  [%.1f%%] units %lu/%lu (queued ahead: %lu) | workers:%d | targets:%lu | found:%lu | %lds, ETA %lds\n",
+                        pct, (unsigned long)next_emit, (unsigned long)units.size(),
+                        (unsigned long)(next_unit - next_emit), nworkers,
+                        (unsigned long)total_targets, (unsigned long)total_found, (long)el, (long)eta);
+            }
+        }
+
+        for (auto &c : conns) { if (c.ready) coord_send(c.fd, COORD_BYE, nullptr, 0); close(c.fd); }
+        conns.clear();
+        close(listen_fd);
+        unlink(o.socket_path);
+        for (pid_t pid : children) waitpid(pid, nullptr, 0);
+
+        time_t end = time(NULL);
+        fprintf(stderr, "\n=== %s (coordinator, %d workers at peak) ===\n", failed ? "FAILED" : "DONE", peak_workers);
+        fprintf(stderr, "Units merged:       %lu/%lu (%lu reassigned)\n",
+                (unsigned long)next_emit, (unsigned long)units.size(), (unsigned long)reassigned);
+        fprintf(stderr, "Targets tested:     %lu\n", (unsigned long)total_targets);
+        fprintf(stderr, "Batches processed:  %lu\n", (unsigned long)total_batches);
+        fprintf(stderr, "QuickCheck hits:    %lu\n", (unsigned long)total_qc_hits);
+        fprintf(stderr, "MidCheck survivors: %lu\n", (unsigned long)total_mid_hits);
+        fprintf(stderr, "ExhaustiveCheck:    %lu\n", (unsigned long)total_exhaust);
+        fprintf(stderr, "Results found:      %lu\n", (unsigned long)total_found);
+        fprintf(stderr, "Total time:         %lds\n", (long)(end - start));
+        return failed ? 1 : 0;
+    }
+};
+
+// ============================================================
+// Self-test: fake workers that answer each unit with its own coordinates;
+// one dies holding units, one handshakes with a bad version.
+// ============================================================
+static void fake_worker(const char* path, int die_after, uint32_t slots) {
+    if (!die_after) usleep(200000);   // let the doomed worker take the first units
+    CoordWorker w;
+    if (!coord_connect(w, path, "fake", 0, (uint32_t)enumerate_instructions_8().size(), slots)) _exit(2);
+    CoordUnit u;
+    int n = 0;
+    while (coord_next_unit(w, u)) {
+        if (++n == die_after) _exit(1);
+        char line[96];
+        int len = snprintf(line, sizeof(line), "%lu %d %d %d %d\n", (unsigned long)u.seq, u.len, u.i0, u.i1_begin, u.i1_end);
+        CoordResult r = {};
+        r.seq = u.seq; r.targets = 1; r.found = 1;
+        usleep(1000 * (u.seq % 3));
+        if (!coord_send_result(w, r, std::string(line, len))) _exit(3);
+    }
+    _exit(0);
+}
+
+static int run_self_test() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/z80coord-test-%d.sock", (int)getpid());
+    CoordOpts o;
+    o.socket_path = path; o.max_target = 3;
+    o.first_op_start = 10; o.first_op_end = 14; o.chunk = 1000; o.window = 4;
+    FILE* out = tmpfile();
+    Coordinator co(o, out);
+    co.build_units(enumerate_instructions_8());
+    if (!co.listen_on(path)) return 1;
+
+    std::vector<pid_t> pids;
+    auto fork_worker = [&](int die_after, uint32_t slots) {
+        pid_t p = fork();
+        if (p == 0) { close(co.listen_fd); fake_worker(path, die_after, slots); }
+        pids.push_back(p);
+    };
+    fork_worker(2, 2);   // dies holding units
+    fork_worker(0, 1);
+    fork_worker(0, 4);
+    pid_t bad = fork();
+    if (bad == 0) {
+        CoordWorker w;
+        w.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un a = coord_addr(path);
+        if (connect(w.fd, (sockaddr*)&a, sizeof(a)) != 0) _exit(2);
+        CoordHello h = {};
+        h.version = COORD_VERSION + 1;
+        uint32_t type; std::string body;
+        coord_send(w.fd, COORD_HELLO, &h, sizeof(h));
+        _exit(coord_recv(w.fd, type, body) && type == COORD_REJECT ? 0 : 4);
+    }
+    int rc = co.run();
+    int wbad = 0;
+    for (pid_t p : pids) waitpid(p, nullptr, 0);
+    int st;
+    waitpid(bad, &st, 0);
+    if (!WIFEXITED(st) || WEXITSTATUS(st) != 0) wbad++;
+
+    // Every unit exactly once, in order.
+    std::string expect;
+    for (const CoordUnit &u : co.units) {
+        char line[96];
+        snprintf(line, sizeof(line), "%lu %d %d %d %d\n", (unsigned long)u.seq, u.len, u.i0, u.i1_begin, u.i1_end);
+        expect += line;
+    }
+    std::string got;
+    rewind(out);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), out)) > 0) got.append(buf, n);
+    fclose(out);
+    bool ok = rc == 0 && got == expect && co.reassigned >= 1 && co.total_found == co.units.size() && !wbad;
+    fprintf(stderr, "Coordinator: %zu units merged in order: %s (%lu reassigned, bad-version worker %s)\n",
+            co.units.size(), got == expect ? "yes" : "NO", (unsigned long)co.reassigned, wbad ? "NOT rejected" : "rejected");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    CoordOpts o;
+    for (int i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"--socket")&&i+1<argc) o.socket_path=argv[++i];
+        else if (!strcmp(argv[i],"--max-target")&&i+1<argc) o.max_target=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--dead-flags")&&i+1<argc) o.dead_flags=(uint8_t)strtoul(argv[++i],NULL,0);
+        else if (!strcmp(argv[i],"--first-op-start")&&i+1<argc) o.first_op_start=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--first-op-end")&&i+1<argc) o.first_op_end=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--chunk")&&i+1<argc) o.chunk=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--window")&&i+1<argc) o.window=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--no-exhaust")) o.no_exhaust=true;
+        else if (!strcmp(argv[i],"--len2-join")) o.features|=COORD_FEAT_LEN2_JOIN;
+        else if (!strcmp(argv[i],"--binary")) o.binary=true;
+        else if (!strcmp(argv[i],"--symmetry")) o.symmetry=true;
+        else if (!strcmp(argv[i],"--subsume")) o.features|=COORD_FEAT_SUBSUME;
+        else if (!strcmp(argv[i],"--spawn")&&i+1<argc) o.spawn=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--")) { for (i++; i<argc; i++) o.worker_argv.push_back(argv[i]); }
+        else if (!strcmp(argv[i],"--test")) return run_self_test();
+        else if (!strcmp(argv[i],"--help")) {
+            fprintf(stderr,"Usage: z80coord --socket PATH [OPTIONS] [--spawn N -- WORKER ARGS...]\n"
+                "  --socket PATH         Unix socket workers connect to (--coordinator PATH)\n"
+                "  --max-target N        Max target sequence length (default: 2)\n"
+                "  --dead-flags 0xNN     Flag mask for dead flags (sent to every worker)\n"
+                "  --first-op-start M    Start outer loop at instruction index M\n"
+                "  --first-op-end N      End outer loop at instruction index N\n"
+                "  --chunk N             Second instructions per length-3 unit (default: 16)\n"
+                "  --window N            Max units handed out past the oldest unwritten one (default: 4096)\n"
+                "  --no-exhaust          Workers skip ExhaustiveCheck\n"
+                "  --len2-join           Workers must join length-3 targets against --len2-db\n"
+                "  --binary              Merge binary result records instead of JSONL (see z80results)\n"
+                "  --symmetry            Workers search one target per register renaming and expand the rules\n"
+                "  --subsume             Workers must skip length-3 targets subsumed by --known-rules\n"
+                "  --spawn N             Start N workers: the command after --, plus --coordinator PATH\n"
+                "  --test                Self-test with fake workers\n");
+            return 0;
+        }
+    }
+    if (!o.socket_path) { fprintf(stderr,"z80coord: --socket PATH is required (see --help)\n"); return 1; }
+    if (o.spawn>0 && o.worker_argv.empty()) { fprintf(stderr,"z80coord: --spawn needs a worker command after --\n"); return 1; }
+    if (o.max_target>3) { fprintf(stderr,"z80coord: --max-target %d not supported (max 3)\n", o.max_target); return 1; }
+    if (o.window<1) o.window=1;
+    if (o.symmetry && (o.features & COORD_FEAT_LEN2_JOIN)) {
+        fprintf(stderr,"z80coord: --symmetry does not cover --len2-join (pair replacements break the renaming)\n");
+        return 1;
+    }
+
+    Coordinator co(o, stdout);
+    co.build_units(enumerate_instructions_8());
+    fprintf(stderr,"Coordinator: %zu units (max_target=%d, dead_flags=0x%02X, ops=[%d,%d), chunk=%d) on %s\n",
+            co.units.size(), o.max_target, o.dead_flags, o.first_op_start,
+            o.first_op_end<0 ? (int)co.cand_count : o.first_op_end, o.chunk, o.socket_path);
+    if (!co.listen_on(o.socket_path)) return 1;
+    return co.run();
+}
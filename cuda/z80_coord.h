@@ -0,0 +1,201 @@
+// Shard coordinator protocol: one z80coord process owns the work queue and
+// hands (target length, i0, i1 range) units to search workers over a Unix
+// domain socket.
+//
+// Every message is a CoordHeader followed by `len` payload bytes:
+//   worker -> coord  HELLO   CoordHello
+//   coord -> worker  WELCOME CoordConfig          (or REJECT: reason text)
+//   coord -> worker  UNIT    CoordUnit            (up to hello.slots outstanding)
+//   worker -> coord  RESULT  CoordResult + output (one per unit, any order)
+//   coord -> worker  BYE                          (queue drained)
+// A worker whose connection drops has its outstanding units handed to the
+// next idle worker, and the coordinator writes results strictly in unit
+// order, so the merged JSONL does not depend on timing or worker count.
+//
+// The worker side (coord_connect, coord_next_unit, coord_send_result,
+// coord_enumerate_unit) is shared by z80_search_v2.cu and z80_search_cpu.cpp.
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_symmetry.h"
+#include "z80_subsume.h"
+
+#define COORD_VERSION 3
+
+// Worker features that change the output; every worker must match the coordinator.
+#define COORD_FEAT_LEN2_JOIN 0x1u   // length-3 targets joined against a len-2 DB
+#define COORD_FEAT_SUBSUME   0x2u   // length-3 targets subsumed by --known-rules skipped
+
+enum : uint32_t { COORD_HELLO=1, COORD_WELCOME, COORD_REJECT, COORD_UNIT, COORD_RESULT, COORD_BYE };
+
+struct CoordHeader { uint32_t type; uint32_t _pad; uint64_t len; };
+
+struct CoordHello {
+    uint32_t version;
+    uint32_t features;       // COORD_FEAT_*
+    uint64_t vectors_hash;   // QuickCheck vectors of the worker build
+    uint32_t cand_count;     // instructions enumerated (4215 for the 8-bit set)
+    uint32_t slots;          // units the worker wants queued at once
+    int32_t  pid;
+    char     backend[12];    // "v2", "cpu"
+};
+
+// binary: ResultRecords (z80_results.h); symmetry: register-renaming reduction (z80_symmetry.h)
+struct CoordConfig { uint8_t dead_flags, no_exhaust, binary, symmetry, _pad[4]; };
+
+// Targets of length len whose first instruction is all_insts[i0] and second
+// is in [i1_begin, i1_end); remaining positions run over the whole set.
+struct CoordUnit { uint64_t seq; int32_t len, i0, i1_begin, i1_end; };
+
+struct CoordResult {
+    uint64_t seq;
+    uint64_t targets, batches, qc_hits, mid_hits, exhaust, found;
+};
+
+static_assert(sizeof(CoordHello) == 40 && sizeof(CoordUnit) == 24 && sizeof(CoordResult) == 56,
+              "coordinator wire layout");
+
+// ============================================================
+// Framing
+// ============================================================
+static bool coord_write_all(int fd, const void* p, size_t n) {
+    const char* c = (const char*)p;
+    while (n) {
+        ssize_t w = send(fd, c, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w; n -= (size_t)w;
+    }
+    return true;
+}
+
+static bool coord_read_all(int fd, void* p, size_t n) {
+    char* c = (char*)p;
+    while (n) {
+        ssize_t r = recv(fd, c, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        c += r; n -= (size_t)r;
+    }
+    return true;
+}
+
+static bool coord_send(int fd, uint32_t type, const void* a, size_t na, const void* b = nullptr, size_t nb = 0) {
+    CoordHeader h = {type, 0, (uint64_t)(na + nb)};
+    return coord_write_all(fd, &h, sizeof(h)) && (!na || coord_write_all(fd, a, na)) &&
+           (!nb || coord_write_all(fd, b, nb));
+}
+
+// Read one message; the payload lands in body.
+static bool coord_recv(int fd, uint32_t &type, std::string &body) {
+    CoordHeader h;
+    if (!coord_read_all(fd, &h, sizeof(h))) return false;
+    if (h.len > (1ull << 32)) return false;
+    type = h.type;
+    body.resize(h.len);
+    return !h.len || coord_read_all(fd, &body[0], h.len);
+}
+
+static sockaddr_un coord_addr(const char* path) {
+    sockaddr_un a;
+    memset(&a, 0, sizeof(a));
+    a.sun_family = AF_UNIX;
+    strncpy(a.sun_path, path, sizeof(a.sun_path) - 1);
+    return a;
+}
+
+// ============================================================
+// Worker side
+// ============================================================
+struct CoordWorker {
+    int fd = -1;
+    CoordConfig cfg = {};
+};
+
+// Connect (retrying for a few seconds while the coordinator starts up) and
+// handshake. On success cfg holds the run configuration to search with.
+static bool coord_connect(CoordWorker &w, const char* path, const char* backend,
+                          uint32_t features, uint32_t cand_count, uint32_t slots) {
+    sockaddr_un a = coord_addr(path);
+    for (int attempt = 0; ; attempt++) {
+        w.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (w.fd < 0) { perror("coordinator: socket"); return false; }
+        if (connect(w.fd, (sockaddr*)&a, sizeof(a)) == 0) break;
+        close(w.fd); w.fd = -1;
+        if (attempt == 50) { fprintf(stderr, "coordinator: cannot connect to '%s': %s\n", path, strerror(errno)); return false; }
+        usleep(100000);
+    }
+    CoordHello h;
+    memset(&h, 0, sizeof(h));
+    h.version = COORD_VERSION; h.features = features;
+    h.vectors_hash = h_test_vectors_hash();
+    h.cand_count = cand_count; h.slots = slots ? slots : 1;
+    h.pid = (int32_t)getpid();
+    strncpy(h.backend, backend, sizeof(h.backend) - 1);
+    uint32_t type; std::string body;
+    if (!coord_send(w.fd, COORD_HELLO, &h, sizeof(h)) || !coord_recv(w.fd, type, body)) {
+        fprintf(stderr, "coordinator: handshake failed\n");
+        return false;
+    }
+    if (type == COORD_REJECT) { fprintf(stderr, "coordinator: rejected: %s\n", body.c_str()); return false; }
+    if (type != COORD_WELCOME || body.size() != sizeof(CoordConfig)) { fprintf(stderr, "coordinator: bad handshake reply\n"); return false; }
+    memcpy(&w.cfg, body.data(), sizeof(CoordConfig));
+    return true;
+}
+
+// True if a message is already waiting, i.e. coord_next_unit will not block.
+static bool coord_unit_ready(const CoordWorker &w) {
+    pollfd p = {w.fd, POLLIN, 0};
+    return poll(&p, 1, 0) > 0;
+}
+
+// Next unit to search; false once the coordinator says BYE (or is gone).
+static bool coord_next_unit(CoordWorker &w, CoordUnit &u) {
+    uint32_t type; std::string body;
+    if (!coord_recv(w.fd, type, body)) { fprintf(stderr, "coordinator: connection lost\n"); return false; }
+    if (type != COORD_UNIT || body.size() != sizeof(CoordUnit)) return false;
+    memcpy(&u, body.data(), sizeof(u));
+    return true;
+}
+
+static bool coord_send_result(CoordWorker &w, const CoordResult &r, const std::string &jsonl) {
+    return coord_send(w.fd, COORD_RESULT, &r, sizeof(r), jsonl.data(), jsonl.size());
+}
+
+static void coord_close(CoordWorker &w) { if (w.fd >= 0) close(w.fd); w.fd = -1; }
+
+// Enumerate a unit's targets in search order, with the drivers' pruning
+// (and symmetry reduction and subsumption as the filter is set up).
+template <class F>
+static void coord_enumerate_unit(const std::vector<Inst> &all_insts, const CoordUnit &u, TargetFilter &filter, F &&push) {
+    int n = (int)all_insts.size();
+    const Inst &a = all_insts[u.i0];
+    BatchTarget bt;
+    for (int i1 = u.i1_begin; i1 < u.i1_end && i1 < n; i1++) {
+        const Inst &b = all_insts[i1];
+        if (u.len == 2) {
+            uint16_t to[2] = {a.op, b.op}, ti[2] = {a.imm, b.imm};
+            if (filter_target(filter, bt, to, ti, 2)) push(bt);
+            continue;
+        }
+        uint16_t po[2] = {a.op, b.op}, pi[2] = {a.imm, b.imm};
+        if (!filter_prefix(filter, po, pi, 2, (uint64_t)n)) continue;
+        for (int i2 = 0; i2 < n; i2++) {
+            const Inst &c = all_insts[i2];
+            uint16_t to[3] = {a.op, b.op, c.op}, ti[3] = {a.imm, b.imm, c.imm};
+            if (filter_target(filter, bt, to, ti, 3)) push(bt);
+        }
+    }
+}
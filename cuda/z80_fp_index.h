@@ -0,0 +1,134 @@
+// Fingerprint hash index for QuickCheck against a fixed candidate set.
+//
+// Candidate fingerprints are deterministic, so instead of executing every
+// candidate for every target (one GPU thread per pair), the dead-flag-masked
+// 80-byte fingerprints are built once into an open-addressed table. A target
+// then costs one probe. Candidates sharing a fingerprint form a group whose
+// members are pre-sorted by byte size, so the probe stops at the first member
+// that is not shorter than the target.
+//
+// Used by z80_search.cu, z80_search_v2.cu and z80_search_cpu.cpp.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "z80_common.h"
+
+// Byte size that marks a candidate as never usable (e.g. pruned NOP/LD r,r).
+#define FP_INDEX_SKIP 0xFF
+
+struct FpIndex {
+    uint8_t dead_flags = 0;
+    uint32_t mask = 0;                  // slot count - 1 (power of two)
+    std::vector<uint32_t> slots;        // group id + 1, 0 = empty
+    std::vector<uint64_t> slot_hash;    // full hash per slot (cheap reject)
+    std::vector<uint8_t>  group_fp;     // groups * FP_LEN, masked
+    std::vector<uint32_t> group_start;  // groups + 1 offsets into members
+    std::vector<uint32_t> members;      // candidate indices, by (bytes, index)
+    std::vector<uint8_t>  member_bytes;
+};
+
+static inline void fp_mask_flags(uint8_t fp[FP_LEN], uint8_t dead_flags) {
+    if (!dead_flags) return;
+    for (int v = 0; v < NUM_VECTORS; v++) fp[v * FP_SIZE + 1] &= (uint8_t)~dead_flags;
+}
+
+static inline uint64_t fp_hash(const uint8_t fp[FP_LEN]) {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < FP_LEN; i += 8) {
+        uint64_t w; memcpy(&w, fp + i, 8);
+        h ^= w; h *= 0xBF58476D1CE4E5B9ull; h ^= h >> 31;
+    }
+    return h ^ (h >> 29);
+}
+
+// Build the index from candidate fingerprints (count * FP_LEN, unmasked).
+// bytes[i] is the encoded size of candidate i, or FP_INDEX_SKIP to leave it out.
+static void fp_index_build_fps(FpIndex &idx, const uint8_t* fps, const uint8_t* bytes,
+                               uint32_t count, uint8_t dead_flags) {
+    struct Ent { uint64_t h; uint32_t ci; uint8_t fp[FP_LEN]; };
+    std::vector<Ent> ents;
+    ents.reserve(count);
+    for (uint32_t ci = 0; ci < count; ci++) {
+        if (bytes[ci] == FP_INDEX_SKIP) continue;
+        Ent e; e.ci = ci;
+        memcpy(e.fp, fps + (size_t)ci * FP_LEN, FP_LEN);
+        fp_mask_flags(e.fp, dead_flags);
+        e.h = fp_hash(e.fp);
+        ents.push_back(e);
+    }
+    // Group identical fingerprints; inside a group order by (bytes, index).
+    std::sort(ents.begin(), ents.end(), [&](const Ent &a, const Ent &b) {
+        if (a.h != b.h) return a.h < b.h;
+        int c = memcmp(a.fp, b.fp, FP_LEN);
+        if (c != 0) return c < 0;
+        if (bytes[a.ci] != bytes[b.ci]) return bytes[a.ci] < bytes[b.ci];
+        return a.ci < b.ci;
+    });
+
+    idx.dead_flags = dead_flags;
+    idx.group_fp.clear(); idx.group_start.clear(); idx.members.clear(); idx.member_bytes.clear();
+    std::vector<uint64_t> ghash;
+    for (size_t i = 0; i < ents.size(); i++) {
+        if (i == 0 || ents[i].h != ents[i-1].h || memcmp(ents[i].fp, ents[i-1].fp, FP_LEN) != 0) {
+            idx.group_start.push_back((uint32_t)idx.members.size());
+            idx.group_fp.insert(idx.group_fp.end(), ents[i].fp, ents[i].fp + FP_LEN);
+            ghash.push_back(ents[i].h);
+        }
+        idx.members.push_back(ents[i].ci);
+        idx.member_bytes.push_back(bytes[ents[i].ci]);
+    }
+    idx.group_start.push_back((uint32_t)idx.members.size());
+
+    uint32_t nslots = 16;
+    while (nslots < ghash.size() * 2) nslots <<= 1;
+    idx.mask = nslots - 1;
+    idx.slots.assign(nslots, 0);
+    idx.slot_hash.assign(nslots, 0);
+    for (uint32_t g = 0; g < (uint32_t)ghash.size(); g++) {
+        uint32_t s = (uint32_t)ghash[g] & idx.mask;
+        while (idx.slots[s]) s = (s + 1) & idx.mask;
+        idx.slots[s] = g + 1;
+        idx.slot_hash[s] = ghash[g];
+    }
+}
+
+// Build the index from packed candidates (op | imm<<16, length 1).
+static void fp_index_build(FpIndex &idx, const uint32_t* packed, const uint8_t* bytes,
+                           uint32_t count, uint8_t dead_flags) {
+    std::vector<uint8_t> fps((size_t)count * FP_LEN);
+    for (uint32_t ci = 0; ci < count; ci++) {
+        if (bytes[ci] == FP_INDEX_SKIP) continue;
+        uint16_t op = (uint16_t)(packed[ci] & 0xFFFF), imm = (uint16_t)(packed[ci] >> 16);
+        h_fingerprint(&op, &imm, 1, &fps[(size_t)ci * FP_LEN]);
+    }
+    fp_index_build_fps(idx, fps.data(), bytes, count, dead_flags);
+}
+
+// Probe with an unmasked target fingerprint. Writes the indices of candidates
+// whose masked fingerprint matches and whose size is < max_bytes, in ascending
+// candidate order (the order the brute-force bitmap walk produces).
+// Returns the number written (at most max_out).
+static int fp_index_probe(const FpIndex &idx, const uint8_t target_fp[FP_LEN], int max_bytes,
+                          uint32_t* out, int max_out) {
+    uint8_t fp[FP_LEN];
+    memcpy(fp, target_fp, FP_LEN);
+    fp_mask_flags(fp, idx.dead_flags);
+    uint64_t h = fp_hash(fp);
+    for (uint32_t s = (uint32_t)h & idx.mask; idx.slots[s]; s = (s + 1) & idx.mask) {
+        if (idx.slot_hash[s] != h) continue;
+        uint32_t g = idx.slots[s] - 1;
+        if (memcmp(&idx.group_fp[(size_t)g * FP_LEN], fp, FP_LEN) != 0) continue;
+        int n = 0;
+        for (uint32_t m = idx.group_start[g]; m < idx.group_start[g+1] && n < max_out; m++) {
+            if (idx.member_bytes[m] >= max_bytes) break;
+            out[n++] = idx.members[m];
+        }
+        std::sort(out, out + n);
+        return n;
+    }
+    return 0;
+}
@@ -0,0 +1,569 @@
+// x86-64 JIT for ExhaustiveCheck.
+//
+// cpu_exhaustive_check re-dispatches every instruction of both programs
+// through h_exec_instruction for every input state. Here a (target,
+// candidate) pair is compiled once into straight-line x86-64 that sweeps the
+// 512 (A, carry) inputs in a tight loop: Z80 registers live in host
+// registers, flags come from LAHF/SETcc plus the sz53/sz53p tables, and the
+// caller walks the remaining registers/SP and calls the function once per
+// point. DAA, which has no x86-64 equivalent, uses its z80_aflut.h table.
+//
+// Domain and verdict are exactly cpu_exhaustive_check's. On other
+// architectures, or if the code buffer cannot be mapped, jit_exhaustive_check
+// is cpu_exhaustive_check.
+//
+// Register map: A=r8b F=r9b B=r10b C=r11b D=r12b E=r13b H=r14b L=r15b,
+// SP=ebp (zero-extended), ebx = loop index (carry << 8 | A), rdi = JitCtx*,
+// rsi = flag tables, eax/ecx/edx scratch.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_aflut.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define Z80_JIT 1
+#include <sys/mman.h>
+#else
+#define Z80_JIT 0
+#endif
+
+// Shared with generated code; field offsets are baked into it.
+struct JitCtx {
+    uint8_t  in[8];     // input registers (A, F set by the loop)
+    uint16_t sp;
+    uint16_t _pad;
+    uint8_t  out[8];    // target's outputs for the current state
+    uint16_t out_sp;
+    uint16_t _pad2;
+};
+#define JIT_IN      0
+#define JIT_SP      8
+#define JIT_OUT     12
+#define JIT_OUT_SP  20
+static_assert(offsetof(JitCtx, sp) == JIT_SP && offsetof(JitCtx, out) == JIT_OUT &&
+              offsetof(JitCtx, out_sp) == JIT_OUT_SP, "JitCtx layout");
+
+// Returns 0 if target and candidate agree on all 512 (A, carry) inputs,
+// else 1 + the index (carry << 8 | A) of the first difference. Sequence
+// functions (jit_compile_seq) run once on ctx->in/sp and leave the result in
+// ctx->out/out_sp.
+typedef uint32_t (*JitFn)(JitCtx*);
+
+#if Z80_JIT
+
+#define JIT_CODE_SIZE (64 * 1024)
+
+// sz53 and sz53p back to back, rsi points here.
+struct JitFlagTables { uint8_t sz53[256], sz53p[256]; };
+static JitFlagTables jit_flag_tables;
+#define JIT_SZ53  0
+#define JIT_SZ53P 256
+
+enum { X_RAX = 0, X_RCX = 1, X_RDX = 2, X_RBX = 3, X_RSP = 4, X_RBP = 5, X_RSI = 6, X_RDI = 7 };
+enum { CC_O = 0x0, CC_C = 0x2, CC_Z = 0x4, CC_NZ = 0x5 };
+static const uint8_t jit_zreg[8] = {8, 9, 10, 11, 12, 13, 14, 15};  // REG_A..REG_L -> r8..r15
+
+struct JitAsm {
+    uint8_t* buf;
+    size_t n, cap;
+    bool overflow = false;
+
+    void b(uint8_t x) { if (n < cap) buf[n++] = x; else overflow = true; }
+    void d32(uint32_t x) { for (int i = 0; i < 4; i++) b((uint8_t)(x >> (8 * i))); }
+    void rex(int w, int r, int bb, bool force) {
+        uint8_t v = (uint8_t)(0x40 | (w << 3) | ((r >> 3) << 2) | (bb >> 3));
+        if (force || v != 0x40) b(v);
+    }
+    void modrm(int mod, int reg, int rm) { b((uint8_t)((mod << 6) | ((reg & 7) << 3) | (rm & 7))); }
+
+    // 8-bit forms always carry a REX so 4-7 mean spl..dil, never ah..bh.
+    void op8_rr(uint8_t opc, int dst, int src) { rex(0, src, dst, true); b(opc); modrm(3, src, dst); }
+    void op32_rr(uint8_t opc, int dst, int src) { rex(0, src, dst, false); b(opc); modrm(3, src, dst); }
+    void grp8_ri(int ext, int reg, uint8_t imm) { rex(0, 0, reg, true); b(0x80); modrm(3, ext, reg); b(imm); }
+    void grp32_ri(int ext, int reg, uint32_t imm) { rex(0, 0, reg, false); b(0x81); modrm(3, ext, reg); d32(imm); }
+    void shift8_1(int ext, int reg) { rex(0, 0, reg, true); b(0xD0); modrm(3, ext, reg); }
+    void shift32_i(int ext, int reg, uint8_t n_) { rex(0, 0, reg, false); b(0xC1); modrm(3, ext, reg); b(n_); }
+    void unary8(uint8_t opc, int ext, int reg) { rex(0, 0, reg, true); b(opc); modrm(3, ext, reg); }
+    void unary32(uint8_t opc, int ext, int reg) { rex(0, 0, reg, false); b(opc); modrm(3, ext, reg); }
+    void mov8_ri(int reg, uint8_t imm) { rex(0, 0, reg, true); b((uint8_t)(0xB0 + (reg & 7))); b(imm); }
+    void mov32_ri(int reg, uint32_t imm) { rex(0, 0, reg, false); b((uint8_t)(0xB8 + (reg & 7))); d32(imm); }
+    void mov64_ri(int reg, uint64_t imm) { rex(1, 0, reg, true); b((uint8_t)(0xB8 + (reg & 7))); d32((uint32_t)imm); d32((uint32_t)(imm >> 32)); }
+    void movzx8(int dst, int src) { rex(0, dst, src, true); b(0x0F); b(0xB6); modrm(3, dst, src); }
+    void setcc(int cc, int reg) { rex(0, 0, reg, true); b(0x0F); b((uint8_t)(0x90 + cc)); modrm(3, 0, reg); }
+    void bt32_i(int reg, uint8_t bit) { rex(0, 0, reg, false); b(0x0F); b(0xBA); modrm(3, 4, reg); b(bit); }
+    void lahf() { b(0x9F); }
+    void test32_i(int reg, uint32_t imm) { rex(0, 0, reg, false); b(0xF7); modrm(3, 0, reg); d32(imm); }
+    void imul32_i8(int dst, int src, uint8_t imm) { rex(0, dst, src, false); b(0x6B); modrm(3, dst, src); b(imm); }
+    // [base + disp32] (base is never rsp/r12, so no SIB)
+    void mem(int reg, int base, int32_t disp) { modrm(2, reg, base); d32((uint32_t)disp); }
+    void load8(int reg, int base, int32_t disp) { rex(0, reg, base, true); b(0x8A); mem(reg, base, disp); }
+    void store8(int base, int32_t disp, int reg) { rex(0, reg, base, true); b(0x88); mem(reg, base, disp); }
+    void cmp8_m(int reg, int base, int32_t disp) { rex(0, reg, base, true); b(0x3A); mem(reg, base, disp); }
+    void movzx8_m(int dst, int base, int32_t disp) { rex(0, dst, base, false); b(0x0F); b(0xB6); mem(dst, base, disp); }
+    void movzx16_m(int dst, int base, int32_t disp) { rex(0, dst, base, false); b(0x0F); b(0xB7); mem(dst, base, disp); }
+    void store16(int base, int32_t disp, int reg) { b(0x66); rex(0, reg, base, false); b(0x89); mem(reg, base, disp); }
+    void cmp16_m(int reg, int base, int32_t disp) { b(0x66); rex(0, reg, base, false); b(0x3B); mem(reg, base, disp); }
+    // movzx dst, byte [rsi + idx + disp32]
+    void movzx8_tab(int dst, int idx, int32_t disp) {
+        rex(0, dst, 0, false); b(0x0F); b(0xB6); modrm(2, dst, 4);
+        b((uint8_t)(((idx & 7) << 3) | X_RSI)); d32((uint32_t)disp);
+    }
+    // movzx eax, word [rdx + rax*2]
+    void movzx16_rdx_rax2() { b(0x0F); b(0xB7); modrm(0, X_RAX, 4); b((uint8_t)((1 << 6) | (X_RAX << 3) | X_RDX)); }
+    size_t jcc32(int cc) { b(0x0F); b((uint8_t)(0x80 + cc)); d32(0); return n; }
+    size_t jmp32() { b(0xE9); d32(0); return n; }
+    void patch(size_t after, size_t target) {
+        if (overflow) return;
+        int32_t rel = (int32_t)(target - after);
+        memcpy(buf + after - 4, &rel, 4);
+    }
+    void push(int reg) { rex(0, 0, reg, false); b((uint8_t)(0x50 + (reg & 7))); }
+    void pop(int reg) { rex(0, 0, reg, false); b((uint8_t)(0x58 + (reg & 7))); }
+};
+
+// 8-bit ALU opcodes (r/m8, r8 form) and group-1 /ext, by Z80 ALU op.
+static const uint8_t jit_alu_rr[8] = {0x00, 0x10, 0x28, 0x18, 0x20, 0x30, 0x08, 0x38};
+static const uint8_t jit_alu_ext[8] = {0, 2, 5, 3, 4, 6, 1, 7};
+
+// F = (x86 S|Z|H|C) | V | n_flag | (src35 & (F3|F5)), from flags just set.
+static void jit_arith_flags(JitAsm &a, int src35_reg, bool src35_imm, uint8_t imm, uint8_t n_flag) {
+    a.lahf();
+    a.setcc(CC_O, X_RCX);
+    a.shift32_i(5, X_RAX, 8);                   // shr eax, 8
+    a.grp32_ri(4, X_RAX, FLAG_S | FLAG_Z | FLAG_H | FLAG_C);
+    a.movzx8(X_RCX, X_RCX);
+    a.shift32_i(4, X_RCX, 2);                   // V -> bit 2
+    a.op32_rr(0x09, X_RAX, X_RCX);
+    if (src35_imm) a.grp32_ri(1, X_RAX, (uint8_t)(imm & (FLAG_3 | FLAG_5)) | n_flag);
+    else {
+        a.movzx8(X_RDX, src35_reg);
+        a.grp32_ri(4, X_RDX, FLAG_3 | FLAG_5);
+        a.op32_rr(0x09, X_RAX, X_RDX);
+        if (n_flag) a.grp32_ri(1, X_RAX, n_flag);
+    }
+    a.op8_rr(0x88, jit_zreg[REG_F], X_RAX);
+}
+
+// F = sz53p[reg] | cl (carry out, already in ecx 0/1) | extra.
+static void jit_sz53p_flags(JitAsm &a, int reg, bool with_cl, uint8_t extra) {
+    a.movzx8(X_RDX, reg);
+    a.movzx8_tab(X_RAX, X_RDX, JIT_SZ53P);
+    if (with_cl) { a.movzx8(X_RCX, X_RCX); a.op32_rr(0x09, X_RAX, X_RCX); }
+    if (extra) a.grp32_ri(1, X_RAX, extra);
+    a.op8_rr(0x88, jit_zreg[REG_F], X_RAX);
+}
+
+// F = (F & keep) | (A & (F3|F5)) | eax_bits, for the accumulator rotates etc.
+static void jit_acc_flags(JitAsm &a, uint8_t keep, bool with_cl, uint8_t set) {
+    int A = jit_zreg[REG_A], F = jit_zreg[REG_F];
+    if (with_cl) a.movzx8(X_RCX, X_RCX);
+    a.movzx8(X_RAX, A);
+    a.grp32_ri(4, X_RAX, FLAG_3 | FLAG_5);
+    if (with_cl) a.op32_rr(0x09, X_RAX, X_RCX);
+    if (set) a.grp32_ri(1, X_RAX, set);
+    a.grp8_ri(4, F, keep);
+    a.op8_rr(0x08, F, X_RAX);
+}
+
+// Load a register pair's value: ecx = low byte, edx = high byte.
+static void jit_pair_bytes(JitAsm &a, int pair) {
+    if (pair == 3) {
+        a.op32_rr(0x89, X_RCX, X_RBP);
+        a.op32_rr(0x89, X_RDX, X_RBP);
+        a.shift32_i(5, X_RDX, 8);
+        return;
+    }
+    static const uint8_t hi[3] = {REG_B, REG_D, REG_H}, lo[3] = {REG_C, REG_E, REG_L};
+    a.movzx8(X_RCX, jit_zreg[lo[pair]]);
+    a.movzx8(X_RDX, jit_zreg[hi[pair]]);
+}
+
+// HL op= pair via low/high byte add/adc/sub/sbb; leaves H/L written and the
+// high-byte flags live. opc_lo/opc_hi are r/m8,r8 opcodes.
+static void jit_hl_arith(JitAsm &a, int pair, bool carry_in, uint8_t opc_lo, uint8_t opc_hi) {
+    int H = jit_zreg[REG_H], L = jit_zreg[REG_L];
+    jit_pair_bytes(a, pair);
+    a.movzx8(X_RAX, L);
+    if (carry_in) a.bt32_i(jit_zreg[REG_F], 0);
+    a.op8_rr(opc_lo, X_RAX, X_RCX);
+    a.op8_rr(0x88, L, X_RAX);
+    a.movzx8(X_RAX, H);
+    a.op8_rr(opc_hi, X_RAX, X_RDX);
+    a.op8_rr(0x88, H, X_RAX);
+}
+
+// Emit one instruction. Returns false if op is unknown.
+static bool jit_emit_instruction(JitAsm &a, uint16_t op, uint16_t imm) {
+    int A = jit_zreg[REG_A], F = jit_zreg[REG_F];
+    if (op < 49) {
+        int dst = LD_DST_H[op / 7], src = LD_FULL_SRC_H[op];
+        if (dst != src) a.op8_rr(0x88, jit_zreg[dst], jit_zreg[src]);
+        return true;
+    }
+    if (op < 56) { a.mov8_ri(jit_zreg[IMM_REG_H[op - 49]], (uint8_t)imm); return true; }
+    if (op < 120) {
+        int alu = (op - 56) / 8, si = (op - 56) % 8;
+        bool is_imm = si == 7;
+        int src = is_imm ? -1 : jit_zreg[ALU_SRC_H[si]];
+        if (alu == 1 || alu == 3) a.bt32_i(F, 0);
+        if (is_imm) a.grp8_ri(jit_alu_ext[alu], A, (uint8_t)imm);
+        else a.op8_rr(jit_alu_rr[alu], A, src);
+        switch (alu) {
+            case 0: case 1: jit_arith_flags(a, A, false, 0, 0); break;
+            case 2: case 3: jit_arith_flags(a, A, false, 0, FLAG_N); break;
+            case 4: jit_sz53p_flags(a, A, false, FLAG_H); break;
+            case 5: case 6: jit_sz53p_flags(a, A, false, 0); break;
+            case 7: jit_arith_flags(a, src, is_imm, (uint8_t)imm, FLAG_N); break;  // F3/F5 from the operand
+        }
+        return true;
+    }
+    if (op < 134) {
+        bool dec = op >= OP_DEC_START;
+        int r = jit_zreg[INCDEC_REG_H[op - (dec ? OP_DEC_START : OP_INC_START)]];
+        a.unary8(0xFE, dec ? 1 : 0, r);
+        a.lahf();
+        a.setcc(CC_O, X_RCX);
+        a.shift32_i(5, X_RAX, 8);
+        a.grp32_ri(4, X_RAX, FLAG_H);
+        a.movzx8(X_RCX, X_RCX);
+        a.shift32_i(4, X_RCX, 2);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        a.movzx8(X_RDX, r);
+        a.movzx8_tab(X_RDX, X_RDX, JIT_SZ53);
+        a.op32_rr(0x09, X_RAX, X_RDX);
+        if (dec) a.grp32_ri(1, X_RAX, FLAG_N);
+        a.grp8_ri(4, F, FLAG_C);
+        a.op8_rr(0x08, F, X_RAX);
+        return true;
+    }
+    const uint8_t PZS = FLAG_P | FLAG_Z | FLAG_S;
+    switch (op) {
+        case OP_RLCA: a.shift8_1(0, A); a.setcc(CC_C, X_RCX); jit_acc_flags(a, PZS, true, 0); return true;
+        case OP_RRCA: a.shift8_1(1, A); a.setcc(CC_C, X_RCX); jit_acc_flags(a, PZS, true, 0); return true;
+        case OP_RLA: a.bt32_i(F, 0); a.shift8_1(2, A); a.setcc(CC_C, X_RCX); jit_acc_flags(a, PZS, true, 0); return true;
+        case OP_RRA: a.bt32_i(F, 0); a.shift8_1(3, A); a.setcc(CC_C, X_RCX); jit_acc_flags(a, PZS, true, 0); return true;
+        case OP_CPL: a.grp8_ri(6, A, 0xFF); jit_acc_flags(a, FLAG_C | PZS, false, FLAG_N | FLAG_H); return true;
+        case OP_SCF: jit_acc_flags(a, PZS, false, FLAG_C); return true;
+        case OP_CCF:   // C -> H, !C -> C
+            a.movzx8(X_RCX, F);
+            a.grp32_ri(4, X_RCX, FLAG_C);
+            a.op32_rr(0x89, X_RDX, X_RCX);
+            a.shift32_i(4, X_RDX, 4);
+            a.grp32_ri(6, X_RCX, FLAG_C);
+            a.op32_rr(0x09, X_RCX, X_RDX);
+            jit_acc_flags(a, PZS, true, 0);
+            return true;
+        case OP_NEG: a.unary8(0xF6, 3, A); jit_arith_flags(a, A, false, 0, FLAG_N); return true;
+        case OP_NOP: return true;
+        case OP_DAA: {   // (A,F) table lookup, see z80_aflut.h
+            const HAfLut &l = aflut_tables[OP_DAA];
+            if (!l.t) return false;
+            a.movzx8(X_RAX, F);
+            a.grp32_ri(4, X_RAX, l.read);
+            a.shift32_i(4, X_RAX, 8);
+            a.movzx8(X_RCX, A);
+            a.op32_rr(0x09, X_RAX, X_RCX);
+            a.mov64_ri(X_RDX, (uint64_t)(uintptr_t)l.t);
+            a.movzx16_rdx_rax2();
+            a.grp8_ri(4, F, l.keep);
+            a.op8_rr(0x08, F, X_RAX);
+            a.shift32_i(5, X_RAX, 8);
+            a.op8_rr(0x88, A, X_RAX);
+            return true;
+        }
+    }
+    if (op >= OP_CB_START && op < OP_BIT_START) {
+        int kind, r;
+        if (op <= 192) { kind = (op - OP_CB_START) / 7; r = jit_zreg[CB_REG_H[(op - OP_CB_START) % 7]]; }
+        else { kind = 7; r = jit_zreg[op == OP_SLL_A ? REG_A : CB_REG_H[(op - OP_SLL_B_START) + 1]]; }
+        static const uint8_t ext[8] = {0, 1, 2, 3, 4, 7, 5, 4};   // rol ror rcl rcr shl sar shr shl
+        if (kind == 2 || kind == 3) a.bt32_i(F, 0);
+        a.shift8_1(ext[kind], r);
+        a.setcc(CC_C, X_RCX);
+        if (kind == 7) a.grp8_ri(1, r, 0x01);   // SLL shifts in a 1
+        jit_sz53p_flags(a, r, true, 0);
+        return true;
+    }
+    if (op >= OP_BIT_START && op < OP_RES_START) {
+        int idx = op - OP_BIT_START, bit = idx / 7, r = jit_zreg[CB_REG_H[idx % 7]];
+        a.movzx8(X_RAX, r);
+        a.op32_rr(0x89, X_RDX, X_RAX);
+        a.grp32_ri(4, X_RDX, FLAG_3 | FLAG_5);
+        a.grp32_ri(1, X_RDX, FLAG_H);
+        a.test32_i(X_RAX, 1u << bit);
+        a.setcc(CC_Z, X_RCX);
+        a.movzx8(X_RCX, X_RCX);
+        a.imul32_i8(X_RCX, X_RCX, FLAG_P | FLAG_Z);
+        a.op32_rr(0x09, X_RDX, X_RCX);
+        if (bit == 7) { a.grp32_ri(4, X_RAX, FLAG_S); a.op32_rr(0x09, X_RDX, X_RAX); }
+        a.grp8_ri(4, F, FLAG_C);
+        a.op8_rr(0x08, F, X_RDX);
+        return true;
+    }
+    if (op >= OP_RES_START && op < OP_16INC_START) {
+        bool set = op >= OP_SET_START;
+        int idx = op - (set ? OP_SET_START : OP_RES_START), bit = idx / 7, r = jit_zreg[CB_REG_H[idx % 7]];
+        if (set) a.grp8_ri(1, r, (uint8_t)(1u << bit));
+        else a.grp8_ri(4, r, (uint8_t)~(1u << bit));
+        return true;
+    }
+    if (op >= OP_16INC_START && op < OP_ADD_HL_START) {
+        int idx = op - OP_16INC_START, pair = idx % 4;
+        bool dec = idx >= 4;
+        if (pair == 3) {
+            a.unary32(0xFF, dec ? 1 : 0, X_RBP);
+            a.grp32_ri(4, X_RBP, 0xFFFF);
+            return true;
+        }
+        static const uint8_t hi[3] = {REG_B, REG_D, REG_H}, lo[3] = {REG_C, REG_E, REG_L};
+        a.movzx8(X_RAX, jit_zreg[hi[pair]]);
+        a.shift32_i(4, X_RAX, 8);
+        a.movzx8(X_RCX, jit_zreg[lo[pair]]);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        a.unary32(0xFF, dec ? 1 : 0, X_RAX);
+        a.op8_rr(0x88, jit_zreg[lo[pair]], X_RAX);
+        a.shift32_i(5, X_RAX, 8);
+        a.op8_rr(0x88, jit_zreg[hi[pair]], X_RAX);
+        return true;
+    }
+    if (op >= OP_ADD_HL_START && op < OP_EX_DE_HL) {
+        // add L,lo / adc H,hi: AF is the carry out of bit 11, CF out of bit 15
+        jit_hl_arith(a, op - OP_ADD_HL_START, false, 0x00, 0x10);
+        a.lahf();
+        a.op32_rr(0x89, X_RCX, X_RAX);
+        a.shift32_i(5, X_RCX, 8);
+        a.grp32_ri(4, X_RCX, FLAG_H | FLAG_C);
+        a.grp32_ri(4, X_RAX, FLAG_3 | FLAG_5);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        a.grp8_ri(4, F, PZS);
+        a.op8_rr(0x08, F, X_RAX);
+        return true;
+    }
+    if (op == OP_EX_DE_HL) {
+        a.op8_rr(0x88, X_RAX, jit_zreg[REG_D]); a.op8_rr(0x88, jit_zreg[REG_D], jit_zreg[REG_H]); a.op8_rr(0x88, jit_zreg[REG_H], X_RAX);
+        a.op8_rr(0x88, X_RAX, jit_zreg[REG_E]); a.op8_rr(0x88, jit_zreg[REG_E], jit_zreg[REG_L]); a.op8_rr(0x88, jit_zreg[REG_L], X_RAX);
+        return true;
+    }
+    if (op == OP_LD_SP_HL) {
+        a.movzx8(X_RBP, jit_zreg[REG_H]);
+        a.shift32_i(4, X_RBP, 8);
+        a.movzx8(X_RAX, jit_zreg[REG_L]);
+        a.op32_rr(0x09, X_RBP, X_RAX);
+        return true;
+    }
+    if (op >= OP_LD_RR_NN_START && op < OP_ADC_HL_START) {
+        int pair = op - OP_LD_RR_NN_START;
+        if (pair == 3) { a.mov32_ri(X_RBP, imm); return true; }
+        static const uint8_t hi[3] = {REG_B, REG_D, REG_H}, lo[3] = {REG_C, REG_E, REG_L};
+        a.mov8_ri(jit_zreg[hi[pair]], (uint8_t)(imm >> 8));
+        a.mov8_ri(jit_zreg[lo[pair]], (uint8_t)imm);
+        return true;
+    }
+    if (op >= OP_ADC_HL_START && op < OP_COUNT) {
+        bool sbc = op >= OP_SBC_HL_START;
+        jit_hl_arith(a, op - (sbc ? OP_SBC_HL_START : OP_ADC_HL_START), true,
+                     sbc ? 0x18 : 0x10, sbc ? 0x18 : 0x10);
+        a.lahf();
+        a.setcc(CC_O, X_RCX);
+        a.shift32_i(5, X_RAX, 8);
+        a.grp32_ri(4, X_RAX, FLAG_S | FLAG_H | FLAG_C);
+        a.movzx8(X_RCX, X_RCX);
+        a.shift32_i(4, X_RCX, 2);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        a.movzx8(X_RDX, jit_zreg[REG_H]);
+        a.op32_rr(0x89, X_RCX, X_RDX);
+        a.grp32_ri(4, X_RCX, FLAG_3 | FLAG_5);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        a.movzx8(X_RCX, jit_zreg[REG_L]);
+        a.op32_rr(0x09, X_RDX, X_RCX);          // ZF = (H | L) == 0
+        a.setcc(CC_Z, X_RCX);
+        a.movzx8(X_RCX, X_RCX);
+        a.shift32_i(4, X_RCX, 6);
+        a.op32_rr(0x09, X_RAX, X_RCX);
+        if (sbc) a.grp32_ri(1, X_RAX, FLAG_N);
+        a.op8_rr(0x88, F, X_RAX);
+        return true;
+    }
+    return false;
+}
+
+static void jit_prologue(JitAsm &a) {
+    static const int saved[6] = {X_RBX, X_RBP, 12, 13, 14, 15};
+    for (int i = 0; i < 6; i++) a.push(saved[i]);
+    a.mov64_ri(X_RSI, (uint64_t)(uintptr_t)&jit_flag_tables);
+}
+
+static void jit_epilogue(JitAsm &a) {
+    static const int saved[6] = {X_RBX, X_RBP, 12, 13, 14, 15};
+    for (int i = 5; i >= 0; i--) a.pop(saved[i]);
+    a.b(0xC3);
+}
+
+// Registers B..L and SP from ctx->in/sp (A and F are set by the caller).
+static void jit_load_regs(JitAsm &a) {
+    for (int r = REG_B; r <= REG_L; r++) a.load8(jit_zreg[r], X_RDI, JIT_IN + r);
+    a.movzx16_m(X_RBP, X_RDI, JIT_SP);
+}
+
+static void jit_store_out(JitAsm &a) {
+    for (int r = 0; r < 8; r++) a.store8(X_RDI, JIT_OUT + r, jit_zreg[r]);
+    a.store16(X_RDI, JIT_OUT_SP, X_RBP);
+}
+
+static bool jit_emit_seq(JitAsm &a, const uint16_t* ops, const uint16_t* imms, int n) {
+    for (int i = 0; i < n; i++)
+        if (!jit_emit_instruction(a, ops[i], imms[i])) return false;
+    return true;
+}
+
+// Per-thread code buffer, RW while emitting and RX while running.
+struct JitBuffer {
+    uint8_t* mem = nullptr;
+    bool failed = false;
+    ~JitBuffer() { if (mem) munmap(mem, JIT_CODE_SIZE); }
+};
+
+static void jit_init_tables() {
+    static bool done = false;
+    if (done) return;
+    memcpy(jit_flag_tables.sz53, h_sz53, 256);
+    memcpy(jit_flag_tables.sz53p, h_sz53p, 256);
+    done = true;
+}
+
+template<class Emit>
+static JitFn jit_finish(Emit emit) {
+    static thread_local JitBuffer jb;
+    if (jb.failed) return nullptr;
+    if (!jb.mem) {
+        void* p = mmap(nullptr, JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) { jb.failed = true; return nullptr; }
+        jb.mem = (uint8_t*)p;
+    } else if (mprotect(jb.mem, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        jb.failed = true; return nullptr;
+    }
+    JitAsm a{jb.mem, 0, JIT_CODE_SIZE};
+    if (!emit(a) || a.overflow) return nullptr;
+    if (mprotect(jb.mem, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) != 0) { jb.failed = true; return nullptr; }
+    return (JitFn)(void*)jb.mem;
+}
+
+// Compile the 512-state (A, carry) sweep for a pair. The returned function
+// lives in a per-thread buffer and is valid until the thread's next compile.
+static JitFn jit_compile_pair(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags
+) {
+    return jit_finish([&](JitAsm &a) {
+        int A = jit_zreg[REG_A], F = jit_zreg[REG_F];
+        jit_prologue(a);
+        a.op32_rr(0x31, X_RBX, X_RBX);             // xor ebx, ebx
+        size_t loop = a.n;
+        for (int pass = 0; pass < 2; pass++) {
+            a.op8_rr(0x88, A, X_RBX);               // A = bl
+            a.op32_rr(0x89, F, X_RBX);
+            a.shift32_i(5, F, 8);                   // F = carry
+            jit_load_regs(a);
+            if (!(pass == 0 ? jit_emit_seq(a, t_ops, t_imms, t_n) : jit_emit_seq(a, c_ops, c_imms, c_n)))
+                return false;
+            if (pass == 0) jit_store_out(a);
+        }
+        std::vector<size_t> fails;
+        for (int r = 0; r < 8; r++) {
+            if (r == REG_F) {
+                a.movzx8(X_RAX, F);
+                a.movzx8_m(X_RDX, X_RDI, JIT_OUT + REG_F);
+                a.op32_rr(0x31, X_RAX, X_RDX);
+                a.test32_i(X_RAX, (uint8_t)~dead_flags);
+                fails.push_back(a.jcc32(CC_NZ));
+                continue;
+            }
+            a.cmp8_m(jit_zreg[r], X_RDI, JIT_OUT + r);
+            fails.push_back(a.jcc32(CC_NZ));
+        }
+        a.cmp16_m(X_RBP, X_RDI, JIT_OUT_SP);
+        fails.push_back(a.jcc32(CC_NZ));
+        a.unary32(0xFF, 0, X_RBX);                  // inc ebx
+        a.grp32_ri(7, X_RBX, 512);
+        a.patch(a.jcc32(0x2), loop);                // jb loop
+        a.op32_rr(0x31, X_RAX, X_RAX);
+        size_t done = a.jmp32();
+        size_t fail = a.n;
+        for (size_t f : fails) a.patch(f, fail);
+        a.op32_rr(0x89, X_RAX, X_RBX);
+        a.unary32(0xFF, 0, X_RAX);                  // 1 + index
+        a.patch(done, a.n);
+        jit_epilogue(a);
+        return true;
+    });
+}
+
+// Compile a sequence run once: ctx->in/sp -> ctx->out/out_sp (for testing).
+static JitFn jit_compile_seq(const uint16_t* ops, const uint16_t* imms, int n) {
+    return jit_finish([&](JitAsm &a) {
+        jit_prologue(a);
+        a.load8(jit_zreg[REG_A], X_RDI, JIT_IN + REG_A);
+        a.load8(jit_zreg[REG_F], X_RDI, JIT_IN + REG_F);
+        jit_load_regs(a);
+        if (!jit_emit_seq(a, ops, imms, n)) return false;
+        jit_store_out(a);
+        a.op32_rr(0x31, X_RAX, X_RAX);
+        jit_epilogue(a);
+        return true;
+    });
+}
+
+#endif  // Z80_JIT
+
+// Available on this host (x86-64 and a mappable code buffer)?
+static bool jit_available() {
+#if Z80_JIT
+    jit_init_tables();
+    if (!aflut_blob) aflut_build();   // DAA table; not installed into h_af_lut
+    uint16_t nop[1] = {OP_NOP}, zero[1] = {0};
+    return jit_compile_seq(nop, zero, 1) != nullptr;
+#else
+    return false;
+#endif
+}
+
+// ExhaustiveCheck on compiled code: same domain and verdict as
+// cpu_exhaustive_check, which it falls back to when there is no JIT.
+// jit_available() must have been called once first.
+static bool jit_exhaustive_check(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags
+) {
+#if Z80_JIT
+    JitFn fn = jit_compile_pair(t_ops, t_imms, t_n, c_ops, c_imms, c_n, dead_flags);
+    if (fn) {
+        int extra[6]; bool sweep_sp;
+        int nextra = sweep_domain(t_ops, t_n, c_ops, c_n, extra, &sweep_sp);
+        bool full = nextra <= 2 && !sweep_sp;
+        int nvals = full ? 256 : 32, nsp = sweep_sp ? 16 : 1;
+        int idx[6] = {0, 0, 0, 0, 0, 0};
+        JitCtx ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        for (;;) {
+            for (int e = 0; e < nextra; e++)
+                ctx.in[extra[e]] = full ? (uint8_t)idx[e] : h_rep_values[idx[e]];
+            for (int si = 0; si < nsp; si++) {
+                ctx.sp = sweep_sp ? h_rep_sp[si] : 0;
+                if (fn(&ctx)) return false;
+            }
+            int e = 0;
+            while (e < nextra && ++idx[e] == nvals) idx[e++] = 0;
+            if (e == nextra) return true;
+        }
+    }
+#endif
+    return cpu_exhaustive_check(t_ops, t_imms, t_n, c_ops, c_imms, c_n, dead_flags);
+}
@@ -0,0 +1,281 @@
+// Counterexample-learned MidCheck vectors (--learned-vectors FILE).
+//
+// A pair that passes MidCheck but fails ExhaustiveCheck differs on some
+// input the 24 MidCheck vectors miss, and the same blind spot lets through
+// many later pairs. learned_capture asks the BDD proof for such an input,
+// and the drivers keep up to LEARN_MAX of them (deduplicated). Later MidCheck
+// survivors are compared on them too, just before ExhaustiveCheck, and a
+// pair that differs on one is dropped without the proof. A learned vector is a
+// real input on which its pair differs, so it only ever drops pairs the
+// proof would reject and the output does not change; only the counters do.
+//
+// When the set is full, a new counterexample replaces the vector that has
+// rejected fewest pairs, among those older than LEARN_GRACE batches. Batches
+// work on a LearnedTable taken when they are queued (the vectors and every
+// candidate instruction's outputs on them, rebuilt when the set changes) and
+// report new counterexamples and per-vector rejections when they are
+// committed, so a run with the same thread count always learns the same set.
+// The file is a text list, one vector per line, loaded at start and
+// rewritten at exit.
+#pragma once
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_bdd.h"
+
+#define LEARN_MAX   64
+#define LEARN_GRACE 64
+
+struct LearnedVec {
+    Z80State s;
+    uint64_t id, rejects, added;   // added: batch number
+};
+
+struct LearnedSet {
+    std::vector<LearnedVec> v;
+    uint64_t next_id = 1;
+    uint64_t loaded = 0, captured = 0, duplicates = 0, evicted = 0, dropped = 0, rejected = 0;
+};
+
+// Immutable snapshot the batches share: the vectors as one state batch and
+// every candidate's outputs on them, so a pair costs a compare.
+struct LearnedTable {
+    int count = 0;
+    std::vector<uint64_t> ids;
+    Z80StateBatch<LEARN_MAX> in;
+    std::vector<uint8_t> cfps;   // per candidate LEARN_MAX * FP_SIZE, dead flags masked
+};
+
+static void learned_fingerprint(Z80StateBatch<LEARN_MAX> &b, uint8_t dead_flags, uint8_t* fp) {
+    batch_fingerprint(b, fp);
+    for (int l = 0; l < LEARN_MAX; l++) fp[l * FP_SIZE + 1] &= (uint8_t)~dead_flags;
+}
+
+// Rebuild after the set changed; unused lanes hold the zero state.
+static std::shared_ptr<const LearnedTable> learned_table(const LearnedSet &ls, const std::vector<Inst> &insts,
+                                                         uint8_t dead_flags) {
+    auto t = std::make_shared<LearnedTable>();
+    t->count = (int)ls.v.size();
+    Z80State in[LEARN_MAX] = {};
+    for (int i = 0; i < t->count; i++) { in[i] = ls.v[i].s; t->ids.push_back(ls.v[i].id); }
+    t->in.load(in);
+    t->cfps.resize(insts.size() * LEARN_MAX * FP_SIZE);
+    for (size_t ci = 0; ci < insts.size() && t->count; ci++) {
+        Z80StateBatch<LEARN_MAX> b = t->in;
+        exec_batch(insts[ci].op, insts[ci].imm, b);
+        learned_fingerprint(b, dead_flags, &t->cfps[ci * LEARN_MAX * FP_SIZE]);
+    }
+    return t;
+}
+
+// What one batch works with and reports back.
+struct LearnedBatch {
+    std::shared_ptr<const LearnedTable> t;
+    std::vector<uint64_t> rejects;    // per table vector
+    std::vector<Z80State> cex;        // new counterexamples, in pair order
+    bool active() const { return t && t->count; }
+};
+
+static void learned_begin(LearnedBatch &b, const std::shared_ptr<const LearnedTable> &t) {
+    b.t = t;
+    b.rejects.assign(t ? t->count : 0, 0);
+    b.cex.clear();
+}
+
+// Outputs of a sequence on the vectors (a target's once per target).
+static void learned_run(const LearnedBatch &b, const uint16_t* ops, const uint16_t* imms, int n, uint8_t dead_flags,
+                        uint8_t fp[LEARN_MAX * FP_SIZE]) {
+    Z80StateBatch<LEARN_MAX> s = b.t->in;
+    exec_batch_seq(ops, imms, n, s);
+    learned_fingerprint(s, dead_flags, fp);
+}
+
+// True if candidate outputs cfp differ from the target's tfp on a learned
+// vector (credited to it).
+static bool learned_reject(LearnedBatch &b, const uint8_t* tfp, const uint8_t* cfp) {
+    if (memcmp(tfp, cfp, (size_t)b.t->count * FP_SIZE) == 0) return false;
+    for (int i = 0; i < b.t->count; i++)
+        if (memcmp(tfp + i * FP_SIZE, cfp + i * FP_SIZE, FP_SIZE) != 0) { b.rejects[i]++; break; }
+    return true;
+}
+
+// Candidate ci of the table's instruction list.
+static const uint8_t* learned_cand(const LearnedBatch &b, uint32_t ci) {
+    return &b.t->cfps[(size_t)ci * LEARN_MAX * FP_SIZE];
+}
+
+// After ExhaustiveCheck rejected a pair: an input on which it differs, if
+// the BDD proof finds one within its node budget.
+static void learned_capture(LearnedBatch &b, const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+                            const uint16_t* c_ops, const uint16_t* c_imms, int c_n, uint8_t dead_flags) {
+    int extra[6]; bool sweep_sp;
+    int nextra = sweep_domain(t_ops, t_n, c_ops, c_n, extra, &sweep_sp);
+    Z80State cex;
+    if (bdd_prove_equivalent(t_ops, t_imms, t_n, c_ops, c_imms, c_n, dead_flags, extra, nextra, sweep_sp, &cex) == 0)
+        b.cex.push_back(cex);
+}
+
+static bool learned_same(const Z80State &a, const Z80State &b) {
+    return memcmp(a.r, b.r, 8) == 0 && a.sp == b.sp;
+}
+
+static bool learned_add(LearnedSet &ls, const Z80State &s, uint64_t batch) {
+    for (const LearnedVec &x : ls.v) if (learned_same(x.s, s)) { ls.duplicates++; return false; }
+    LearnedVec nv = {s, ls.next_id++, 0, batch};
+    if (ls.v.size() < LEARN_MAX) { ls.v.push_back(nv); return true; }
+    LearnedVec* worst = nullptr;
+    for (LearnedVec &x : ls.v)
+        if (x.added + LEARN_GRACE <= batch && (!worst || x.rejects < worst->rejects)) worst = &x;
+    if (!worst) { ls.dropped++; return false; }
+    *worst = nv;
+    ls.evicted++;
+    return true;
+}
+
+// Fold a finished batch in (commit order); true if the set changed.
+static bool learned_commit(LearnedSet &ls, const LearnedBatch &b, uint64_t batch) {
+    for (size_t i = 0; i < b.rejects.size(); i++) {
+        if (!b.rejects[i]) continue;
+        ls.rejected += b.rejects[i];
+        for (LearnedVec &x : ls.v) if (x.id == b.t->ids[i]) x.rejects += b.rejects[i];
+    }
+    bool changed = false;
+    for (const Z80State &s : b.cex) { ls.captured++; changed |= learned_add(ls, s, batch); }
+    return changed;
+}
+
+// One vector per line: A F B C D E H L SP in hex, then the rejections so far.
+static bool learned_load(LearnedSet &ls, const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        unsigned r[8], sp;
+        unsigned long long rej = 0;
+        if (sscanf(line, "%x %x %x %x %x %x %x %x %x %llu", &r[0], &r[1], &r[2], &r[3], &r[4], &r[5], &r[6], &r[7],
+                   &sp, &rej) < 9)
+            continue;
+        Z80State s;
+        for (int k = 0; k < 8; k++) s.r[k] = (uint8_t)r[k];
+        s.sp = (uint16_t)sp;
+        size_t before = ls.v.size();
+        learned_add(ls, s, 0);
+        if (ls.v.size() > before) { ls.v.back().rejects = rej; ls.loaded++; }
+    }
+    fclose(f);
+    return true;
+}
+
+static bool learned_save(const LearnedSet &ls, const char* path) {
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    std::vector<LearnedVec> v = ls.v;
+    std::stable_sort(v.begin(), v.end(), [](const LearnedVec &a, const LearnedVec &b) { return a.rejects > b.rejects; });
+    fprintf(f, "# learned MidCheck vectors: A F B C D E H L SP, pairs rejected\n");
+    for (const LearnedVec &x : v) {
+        for (int k = 0; k < 8; k++) fprintf(f, "%02X ", x.s.r[k]);
+        fprintf(f, "%04X %" PRIu64 "\n", x.s.sp, x.rejects);
+    }
+    bool ok = fclose(f) == 0;
+    return ok && rename(tmp.c_str(), path) == 0;
+}
+
+static void learned_report(const LearnedSet &ls) {
+    fprintf(stderr, "Learned vectors:    %zu kept (%lu loaded, %lu captured, %lu duplicate, %lu evicted, %lu dropped), "
+            "%lu pairs rejected before ExhaustiveCheck\n", ls.v.size(), (unsigned long)ls.loaded,
+            (unsigned long)ls.captured, (unsigned long)ls.duplicates, (unsigned long)ls.evicted,
+            (unsigned long)ls.dropped, (unsigned long)ls.rejected);
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// Captured counterexamples reject their pairs and no equivalent one, and the
+// set stays bounded through adds and a save/load. Returns the failure count.
+static long learned_verify(const std::vector<Inst> &insts, const CandTable &ct, std::mt19937 &rng) {
+    struct Pair { uint16_t to[2], ti[2]; uint32_t ci; bool eq; };
+    std::vector<Pair> pairs;
+    LearnedSet ls;
+    LearnedBatch lb;
+    long bad=0, fps=0;
+    uint32_t hits[256];
+    for (long tries=0; fps<24 && tries<400000; tries++) {
+        const Inst &t0=insts[rng()%insts.size()], &t1=insts[rng()%insts.size()];
+        Pair p = {{t0.op,t1.op}, {t0.imm,t1.imm}, 0, false};
+        if (should_prune(p.to,p.ti,2)) continue;
+        uint8_t fp[FP_LEN];
+        h_fingerprint(p.to,p.ti,2,fp);
+        int nh=fp_index_probe(ct.qc,fp,256,hits,256);
+        for (int k=0; k<nh; k++) {
+            p.ci=hits[k];
+            uint16_t co[1]={ct.insts[p.ci].op}, cm[1]={ct.insts[p.ci].imm};
+            if (!h_midcheck(p.to,p.ti,2,co,cm,1,0)) continue;
+            p.eq=bdd_exhaustive_check(p.to,p.ti,2,co,cm,1,0);
+            if (!p.eq) {
+                size_t before=lb.cex.size();
+                learned_capture(lb,p.to,p.ti,2,co,cm,1,0);
+                if (lb.cex.size()==before) continue;
+                Z80State x=lb.cex.back(), y=x;
+                h_exec_seq(x,p.to,p.ti,2); h_exec_seq(y,co,cm,1);
+                if (h_states_equal(x,y,0)) bad++;
+                fps++;
+            }
+            if (pairs.size()<2000 || !p.eq) pairs.push_back(p);
+        }
+    }
+    learned_commit(ls, lb, 0);
+    auto tab = learned_table(ls, ct.insts, 0);
+    LearnedBatch b;
+    learned_begin(b, tab);
+    long rejected=0;
+    uint8_t t_out[LEARN_MAX*FP_SIZE], c_out[LEARN_MAX*FP_SIZE];
+    for (const Pair &p : pairs) {
+        learned_run(b,p.to,p.ti,2,0,t_out);
+        uint16_t co[1]={ct.insts[p.ci].op}, cm[1]={ct.insts[p.ci].imm};
+        learned_run(b,co,cm,1,0,c_out);
+        if (memcmp(c_out,learned_cand(b,p.ci),(size_t)tab->count*FP_SIZE)!=0) bad++;
+        bool r=learned_reject(b,t_out,c_out);
+        rejected+=r;
+        if (r==p.eq) bad++;     // equivalent pairs pass, every captured one is rejected
+    }
+    // Bounded: within the grace period new vectors are dropped, after it the
+    // least useful one is evicted; duplicates are never added.
+    LearnedSet bs;
+    Z80State s0 = {};
+    for (int i=0; i<2*LEARN_MAX; i++) {
+        Z80State s; for (int k=0; k<8; k++) s.r[k]=(uint8_t)rng(); s.sp=(uint16_t)rng();
+        if (i==0) s0=s;
+        learned_add(bs,s,0);
+    }
+    learned_add(bs,s0,LEARN_GRACE);
+    if (bs.v.size()!=LEARN_MAX || bs.dropped!=LEARN_MAX || bs.duplicates!=1) bad++;
+    bs.v[0].rejects=5;
+    Z80State s1 = {}; s1.sp=1;
+    learned_add(bs,s1,LEARN_GRACE);
+    if (bs.v.size()!=LEARN_MAX || bs.evicted!=1 || bs.v[0].rejects!=5) bad++;
+    const char* path="/tmp/z80_learned_test.txt";
+    LearnedSet rs;
+    if (!learned_save(bs,path) || !learned_load(rs,path) || rs.v.size()!=bs.v.size()) bad++;
+    else for (const LearnedVec &x : bs.v) {
+        bool found=false;
+        for (const LearnedVec &y : rs.v) found |= learned_same(x.s,y.s) && x.rejects==y.rejects;
+        if (!found) bad++;
+    }
+    remove(path);
+    fprintf(stderr,"Learned vectors: %ld MidCheck false positives captured (%zu kept), %ld of %zu pairs rejected, %ld failures\n",
+            fps, ls.v.size(), rejected, pairs.size(), bad);
+    return bad;
+}
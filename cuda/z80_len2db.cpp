@@ -0,0 +1,171 @@
+// Z80 Length-2 Fingerprint Database Builder
+//
+// Enumerates every pruned length-2 sequence (same order and pruning as the
+// search drivers), takes its QuickCheck fingerprint once, and writes the
+// sorted, directory-indexed file described in z80_len2db.h. The file does
+// not depend on the dead-flag mask, so one build serves every run.
+//
+// Build: g++ -O3 -march=native -pthread -o z80len2db z80_len2db.cpp
+// Usage: ./z80len2db --out len2.db [--threads N]
+//        ./z80len2db --info len2.db
+//
+// Then: ./z80search_cpu --max-target 3 --len2-db len2.db
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_aflut.h"
+#include "z80_len2db.h"
+#include "z80_workpool.h"
+
+static bool write_all(FILE* f, const void* p, size_t n) { return fwrite(p, 1, n, f) == n; }
+
+static int build_db(const char* path, int nthreads) {
+    std::vector<Inst> all_insts = enumerate_instructions_8();
+    size_t ni = all_insts.size();
+    fprintf(stderr, "Instruction set: %zu instructions (8-bit)\n", ni);
+    time_t start = time(NULL);
+
+    // One task per first instruction, each filling its own slice.
+    std::vector<std::vector<L2DbRecord>> parts(ni);
+    {
+        WorkPool pool(nthreads);
+        for (size_t i0 = 0; i0 < ni; i0++) {
+            pool.submit([&, i0]() {
+                std::vector<L2DbRecord> &out = parts[i0];
+                PrefixCache pc;
+                for (size_t i1 = 0; i1 < ni; i1++) {
+                    uint16_t ops[2] = {all_insts[i0].op, all_insts[i1].op};
+                    uint16_t imms[2] = {all_insts[i0].imm, all_insts[i1].imm};
+                    // Dead with every flag live is dead under any --dead-flags mask
+                    if (should_prune(ops, imms, 2) || dead_instruction(ops, 2, 0) >= 0) continue;
+                    uint8_t fp[FP_LEN];
+                    pc.set(ops, imms, 2);
+                    pc.fingerprint(fp);
+                    L2DbRecord r;
+                    r.key = l2db_key(fp);
+                    for (int v = 0; v < NUM_VECTORS; v++) r.f[v] = fp[v * FP_SIZE + 1];
+                    r.ops[0] = ops[0]; r.ops[1] = ops[1];
+                    r.imms[0] = imms[0]; r.imms[1] = imms[1];
+                    out.push_back(r);
+                }
+            });
+        }
+        pool.wait_idle();
+    }
+
+    size_t count = 0;
+    for (auto &p : parts) count += p.size();
+    if (count >= UINT32_MAX) { fprintf(stderr, "len2db: too many records (%zu)\n", count); return 1; }
+    std::vector<L2DbRecord> recs;
+    recs.reserve(count);
+    for (auto &p : parts) { recs.insert(recs.end(), p.begin(), p.end()); std::vector<L2DbRecord>().swap(p); }
+    fprintf(stderr, "Fingerprinted %zu sequences (%lds)\n", count, (long)(time(NULL) - start));
+
+    // Sort by (key, F bytes); enumeration order breaks the remaining ties so
+    // the file is reproducible.
+    std::stable_sort(recs.begin(), recs.end(), [](const L2DbRecord &a, const L2DbRecord &b) {
+        if (a.key != b.key) return a.key < b.key;
+        return memcmp(a.f, b.f, NUM_VECTORS) < 0;
+    });
+
+    uint32_t dir_bits = L2DB_DIR_BITS;
+    size_t nb = (size_t)1 << dir_bits;
+    std::vector<uint32_t> dir(nb + 1);
+    size_t r = 0;
+    for (size_t b = 0; b < nb; b++) {
+        dir[b] = (uint32_t)r;
+        while (r < count && (recs[r].key >> (64 - dir_bits)) == b) r++;
+    }
+    dir[nb] = (uint32_t)count;
+
+    L2DbHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, L2DB_MAGIC, 8);
+    h.version = L2DB_VERSION;
+    h.rec_size = sizeof(L2DbRecord);
+    h.count = count;
+    h.vectors_hash = l2db_vectors_hash();
+    h.dir_bits = dir_bits;
+    h.dir_offset = sizeof(L2DbHeader);
+    size_t dir_end = h.dir_offset + dir.size() * sizeof(uint32_t);
+    h.rec_offset = (dir_end + L2DB_REC_ALIGN - 1) & ~(uint64_t)(L2DB_REC_ALIGN - 1);
+
+    // Write to a temp name and rename, so a reader never maps a partial file.
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) { fprintf(stderr, "len2db: cannot create '%s'\n", tmp.c_str()); return 1; }
+    std::vector<uint8_t> pad(h.rec_offset - dir_end, 0);
+    bool ok = write_all(f, &h, sizeof(h)) &&
+              write_all(f, dir.data(), dir.size() * sizeof(uint32_t)) &&
+              write_all(f, pad.data(), pad.size()) &&
+              write_all(f, recs.data(), recs.size() * sizeof(L2DbRecord));
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path) != 0) {
+        fprintf(stderr, "len2db: write to '%s' failed\n", path);
+        remove(tmp.c_str());
+        return 1;
+    }
+    fprintf(stderr, "Wrote %s: %zu records, %.1f MB (%lds)\n", path, count,
+            (h.rec_offset + count * sizeof(L2DbRecord)) / 1048576.0, (long)(time(NULL) - start));
+    return 0;
+}
+
+static int print_info(const char* path) {
+    L2Db db;
+    if (!l2db_open(db, path, false)) return 1;
+    uint64_t keys = 0, largest = 0;
+    for (uint64_t i = 0; i < db.hdr->count; ) {
+        uint64_t j = i;
+        while (j < db.hdr->count && db.recs[j].key == db.recs[i].key) j++;
+        keys++;
+        if (j - i > largest) largest = j - i;
+        i = j;
+    }
+    printf("file:          %s\n", path);
+    printf("version:       %u\n", db.hdr->version);
+    printf("records:       %lu\n", (unsigned long)db.hdr->count);
+    printf("distinct keys: %lu\n", (unsigned long)keys);
+    printf("largest group: %lu\n", (unsigned long)largest);
+    printf("directory:     2^%u buckets\n", db.hdr->dir_bits);
+    printf("size:          %.1f MB\n", db.size / 1048576.0);
+    l2db_close(db);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* out_path = NULL;
+    const char* info_path = NULL;
+    int nthreads = (int)std::thread::hardware_concurrency();
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--out") && i + 1 < argc) out_path = argv[++i];
+        else if (!strcmp(argv[i], "--info") && i + 1 < argc) info_path = argv[++i];
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--help")) {
+            fprintf(stderr, "Usage: z80len2db --out FILE [--threads N]\n"
+                "       z80len2db --info FILE\n"
+                "  --out FILE     Build the length-2 fingerprint database\n"
+                "  --info FILE    Validate a database and print its statistics\n"
+                "  --threads N    Worker threads (default: all cores)\n");
+            return 0;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+
+    init_tables();
+    aflut_init();
+
+    if (info_path) return print_info(info_path);
+    if (!out_path) { fprintf(stderr, "Error: --out FILE or --info FILE required (see --help)\n"); return 1; }
+    return build_db(out_path, nthreads);
+}
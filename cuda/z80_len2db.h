@@ -0,0 +1,165 @@
+// Length-2 fingerprint database — on-disk, sorted, mmap'd.
+//
+// Every pruned length-2 sequence is stored once with its QuickCheck result:
+// a 64-bit key hashed over the 72 non-F fingerprint bytes plus the 8 raw F
+// bytes. Because F is kept out of the key, one file serves every dead-flag
+// mask: the key narrows the probe, the F bytes are then compared under the
+// run's mask. Records are sorted by key and indexed by a top-bits directory,
+// so a probe is one directory lookup plus a short scan, and a length-3 sweep
+// becomes a streaming join against the file instead of a 4215^2 inner loop.
+//
+// Written by z80_len2db.cpp, probed by z80_search_cpu.cpp --len2-db.
+//
+// File layout (little-endian):
+//   L2DbHeader                        64 bytes
+//   uint32 dir[(1 << dir_bits) + 1]   first record index per key prefix
+//   (pad to 2 MB)
+//   L2DbRecord rec[count]             sorted by key
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "z80_common.h"
+
+#define L2DB_MAGIC      "Z80L2DB"
+#define L2DB_VERSION    1
+#define L2DB_DIR_BITS   20
+#define L2DB_REC_ALIGN  (1u << 21)   // records start on a 2 MB (huge page) boundary
+
+struct L2DbHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t rec_size;
+    uint64_t count;
+    uint64_t vectors_hash;   // h_test_vectors the fingerprints were taken with
+    uint32_t dir_bits;
+    uint32_t _pad;
+    uint64_t dir_offset;
+    uint64_t rec_offset;
+    uint8_t  _reserved[8];
+};
+
+struct L2DbRecord {
+    uint64_t key;
+    uint8_t  f[NUM_VECTORS];  // F register per QuickCheck vector, unmasked
+    uint16_t ops[2];
+    uint16_t imms[2];
+};
+
+static_assert(sizeof(L2DbHeader) == 64, "L2DbHeader layout");
+static_assert(sizeof(L2DbRecord) == 24, "L2DbRecord layout");
+
+// Key over everything except F, so it is independent of the dead-flag mask.
+static inline uint64_t l2db_key(const uint8_t fp[FP_LEN]) {
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (int i = 0; i < FP_LEN; i++) {
+        if (i % FP_SIZE == 1) continue;
+        h ^= fp[i]; h *= 0x100000001B3ull;
+    }
+    h ^= h >> 33; h *= 0xFF51AFD7ED558CCDull; h ^= h >> 33;
+    return h;
+}
+
+static inline uint64_t l2db_vectors_hash() { return h_test_vectors_hash(); }
+
+static inline bool l2db_flags_match(const L2DbRecord &rec, const uint8_t fp[FP_LEN], uint8_t dead_flags) {
+    uint8_t live = (uint8_t)~dead_flags;
+    for (int v = 0; v < NUM_VECTORS; v++)
+        if ((rec.f[v] & live) != (fp[v * FP_SIZE + 1] & live)) return false;
+    return true;
+}
+
+// Read-only mapping of a database file.
+struct L2Db {
+    int fd = -1;
+    void* base = nullptr;
+    size_t size = 0;
+    const L2DbHeader* hdr = nullptr;
+    const uint32_t* dir = nullptr;
+    const L2DbRecord* recs = nullptr;
+};
+
+// Map a database and validate it against the compiled-in test vectors.
+// populate=true pre-faults the whole file (MAP_POPULATE); either way the
+// record area is advised for huge pages and random access.
+static bool l2db_open(L2Db &db, const char* path, bool populate) {
+    db.fd = open(path, O_RDONLY);
+    if (db.fd < 0) { fprintf(stderr, "len2db: cannot open '%s'\n", path); return false; }
+    struct stat st;
+    if (fstat(db.fd, &st) != 0 || (size_t)st.st_size < sizeof(L2DbHeader)) {
+        fprintf(stderr, "len2db: '%s' is too short\n", path);
+        close(db.fd); db.fd = -1; return false;
+    }
+    db.size = (size_t)st.st_size;
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (populate) flags |= MAP_POPULATE;
+#endif
+    db.base = mmap(nullptr, db.size, PROT_READ, flags, db.fd, 0);
+    if (db.base == MAP_FAILED) {
+        fprintf(stderr, "len2db: mmap '%s' failed\n", path);
+        db.base = nullptr; close(db.fd); db.fd = -1; return false;
+    }
+    db.hdr = (const L2DbHeader*)db.base;
+    const L2DbHeader &h = *db.hdr;
+    const char* err = nullptr;
+    if (memcmp(h.magic, L2DB_MAGIC, 8) != 0) err = "bad magic";
+    else if (h.version != L2DB_VERSION) err = "unsupported version";
+    else if (h.rec_size != sizeof(L2DbRecord)) err = "record size mismatch";
+    else if (h.vectors_hash != l2db_vectors_hash()) err = "built with different QuickCheck vectors";
+    else if (h.dir_offset + (((size_t)1 << h.dir_bits) + 1) * sizeof(uint32_t) > db.size ||
+             h.rec_offset + h.count * sizeof(L2DbRecord) > db.size) err = "truncated";
+    if (err) {
+        fprintf(stderr, "len2db: '%s': %s\n", path, err);
+        munmap(db.base, db.size); close(db.fd); db = L2Db(); return false;
+    }
+    db.dir = (const uint32_t*)((const uint8_t*)db.base + h.dir_offset);
+    db.recs = (const L2DbRecord*)((const uint8_t*)db.base + h.rec_offset);
+#ifdef MADV_HUGEPAGE
+    madvise((uint8_t*)db.base + h.rec_offset, db.size - h.rec_offset, MADV_HUGEPAGE);
+#endif
+    madvise((uint8_t*)db.base + h.rec_offset, db.size - h.rec_offset, MADV_RANDOM);
+    return true;
+}
+
+static void l2db_close(L2Db &db) {
+    if (db.base) munmap(db.base, db.size);
+    if (db.fd >= 0) close(db.fd);
+    db = L2Db();
+}
+
+// Probe with an unmasked target fingerprint. Writes the indices of records
+// whose fingerprint equals the target's under dead_flags, in file order, and
+// returns how many were written (at most max_out). Inside a key group records
+// are sorted by F, so with no dead flags the exact F run is binary-searched;
+// otherwise the group is scanned (F-only sequences share one large group).
+static int l2db_probe(const L2Db &db, const uint8_t target_fp[FP_LEN], uint8_t dead_flags,
+                      uint64_t* out, int max_out) {
+    uint64_t key = l2db_key(target_fp);
+    uint64_t b = key >> (64 - db.hdr->dir_bits);
+    uint64_t lo = db.dir[b], hi = db.dir[b + 1];
+    uint8_t tf[NUM_VECTORS];
+    for (int v = 0; v < NUM_VECTORS; v++) tf[v] = target_fp[v * FP_SIZE + 1];
+    auto before = [&](const L2DbRecord &r) {  // r sorts before (key, tf)
+        if (r.key != key) return r.key < key;
+        return dead_flags == 0 && memcmp(r.f, tf, NUM_VECTORS) < 0;
+    };
+    while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (before(db.recs[mid])) lo = mid + 1; else hi = mid;
+    }
+    int n = 0;
+    for (uint64_t i = lo; i < db.dir[b + 1] && n < max_out; i++) {
+        const L2DbRecord &r = db.recs[i];
+        if (r.key != key) break;
+        if (l2db_flags_match(r, target_fp, dead_flags)) out[n++] = i;
+        else if (dead_flags == 0) break;
+    }
+    return n;
+}
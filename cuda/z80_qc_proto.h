@@ -0,0 +1,230 @@
+// QuickCheck server protocol, shared by z80_quickcheck.cu (z80qc) and
+// z80_quickcheck_cpu.cpp (z80qc_cpu).
+//
+// Version 1 (pkg/gpu's CUDAProcess) starts with the candidate upload and
+// then sends one 84-byte query per round trip:
+//   client -> server  uint32 candidate_count, uint32 seq_len,
+//                     candidate_count * seq_len * uint32 (op | imm<<16)
+//   client -> server  uint8[80] target_fp + uint32 dead_flags
+//   server -> client  uint32 match_count + uint32[match_count] indices
+//
+// Version 2 carries many fingerprints per request and lets the client keep
+// several requests in flight. The client opens with a QcHello; its magic
+// would be a v1 candidate count of 842M, which no v1 client sends, so the
+// server tells the two apart from the first word:
+//   client -> server  QcHello  {QC_MAGIC, 2, features wanted}
+//   server -> client  QcHello  {QC_MAGIC, 2, features granted, max_batch, max_inflight}
+//   client -> server  the v1 upload
+//   client -> server  QcRequest {id, n} + n QcQuery      (up to max_inflight unanswered)
+//   server -> client  QcResponse {id, n, total} + n uint32 match counts
+//                     + total uint32 indices, query by query
+// Ids are the client's and are echoed back; responses are written as
+// requests complete, which need not be the order they were sent. Within a
+// query, indices ascend, as in v1. A request with more than max_batch
+// queries, or a short read, ends the session; so does EOF once every
+// response is written.
+//
+// A client that asks for QC_FEAT_SHM passes a shared-memory region (see
+// z80_shm_ring.h) to the child as an open fd and names it and its ring size
+// in its hello. If the server can map it, it grants the feature, and after
+// the upload (still on the pipe) each QcRequest + queries and each response
+// is one message on the rings instead; the client closes its ring instead
+// of the pipe, and the server closes its own once every response is in it.
+// If not, the session carries on over the pipes.
+//
+// z80qc_cpu --daemon serves v2 sessions on a Unix socket, many at once, and
+// keeps one resident copy of each candidate set, keyed by qc_content_hash.
+// A plain v2 upload works there too (the daemon hashes it and drops it if
+// the set is already resident); a client that asks for QC_FEAT_RESIDENT
+// may skip the upload:
+//   client -> server  uint32 candidate_count, uint32 seq_len, uint64 hash
+//   server -> client  uint32 resident: 1, or 0 and the client sends the
+//                     candidates (which must hash to what it claimed)
+// The daemon grants no QC_FEAT_SHM: the region's fd cannot cross a socket
+// named only by its number.
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+
+#include "z80_shm_ring.h"
+
+#define QC_MAGIC        0x3243515Au   // "ZQC2"
+#define QC_VERSION      2
+#define QC_FP_LEN       80            // 8 vectors x 10 bytes
+#define QC_MAX_BATCH    4096          // queries per request
+#define QC_MAX_INFLIGHT 16            // requests sent but not answered
+
+#define QC_FEAT_SHM      1u           // requests and responses on shared-memory rings
+#define QC_FEAT_RESIDENT 2u           // upload keyed by content hash, skipped if resident
+
+struct QcHello {
+    uint32_t magic, version;
+    uint32_t features;                // QC_FEAT_*: wanted, then granted
+    uint32_t max_batch, max_inflight; // server's limits (0 from the client)
+    uint32_t shm_fd, shm_ring_bytes;  // client's region, with QC_FEAT_SHM
+    uint32_t _pad;
+};
+
+struct QcQuery { uint8_t fp[QC_FP_LEN]; uint32_t dead_flags; };
+struct QcRequest { uint32_t id, n; };
+struct QcResponse { uint32_t id, n, total, _pad; };
+
+static_assert(sizeof(QcHello) == 32 && sizeof(QcQuery) == 84 && sizeof(QcRequest) == 8 &&
+              sizeof(QcResponse) == 16, "QuickCheck server wire layout");
+
+// Block until fd is readable; false once cancel_fd (if any) is, instead.
+static bool qc_wait_readable(int fd, int cancel_fd) {
+    if (cancel_fd < 0) return true;
+    struct pollfd p[2] = {{fd, POLLIN, 0}, {cancel_fd, POLLIN, 0}};
+    while (poll(p, 2, -1) < 0)
+        if (errno != EINTR) return false;
+    return !p[1].revents;
+}
+
+static bool qc_read_all(int fd, void* p, size_t n, int cancel_fd = -1) {
+    char* c = (char*)p;
+    while (n) {
+        if (!qc_wait_readable(fd, cancel_fd)) return false;
+        ssize_t r = read(fd, c, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        c += r; n -= (size_t)r;
+    }
+    return true;
+}
+
+// Like qc_read_all, but 0 at a clean EOF (or cancel) before the first byte,
+// -1 on a short read or error, 1 when all n bytes arrived.
+static int qc_read_msg(int fd, void* p, size_t n, int cancel_fd = -1) {
+    char* c = (char*)p;
+    size_t got = 0;
+    while (got < n) {
+        if (!qc_wait_readable(fd, cancel_fd)) return got == 0 ? 0 : -1;
+        ssize_t r = read(fd, c + got, n - got);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return got == 0 && r == 0 ? 0 : -1;
+        got += (size_t)r;
+    }
+    return 1;
+}
+
+static bool qc_write_all(int fd, const void* p, size_t n) {
+    const char* c = (const char*)p;
+    while (n) {
+        ssize_t w = write(fd, c, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return false;
+        c += w; n -= (size_t)w;
+    }
+    return true;
+}
+
+// Where a v2 session's requests and responses travel: the pipes, or the
+// rings if the handshake granted QC_FEAT_SHM.
+struct QcLink {
+    int in_fd = 0, out_fd = 1;
+    int cancel_fd = -1;   // readable: qc_recv stops waiting on in_fd
+    bool shm = false;
+    ShmRegion region;
+    std::string buf;   // last message received from the rings
+};
+
+// FNV-1a over the upload as it is on the wire: the two header words, then
+// the packed candidates. Names a candidate set in a daemon.
+static uint64_t qc_content_hash(uint32_t count, uint32_t seq_len, const uint32_t* packed) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](const void* p, size_t n) {
+        const uint8_t* b = (const uint8_t*)p;
+        for (size_t i = 0; i < n; i++) h = (h ^ b[i]) * 0x100000001b3ull;
+    };
+    uint32_t header[2] = {count, seq_len};
+    mix(header, sizeof(header));
+    mix(packed, (size_t)count * seq_len * sizeof(uint32_t));
+    return h;
+}
+
+// The server's half of the handshake, after it has read the magic word;
+// it grants what the client wants of offer (QC_FEAT_*) and can do.
+static bool qc_accept_hello(QcLink &link, QcHello &client, uint32_t offer) {
+    client.magic = QC_MAGIC;
+    if (!qc_read_all(link.in_fd, (char*)&client + 4, sizeof(client) - 4)) return false;
+    client.features &= offer;
+    if ((client.features & QC_FEAT_SHM) &&
+        shm_region_map((int)client.shm_fd, client.shm_ring_bytes, true, link.region)) {
+        // the client never writes the pipe again, and stops reading ours when it exits
+        link.shm = true;
+        link.region.rx.peer_fd = link.in_fd;
+        link.region.tx.peer_fd = link.out_fd;
+        link.region.tx.peer_out = true;
+    }
+    QcHello h = {};
+    h.magic = QC_MAGIC;
+    h.version = QC_VERSION;
+    h.features = (client.features & ~QC_FEAT_SHM) | (link.shm ? QC_FEAT_SHM : 0);
+    h.max_batch = QC_MAX_BATCH;
+    h.max_inflight = QC_MAX_INFLIGHT;
+    return qc_write_all(link.out_fd, &h, sizeof(h));
+}
+
+// Next request: 1, 0 at the end of the session, -1 (reported) on a bad one.
+static int qc_recv(QcLink &link, QcRequest &rq, std::vector<QcQuery> &q) {
+    if (link.shm) {
+        int r = shm_recv(link.region.rx, link.buf);
+        if (r < 0) { fprintf(stderr, "Request stream cut short\n"); return -1; }
+        if (r == 0) return 0;
+        if (link.buf.size() < sizeof(rq)) { fprintf(stderr, "Short request header\n"); return -1; }
+        memcpy(&rq, link.buf.data(), sizeof(rq));
+    } else {
+        int r = qc_read_msg(link.in_fd, &rq, sizeof(rq), link.cancel_fd);
+        if (r < 0) { fprintf(stderr, "Short read on request header\n"); return -1; }
+        if (r == 0) return 0;
+    }
+    if (rq.n > QC_MAX_BATCH) {
+        fprintf(stderr, "Request %u has %u queries (max %d)\n", rq.id, rq.n, QC_MAX_BATCH);
+        return -1;
+    }
+    q.resize(rq.n);
+    if (link.shm) {
+        if (link.buf.size() != sizeof(rq) + rq.n * sizeof(QcQuery)) {
+            fprintf(stderr, "Request %u: %zu bytes for %u queries\n", rq.id, link.buf.size(), rq.n);
+            return -1;
+        }
+        if (rq.n) memcpy(q.data(), link.buf.data() + sizeof(rq), rq.n * sizeof(QcQuery));
+    } else if (rq.n && !qc_read_all(link.in_fd, q.data(), rq.n * sizeof(QcQuery), link.cancel_fd)) {
+        fprintf(stderr, "Short read on request %u\n", rq.id);
+        return -1;
+    }
+    return 1;
+}
+
+static bool qc_send(QcLink &link, const std::string &out) {
+    if (link.shm) return shm_send(link.region.tx, out.data(), out.size());
+    return qc_write_all(link.out_fd, out.data(), out.size());
+}
+
+// Every response is sent: tell a shared-memory client, and let go of the region.
+static void qc_link_end(QcLink &link) {
+    if (!link.shm) return;
+    shm_close(link.region.tx);
+    shm_region_unmap(link.region);
+    link.shm = false;
+}
+
+// Serialise one response: per-query match lists in query order.
+static void qc_response(uint32_t id, const std::vector<std::vector<uint32_t>> &matches, std::string &out) {
+    QcResponse r = {id, (uint32_t)matches.size(), 0, 0};
+    for (const auto &m : matches) r.total += (uint32_t)m.size();
+    out.assign((const char*)&r, sizeof(r));
+    for (const auto &m : matches) {
+        uint32_t c = (uint32_t)m.size();
+        out.append((const char*)&c, 4);
+    }
+    for (const auto &m : matches) if (!m.empty()) out.append((const char*)m.data(), m.size() * 4);
+}
@@ -3,24 +3,37 @@
 // against a target fingerprint. Each CUDA thread evaluates one candidate.
 //
 // Build: nvcc -O2 -o z80qc z80_quickcheck.cu
-// Usage: ./z80qc < input.bin > output.bin
+// Usage: ./z80qc [--server] < input.bin > output.bin
 //
 // Binary protocol (stdin):
 //   Header:  uint32 candidate_count
 //            uint32 seq_len (instructions per candidate, e.g. 2)
-//            uint32 dead_flags (flag mask, 0 = exact match)
-//            uint8  target_fingerprint[80]  (10 bytes * 8 test vectors)
 //   Body:    For each candidate (candidate_count times):
 //              seq_len * 4 bytes: (uint16 opcode, uint16 imm) per instruction
+//   Query:   uint8  target_fingerprint[80]  (10 bytes * 8 test vectors)
+//            uint32 dead_flags (flag mask, 0 = exact match)
+//            (repeated until EOF with --server)
 //
 // Binary protocol (stdout):
 //   uint32 match_count
 //   uint32 match_indices[match_count]
+//
+// Clients that open with the v2 handshake get batched, tagged and
+// pipelined queries instead (z80_qc_proto.h); z80_quickcheck_cpu.cpp is
+// the same server for hosts without a GPU.
 
 #include <cstdio>
 #include <cstdlib>
 #include <cstdint>
 #include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "z80_qc_proto.h"
 
 // ============================================================
 // Z80 flag bits
@@ -631,6 +644,30 @@ __device__ void exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
 #define NUM_VECTORS 8
 #define FP_LEN (FP_SIZE * NUM_VECTORS)
 
+// Fingerprint of one packed candidate sequence on the 8 test vectors.
+__device__ void candidate_fingerprint(const uint32_t* seq, uint32_t seq_len, uint8_t fp[FP_LEN]) {
+    for (int v = 0; v < NUM_VECTORS; v++) {
+        Z80State s = d_test_vectors[v];
+        for (uint32_t i = 0; i < seq_len; i++) {
+            uint32_t packed = seq[i];
+            uint16_t op  = (uint16_t)(packed & 0xFFFF);
+            uint16_t imm = (uint16_t)(packed >> 16);
+            exec_instruction(s, op, imm);
+        }
+        int off = v * FP_SIZE;
+        fp[off + 0] = s.r[REG_A];
+        fp[off + 1] = s.r[REG_F];
+        fp[off + 2] = s.r[REG_B];
+        fp[off + 3] = s.r[REG_C];
+        fp[off + 4] = s.r[REG_D];
+        fp[off + 5] = s.r[REG_E];
+        fp[off + 6] = s.r[REG_H];
+        fp[off + 7] = s.r[REG_L];
+        fp[off + 8] = (uint8_t)(s.sp >> 8);
+        fp[off + 9] = (uint8_t)s.sp;
+    }
+}
+
 __global__ void quickcheck_kernel(
     const uint32_t* __restrict__ candidates,  // packed (op16 | imm16<<16) per instruction
     const uint8_t*  __restrict__ target_fp,   // 80-byte target fingerprint
@@ -642,31 +679,9 @@ __global__ void quickcheck_kernel(
     uint32_t tid = blockIdx.x * blockDim.x + threadIdx.x;
     if (tid >= candidate_count) return;
 
-    // Load candidate's instruction sequence
-    const uint32_t* my_seq = candidates + (uint64_t)tid * seq_len;
-
     // Compute fingerprint for this candidate
     uint8_t my_fp[FP_LEN];
-    for (int v = 0; v < NUM_VECTORS; v++) {
-        Z80State s = d_test_vectors[v];
-        for (uint32_t i = 0; i < seq_len; i++) {
-            uint32_t packed = my_seq[i];
-            uint16_t op  = (uint16_t)(packed & 0xFFFF);
-            uint16_t imm = (uint16_t)(packed >> 16);
-            exec_instruction(s, op, imm);
-        }
-        int off = v * FP_SIZE;
-        my_fp[off + 0] = s.r[REG_A];
-        my_fp[off + 1] = s.r[REG_F];
-        my_fp[off + 2] = s.r[REG_B];
-        my_fp[off + 3] = s.r[REG_C];
-        my_fp[off + 4] = s.r[REG_D];
-        my_fp[off + 5] = s.r[REG_E];
-        my_fp[off + 6] = s.r[REG_H];
-        my_fp[off + 7] = s.r[REG_L];
-        my_fp[off + 8] = (uint8_t)(s.sp >> 8);
-        my_fp[off + 9] = (uint8_t)s.sp;
-    }
+    candidate_fingerprint(candidates + (uint64_t)tid * seq_len, seq_len, my_fp);
 
     // Compare against target fingerprint
     uint8_t flag_mask = (uint8_t)dead_flags;
@@ -684,6 +699,48 @@ __global__ void quickcheck_kernel(
     results[tid] = match ? 1u : 0u;
 }
 
+// Protocol v2: candidate fingerprints are computed once, column-major (byte
+// k of candidate c at k * count + c, so a warp's loads coalesce) ...
+__global__ void fingerprint_kernel(
+    const uint32_t* __restrict__ candidates,
+    uint8_t*        __restrict__ cand_fps,    // FP_LEN * candidate_count
+    uint32_t        candidate_count,
+    uint32_t        seq_len
+) {
+    uint32_t tid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (tid >= candidate_count) return;
+    uint8_t fp[FP_LEN];
+    candidate_fingerprint(candidates + (uint64_t)tid * seq_len, seq_len, fp);
+    for (int i = 0; i < FP_LEN; i++) cand_fps[(uint64_t)i * candidate_count + tid] = fp[i];
+}
+
+// ... and each request compares every candidate against n queries, each
+// with its own dead-flag mask; matches set bits in one bitmap row per query.
+__global__ void quickcheck_batch_kernel(
+    const uint8_t* __restrict__ cand_fps,
+    uint32_t       candidate_count,
+    const QcQuery* __restrict__ queries,
+    uint32_t       n,
+    uint32_t       bitmap_words,
+    uint32_t*      __restrict__ bitmap        // n * bitmap_words, zeroed
+) {
+    uint32_t tid = blockIdx.x * blockDim.x + threadIdx.x;
+    if (tid >= candidate_count) return;
+    uint8_t fp[FP_LEN];
+    for (int i = 0; i < FP_LEN; i++) fp[i] = cand_fps[(uint64_t)i * candidate_count + tid];
+    for (uint32_t q = 0; q < n; q++) {
+        const uint8_t* t = queries[q].fp;
+        uint8_t flag_mask = (uint8_t)queries[q].dead_flags;
+        bool match = true;
+        for (int i = 0; i < FP_LEN && match; i++) {
+            uint8_t d = fp[i] ^ t[i];
+            if ((i % FP_SIZE) == 1) d &= ~flag_mask;
+            match = d == 0;
+        }
+        if (match) atomicOr(&bitmap[(uint64_t)q * bitmap_words + tid / 32], 1u << (tid & 31));
+    }
+}
+
 // ============================================================
 // Host code
 // ============================================================
@@ -719,6 +776,121 @@ static void cpu_fingerprint(const uint32_t* seq, uint32_t seq_len, uint8_t fp[FP
     }
 }
 
+// ============================================================
+// Protocol v2 (z80_qc_proto.h): batched, tagged requests
+// ============================================================
+// A reader thread keeps up to QC_MAX_INFLIGHT requests parsed ahead while
+// the GPU works on the current one, so the pipe is never idle; each request
+// runs as one launch per bitmap-sized chunk of queries and its response is
+// written as soon as it is done.
+#define QC_BITMAP_BYTES (64u << 20)
+
+struct QcPending { QcRequest rq; std::vector<QcQuery> q; };
+
+static int serve_batched(const uint32_t* d_candidates, uint32_t candidate_count, uint32_t seq_len, QcLink &link) {
+    int blockSize = 256;
+    int gridSize = (candidate_count + blockSize - 1) / blockSize;
+    uint8_t* d_cand_fps;
+    cudaMalloc(&d_cand_fps, (size_t)FP_LEN * candidate_count + 1);
+    if (candidate_count)
+        fingerprint_kernel<<<gridSize, blockSize>>>(d_candidates, d_cand_fps, candidate_count, seq_len);
+
+    uint32_t words = (candidate_count + 31) / 32;
+    uint32_t chunk = QC_MAX_BATCH;
+    if (words && (size_t)chunk * words * 4 > QC_BITMAP_BYTES) chunk = QC_BITMAP_BYTES / (words * 4);
+    if (chunk == 0) chunk = 1;
+    QcQuery* d_queries;
+    uint32_t* d_bitmap;
+    cudaMalloc(&d_queries, chunk * sizeof(QcQuery));
+    cudaMalloc(&d_bitmap, (size_t)chunk * words * 4 + 4);
+    std::vector<uint32_t> h_bitmap((size_t)chunk * words);
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<QcPending> queue;
+    bool eof = false, failed = false, stop = false;
+    // On an error the reader is woken wherever it waits (the cancel pipe, or
+    // the closed request ring) and always joined.
+    int cancel[2] = {-1, -1};
+    if (!link.shm && pipe(cancel) == 0) link.cancel_fd = cancel[0];
+    std::thread reader([&]() {
+        while (true) {
+            QcPending p;
+            int r = qc_recv(link, p.rq, p.q);
+            std::unique_lock<std::mutex> lk(mu);
+            if (stop) return;
+            if (r <= 0) { eof = true; failed = r < 0; cv.notify_all(); return; }
+            cv.wait(lk, [&] { return queue.size() < QC_MAX_INFLIGHT || stop; });
+            if (stop) return;
+            queue.push_back(std::move(p));
+            cv.notify_all();
+        }
+    });
+
+    uint64_t requests = 0, queries = 0;
+    int rc = 0;
+    std::vector<std::vector<uint32_t>> matches;
+    std::string out;
+    while (true) {
+        QcPending p;
+        {
+            std::unique_lock<std::mutex> lk(mu);
+            cv.wait(lk, [&] { return !queue.empty() || eof; });
+            if (queue.empty()) break;
+            p = std::move(queue.front());
+            queue.pop_front();
+            cv.notify_all();
+        }
+        matches.assign(p.rq.n, std::vector<uint32_t>());
+        for (uint32_t lo = 0; lo < p.rq.n; lo += chunk) {
+            uint32_t n = std::min(chunk, p.rq.n - lo);
+            cudaMemcpy(d_queries, p.q.data() + lo, n * sizeof(QcQuery), cudaMemcpyHostToDevice);
+            cudaMemset(d_bitmap, 0, (size_t)n * words * 4);
+            if (candidate_count)
+                quickcheck_batch_kernel<<<gridSize, blockSize>>>(d_cand_fps, candidate_count, d_queries, n, words, d_bitmap);
+            cudaError_t err = cudaDeviceSynchronize();
+            if (err != cudaSuccess) {
+                fprintf(stderr, "CUDA error at request %u: %s\n", p.rq.id, cudaGetErrorString(err));
+                rc = 1;
+                break;
+            }
+            cudaMemcpy(h_bitmap.data(), d_bitmap, (size_t)n * words * 4, cudaMemcpyDeviceToHost);
+            for (uint32_t k = 0; k < n; k++)
+                for (uint32_t w = 0; w < words; w++)
+                    for (uint32_t bits = h_bitmap[(size_t)k * words + w]; bits; bits &= bits - 1)
+                        matches[lo + k].push_back(w * 32 + __builtin_ctz(bits));
+        }
+        if (rc) break;
+        qc_response(p.rq.id, matches, out);
+        if (!qc_send(link, out)) {
+            fprintf(stderr, "Failed to write responses\n");
+            rc = 1;
+            break;
+        }
+        requests++; queries += p.rq.n;
+    }
+    if (rc) {
+        // stop the reader: it may be blocked on a full queue, stdin or the rings
+        {
+            std::lock_guard<std::mutex> lk(mu);
+            stop = true;
+            queue.clear();
+            cv.notify_all();
+        }
+        if (link.shm) shm_close(link.region.rx);
+        else if (cancel[1] >= 0 && write(cancel[1], "x", 1) < 0) {}
+    }
+    reader.join();
+    qc_link_end(link);
+    if (cancel[0] >= 0) { close(cancel[0]); close(cancel[1]); link.cancel_fd = -1; }
+    if (failed) rc = 1;
+    fprintf(stderr, "Processed %lu requests (%lu queries)\n", (unsigned long)requests, (unsigned long)queries);
+    cudaFree(d_cand_fps);
+    cudaFree(d_queries);
+    cudaFree(d_bitmap);
+    return rc;
+}
+
 int main(int argc, char** argv) {
     bool self_test = (argc > 1 && strcmp(argv[1], "--test") == 0);
 
@@ -829,12 +1001,28 @@ int main(int argc, char** argv) {
     //   uint8[80] target_fp  +  uint32 dead_flags  (84 bytes per query)
     //   → uint32 match_count  +  uint32[match_count] match_indices
     // Phase ends when stdin reaches EOF.
+    // A client that opens with the v2 handshake (z80_qc_proto.h) gets the
+    // batched protocol instead, after the same upload, on the pipes or on
+    // shared-memory rings.
 
     bool server_mode = (argc > 1 && strcmp(argv[1], "--server") == 0);
 
-    // ---- Read header ----
+    // ---- Read header (or the v2 handshake, then the header) ----
     uint32_t header[2];
-    if (fread(header, sizeof(uint32_t), 2, stdin) != 2) {
+    if (!qc_read_all(0, &header[0], sizeof(uint32_t))) {
+        fprintf(stderr, "Failed to read header\n");
+        return 1;
+    }
+    bool batched = header[0] == QC_MAGIC;
+    QcLink link;
+    if (batched) {
+        QcHello hello;
+        if (!qc_accept_hello(link, hello, QC_FEAT_SHM) || !qc_read_all(0, &header[0], sizeof(uint32_t))) {
+            fprintf(stderr, "Failed to read handshake\n");
+            return 1;
+        }
+    }
+    if (!qc_read_all(0, &header[1], sizeof(uint32_t))) {
         fprintf(stderr, "Failed to read header\n");
         return 1;
     }
@@ -848,14 +1036,13 @@ int main(int argc, char** argv) {
         fprintf(stderr, "Failed to allocate %zu bytes for candidates\n", cand_bytes);
         return 1;
     }
-    size_t cand_words = (size_t)candidate_count * seq_len;
-    if (fread(h_candidates, sizeof(uint32_t), cand_words, stdin) != cand_words) {
+    if (!qc_read_all(0, h_candidates, cand_bytes)) {
         fprintf(stderr, "Failed to read candidate data\n");
         return 1;
     }
 
     fprintf(stderr, "Loaded %u candidates, seq_len=%u, mode=%s\n",
-            candidate_count, seq_len, server_mode ? "server" : "single");
+            candidate_count, seq_len, link.shm ? "batched, shared memory" : batched ? "batched" : server_mode ? "server" : "single");
 
     // Allocate GPU memory
     uint32_t *d_candidates, *d_results;
@@ -868,13 +1055,21 @@ int main(int argc, char** argv) {
     cudaMemcpy(d_candidates, h_candidates, cand_bytes, cudaMemcpyHostToDevice);
     free(h_candidates);
 
-    // Allocate host results buffer (reused)
-    uint32_t* h_results = (uint32_t*)malloc(candidate_count * sizeof(uint32_t));
-    uint32_t* matches = (uint32_t*)malloc(candidate_count * sizeof(uint32_t));
-
     int blockSize = 256;
     int gridSize = (candidate_count + blockSize - 1) / blockSize;
 
+    if (batched) {
+        int rc = serve_batched(d_candidates, candidate_count, seq_len, link);
+        cudaFree(d_candidates);
+        cudaFree(d_results);
+        cudaFree(d_target_fp);
+        return rc;
+    }
+
+    // Allocate host results buffer (reused); matches[0] is the count
+    uint32_t* h_results = (uint32_t*)malloc(candidate_count * sizeof(uint32_t));
+    uint32_t* matches = (uint32_t*)malloc((candidate_count + 1) * sizeof(uint32_t));
+
     // ---- Query loop ----
     uint8_t target_fp[FP_LEN];
     uint32_t dead_flags;
@@ -882,13 +1077,13 @@ int main(int argc, char** argv) {
 
     while (true) {
         // Read target fingerprint (80 bytes) + dead_flags (4 bytes)
-        size_t nread = fread(target_fp, 1, FP_LEN, stdin);
+        int nread = qc_read_msg(0, target_fp, FP_LEN);
         if (nread == 0) break; // EOF
-        if (nread != FP_LEN) {
-            fprintf(stderr, "Short read on target_fp: %zu/%d\n", nread, FP_LEN);
+        if (nread < 0) {
+            fprintf(stderr, "Short read on target_fp\n");
             break;
         }
-        if (fread(&dead_flags, sizeof(uint32_t), 1, stdin) != 1) {
+        if (!qc_read_all(0, &dead_flags, sizeof(uint32_t))) {
             fprintf(stderr, "Failed to read dead_flags\n");
             break;
         }
@@ -913,14 +1108,15 @@ int main(int argc, char** argv) {
         // Collect matches
         uint32_t match_count = 0;
         for (uint32_t i = 0; i < candidate_count; i++) {
-            if (h_results[i]) matches[match_count++] = i;
+            if (h_results[i]) matches[1 + match_count++] = i;
         }
 
         // Write output
-        fwrite(&match_count, sizeof(uint32_t), 1, stdout);
-        if (match_count > 0)
-            fwrite(matches, sizeof(uint32_t), match_count, stdout);
-        fflush(stdout);
+        matches[0] = match_count;
+        if (!qc_write_all(1, matches, (match_count + 1) * sizeof(uint32_t))) {
+            fprintf(stderr, "Failed to write matches\n");
+            return 1;
+        }
 
         query_count++;
 
@@ -0,0 +1,841 @@
+// Z80 QuickCheck CPU server — drop-in for z80_quickcheck.cu on hosts without
+// an NVIDIA GPU. Same stdin/stdout protocol, same answers, byte for byte.
+//
+// Candidates are fingerprinted once when they are uploaded (the 8 test
+// vectors never change, only the target and the dead-flag mask do) and kept
+// column-major: one array per fingerprint byte across all candidates. A
+// query then compares columns against the target's bytes, a block of
+// candidates at a time, which vectorises, and stops for a block as soon as
+// no candidate in it is left. Large candidate sets are split into slices on
+// the work pool; the slices' matches are concatenated in slice order, so the
+// indices come back ascending, as from the GPU.
+//
+// Build: g++ -O3 -march=native -pthread -o z80qc_cpu z80_quickcheck_cpu.cpp
+// Usage: ./z80qc_cpu [--server] [--threads N] < input.bin > output.bin
+//        ./z80qc_cpu --daemon /tmp/z80qc.sock [--max-resident-mb N]
+//        ./z80qc_cpu --test   (index order and matches vs direct fingerprints)
+//
+// Protocol (as z80_quickcheck.cu):
+//   stdin:  uint32 candidate_count, uint32 seq_len,
+//           candidate_count * seq_len * uint32 (op | imm<<16)
+//           then per query: uint8[80] target_fp + uint32 dead_flags
+//   stdout: per query: uint32 match_count + uint32[match_count] match_indices
+// Without --server, the first query is answered and the server exits.
+//
+// The Go side (pkg/gpu) only needs CUDABinaryPath pointed at this binary.
+//
+// --daemon serves many v2 clients at once on a Unix socket (pkg/gpu's
+// DialQCDaemon): each candidate set is loaded once and stays resident while
+// it fits, and every session's tasks are dealt round-robin onto one pool.
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_workpool.h"
+#include "z80_qc_proto.h"
+
+#define QC_BLOCK 256            // candidates compared together
+#define QC_SLICE (64 * 1024)    // candidates per pool task
+#define QC_TASK_PAIRS (1u << 20) // (query, candidate) pairs per v2 pool task
+#define QC_INLINE_PAIRS (1u << 16) // smaller v2 requests are answered by the reader
+
+// Where a session's tasks go: straight onto the pool, or, in the daemon,
+// through the fair queue it shares with the other clients.
+using QcSubmit = std::function<void(std::function<void()>)>;
+
+// Run tasks through submit and wait for them (not for the rest of the pool).
+static void qc_run_all(const QcSubmit &submit, std::vector<std::function<void()>> &tasks) {
+    std::mutex mu;
+    std::condition_variable cv;
+    size_t left = tasks.size();
+    for (auto &t : tasks)
+        submit([&mu, &cv, &left, &t]() {
+            t();
+            std::lock_guard<std::mutex> lk(mu);
+            if (--left == 0) cv.notify_all();
+        });
+    std::unique_lock<std::mutex> lk(mu);
+    cv.wait(lk, [&] { return left == 0; });
+}
+
+struct QcServer {
+    uint32_t count = 0, seq_len = 0;
+    std::vector<uint8_t> cols;  // FP_LEN columns of count bytes each
+};
+
+// Fingerprint candidates [lo, hi) into the columns.
+static void qc_fill(QcServer &qs, const uint32_t* packed, uint32_t lo, uint32_t hi) {
+    std::vector<uint16_t> ops(qs.seq_len), imms(qs.seq_len);
+    uint8_t fp[FP_LEN];
+    for (uint32_t ci = lo; ci < hi; ci++) {
+        for (uint32_t i = 0; i < qs.seq_len; i++) {
+            uint32_t p = packed[(size_t)ci * qs.seq_len + i];
+            ops[i] = (uint16_t)p; imms[i] = (uint16_t)(p >> 16);
+        }
+        Z80StateBatch<NUM_VECTORS> b;
+        b.load(h_test_vectors);
+        exec_batch_seq(ops.data(), imms.data(), (int)qs.seq_len, b);
+        batch_fingerprint(b, fp);
+        for (int k = 0; k < FP_LEN; k++) qs.cols[(size_t)k * qs.count + ci] = fp[k];
+    }
+}
+
+static void qc_load(QcServer &qs, const uint32_t* packed, uint32_t count, uint32_t seq_len, const QcSubmit &submit) {
+    qs.count = count; qs.seq_len = seq_len;
+    qs.cols.assign((size_t)FP_LEN * count, 0);
+    std::vector<std::function<void()>> tasks;
+    for (uint32_t lo = 0; lo < count; lo += QC_SLICE)
+        tasks.push_back([&qs, packed, lo]() { qc_fill(qs, packed, lo, std::min(qs.count, lo + QC_SLICE)); });
+    qc_run_all(submit, tasks);
+}
+
+// Matches among candidates [lo, hi), ascending.
+static void qc_match(const QcServer &qs, const uint8_t* tfp, const uint8_t* mask, uint32_t lo, uint32_t hi,
+                     std::vector<uint32_t> &out) {
+    uint8_t alive[QC_BLOCK];
+    for (uint32_t base = lo; base < hi; base += QC_BLOCK) {
+        uint32_t n = std::min<uint32_t>(QC_BLOCK, hi - base);
+        memset(alive, 1, n);
+        bool any = true;
+        for (int v = 0; v < NUM_VECTORS && any; v++) {
+            for (int k = v * FP_SIZE; k < (v + 1) * FP_SIZE; k++) {
+                const uint8_t* col = &qs.cols[(size_t)k * qs.count + base];
+                uint8_t t = tfp[k] & mask[k], m = mask[k];
+                for (uint32_t i = 0; i < n; i++) alive[i] &= (uint8_t)((col[i] & m) == t);
+            }
+            uint8_t acc = 0;
+            for (uint32_t i = 0; i < n; i++) acc |= alive[i];
+            any = acc != 0;
+        }
+        if (!any) continue;
+        for (uint32_t i = 0; i < n; i++) if (alive[i]) out.push_back(base + i);
+    }
+}
+
+// One query: matching candidate indices, ascending (the kernel's result
+// array walked in order).
+static void qc_query(const QcServer &qs, const uint8_t tfp[FP_LEN], uint32_t dead_flags, WorkPool &pool,
+                     std::vector<std::vector<uint32_t>> &parts, std::vector<uint32_t> &matches) {
+    uint8_t mask[FP_LEN];
+    for (int k = 0; k < FP_LEN; k++) mask[k] = (k % FP_SIZE) == 1 ? (uint8_t)~dead_flags : 0xFF;
+    matches.clear();
+    uint32_t nslices = (qs.count + QC_SLICE - 1) / QC_SLICE;
+    if (nslices <= 1 || pool.size() == 1) { qc_match(qs, tfp, mask, 0, qs.count, matches); return; }
+    parts.resize(nslices);
+    for (uint32_t s = 0; s < nslices; s++) {
+        parts[s].clear();
+        pool.submit([&, s]() {
+            qc_match(qs, tfp, mask, s * QC_SLICE, std::min(qs.count, (s + 1) * QC_SLICE), parts[s]);
+        });
+    }
+    pool.wait_idle();
+    for (uint32_t s = 0; s < nslices; s++) matches.insert(matches.end(), parts[s].begin(), parts[s].end());
+}
+
+// Version 2: requests are split into tasks of up to QC_TASK_PAIRS
+// (query, candidate) pairs, by query and by slice; the task that finishes a
+// request assembles and writes its response, so responses leave in
+// completion order while the next requests are still being read.
+struct QcJob {
+    uint32_t id;
+    std::vector<QcQuery> q;
+    std::vector<std::vector<std::vector<uint32_t>>> parts;   // [slice][query]
+    std::atomic<uint32_t> left{0};
+};
+
+static int serve_batched(const QcServer &qs, QcLink &link, const QcSubmit &submit) {
+    std::mutex mu;
+    std::condition_variable cv;
+    uint32_t inflight = 0;
+    bool write_failed = false;
+    uint64_t requests = 0, queries = 0;
+    uint32_t nslices = std::max<uint32_t>(1, (qs.count + QC_SLICE - 1) / QC_SLICE);
+    uint32_t per_task = std::max<uint32_t>(1, QC_TASK_PAIRS / std::max<uint32_t>(1, std::min<uint32_t>(qs.count, QC_SLICE)));
+
+    auto finish = [&](QcJob &job) {
+        std::vector<std::vector<uint32_t>> m(job.q.size());
+        for (size_t k = 0; k < job.q.size(); k++)
+            for (uint32_t s = 0; s < nslices; s++) m[k].insert(m[k].end(), job.parts[s][k].begin(), job.parts[s][k].end());
+        std::string out;
+        qc_response(job.id, m, out);
+        std::lock_guard<std::mutex> lk(mu);
+        if (!write_failed && !qc_send(link, out)) write_failed = true;
+        inflight--;
+        cv.notify_all();
+    };
+
+    int rc = 0;
+    while (true) {
+        QcRequest rq;
+        auto job = std::make_shared<QcJob>();
+        int r = qc_recv(link, rq, job->q);
+        if (r <= 0) { rc = r < 0; break; }
+        job->id = rq.id;
+        {
+            std::unique_lock<std::mutex> lk(mu);
+            cv.wait(lk, [&] { return inflight < QC_MAX_INFLIGHT || write_failed; });
+            if (write_failed) break;
+            inflight++;
+        }
+        requests++; queries += rq.n;
+        if (rq.n == 0) { finish(*job); continue; }
+        job->parts.assign(nslices, std::vector<std::vector<uint32_t>>(rq.n));
+        uint32_t nchunks = (rq.n + per_task - 1) / per_task;
+        auto run = [&qs, per_task](QcJob &j, uint32_t c, uint32_t s) {
+            uint32_t lo = s * QC_SLICE, hi = std::min(qs.count, lo + QC_SLICE);
+            for (uint32_t k = c * per_task; k < std::min<uint32_t>(j.q.size(), (c + 1) * per_task); k++) {
+                uint8_t mask[FP_LEN];
+                for (int b = 0; b < FP_LEN; b++) mask[b] = (b % FP_SIZE) == 1 ? (uint8_t)~j.q[k].dead_flags : 0xFF;
+                qc_match(qs, j.q[k].fp, mask, lo, hi, j.parts[s][k]);
+            }
+        };
+        if ((uint64_t)rq.n * qs.count <= QC_INLINE_PAIRS) {
+            // cheaper here than the hand-off to a worker and back
+            run(*job, 0, 0);
+            finish(*job);
+            continue;
+        }
+        job->left = nchunks * nslices;
+        for (uint32_t c = 0; c < nchunks; c++)
+            for (uint32_t s = 0; s < nslices; s++)
+                submit([&, run, job, c, s]() {
+                    run(*job, c, s);
+                    if (job->left.fetch_sub(1) == 1) finish(*job);
+                });
+    }
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        cv.wait(lk, [&] { return inflight == 0; });
+    }
+    qc_link_end(link);
+    if (write_failed) { fprintf(stderr, "Failed to write responses\n"); rc = 1; }
+    fprintf(stderr, "Processed %lu requests (%lu queries)\n", (unsigned long)requests, (unsigned long)queries);
+    return rc;
+}
+
+static int serve(int in_fd, int out_fd, bool server_mode, WorkPool &pool) {
+    // A v2 client opens with the handshake; anything else is a v1 upload.
+    uint32_t header[2];
+    if (!qc_read_all(in_fd, &header[0], 4)) {
+        fprintf(stderr, "Failed to read header\n");
+        return 1;
+    }
+    bool batched = header[0] == QC_MAGIC;
+    QcLink link;
+    link.in_fd = in_fd; link.out_fd = out_fd;
+    if (batched) {
+        QcHello hello;
+        if (!qc_accept_hello(link, hello, QC_FEAT_SHM) || !qc_read_all(in_fd, &header[0], 4)) {
+            fprintf(stderr, "Failed to read handshake\n");
+            return 1;
+        }
+    }
+    if (!qc_read_all(in_fd, &header[1], 4)) {
+        fprintf(stderr, "Failed to read header\n");
+        return 1;
+    }
+    uint32_t candidate_count = header[0], seq_len = header[1];
+    size_t cand_words = (size_t)candidate_count * seq_len;
+    std::vector<uint32_t> packed(cand_words);
+    if (!qc_read_all(in_fd, packed.data(), cand_words * sizeof(uint32_t))) {
+        fprintf(stderr, "Failed to read candidate data\n");
+        return 1;
+    }
+    fprintf(stderr, "Loaded %u candidates, seq_len=%u, mode=%s\n",
+            candidate_count, seq_len, link.shm ? "batched, shared memory" : batched ? "batched" : server_mode ? "server" : "single");
+
+    QcSubmit submit = [&pool](std::function<void()> t) { pool.submit(std::move(t)); };
+    QcServer qs;
+    qc_load(qs, packed.data(), candidate_count, seq_len, submit);
+    packed.clear(); packed.shrink_to_fit();
+    if (batched) return serve_batched(qs, link, submit);
+
+    QcQuery q;
+    uint64_t query_count = 0;
+    std::vector<std::vector<uint32_t>> parts;
+    std::vector<uint32_t> matches;
+    matches.reserve(candidate_count + 1);
+    while (true) {
+        int r = qc_read_msg(in_fd, q.fp, FP_LEN);
+        if (r == 0) break; // EOF
+        if (r < 0) {
+            fprintf(stderr, "Short read on target_fp\n");
+            break;
+        }
+        if (!qc_read_all(in_fd, &q.dead_flags, sizeof(uint32_t))) {
+            fprintf(stderr, "Failed to read dead_flags\n");
+            break;
+        }
+        qc_query(qs, q.fp, q.dead_flags, pool, parts, matches);
+        uint32_t match_count = (uint32_t)matches.size();
+        matches.insert(matches.begin(), match_count);
+        if (!qc_write_all(out_fd, matches.data(), matches.size() * sizeof(uint32_t))) {
+            fprintf(stderr, "Failed to write matches\n");
+            return 1;
+        }
+        query_count++;
+        if (!server_mode) break; // single-query mode: exit after first query
+    }
+    if (server_mode) fprintf(stderr, "Processed %lu queries\n", (unsigned long)query_count);
+    return 0;
+}
+
+// ============================================================
+// Daemon: v2 sessions from many clients on a Unix socket, one resident copy
+// of each candidate set, and the sessions' tasks dealt round-robin onto the
+// one pool, so a client with huge requests cannot starve the others
+// ============================================================
+
+// Per-client task queues in front of the pool. At most one task per worker
+// is on the pool at a time; when one finishes, the next comes from the
+// client after the last one served that has work.
+class QcFairQueue {
+public:
+    struct Client {
+        std::deque<std::function<void()>> tasks;
+        bool listed = false;
+    };
+
+    explicit QcFairQueue(WorkPool &pool) : pool_(pool) {}
+
+    void submit(Client &c, std::function<void()> task) {
+        std::lock_guard<std::mutex> lk(mu_);
+        c.tasks.push_back(std::move(task));
+        if (!c.listed) { ring_.push_back(&c); c.listed = true; }
+        pump();
+    }
+
+private:
+    void pump() {   // mu_ held
+        while (running_ < pool_.size() && !ring_.empty()) {
+            Client* c = ring_.front();
+            ring_.pop_front();
+            std::function<void()> t = std::move(c->tasks.front());
+            c->tasks.pop_front();
+            if (c->tasks.empty()) c->listed = false;
+            else ring_.push_back(c);
+            running_++;
+            pool_.submit([this, t]() {
+                t();
+                std::lock_guard<std::mutex> lk(mu_);
+                running_--;
+                pump();
+            });
+        }
+    }
+
+    WorkPool &pool_;
+    std::mutex mu_;
+    std::deque<Client*> ring_;
+    int running_ = 0;
+};
+
+struct QcResident {
+    QcServer qs;
+    bool ready = false;     // loaded; until then its loader is filling qs
+    uint32_t users = 0;
+    uint64_t last_used = 0;
+};
+
+struct QcDaemon {
+    QcFairQueue fair;
+    size_t max_bytes;       // unused sets beyond this are dropped, oldest first
+    std::mutex mu;
+    std::condition_variable cv;
+    // keyed by (content hash, count, seq_len)
+    std::map<std::tuple<uint64_t, uint32_t, uint32_t>, std::unique_ptr<QcResident>> sets;
+    uint64_t clock = 0, loads = 0, hits = 0;
+    int sessions = 0, listen_fd = -1;
+
+    QcDaemon(WorkPool &pool, size_t max_bytes) : fair(pool), max_bytes(max_bytes) {}
+};
+
+static void qc_daemon_evict(QcDaemon &d) {   // d.mu held
+    size_t bytes = 0;
+    for (auto &e : d.sets) bytes += e.second->qs.cols.size();
+    while (bytes > d.max_bytes) {
+        auto victim = d.sets.end();
+        for (auto it = d.sets.begin(); it != d.sets.end(); ++it)
+            if (it->second->ready && it->second->users == 0 &&
+                (victim == d.sets.end() || it->second->last_used < victim->second->last_used)) victim = it;
+        if (victim == d.sets.end()) return;
+        bytes -= victim->second->qs.cols.size();
+        fprintf(stderr, "Dropped candidate set %016llx (%u candidates)\n",
+                (unsigned long long)std::get<0>(victim->first), victim->second->qs.count);
+        d.sets.erase(victim);
+    }
+}
+
+// One client, from the magic word to EOF.
+static int qc_daemon_session(QcDaemon &d, int fd, int id) {
+    uint32_t magic;
+    if (!qc_read_all(fd, &magic, 4)) return 1;
+    if (magic != QC_MAGIC) {
+        fprintf(stderr, "Client %d: the daemon speaks protocol v2 only\n", id);
+        return 1;
+    }
+    QcLink link;
+    link.in_fd = link.out_fd = fd;
+    QcHello hello;
+    uint32_t header[2];
+    if (!qc_accept_hello(link, hello, QC_FEAT_RESIDENT) || !qc_read_all(fd, header, sizeof(header))) {
+        fprintf(stderr, "Client %d: failed to read handshake\n", id);
+        return 1;
+    }
+    uint32_t count = header[0], seq_len = header[1];
+    bool keyed = hello.features & QC_FEAT_RESIDENT;
+    uint64_t hash = 0;
+    std::vector<uint32_t> packed;
+    auto read_upload = [&]() {
+        packed.resize((size_t)count * seq_len);
+        if (!qc_read_all(fd, packed.data(), packed.size() * sizeof(uint32_t))) {
+            fprintf(stderr, "Client %d: failed to read candidate data\n", id);
+            return false;
+        }
+        return true;
+    };
+    if (keyed) {
+        if (!qc_read_all(fd, &hash, sizeof(hash))) return 1;
+    } else {
+        if (!read_upload()) return 1;
+        hash = qc_content_hash(count, seq_len, packed.data());
+    }
+
+    // Attach: use the resident copy, wait for one being loaded, or load it.
+    auto key = std::make_tuple(hash, count, seq_len);
+    QcResident* set;
+    bool load;
+    {
+        std::unique_lock<std::mutex> lk(d.mu);
+        d.cv.wait(lk, [&] { auto it = d.sets.find(key); return it == d.sets.end() || it->second->ready; });
+        auto it = d.sets.find(key);
+        load = it == d.sets.end();
+        if (load) it = d.sets.emplace(key, std::unique_ptr<QcResident>(new QcResident())).first;
+        else d.hits++;
+        set = it->second.get();
+        set->users++;
+    }
+    auto detach = [&](bool drop) {
+        std::lock_guard<std::mutex> lk(d.mu);
+        set->users--;
+        set->last_used = ++d.clock;
+        if (drop) d.sets.erase(key);
+        else qc_daemon_evict(d);
+        d.cv.notify_all();
+    };
+    if (keyed) {
+        uint32_t resident = load ? 0 : 1;
+        if (!qc_write_all(fd, &resident, sizeof(resident)) || (load && !read_upload())) {
+            detach(load);
+            return 1;
+        }
+        if (load && qc_content_hash(count, seq_len, packed.data()) != hash) {
+            fprintf(stderr, "Client %d: upload does not hash to %016llx\n", id, (unsigned long long)hash);
+            detach(true);
+            return 1;
+        }
+    }
+    QcFairQueue::Client fc;
+    QcSubmit submit = [&d, &fc](std::function<void()> t) { d.fair.submit(fc, std::move(t)); };
+    if (load) {
+        qc_load(set->qs, packed.data(), count, seq_len, submit);
+        std::lock_guard<std::mutex> lk(d.mu);
+        set->ready = true;
+        d.loads++;
+        d.cv.notify_all();
+    }
+    packed.clear(); packed.shrink_to_fit();
+    fprintf(stderr, "Client %d: %s candidate set %016llx (%u candidates, seq_len=%u)\n",
+            id, load ? "loaded" : "attached to resident", (unsigned long long)hash, count, seq_len);
+
+    int rc = serve_batched(set->qs, link, submit);
+    detach(false);
+    return rc;
+}
+
+// Accept clients until the listening socket is shut down, then wait for
+// the sessions still running.
+static void qc_daemon_run(QcDaemon &d) {
+    for (int id = 1;; id++) {
+        int fd = accept(d.listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lk(d.mu);
+            d.sessions++;
+        }
+        std::thread([&d, fd, id]() {
+            qc_daemon_session(d, fd, id);
+            close(fd);
+            std::lock_guard<std::mutex> lk(d.mu);
+            d.sessions--;
+            d.cv.notify_all();
+        }).detach();
+    }
+    std::unique_lock<std::mutex> lk(d.mu);
+    d.cv.wait(lk, [&] { return d.sessions == 0; });
+}
+
+static int qc_daemon_listen(const char* path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) { perror("socket"); return -1; }
+    unlink(path);   // a stale socket from an earlier daemon
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// ============================================================
+// Self-test: both protocol versions end to end (through temporary files,
+// and v2 live on the shared-memory rings) against fingerprints compared one
+// candidate at a time
+// ============================================================
+
+// The client end of a v2 session with serve() on a thread, over pipes or rings.
+struct QcPeer {
+    int to_srv[2] = {-1, -1}, from_srv[2] = {-1, -1}, shm_fd = -1;
+    QcLink link;   // client's side: it reads from_srv, writes to_srv
+    std::thread server;
+    int rc = 0;
+};
+
+static bool qc_peer_open(QcPeer &p, bool shm, const std::vector<uint32_t> &packed, uint32_t count, uint32_t seq_len,
+                         WorkPool &pool) {
+    if (pipe(p.to_srv) != 0 || pipe(p.from_srv) != 0) return false;
+    p.link.in_fd = p.from_srv[0]; p.link.out_fd = p.to_srv[1];
+    QcHello h = {QC_MAGIC, QC_VERSION, 0, 0, 0, 0, 0, 0};
+    if (shm) {
+        if (!shm_region_create(SHM_MIN_RING, p.shm_fd, p.link.region)) return false;   // small: wraps and fragments
+        h.features = QC_FEAT_SHM; h.shm_fd = (uint32_t)p.shm_fd; h.shm_ring_bytes = SHM_MIN_RING;
+    }
+    p.server = std::thread([&p, &pool]() { p.rc = serve(p.to_srv[0], p.from_srv[1], true, pool); });
+    uint32_t header[2] = {count, seq_len};
+    QcHello r;
+    bool ok = qc_write_all(p.to_srv[1], &h, sizeof(h)) && qc_write_all(p.to_srv[1], header, sizeof(header)) &&
+              qc_write_all(p.to_srv[1], packed.data(), packed.size() * 4) && qc_read_all(p.from_srv[0], &r, sizeof(r));
+    p.link.shm = ok && (r.features & QC_FEAT_SHM);
+    p.link.region.rx.peer_fd = p.from_srv[0];
+    p.link.region.tx.peer_fd = p.to_srv[1];
+    p.link.region.tx.peer_out = true;
+    return ok && p.link.shm == shm;
+}
+
+static bool qc_peer_send(QcPeer &p, uint32_t id, const QcQuery* q, uint32_t n) {
+    QcRequest rq = {id, n};
+    std::string msg((const char*)&rq, sizeof(rq));
+    msg.append((const char*)q, n * sizeof(QcQuery));
+    return qc_send(p.link, msg);
+}
+
+// One whole response, as on the pipe.
+static bool qc_peer_recv(QcPeer &p, std::string &msg) {
+    if (p.link.shm) return shm_recv(p.link.region.rx, msg) > 0;
+    QcResponse rs;
+    if (!qc_read_all(p.from_srv[0], &rs, sizeof(rs))) return false;
+    msg.assign((const char*)&rs, sizeof(rs));
+    msg.resize(sizeof(rs) + ((size_t)rs.n + rs.total) * 4);
+    return qc_read_all(p.from_srv[0], &msg[sizeof(rs)], msg.size() - sizeof(rs));
+}
+
+static int qc_peer_close(QcPeer &p) {
+    if (p.link.shm) shm_close(p.link.region.tx);
+    close(p.to_srv[1]);
+    if (p.server.joinable()) p.server.join();
+    shm_region_unmap(p.link.region);
+    for (int fd : {p.to_srv[0], p.from_srv[0], p.from_srv[1], p.shm_fd}) if (fd >= 0) close(fd);
+    return p.rc;
+}
+
+// A daemon client sending the requests of a v2 session, with or without
+// QC_FEAT_RESIDENT; what the daemon sends back, but for the resident word,
+// goes to out, as a pipe would carry it.
+static bool qc_daemon_client(const char* path, bool keyed, const std::vector<uint32_t> &packed, uint32_t count,
+                             uint32_t seq_len, const std::string &requests, FILE* out) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { if (fd >= 0) close(fd); return false; }
+    QcHello h = {QC_MAGIC, QC_VERSION, keyed ? QC_FEAT_RESIDENT : 0, 0, 0, 0, 0, 0}, r;
+    uint32_t header[2] = {count, seq_len}, resident = 0;
+    uint64_t hash = qc_content_hash(count, seq_len, packed.data());
+    bool ok = qc_write_all(fd, &h, sizeof(h)) && qc_read_all(fd, &r, sizeof(r)) && r.features == h.features &&
+              qc_write_all(fd, header, sizeof(header));
+    if (ok && keyed) ok = qc_write_all(fd, &hash, sizeof(hash)) && qc_read_all(fd, &resident, sizeof(resident));
+    if (ok && !resident) ok = qc_write_all(fd, packed.data(), packed.size() * 4);
+    fwrite(&r, sizeof(r), 1, out);
+    std::thread sender([&]() {
+        if (ok) ok = qc_write_all(fd, requests.data(), requests.size());
+        shutdown(fd, SHUT_WR);
+    });
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) fwrite(buf, 1, (size_t)n, out);
+    sender.join();
+    close(fd);
+    return ok;
+}
+
+static int self_test(int nthreads) {
+    std::mt19937 rng(7);
+    std::vector<Inst> insts = enumerate_instructions_8();
+    long queries = 0, matched = 0, bad = 0;
+
+    // A daemon serving every set to three clients at once (two of them keyed)
+    signal(SIGPIPE, SIG_IGN);
+    char sock_dir[] = "/tmp/z80qc-test-XXXXXX";
+    if (!mkdtemp(sock_dir)) { perror("mkdtemp"); return 1; }
+    std::string sock_path = std::string(sock_dir) + "/qc.sock";
+    WorkPool daemon_pool(nthreads);
+    QcDaemon daemon(daemon_pool, (size_t)1 << 30);
+    if ((daemon.listen_fd = qc_daemon_listen(sock_path.c_str())) < 0) return 1;
+    std::thread daemon_thread([&]() { qc_daemon_run(daemon); });
+    const int daemon_clients = 3;
+
+    for (uint32_t seq_len = 1; seq_len <= 2; seq_len++) {
+        // Enough length-2 candidates for several slices
+        uint32_t count = seq_len == 1 ? (uint32_t)insts.size() : 3 * QC_SLICE + 1234;
+        std::vector<uint32_t> packed((size_t)count * seq_len);
+        for (uint32_t ci = 0; ci < count; ci++)
+            for (uint32_t i = 0; i < seq_len; i++) {
+                const Inst &x = seq_len == 1 ? insts[ci] : insts[rng() % insts.size()];
+                packed[(size_t)ci * seq_len + i] = (uint32_t)x.op | ((uint32_t)x.imm << 16);
+            }
+        std::vector<uint8_t> fps((size_t)count * FP_LEN);
+        for (uint32_t ci = 0; ci < count; ci++) {
+            uint16_t ops[2], imms[2];
+            for (uint32_t i = 0; i < seq_len; i++) {
+                ops[i] = (uint16_t)packed[(size_t)ci * seq_len + i];
+                imms[i] = (uint16_t)(packed[(size_t)ci * seq_len + i] >> 16);
+            }
+            h_fingerprint(ops, imms, (int)seq_len, &fps[(size_t)ci * FP_LEN]);
+        }
+        // Queries on candidates' own fingerprints, some perturbed so that
+        // nothing matches; reference answers compare one candidate at a time.
+        static const uint32_t dfs[4] = {0x00, 0x28, 0xD7, 0xFF};
+        std::vector<QcQuery> qv;
+        std::vector<std::vector<uint32_t>> want;
+        for (int k = 0; k < 300; k++) {
+            QcQuery q;
+            q.dead_flags = dfs[k & 3];
+            memcpy(q.fp, &fps[(size_t)(rng() % count) * FP_LEN], FP_LEN);
+            if (k % 5 == 4) q.fp[rng() % FP_LEN] ^= 0x10;
+            std::vector<uint32_t> w;
+            for (uint32_t ci = 0; ci < count; ci++) {
+                const uint8_t* c = &fps[(size_t)ci * FP_LEN];
+                bool eq = true;
+                for (int b = 0; b < FP_LEN && eq; b++)
+                    eq = ((c[b] ^ q.fp[b]) & ((b % FP_SIZE) == 1 ? ~q.dead_flags : 0xFF)) == 0;
+                if (eq) w.push_back(ci);
+            }
+            qv.push_back(q);
+            want.push_back(w);
+        }
+        // version 3: v2 on the rings; 4: v2 through the daemon
+        for (int version = 1; version <= 4; version++) {
+            FILE* in = tmpfile();
+            std::vector<FILE*> outs(version == 4 ? daemon_clients : 1);
+            for (FILE* &out : outs) out = tmpfile();
+            FILE* out = outs[0];
+            if (!in || !outs.back()) { fprintf(stderr, "tmpfile failed\n"); return 1; }
+            // v2: requests of 1..64 queries (one empty), ids counting down
+            std::vector<std::pair<uint32_t, uint32_t>> reqs;   // first query, count
+            if (version >= 2) {
+                QcHello h = {QC_MAGIC, QC_VERSION, 0, 0, 0, 0, 0, 0};
+                fwrite(&h, sizeof(h), 1, in);
+                for (uint32_t k = 0; k < qv.size(); ) {
+                    uint32_t n = reqs.size() == 3 ? 0 : std::min<uint32_t>((uint32_t)qv.size() - k, 1 + rng() % 64);
+                    reqs.push_back({k, n});
+                    k += n;
+                }
+            }
+            uint32_t header[2] = {count, seq_len};
+            fwrite(header, sizeof(uint32_t), 2, in);
+            fwrite(packed.data(), sizeof(uint32_t), packed.size(), in);
+            if (version == 1) fwrite(qv.data(), sizeof(QcQuery), qv.size(), in);
+            for (size_t r = 0; r < reqs.size(); r++) {
+                QcRequest rq = {(uint32_t)(1000 - r), reqs[r].second};
+                fwrite(&rq, sizeof(rq), 1, in);
+                fwrite(&qv[reqs[r].first], sizeof(QcQuery), rq.n, in);
+            }
+            fflush(in);
+            rewind(in);
+            {
+                WorkPool pool(nthreads);
+                if (version < 3) {
+                    if (serve(fileno(in), fileno(out), true, pool) != 0) return 1;
+                } else if (version == 4) {
+                    std::string requests;
+                    size_t skip = sizeof(QcHello) + 8 + packed.size() * 4;
+                    char buf[65536];
+                    size_t n;
+                    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) requests.append(buf, n);
+                    requests.erase(0, skip);
+                    std::vector<std::thread> clients;
+                    std::atomic<bool> ok{true};
+                    for (int c = 0; c < daemon_clients; c++)
+                        clients.emplace_back([&, c]() {
+                            if (!qc_daemon_client(sock_path.c_str(), c > 0, packed, count, seq_len, requests, outs[c]))
+                                ok = false;
+                        });
+                    for (auto &t : clients) t.join();
+                    if (!ok) { fprintf(stderr, "Daemon session failed\n"); return 1; }
+                } else {
+                    // the same requests live; responses are copied out as the pipe would carry them
+                    QcPeer p;
+                    bool ok = qc_peer_open(p, true, packed, count, seq_len, pool);
+                    std::thread sender([&]() {
+                        for (size_t r = 0; r < reqs.size() && ok; r++)
+                            ok = qc_peer_send(p, (uint32_t)(1000 - r), &qv[reqs[r].first], reqs[r].second);
+                        if (p.link.shm) shm_close(p.link.region.tx);
+                    });
+                    QcHello h = {QC_MAGIC, QC_VERSION, QC_FEAT_SHM, 0, 0, 0, 0, 0};
+                    fwrite(&h, sizeof(h), 1, out);
+                    std::string msg;
+                    for (size_t r = 0; r < reqs.size() && p.link.shm && qc_peer_recv(p, msg); r++)
+                        fwrite(msg.data(), 1, msg.size(), out);
+                    sender.join();
+                    if (qc_peer_close(p) != 0 || !ok) return 1;
+                }
+            }
+            for (FILE* o : outs) { fflush(o); rewind(o); }
+            auto check = [&](size_t k, uint32_t n, const uint32_t* got) {
+                queries++; matched += n;
+                if (std::vector<uint32_t>(got, got + n) != want[k]) bad++;
+            };
+            if (version == 1) {
+                for (size_t k = 0; k < qv.size(); k++) {
+                    uint32_t n;
+                    if (fread(&n, 4, 1, out) != 1) { bad++; break; }
+                    std::vector<uint32_t> got(n);
+                    if (n && fread(got.data(), 4, n, out) != n) { bad++; break; }
+                    check(k, n, got.data());
+                }
+            } else for (FILE* out : outs) {
+                QcHello h;
+                if (fread(&h, sizeof(h), 1, out) != 1 || h.magic != QC_MAGIC || h.version != QC_VERSION) bad++;
+                std::vector<bool> seen(reqs.size());
+                for (size_t r = 0; r < reqs.size(); r++) {
+                    QcResponse rs;
+                    if (fread(&rs, sizeof(rs), 1, out) != 1) { bad++; break; }
+                    uint32_t ri = 1000 - rs.id;
+                    if (ri >= reqs.size() || seen[ri] || rs.n != reqs[ri].second) { bad++; break; }
+                    seen[ri] = true;
+                    std::vector<uint32_t> counts(rs.n), idx(rs.total);
+                    if ((rs.n && fread(counts.data(), 4, rs.n, out) != rs.n) ||
+                        (rs.total && fread(idx.data(), 4, rs.total, out) != rs.total)) { bad++; break; }
+                    uint32_t off = 0;
+                    for (uint32_t k = 0; k < rs.n; k++) { check(reqs[ri].first + k, counts[k], idx.data() + off); off += counts[k]; }
+                }
+            }
+            fclose(in);
+            for (FILE* o : outs) fclose(o);
+        }
+    }
+    fprintf(stderr, "QuickCheck server: %ld queries (%ld matches) over v1, v2, v2 on shared memory and the daemon, "
+            "%ld mismatches\n", queries, matched, bad);
+    shutdown(daemon.listen_fd, SHUT_RDWR);
+    daemon_thread.join();
+    close(daemon.listen_fd);
+    unlink(sock_path.c_str());
+    rmdir(sock_dir);
+    fprintf(stderr, "Daemon: %d sessions, %llu candidate sets loaded, %llu attached resident\n",
+            2 * daemon_clients, (unsigned long long)daemon.loads, (unsigned long long)daemon.hits);
+    if (daemon.loads != 2 || daemon.hits != 2 * (daemon_clients - 1)) bad++;
+
+    // Transport overhead: one query per request, a few candidates, one request in flight
+    {
+        const uint32_t count = 64, rounds = 2000;
+        std::vector<uint32_t> packed(count);
+        for (uint32_t ci = 0; ci < count; ci++) packed[ci] = (uint32_t)insts[ci].op | ((uint32_t)insts[ci].imm << 16);
+        QcQuery q = {};
+        double us[2] = {0, 0};
+        for (int shm = 0; shm < 2; shm++) {
+            WorkPool pool(nthreads);
+            QcPeer p;
+            std::string msg;
+            bool ok = qc_peer_open(p, shm, packed, count, 1, pool);
+            auto t0 = std::chrono::steady_clock::now();
+            for (uint32_t r = 0; r < rounds + 100 && ok; r++) {
+                if (r == 100) t0 = std::chrono::steady_clock::now();   // after warm-up
+                ok = qc_peer_send(p, r, &q, 1) && qc_peer_recv(p, msg);
+            }
+            us[shm] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / rounds;
+            if (qc_peer_close(p) != 0 || !ok) bad++;
+        }
+        fprintf(stderr, "Round trip, 1 query x %u candidates: %.1f us over pipes, %.1f us over shared memory (%.1fx)\n",
+                count, us[0], us[1], us[0] / us[1]);
+    }
+    fprintf(stderr, "%s\n", bad ? "SELF-TEST FAILED" : "SELF-TEST PASSED");
+    return bad ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    bool server_mode = false, test = false;
+    const char* daemon_path = nullptr;
+    size_t max_resident_mb = 4096;
+    int nthreads = (int)std::thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--server")) server_mode = true;
+        else if (!strcmp(argv[i], "--test")) test = true;
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) nthreads = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--daemon") && i + 1 < argc) daemon_path = argv[++i];
+        else if (!strcmp(argv[i], "--max-resident-mb") && i + 1 < argc) max_resident_mb = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--help")) {
+            fprintf(stderr, "Usage: z80qc_cpu [OPTIONS] < input.bin > output.bin\n"
+                "  --server              Answer queries until EOF (default: one query)\n"
+                "  --threads N           Worker threads (default: all cores)\n"
+                "  --daemon PATH         Serve v2 clients on Unix socket PATH, sharing resident\n"
+                "                        candidate sets and the worker threads between them\n"
+                "  --max-resident-mb N   Drop unused candidate sets beyond N MB (default: 4096)\n"
+                "  --test                Self-test against direct fingerprint comparison\n");
+            return 0;
+        }
+    }
+    if (nthreads < 1) nthreads = 1;
+    init_tables();
+    if (test) return self_test(nthreads);
+    WorkPool pool(nthreads);
+    if (daemon_path) {
+        signal(SIGPIPE, SIG_IGN);   // a client that goes away is one failed session
+        QcDaemon d(pool, max_resident_mb << 20);
+        if ((d.listen_fd = qc_daemon_listen(daemon_path)) < 0) return 1;
+        fprintf(stderr, "Listening on %s (%d threads)\n", daemon_path, pool.size());
+        qc_daemon_run(d);
+        return 0;
+    }
+    return serve(0, 1, server_mode, pool);
+}
@@ -21,13 +21,20 @@
 //
 // Build: nvcc -O3 -o z80_regalloc z80_regalloc.cu
 // Usage: z80_regalloc < func_desc.json
+//        z80_regalloc --test   (--server over pipes and shared memory)
 
+#include <chrono>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <string>
+#include <thread>
 #include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "z80_shm_ring.h"
 
 // ============================================================
 // Constants
@@ -609,7 +616,10 @@ void print_usage() {
     fprintf(stderr, "  --json     Read single JSON function from stdin, write result to stdout\n");
     fprintf(stderr, "  --server   Long-running: read JSON-per-line from stdin, write results per-line\n");
     fprintf(stderr, "             CUDA inits once at startup. Exits on EOF. For Go integration.\n");
+    fprintf(stderr, "             A first line {\"shm\": {\"fd\": N, \"ringBytes\": B}} moves requests\n");
+    fprintf(stderr, "             and results to shared-memory rings (z80_shm_ring.h).\n");
     fprintf(stderr, "  --demo     Run built-in demo (add function)\n");
+    fprintf(stderr, "  --test     Run --server over pipes and shared-memory rings, compare, time the round trip\n");
     fprintf(stderr, "  (default)  Read binary FuncDesc from stdin\n");
     fprintf(stderr, "\n");
     fprintf(stderr, "Loc indices: A=0,B=1,C=2,D=3,E=4,H=5,L=6,BC=7,DE=8,HL=9,IXH=10,IXL=11,IYH=12,IYL=13,mem0=14\n");
@@ -1001,29 +1011,102 @@ static bool solve_backtrack(const FuncDesc &func,
     return true;
 }
 
-// Print JSON result line to stdout
-static void print_json_result(const FuncDesc &func, uint32_t cost, uint64_t bestIdx,
-                               uint64_t totalAssignments, uint64_t feasibleCount) {
+// Format a JSON result line (with its newline)
+static std::string format_json_result(const FuncDesc &func, uint32_t cost, const uint8_t *assignment,
+                                      uint64_t searchSpace, uint64_t feasibleCount, const char *solver) {
+    char buf[128];
+    std::string s;
     if (cost == INVALID_COST) {
-        printf("{\"cost\": -1, \"assignment\": [], \"searchSpace\": %llu, \"feasible\": 0}\n",
-               (unsigned long long)totalAssignments);
+        snprintf(buf, sizeof(buf), "{\"cost\": -1, \"assignment\": [], \"searchSpace\": %llu, \"feasible\": 0",
+                 (unsigned long long)searchSpace);
+        s = buf;
     } else {
-        uint8_t best[MAX_VREGS];
-        decode_assignment_host(bestIdx, func, best);
-        printf("{\"cost\": %u, \"assignment\": [", cost);
+        snprintf(buf, sizeof(buf), "{\"cost\": %u, \"assignment\": [", cost);
+        s = buf;
         for (int i = 0; i < func.nVregs; i++) {
-            if (i > 0) printf(", ");
-            printf("%d", best[i]);
+            snprintf(buf, sizeof(buf), i > 0 ? ", %d" : "%d", assignment[i]);
+            s += buf;
         }
-        printf("], \"searchSpace\": %llu, \"feasible\": %llu}\n",
-               (unsigned long long)totalAssignments,
-               (unsigned long long)feasibleCount);
+        snprintf(buf, sizeof(buf), "], \"searchSpace\": %llu, \"feasible\": %llu",
+                 (unsigned long long)searchSpace, (unsigned long long)feasibleCount);
+        s += buf;
     }
+    if (solver) { s += ", \"solver\": \""; s += solver; s += "\""; }
+    s += "}\n";
+    return s;
+}
+
+// Print JSON result line to stdout
+static void print_json_result(const FuncDesc &func, uint32_t cost, uint64_t bestIdx,
+                               uint64_t totalAssignments, uint64_t feasibleCount) {
+    uint8_t best[MAX_VREGS] = {};
+    if (cost != INVALID_COST) decode_assignment_host(bestIdx, func, best);
+    fputs(format_json_result(func, cost, best, totalAssignments, feasibleCount, nullptr).c_str(), stdout);
     fflush(stdout);
 }
 
-// --server mode: init CUDA once, read JSON-per-line from stdin, write JSON-per-line to stdout
-static int run_server() {
+// --server transport: JSON lines on stdin/stdout, or shared-memory rings
+// (z80_shm_ring.h) if the client opens with a hello line
+//   {"shm": {"fd": N, "ringBytes": B}}
+// naming a region it created and passed to us as fd N. We answer
+// {"shm": true} (then every request and result is one ring message) or
+// {"shm": false} (carry on with lines). On the rings a request is a JSON
+// function, or a binary FuncDesc (told apart by its first byte, which is
+// never '{'), and the answer is the same result line as on stdout.
+struct RegallocLink {
+    FILE* in = stdin;
+    FILE* out = stdout;
+    bool shm = false;
+    ShmRegion region;
+    std::string msg;
+    char buf[65536];
+    bool have_line = false;  // buf holds a line read while looking for a hello
+};
+
+static void regalloc_accept_hello(RegallocLink &link) {
+    if (fgets(link.buf, sizeof(link.buf), link.in) == NULL) return;
+    int fd = -1;
+    unsigned ring = 0;
+    if (sscanf(link.buf, " { \"shm\" : { \"fd\" : %d , \"ringBytes\" : %u", &fd, &ring) != 2) {
+        link.have_line = true;   // an ordinary first request
+        return;
+    }
+    if (fd >= 0 && shm_region_map(fd, ring, true, link.region)) {
+        // the client never writes stdin again, and stops reading stdout when it exits
+        link.shm = true;
+        link.region.rx.peer_fd = fileno(link.in);
+        link.region.tx.peer_fd = fileno(link.out);
+        link.region.tx.peer_out = true;
+    }
+    fprintf(link.out, "{\"shm\": %s}\n", link.shm ? "true" : "false");
+    fflush(link.out);
+}
+
+// Next request into line (JSON) or func (binary, ring only): 1 JSON, 2 binary,
+// 0 at the end, -1 if the ring stream was cut short.
+static int regalloc_recv(RegallocLink &link, std::string &line, FuncDesc &func) {
+    if (link.shm) {
+        int r = shm_recv(link.region.rx, link.msg);
+        if (r <= 0) return r;
+        if (!link.msg.empty() && link.msg[0] == '{') { line = link.msg; return 1; }
+        memset(&func, 0, sizeof(func));
+        memcpy(&func, link.msg.data(), std::min(link.msg.size(), sizeof(func)));
+        return link.msg.size() == sizeof(func) ? 2 : -2;
+    }
+    if (!link.have_line && fgets(link.buf, sizeof(link.buf), link.in) == NULL) return 0;
+    link.have_line = false;
+    line = link.buf;
+    return 1;
+}
+
+static bool regalloc_send(RegallocLink &link, const std::string &result) {
+    if (link.shm) return shm_send(link.region.tx, result.data(), result.size());
+    fputs(result.c_str(), link.out);
+    return fflush(link.out) == 0;
+}
+
+// --server mode: init CUDA once, read JSON-per-line from in (stdin), write JSON-per-line to out (stdout)
+static int run_server(FILE* in, FILE* out) {
     cudaSetDeviceFlags(cudaDeviceScheduleBlockingSync);
 
     // Allocate GPU buffers once
@@ -1043,68 +1126,206 @@ static int run_server() {
     fprintf(stderr, "regalloc-server: ready\n");
     fflush(stderr);
 
-    // Read one JSON object per line
-    char buf[65536];
-    int lineNum = 0;
-    while (fgets(buf, sizeof(buf), stdin) != NULL) {
-        lineNum++;
-        // Skip empty lines
-        size_t len = strlen(buf);
-        while (len > 0 && (buf[len-1] == '\n' || buf[len-1] == '\r')) {
-            buf[--len] = '\0';
-        }
-        if (len == 0) continue;
+    RegallocLink link;
+    link.in = in;
+    link.out = out;
+    regalloc_accept_hello(link);
+    if (link.shm) fprintf(stderr, "regalloc-server: requests on shared memory\n");
 
-        std::string line(buf, len);
+    // One JSON object per line (or per ring message)
+    std::string line;
+    int lineNum = 0, rc = 0;
+    while (true) {
         FuncDesc func;
-        if (!parse_json(line, func)) {
-            fprintf(stderr, "regalloc-server: parse error on line %d\n", lineNum);
-            // Output error result so Go can still read one line per input
-            printf("{\"cost\": -1, \"assignment\": [], \"searchSpace\": 0, \"feasible\": 0, \"error\": \"parse error\"}\n");
-            fflush(stdout);
-            continue;
+        int r = regalloc_recv(link, line, func);
+        if (r == 0) break;
+        if (r == -1) {
+            fprintf(stderr, "regalloc-server: request stream cut short\n");
+            rc = 1;
+            break;
         }
-
-        // Build constrained loc maps from op patterns before GPU launch.
-        // This shrinks search space from MAX_LOCS^N to product(locCount[i]).
-        // Example: locSet2 (7 GPRs), nv=6 → 7^6=117K vs 15^6=11.4M (97× faster).
-        compute_constrained_locs(func);
-
-        uint32_t cost;
-        uint64_t bestIdx, feasible, total;
-        if (!solve_one(func, d_bestCost, d_bestIdx, d_feasibleCount,
-                       cost, bestIdx, feasible, total, true)) {
-            // GPU search space too large — fall back to CPU backtracking
-            uint8_t btAssignment[MAX_VREGS];
-            uint64_t btNodes;
-            solve_backtrack(func, cost, btAssignment, feasible, btNodes);
-
-            if (cost == INVALID_COST) {
-                printf("{\"cost\": -1, \"assignment\": [], \"searchSpace\": %llu, \"feasible\": 0, \"solver\": \"backtrack\"}\n",
-                       (unsigned long long)btNodes);
+        lineNum++;
+        std::string result;
+        if (r == 1) {
+            // Skip empty lines
+            size_t len = line.size();
+            while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) len--;
+            line.resize(len);
+            if (len == 0 && !link.shm) continue;
+            if (!parse_json(line, func)) r = -2;
+        }
+        if (r == -2) {
+            fprintf(stderr, "regalloc-server: parse error on %s %d\n", link.shm ? "request" : "line", lineNum);
+            // Output error result so Go can still read one line per input
+            result = "{\"cost\": -1, \"assignment\": [], \"searchSpace\": 0, \"feasible\": 0, \"error\": \"parse error\"}\n";
+        } else {
+            // Build constrained loc maps from op patterns before GPU launch.
+            // This shrinks search space from MAX_LOCS^N to product(locCount[i]).
+            // Example: locSet2 (7 GPRs), nv=6 → 7^6=117K vs 15^6=11.4M (97× faster).
+            compute_constrained_locs(func);
+
+            uint32_t cost;
+            uint64_t bestIdx, feasible, total;
+            uint8_t assignment[MAX_VREGS] = {};
+            if (solve_one(func, d_bestCost, d_bestIdx, d_feasibleCount,
+                          cost, bestIdx, feasible, total, true)) {
+                if (cost != INVALID_COST) decode_assignment_host(bestIdx, func, assignment);
+                result = format_json_result(func, cost, assignment, total, feasible, nullptr);
             } else {
-                printf("{\"cost\": %u, \"assignment\": [", cost);
-                for (int i = 0; i < func.nVregs; i++) {
-                    if (i > 0) printf(", ");
-                    printf("%d", btAssignment[i]);
-                }
-                printf("], \"searchSpace\": %llu, \"feasible\": %llu, \"solver\": \"backtrack\"}\n",
-                       (unsigned long long)btNodes,
-                       (unsigned long long)feasible);
+                // GPU search space too large — fall back to CPU backtracking
+                uint64_t btNodes;
+                solve_backtrack(func, cost, assignment, feasible, btNodes);
+                result = format_json_result(func, cost, assignment, btNodes, feasible, "backtrack");
             }
-            fflush(stdout);
-            continue;
         }
-
-        print_json_result(func, cost, bestIdx, total, feasible);
+        if (!regalloc_send(link, result)) {
+            fprintf(stderr, "regalloc-server: failed to write result %d\n", lineNum);
+            rc = 1;
+            break;
+        }
     }
 
     fprintf(stderr, "regalloc-server: processed %d functions, exiting\n", lineNum);
+    if (link.shm) {
+        shm_close(link.region.tx);
+        shm_region_unmap(link.region);
+    }
 
     cudaFree(d_bestCost);
     cudaFree(d_bestIdx);
     cudaFree(d_feasibleCount);
-    return 0;
+    return rc;
+}
+
+// ============================================================
+// --test: the --server loop end to end, over the pipes and over the rings
+// ============================================================
+
+// Shapes as cmd/regalloc-enum sends them, the --demo function, and a
+// request that fails to parse (nVregs 0; answered without a GPU launch).
+static const char* const regalloc_test_funcs[] = {
+    "{\"nVregs\":3,\"ops\":[{\"dst\":2,\"src0\":0,\"src1\":1,\"patterns\":[{\"dstLocs\":[0],\"srcLocs0\":[0],\"srcLocs1\":[],\"cost\":4,\"tiedDstSrc\":true}]}],"
+        "\"interference\":[[0,1]],\"paramConstraints\":[{\"vreg\":0,\"loc\":0},{\"vreg\":1,\"loc\":1}]}",
+    "{\"nVregs\":2,\"widths\":[8,8],\"ops\":[{\"dst\":0,\"src0\":-1,\"src1\":-1,\"patterns\":[{\"dstLocs\":[0],\"srcLocs0\":[],\"srcLocs1\":[],\"cost\":4}]},"
+        "{\"dst\":1,\"src0\":-1,\"src1\":-1,\"patterns\":[{\"dstLocs\":[0],\"srcLocs0\":[],\"srcLocs1\":[],\"cost\":4}]}],\"interference\":null,\"paramConstraints\":null}",
+    "{\"nVregs\":2,\"widths\":[8,8],\"ops\":[{\"dst\":0,\"src0\":-1,\"src1\":-1,\"patterns\":[{\"dstLocs\":[2],\"srcLocs0\":[],\"srcLocs1\":[],\"cost\":4}]},"
+        "{\"dst\":1,\"src0\":-1,\"src1\":-1,\"patterns\":[{\"dstLocs\":[0,1,2,3,4,10,11,12,13],\"srcLocs0\":[],\"srcLocs1\":[],\"cost\":4}]},"
+        "{\"dst\":0,\"src0\":1,\"src1\":-1,\"patterns\":[{\"dstLocs\":[2],\"srcLocs0\":[0,1,2,3,4,10,11,12,13],\"srcLocs1\":[],\"cost\":4}]}],"
+        "\"interference\":[[0,1]],\"paramConstraints\":null}",
+    "{\"nVregs\":0}",
+};
+#define REGALLOC_TEST_DEMO  0
+#define REGALLOC_TEST_BAD   3
+#define REGALLOC_TEST_TRIPS 2000
+
+// The client end of a --server session with run_server on a thread.
+struct RegallocPeer {
+    int to_srv[2] = {-1, -1}, from_srv[2] = {-1, -1}, shm_fd = -1;
+    FILE* from = nullptr;
+    ShmRegion region;
+    bool shm = false;
+    std::thread server;
+    int rc = 0;
+};
+
+static bool regalloc_peer_open(RegallocPeer &p, bool shm) {
+    if (pipe(p.to_srv) != 0 || pipe(p.from_srv) != 0) return false;
+    int in_fd = p.to_srv[0], out_fd = p.from_srv[1];
+    p.server = std::thread([&p, in_fd, out_fd]() {
+        FILE* in = fdopen(in_fd, "r");
+        FILE* out = fdopen(out_fd, "w");
+        p.rc = run_server(in, out);
+        fclose(in);
+        fclose(out);
+    });
+    p.from = fdopen(p.from_srv[0], "r");
+    if (!shm) return true;
+    // small rings: messages wrap and fragment
+    if (!shm_region_create(SHM_MIN_RING, p.shm_fd, p.region)) return false;
+    char hello[128], reply[64];
+    int n = snprintf(hello, sizeof(hello), "{\"shm\": {\"fd\": %d, \"ringBytes\": %u}}\n", p.shm_fd, SHM_MIN_RING);
+    if (write(p.to_srv[1], hello, n) != n || !fgets(reply, sizeof(reply), p.from)) return false;
+    p.shm = strcmp(reply, "{\"shm\": true}\n") == 0;
+    p.region.rx.peer_fd = p.from_srv[0];
+    p.region.tx.peer_fd = p.to_srv[1];
+    p.region.tx.peer_out = true;
+    return p.shm;
+}
+
+// One request (a JSON line, or on the rings a message), one result line.
+static bool regalloc_peer_call(RegallocPeer &p, const std::string &req, std::string &result) {
+    if (p.shm) return shm_send(p.region.tx, req.data(), req.size()) && shm_recv(p.region.rx, result) > 0;
+    std::string line = req + "\n";
+    char buf[4096];
+    if (write(p.to_srv[1], line.data(), line.size()) != (ssize_t)line.size() || !fgets(buf, sizeof(buf), p.from)) return false;
+    result = buf;
+    return true;
+}
+
+static int regalloc_peer_close(RegallocPeer &p) {
+    if (p.shm) shm_close(p.region.tx);
+    close(p.to_srv[1]);
+    if (p.server.joinable()) p.server.join();
+    shm_region_unmap(p.region);
+    if (p.from) fclose(p.from);
+    if (p.shm_fd >= 0) close(p.shm_fd);
+    return p.rc;
+}
+
+// Every request answered the same over pipes and rings, a binary FuncDesc
+// like its JSON, bad requests with an error line; then the round trip of a
+// request that never reaches the GPU, which is the transport's overhead.
+static int run_self_test() {
+    const int nf = (int)(sizeof(regalloc_test_funcs) / sizeof(regalloc_test_funcs[0]));
+    std::vector<std::string> want(nf), got(nf);
+    std::string bin_demo, bin_short, bad_short;
+    long bad = 0;
+    double us[2] = {0, 0};
+    for (int shm = 0; shm <= 1; shm++) {
+        RegallocPeer p;
+        if (!regalloc_peer_open(p, shm)) {
+            fprintf(stderr, "Cannot open a %s session\n", shm ? "shared-memory" : "pipe");
+            regalloc_peer_close(p);
+            return 1;
+        }
+        std::vector<std::string> &res = shm ? got : want;
+        for (int i = 0; i < nf; i++)
+            if (!regalloc_peer_call(p, regalloc_test_funcs[i], res[i])) bad++;
+        if (shm) {
+            FuncDesc func;
+            parse_json(regalloc_test_funcs[REGALLOC_TEST_DEMO], func);
+            std::string msg((const char*)&func, sizeof(func));
+            if (!regalloc_peer_call(p, msg, bin_demo)) bad++;
+            msg.resize(sizeof(func) / 2);
+            if (!regalloc_peer_call(p, msg, bin_short)) bad++;
+        }
+        // the server reports each parse error on stderr; keep that out of the timing
+        std::string r;
+        fflush(stderr);
+        int saved_stderr = dup(2), devnull = open("/dev/null", O_WRONLY);
+        if (devnull >= 0) dup2(devnull, 2);
+        auto t0 = std::chrono::steady_clock::now();
+        for (int k = 0; k < REGALLOC_TEST_TRIPS; k++)
+            if (!regalloc_peer_call(p, regalloc_test_funcs[REGALLOC_TEST_BAD], r)) { bad++; break; }
+        us[shm] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / REGALLOC_TEST_TRIPS;
+        dup2(saved_stderr, 2);
+        close(saved_stderr);
+        if (devnull >= 0) close(devnull);
+        if (r != want[REGALLOC_TEST_BAD]) bad++;
+        if (regalloc_peer_close(p) != 0) bad++;
+    }
+    for (int i = 0; i < nf; i++) {
+        bool is_bad = i == REGALLOC_TEST_BAD;
+        if (got[i] != want[i] || (want[i].find("\"error\"") != std::string::npos) != is_bad) {
+            fprintf(stderr, "  request %d: pipe %s           rings %s", i, want[i].c_str(), got[i].c_str());
+            bad++;
+        }
+    }
+    if (bin_demo != want[REGALLOC_TEST_DEMO] || bin_short != want[REGALLOC_TEST_BAD]) bad++;
+    fprintf(stderr, "Round trip, request answered without the GPU: %.1f us over pipes, %.1f us over shared memory (%.1fx)\n",
+            us[0], us[1], us[1] > 0 ? us[0] / us[1] : 0.0);
+    fprintf(stderr, "%s\n", bad ? "SELF-TEST FAILED" : "SELF-TEST PASSED");
+    return bad ? 1 : 0;
 }
 
 int main(int argc, char *argv[]) {
@@ -1130,7 +1351,10 @@ int main(int argc, char *argv[]) {
 
     // --server mode: long-running JSON-per-line protocol
     if (argc > 1 && strcmp(argv[1], "--server") == 0) {
-        return run_server();
+        return run_server(stdin, stdout);
+    }
+    if (argc > 1 && strcmp(argv[1], "--test") == 0) {
+        return run_self_test();
     }
 
     if (argc > 1 && strcmp(argv[1], "--json") == 0) {
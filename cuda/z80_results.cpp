@@ -0,0 +1,187 @@
+// Z80 Binary Result Converter
+//
+// Renders the fixed-record stream written by the search drivers with
+// --binary (format: z80_results.h) as the JSONL they would otherwise have
+// printed, byte for byte, or as a human-readable disassembly listing.
+//
+// Build: g++ -O3 -march=native -pthread -o z80results z80_results.cpp
+// Usage: ./z80results --jsonl results.bin > results.jsonl   ('-' reads stdin)
+//        ./z80results --asm results.bin
+//        ./z80results --info results.bin
+//        ./z80results --test   (record -> JSONL round trip, async writer)
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_results.h"
+
+#define READ_RECORDS 65536   // records per read
+
+enum { MODE_JSONL, MODE_ASM, MODE_INFO };
+
+static bool read_header(FILE* f, const char* path, ResultFileHeader &h) {
+    if (fread(&h, 1, sizeof(h), f) != sizeof(h)) { fprintf(stderr, "%s: too short for a result header\n", path); return false; }
+    if (memcmp(h.magic, RESULT_MAGIC, 8) != 0) { fprintf(stderr, "%s: not a z80 result stream (bad magic)\n", path); return false; }
+    if (h.version != RESULT_VERSION || h.record_size != sizeof(ResultRecord)) {
+        fprintf(stderr, "%s: unsupported version %u (record size %u)\n", path, h.version, h.record_size);
+        return false;
+    }
+    if (h.op_count != OP_COUNT) {
+        fprintf(stderr, "%s: written with %u opcodes, this build has %d\n", path, h.op_count, OP_COUNT);
+        return false;
+    }
+    h.build[sizeof(h.build) - 1] = 0;
+    return true;
+}
+
+static void format_record_asm(char* out, size_t outsz, const ResultRecord &r) {
+    char p[64], src[256] = "", dst[192] = "";
+    int sn = 0, dn = 0;
+    for (int j = 0; j < r.t_len && j < 3; j++) {
+        disasm(r.t_ops[j], r.t_imms[j], p, sizeof(p));
+        sn += snprintf(src + sn, sizeof(src) - sn, j ? " : %s" : "%s", p);
+    }
+    for (int j = 0; j < r.c_len && j < 2; j++) {
+        disasm(r.c_ops[j], r.c_imms[j], p, sizeof(p));
+        dn += snprintf(dst + dn, sizeof(dst) - dn, j ? " : %s" : "%s", p);
+    }
+    int n = snprintf(out, outsz, "%-40s -> %-24s ; -%dB -%dT", src, dst, r.bytes_saved, r.cycles_saved);
+    if (r.dead_flags) n += snprintf(out + n, outsz - n, " (dead flags 0x%02X)", r.dead_flags);
+    snprintf(out + n, outsz - n, "\n");
+}
+
+static int convert(const char* path, int mode) {
+    FILE* f = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!f) { perror(path); return 1; }
+    ResultFileHeader h;
+    if (!read_header(f, path, h)) return 1;
+    if (mode == MODE_INFO)
+        printf("%s: %s, dead_flags=0x%02X, vectors=%016llx%s\n", path, h.build, h.dead_flags,
+               (unsigned long long)h.vectors_hash, h.vectors_hash == h_test_vectors_hash() ? "" : " (not this build's vectors)");
+
+    std::vector<ResultRecord> recs(READ_RECORDS);
+    std::string out;
+    char line[512];
+    uint64_t count = 0, bytes_saved = 0, cycles_saved = 0, by_len[4][3] = {};
+    size_t have = 0, n;   // bytes buffered; a record may straddle two reads
+    while ((n = fread((char*)recs.data() + have, 1, READ_RECORDS * sizeof(ResultRecord) - have, f)) > 0) {
+        have += n;
+        size_t nrec = have / sizeof(ResultRecord);
+        for (size_t k = 0; k < nrec; k++) {
+            const ResultRecord &r = recs[k];
+            count++;
+            if (mode == MODE_INFO) {
+                bytes_saved += r.bytes_saved; cycles_saved += r.cycles_saved;
+                by_len[r.t_len & 3][r.c_len < 3 ? r.c_len : 2]++;
+                continue;
+            }
+            int ln = mode == MODE_JSONL ? format_record_jsonl(line, sizeof(line), r) : (format_record_asm(line, sizeof(line), r), (int)strlen(line));
+            out.append(line, ln);
+        }
+        if (!out.empty()) { fwrite(out.data(), 1, out.size(), stdout); out.clear(); }
+        have -= nrec * sizeof(ResultRecord);
+        memmove(recs.data(), (char*)recs.data() + nrec * sizeof(ResultRecord), have);
+    }
+    if (have) fprintf(stderr, "%s: %zu trailing bytes (truncated record) ignored\n", path, have);
+    if (f != stdin) fclose(f);
+    if (mode == MODE_INFO) {
+        printf("Records:            %lu\n", (unsigned long)count);
+        for (int t = 1; t <= 3; t++)
+            for (int c = 1; c <= 2; c++)
+                if (by_len[t][c]) printf("  %d -> %d:            %lu\n", t, c, (unsigned long)by_len[t][c]);
+        if (count) printf("Saved (mean):       %.2f bytes, %.2f T-states\n", (double)bytes_saved / count, (double)cycles_saved / count);
+    }
+    return 0;
+}
+
+// ============================================================
+// Self-test: records render to exactly the drivers' JSONL, and the
+// async writer delivers every byte in order
+// ============================================================
+static int run_self_test() {
+    std::mt19937 rng(7);
+    std::vector<Inst> insts = enumerate_instructions_8();
+    long lines = 0, bad = 0;
+    for (int k = 0; k < 200000; k++) {
+        BatchTarget bt;
+        memset(&bt, 0, sizeof(bt));
+        bt.len = 1 + (int)(rng() % 3);
+        bt.bytes = 0;
+        for (int j = 0; j < bt.len; j++) {
+            const Inst &x = insts[rng() % insts.size()];
+            bt.ops[j] = x.op; bt.imms[j] = x.imm; bt.bytes += byte_size(x.op);
+        }
+        int c_n = 1 + (int)(rng() % 2);
+        uint16_t co[2], ci[2];
+        for (int j = 0; j < c_n; j++) {
+            uint16_t op = (uint16_t)(rng() % OP_COUNT);
+            co[j] = op;
+            ci[j] = is_imm16(op) ? (uint16_t)rng() : is_imm8(op) ? (uint16_t)(rng() & 0xFF) : 0;
+        }
+        uint8_t df = (k & 1) ? 0 : (uint8_t)rng();
+        char a[512], b[512];
+        format_result_jsonl_seq(a, sizeof(a), bt, co, ci, c_n, df);
+        ResultRecord r = make_result_record(bt, co, ci, c_n, df);
+        format_record_jsonl(b, sizeof(b), r);
+        std::string s;
+        size_t n = append_result(s, false, bt, co, ci, c_n, df);
+        lines++;
+        if (strcmp(a, b) != 0 || s != a || n != strlen(a)) {
+            if (bad++ < 5) fprintf(stderr, "  mismatch:\n    %s    %s", a, b);
+        }
+    }
+    fprintf(stderr, "Records: %ld rendered, %ld differ from the JSONL formatter\n", lines, bad);
+
+    FILE* tf = tmpfile();
+    std::string expect;
+    long wbad = 0;
+    {
+        ResultWriter w(tf, 4096);
+        for (int k = 0; k < 100000; k++) {
+            char chunk[64];
+            int n = snprintf(chunk, sizeof(chunk), "%d:%u\n", k, (unsigned)rng());
+            w.write(chunk, n);
+            expect.append(chunk, n);
+            if (w.pending() > 2 * RESULT_WRITER_BACKLOG * 4096 + sizeof(chunk)) wbad++;
+            if (k % 25000 == 0) {
+                if (!w.flush()) wbad++;
+                if (ftell(tf) != (long)expect.size()) wbad++;
+            }
+        }
+    }
+    std::string got(expect.size() + 1, '\0');
+    rewind(tf);
+    got.resize(fread(&got[0], 1, got.size(), tf));
+    fclose(tf);
+    if (got != expect) wbad++;
+    fprintf(stderr, "Writer: %zu bytes through the async writer, %s\n", expect.size(), wbad ? "MISMATCH" : "identical");
+    return (bad || wbad) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    int mode = -1;
+    const char* path = nullptr;
+    for (int i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"--jsonl")&&i+1<argc) { mode=MODE_JSONL; path=argv[++i]; }
+        else if (!strcmp(argv[i],"--asm")&&i+1<argc) { mode=MODE_ASM; path=argv[++i]; }
+        else if (!strcmp(argv[i],"--info")&&i+1<argc) { mode=MODE_INFO; path=argv[++i]; }
+        else if (!strcmp(argv[i],"--test")) { init_tables(); return run_self_test(); }
+        else {
+            fprintf(stderr,"Usage: z80results --jsonl FILE | --asm FILE | --info FILE | --test\n"
+                "  --jsonl FILE   Render records as the search drivers' JSONL ('-' = stdin)\n"
+                "  --asm FILE     Render records as a disassembly listing\n"
+                "  --info FILE    Header and record statistics\n"
+                "  --test         Round-trip records through the JSONL formatter\n");
+            return strcmp(argv[i],"--help") ? 1 : 0;
+        }
+    }
+    if (mode < 0) { fprintf(stderr,"z80results: nothing to do (see --help)\n"); return 1; }
+    return convert(path, mode);
+}
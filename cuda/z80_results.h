@@ -0,0 +1,186 @@
+// Binary result stream for the standalone search drivers (--binary).
+//
+// A file is one ResultFileHeader followed by fixed 32-byte ResultRecords,
+// one per confirmed rule: packed target and replacement ops/imms, lengths,
+// byte sizes, bytes and T-states saved, and the dead-flag mask. Nothing is
+// disassembled or formatted during the search; z80_results.cpp renders
+// records as the exact JSONL the drivers would have printed, or as a
+// disassembly listing.
+//
+// ResultWriter moves stdout writes (binary or JSONL) to a background
+// thread: producers append to a buffer under a mutex, the thread writes it
+// out in large chunks at least once a second, instead of an fflush per rule.
+// Once RESULT_WRITER_BACKLOG chunks are waiting (stdout on a slow pipe or
+// network FS), write() blocks until the thread has taken them.
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+
+#define RESULT_MAGIC   "Z80RSLT"
+#define RESULT_VERSION 1
+#define RESULT_WRITER_BACKLOG 4   // chunks buffered before write() blocks
+
+struct ResultFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;     // sizeof(ResultRecord)
+    uint64_t vectors_hash;    // QuickCheck vectors of the producing build
+    uint16_t op_count;        // opcode numbering the records use (OP_COUNT)
+    uint8_t  dead_flags;      // run's mask (each record carries its own too)
+    uint8_t  _pad[5];
+    char     build[32];       // producing binary and compile date
+};
+
+struct ResultRecord {
+    uint16_t t_ops[3], t_imms[3];   // target, t_len used
+    uint16_t c_ops[2], c_imms[2];   // replacement, c_len used
+    uint8_t  t_len, c_len;
+    uint8_t  t_bytes, c_bytes;
+    int8_t   bytes_saved;
+    uint8_t  dead_flags;
+    int16_t  cycles_saved;
+    uint8_t  _pad[4];
+};
+
+static_assert(sizeof(ResultFileHeader) == 64 && sizeof(ResultRecord) == 32, "result file layout");
+
+static void result_header_init(ResultFileHeader &h, const char* producer, uint8_t dead_flags) {
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, RESULT_MAGIC, 8);
+    h.version = RESULT_VERSION;
+    h.record_size = sizeof(ResultRecord);
+    h.vectors_hash = h_test_vectors_hash();
+    h.op_count = OP_COUNT;
+    h.dead_flags = dead_flags;
+    snprintf(h.build, sizeof(h.build), "%s %s", producer, __DATE__);
+}
+
+static ResultRecord make_result_record(const BatchTarget &bt, const uint16_t* c_ops, const uint16_t* c_imms,
+                                       int c_n, uint8_t dead_flags) {
+    ResultRecord r;
+    memset(&r, 0, sizeof(r));
+    int cb = 0, cyc = 0;
+    for (int j = 0; j < bt.len; j++) { r.t_ops[j] = bt.ops[j]; r.t_imms[j] = bt.imms[j]; cyc += tstates(bt.ops[j]); }
+    for (int j = 0; j < c_n; j++) {
+        r.c_ops[j] = c_ops[j]; r.c_imms[j] = c_imms[j];
+        cb += byte_size(c_ops[j]); cyc -= tstates(c_ops[j]);
+    }
+    r.t_len = (uint8_t)bt.len; r.c_len = (uint8_t)c_n;
+    r.t_bytes = (uint8_t)bt.bytes; r.c_bytes = (uint8_t)cb;
+    r.bytes_saved = (int8_t)(bt.bytes - cb);
+    r.cycles_saved = (int16_t)cyc;
+    r.dead_flags = dead_flags;
+    return r;
+}
+
+// The JSONL line the drivers print for this rule (format_result_jsonl_seq).
+static int format_record_jsonl(char* out, size_t outsz, const ResultRecord &r) {
+    BatchTarget bt;
+    memset(&bt, 0, sizeof(bt));
+    for (int j = 0; j < r.t_len && j < 3; j++) { bt.ops[j] = r.t_ops[j]; bt.imms[j] = r.t_imms[j]; }
+    bt.len = r.t_len; bt.bytes = r.t_bytes;
+    return format_result_jsonl_seq(out, outsz, bt, r.c_ops, r.c_imms, r.c_len < 2 ? r.c_len : 2, r.dead_flags);
+}
+
+// Append one confirmed rule in the run's output format; returns bytes added.
+static size_t append_result(std::string &out, bool binary, const BatchTarget &bt,
+                            const uint16_t* c_ops, const uint16_t* c_imms, int c_n, uint8_t dead_flags) {
+    if (binary) {
+        ResultRecord r = make_result_record(bt, c_ops, c_imms, c_n, dead_flags);
+        out.append((const char*)&r, sizeof(r));
+        return sizeof(r);
+    }
+    char line[512];
+    int n = format_result_jsonl_seq(line, sizeof(line), bt, c_ops, c_imms, c_n, dead_flags);
+    out.append(line, n);
+    return (size_t)n;
+}
+
+class ResultWriter {
+public:
+    explicit ResultWriter(FILE* f, size_t chunk = 1 << 20) : f_(f), chunk_(chunk), thread_([this] { loop(); }) {}
+
+    ~ResultWriter() {
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+    }
+
+    void write(const void* p, size_t n) {
+        if (!n) return;
+        bool wake;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            if (buf_.size() >= RESULT_WRITER_BACKLOG * chunk_) {
+                cv_.notify_all();
+                done_cv_.wait(lk, [this] { return buf_.size() < RESULT_WRITER_BACKLOG * chunk_; });
+            }
+            buf_.append((const char*)p, n);
+            queued_ += n;
+            wake = buf_.size() >= chunk_;
+        }
+        if (wake) cv_.notify_all();
+    }
+    void write(const std::string &s) { write(s.data(), s.size()); }
+
+    // Block until everything written so far has reached the FILE (flushed),
+    // e.g. before a checkpoint records the output size.
+    bool flush() {
+        std::unique_lock<std::mutex> lk(mu_);
+        uint64_t target = queued_;
+        flush_req_ = true;
+        cv_.notify_all();
+        done_cv_.wait(lk, [&] { return written_ >= target; });
+        return !failed_;
+    }
+
+    bool failed() const { std::lock_guard<std::mutex> lk(mu_); return failed_; }
+    // Bytes queued but not yet written (at most about 2 * RESULT_WRITER_BACKLOG chunks).
+    uint64_t pending() const { std::lock_guard<std::mutex> lk(mu_); return queued_ - written_; }
+
+private:
+    void loop() {
+        std::string out;
+        std::unique_lock<std::mutex> lk(mu_);
+        for (;;) {
+            cv_.wait_for(lk, std::chrono::seconds(1),
+                         [this] { return stop_ || flush_req_ || buf_.size() >= chunk_; });
+            flush_req_ = false;
+            if (!buf_.empty()) {
+                out.swap(buf_);
+                done_cv_.notify_all();   // room for blocked producers
+                lk.unlock();
+                bool ok = fwrite(out.data(), 1, out.size(), f_) == out.size() && fflush(f_) == 0;
+                size_t n = out.size();
+                out.clear();
+                lk.lock();
+                if (!ok) failed_ = true;
+                written_ += n;
+            }
+            done_cv_.notify_all();
+            if (stop_ && buf_.empty()) return;
+        }
+    }
+
+    FILE* f_;
+    size_t chunk_;
+    mutable std::mutex mu_;
+    std::condition_variable cv_, done_cv_;
+    std::string buf_;
+    uint64_t queued_ = 0, written_ = 0;
+    bool stop_ = false, flush_req_ = false, failed_ = false;
+    std::thread thread_;
+};
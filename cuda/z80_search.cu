@@ -1,7 +1,10 @@
 // Z80 Standalone GPU Superoptimizer Search
 //
 // Build: nvcc -O2 -o z80search z80_search.cu
-// Usage: ./z80search --max-target 3 [--dead-flags 0x28] [--gpu-only]
+// Usage: ./z80search --max-target 3 [--dead-flags 0x28] [--gpu-only] [--gpu-qc]
+//
+// QuickCheck probes a host-side fingerprint hash index (z80_fp_index.h);
+// --gpu-qc restores the per-target kernel launch over all candidates.
 //
 // Output: JSONL to stdout (one result per line)
 // Progress: stderr
@@ -15,6 +18,7 @@
 #include <algorithm>
 
 #include "z80_common.h"
+#include "z80_fp_index.h"
 
 // ============================================================
 // CUDA constants (device memory)
@@ -820,18 +824,21 @@ int main(int argc, char** argv) {
     uint8_t dead_flags = 0;
     int gpu_id = 0;
     const char* output_file = NULL;
+    bool gpu_qc = false;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--max-target") == 0 && i+1 < argc) max_target = atoi(argv[++i]);
         else if (strcmp(argv[i], "--dead-flags") == 0 && i+1 < argc) dead_flags = (uint8_t)strtoul(argv[++i], NULL, 0);
         else if (strcmp(argv[i], "--gpu-id") == 0 && i+1 < argc) gpu_id = atoi(argv[++i]);
         else if ((strcmp(argv[i], "--output") == 0 || strcmp(argv[i], "-o") == 0) && i+1 < argc) output_file = argv[++i];
+        else if (strcmp(argv[i], "--gpu-qc") == 0) gpu_qc = true;
         else if (strcmp(argv[i], "--help") == 0) {
-            fprintf(stderr, "Usage: z80search [--max-target N] [--dead-flags 0xNN] [--gpu-id N] [--output FILE]\n");
+            fprintf(stderr, "Usage: z80search [--max-target N] [--dead-flags 0xNN] [--gpu-id N] [--output FILE] [--gpu-qc]\n");
             fprintf(stderr, "  --max-target N    Max target sequence length (default: 2)\n");
             fprintf(stderr, "  --dead-flags 0xNN Flag mask for dead flags\n");
             fprintf(stderr, "  --gpu-id N        CUDA device ID (default: 0)\n");
             fprintf(stderr, "  --output FILE     Write JSONL results to FILE (default: stdout)\n");
+            fprintf(stderr, "  --gpu-qc          Brute-force GPU QuickCheck instead of the fingerprint index\n");
             return 0;
         }
     }
@@ -873,6 +880,18 @@ int main(int argc, char** argv) {
 
     // Upload candidates to GPU
     uint32_t cand_count = (uint32_t)all_insts.size();
+
+    // QuickCheck index: one hash probe per target instead of cand_count executions
+    FpIndex qc_index;
+    {
+        std::vector<uint8_t> cand_bytes(cand_count);
+        for (uint32_t i = 0; i < cand_count; i++) {
+            uint16_t co[1] = {all_insts[i].op}, cm[1] = {all_insts[i].imm};
+            cand_bytes[i] = should_prune(co, cm, 1) ? FP_INDEX_SKIP : (uint8_t)byte_size(co[0]);
+        }
+        fp_index_build(qc_index, cand_packed.data(), cand_bytes.data(), cand_count, dead_flags);
+    }
+
     uint32_t *d_candidates, *d_results;
     uint8_t *d_target_fp;
     cudaMalloc(&d_candidates, cand_count * sizeof(uint32_t));
@@ -1001,6 +1020,9 @@ int main(int argc, char** argv) {
         // For length 2: nested loop over all_insts × all_insts
         // For length 3: triple nested (large!)
         // We'll use a flat array approach
+        // The loops walk targets depth-first; prefix keeps each vector's state
+        // after the shared leading instructions, so a target costs one step.
+        PrefixCache prefix;
 
         if (target_len == 2) {
             for (size_t i0 = 0; i0 < all_insts.size(); i0++) {
@@ -1027,18 +1049,21 @@ int main(int argc, char** argv) {
 
                     // Compute target fingerprint
                     uint8_t fp[FP_LEN];
-                    h_fingerprint(t_ops, t_imms, 2, fp);
-
-                    // GPU QuickCheck
-                    cudaMemcpy(d_target_fp, fp, FP_LEN, cudaMemcpyHostToDevice);
-                    quickcheck_kernel<<<gridSize, blockSize>>>(d_candidates, d_target_fp, d_results, cand_count, 1, dead_flags);
-                    cudaDeviceSynchronize();
-                    cudaMemcpy(h_results, d_results, cand_count * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+                    prefix.set(t_ops, t_imms, 2);
+                    prefix.fingerprint(fp);
 
-                    // Collect matches
+                    // QuickCheck
                     uint32_t match_count = 0;
-                    for (uint32_t k = 0; k < cand_count; k++)
-                        if (h_results[k]) matches[match_count++] = k;
+                    if (gpu_qc) {
+                        cudaMemcpy(d_target_fp, fp, FP_LEN, cudaMemcpyHostToDevice);
+                        quickcheck_kernel<<<gridSize, blockSize>>>(d_candidates, d_target_fp, d_results, cand_count, 1, dead_flags);
+                        cudaDeviceSynchronize();
+                        cudaMemcpy(h_results, d_results, cand_count * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+                        for (uint32_t k = 0; k < cand_count; k++)
+                            if (h_results[k]) matches[match_count++] = k;
+                    } else {
+                        match_count = (uint32_t)fp_index_probe(qc_index, fp, target_bytes, matches, (int)cand_count);
+                    }
 
                     total_gpu_hits += match_count;
 
@@ -1053,7 +1078,7 @@ int main(int argc, char** argv) {
                         if (should_prune(c_ops, c_imms, 1)) continue;
 
                         // MidCheck: 32-vector filter to catch false positives
-                        if (!h_midcheck(t_ops, t_imms, 2, c_ops, c_imms, 1, dead_flags)) {
+                        if (!prefix.midcheck(c_ops, c_imms, 1, dead_flags)) {
                             total_mid_rejected++;
                             continue;
                         }
@@ -1088,17 +1113,21 @@ int main(int argc, char** argv) {
                         int target_bytes = byte_size(t_ops[0]) + byte_size(t_ops[1]) + byte_size(t_ops[2]);
 
                         uint8_t fp[FP_LEN];
-                        h_fingerprint(t_ops, t_imms, 3, fp);
-
-                        // GPU QuickCheck against length-1 candidates
-                        cudaMemcpy(d_target_fp, fp, FP_LEN, cudaMemcpyHostToDevice);
-                        quickcheck_kernel<<<gridSize, blockSize>>>(d_candidates, d_target_fp, d_results, cand_count, 1, dead_flags);
-                        cudaDeviceSynchronize();
-                        cudaMemcpy(h_results, d_results, cand_count * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+                        prefix.set(t_ops, t_imms, 3);
+                        prefix.fingerprint(fp);
 
+                        // QuickCheck against length-1 candidates
                         uint32_t match_count = 0;
-                        for (uint32_t k = 0; k < cand_count; k++)
-                            if (h_results[k]) matches[match_count++] = k;
+                        if (gpu_qc) {
+                            cudaMemcpy(d_target_fp, fp, FP_LEN, cudaMemcpyHostToDevice);
+                            quickcheck_kernel<<<gridSize, blockSize>>>(d_candidates, d_target_fp, d_results, cand_count, 1, dead_flags);
+                            cudaDeviceSynchronize();
+                            cudaMemcpy(h_results, d_results, cand_count * sizeof(uint32_t), cudaMemcpyDeviceToHost);
+                            for (uint32_t k = 0; k < cand_count; k++)
+                                if (h_results[k]) matches[match_count++] = k;
+                        } else {
+                            match_count = (uint32_t)fp_index_probe(qc_index, fp, target_bytes, matches, (int)cand_count);
+                        }
                         total_gpu_hits += match_count;
 
                         for (uint32_t mi = 0; mi < match_count; mi++) {
@@ -1109,7 +1138,7 @@ int main(int argc, char** argv) {
                             if (cand_bytes >= target_bytes) continue;
                             if (should_prune(c_ops, c_imms, 1)) continue;
                             // MidCheck: 32-vector filter
-                            if (!h_midcheck(t_ops, t_imms, 3, c_ops, c_imms, 1, dead_flags)) {
+                            if (!prefix.midcheck(c_ops, c_imms, 1, dead_flags)) {
                                 total_mid_rejected++;
                                 continue;
                             }
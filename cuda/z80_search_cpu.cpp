@@ -0,0 +1,877 @@
+// Z80 Standalone CPU Superoptimizer Search — v2 pipeline on host cores
+//
+// Same 3-stage pipeline as z80_search_v2.cu, for hosts without an NVIDIA GPU:
+//   Stage 1: Batched QuickCheck (one fingerprint-index probe per target)
+//   Stage 2: MidCheck (survivors only, 24 additional test vectors, compared in
+//            an adaptive per-class order, z80_vec_order.h)
+//   Stage 3: ExhaustiveCheck (BDD proof over the whole input domain; bit-sliced
+//            256-lane sweep if a BDD outgrows its node budget); its
+//            counterexamples become extra vectors that later MidCheck
+//            survivors are compared on first (z80_learned.h)
+//
+// Batches run on a work-stealing pool (z80_workpool.h). Finished batches are
+// committed strictly in enumeration order, and the GPU/CPU exhaustive split of
+// v2 is reproduced, so the JSONL is byte-identical to z80search_v2 for the
+// same arguments and shards can be mixed freely between GPU and CPU hosts.
+//
+// Build: g++ -O3 -march=native -pthread -o z80search_cpu z80_search_cpu.cpp
+// Usage: ./z80search_cpu --max-target 2 [--dead-flags 0x28] [--threads N]
+//                        [--first-op-start M] [--first-op-end N]
+//                        [--len2-db len2.db] [--no-bdd] [--scalar-exhaust] [--jit]
+//                        [--no-af-lut] [--af-lut-check] [--binary] [--symmetry]
+//                        [--known-rules len2.jsonl [--keep-subsumed]] [--symbolic-imm]
+//                        [--learned-vectors FILE | --no-learn]
+//                        [--status FILE] [--status-prom FILE] [--status-interval S]
+//        ./z80search_cpu --coordinator SOCKET [--threads N]   (worker for z80coord)
+//        ./z80search_cpu --test   (bit-sliced executor, (A,F) tables, JIT and prefix cache vs h_exec_instruction,
+//                                  symmetry expansion vs direct search, subsumption, trace form,
+//                                  whole-sequence liveness, symbolic immediate templates,
+//                                  MidCheck vector order, learned vectors, telemetry)
+//
+// With --len2-db (built by z80_len2db.cpp), length-3 targets are also joined
+// against the mmap'd length-2 fingerprint database, so 3->2 rewrites are found
+// in the same pass; those lines follow the 3->1 lines of each batch.
+//
+// With --symbolic-imm (z80_symimm.h), immediate operands are enumerated as
+// symbols: rules that hold for every value (or a range, for one symbol) are
+// written once as templates, and only the instances they do not cover are
+// expanded and searched concretely.
+//
+// Output: JSONL to stdout (one result per line), or with --binary the
+//         fixed-record stream of z80_results.h (render with z80results)
+// Progress: stderr, and with --status/--status-prom a periodically rewritten
+//           status file (z80_telemetry.h)
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <deque>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_aflut.h"
+#include "z80_jit.h"
+#include "z80_fp_index.h"
+#include "z80_len2db.h"
+#include "z80_workpool.h"
+#include "z80_coord.h"
+#include "z80_results.h"
+#include "z80_symmetry.h"
+#include "z80_subsume.h"
+#include "z80_symimm.h"
+#include "z80_vec_order.h"
+#include "z80_learned.h"
+#include "z80_telemetry.h"
+
+// ============================================================
+// Pipeline tuning constants (match z80_search_v2.cu)
+// ============================================================
+#define BATCH_SIZE         512      // targets per batch (one pool task)
+#define MAX_MID_PAIRS      (BATCH_SIZE * 256)
+#define MAX_EXHAUST_PAIRS  16384    // v2's GPU exhaustive buffer; overflow goes to the reduced list
+#define INFLIGHT_PER_THREAD 16      // batches queued per worker before the enumerator blocks
+#define MAX_LEN2_HITS      4096     // length-2 QuickCheck matches kept per target
+
+// ============================================================
+// One batch = one pool task
+// ============================================================
+struct BatchJob {
+    std::vector<BatchTarget> targets;
+    std::string out;  // JSONL (or ResultRecords) for this batch, in v2 emission order
+    uint64_t qc_hits=0, mid_hits=0, exhaust_full=0, exhaust_reduced=0, found=0;
+    uint64_t l2_qc_hits=0, l2_mid_hits=0, l2_found=0;
+    uint64_t learned_rejects=0, exhaust_confirmed=0, l2_exhaust=0;   // telemetry only
+    TmTime queued;
+    VecOrder order;   // MidCheck vector order when the batch was queued
+    VecStats vec;
+    LearnedBatch learn;
+    std::promise<void> done;
+};
+
+struct SearchCtx {
+    const CandTable* ct;
+    uint8_t dead_flags;
+    bool no_exhaust;
+    bool binary;        // ResultRecords instead of JSONL
+    const L2Db* l2db;   // null unless --len2-db
+    bool learn;         // capture counterexamples (z80_learned.h)
+    bool (*exhaust)(const uint16_t*, const uint16_t*, int,
+                    const uint16_t*, const uint16_t*, int, uint8_t);
+};
+
+// Length-3 -> length-2: probe the database with each target's fingerprint,
+// then MidCheck and ExhaustiveCheck the (shorter) matches on the host.
+static void run_len2_join(BatchJob &job, const SearchCtx &ctx, PrefixCache &pc) {
+    std::vector<uint64_t> hits(MAX_LEN2_HITS);
+    uint8_t fp[FP_LEN], tmfp[MID_FP_LEN];
+    uint8_t t_out[LEARN_MAX * FP_SIZE], c_out[LEARN_MAX * FP_SIZE];
+    for (const BatchTarget &bt : job.targets) {
+        if (bt.len!=3) continue;
+        pc.set(bt.ops, bt.imms, bt.len);
+        pc.fingerprint(fp);
+        int nh = l2db_probe(*ctx.l2db, fp, ctx.dead_flags, hits.data(), MAX_LEN2_HITS);
+        bool have_tmfp = false, have_tout = false;
+        for (int k=0; k<nh; k++) {
+            const L2DbRecord &r = ctx.l2db->recs[hits[k]];
+            if (byte_size(r.ops[0])+byte_size(r.ops[1]) >= bt.bytes) continue;
+            job.l2_qc_hits++;
+            if (!have_tmfp) {
+                pc.mid_fingerprint(tmfp);
+                mask_fp_flags(tmfp, MID_VECTORS, ctx.dead_flags);
+                have_tmfp = true;
+            }
+            if (!vec_midcheck(job.order, tmfp, r.ops, r.imms, 2, ctx.dead_flags, job.vec)) continue;
+            job.l2_mid_hits++;
+            if (!ctx.no_exhaust) {
+                if (job.learn.active()) {
+                    if (!have_tout) { learned_run(job.learn, bt.ops, bt.imms, bt.len, ctx.dead_flags, t_out); have_tout = true; }
+                    learned_run(job.learn, r.ops, r.imms, 2, ctx.dead_flags, c_out);
+                    if (learned_reject(job.learn, t_out, c_out)) { job.learned_rejects++; continue; }
+                }
+                job.l2_exhaust++;
+                if (!ctx.exhaust(bt.ops, bt.imms, bt.len, r.ops, r.imms, 2, ctx.dead_flags)) {
+                    if (ctx.learn) learned_capture(job.learn, bt.ops, bt.imms, bt.len, r.ops, r.imms, 2, ctx.dead_flags);
+                    continue;
+                }
+                job.exhaust_confirmed++;
+            }
+            append_result(job.out, ctx.binary, bt, r.ops, r.imms, 2, ctx.dead_flags);
+            job.l2_found++;
+        }
+    }
+}
+
+static void run_batch(BatchJob &job, const SearchCtx &ctx) {
+    const CandTable &ct = *ctx.ct;
+    uint32_t bc = (uint32_t)job.targets.size();
+
+    // Targets come in enumeration order; the cache re-executes only the suffix
+    // that differs from the previous target.
+    PrefixCache pc;
+    TmTime t_stage = tm_now();
+
+    // Stage 1: QuickCheck — same (target, candidate) order and cap as v2's bitmap walk
+    struct EInfo { uint32_t bi, ci; };
+    std::vector<EInfo> qc_pairs;
+    uint32_t hits[256];
+    for (uint32_t bi=0; bi<bc && qc_pairs.size()<MAX_MID_PAIRS; bi++) {
+        BatchTarget &bt = job.targets[bi];
+        uint8_t fp[FP_LEN];
+        pc.set(bt.ops, bt.imms, bt.len);
+        pc.fingerprint(fp);
+        int nh = fp_index_probe(ct.qc, fp, bt.bytes, hits, 256);
+        for (int k=0; k<nh && qc_pairs.size()<MAX_MID_PAIRS; k++) qc_pairs.push_back({bi, hits[k]});
+    }
+    job.qc_hits = qc_pairs.size();
+    tm_since(TM_H_QC, t_stage);
+    t_stage = tm_now();
+
+    // Stage 2: MidCheck (target mid fingerprints only for targets with QC hits)
+    std::vector<EInfo> mid_survivors;
+    uint8_t mfp[MID_FP_LEN];
+    uint32_t mfp_bi = UINT32_MAX;
+    for (auto &p : qc_pairs) {
+        if (p.bi != mfp_bi) {
+            BatchTarget &bt = job.targets[p.bi];
+            pc.set(bt.ops, bt.imms, bt.len);
+            pc.mid_fingerprint(mfp);
+            mask_fp_flags(mfp, MID_VECTORS, ctx.dead_flags);
+            mfp_bi = p.bi;
+        }
+        if (vec_compare(job.order, vec_class(ct.insts[p.ci].op), mfp, &ct.mfps[(size_t)p.ci*MID_FP_LEN], job.vec))
+            mid_survivors.push_back(p);
+    }
+    job.mid_hits = mid_survivors.size();
+    tm_since(TM_H_MID, t_stage);
+    t_stage = tm_now();
+
+    auto emit = [&](const EInfo &inf) {
+        size_t nb;
+        job.found += append_result_orbit(job.out, ctx.binary, job.targets[inf.bi],
+                                         ct.insts[inf.ci].op, ct.insts[inf.ci].imm, ctx.dead_flags, &nb);
+    };
+
+    if (ctx.no_exhaust) {
+        for (auto &inf : mid_survivors) emit(inf);
+        if (ctx.l2db) run_len2_join(job, ctx, pc);
+        return;
+    }
+
+    // Stage 3: v2 sends full-sweep pairs to the GPU (up to its buffer size) and
+    // emits them before the reduced-sweep pairs; keep that order.
+    std::vector<EInfo> full, reduced;
+    for (auto &inf : mid_survivors) {
+        const BatchTarget &bt = job.targets[inf.bi];
+        uint16_t co[1]={ct.insts[inf.ci].op};
+        uint16_t reads = regs_read(bt.ops, bt.len) | regs_read(co, 1);
+        int nextra = __builtin_popcount(reads & (RMASK_B|RMASK_C|RMASK_D|RMASK_E|RMASK_H|RMASK_L));
+        bool use_full = nextra<=2 && !(reads & RMASK_SP);
+        if (use_full && full.size()<MAX_EXHAUST_PAIRS) full.push_back(inf);
+        else reduced.push_back(inf);
+    }
+    // Learned vectors drop pairs after the split, so it does not depend on them.
+    uint8_t t_out[LEARN_MAX * FP_SIZE];
+    uint32_t t_bi = UINT32_MAX;
+    for (auto *group : {&full, &reduced}) {
+        for (auto &inf : *group) {
+            const BatchTarget &bt = job.targets[inf.bi];
+            uint16_t co[1]={ct.insts[inf.ci].op}, cm[1]={ct.insts[inf.ci].imm};
+            if (job.learn.active()) {
+                if (inf.bi != t_bi) { learned_run(job.learn, bt.ops, bt.imms, bt.len, ctx.dead_flags, t_out); t_bi = inf.bi; }
+                if (learned_reject(job.learn, t_out, learned_cand(job.learn, inf.ci))) { job.learned_rejects++; continue; }
+            }
+            (group == &full ? job.exhaust_full : job.exhaust_reduced)++;
+            if (ctx.exhaust(bt.ops, bt.imms, bt.len, co, cm, 1, ctx.dead_flags)) { emit(inf); job.exhaust_confirmed++; }
+            else if (ctx.learn) learned_capture(job.learn, bt.ops, bt.imms, bt.len, co, cm, 1, ctx.dead_flags);
+        }
+    }
+    if (ctx.l2db) run_len2_join(job, ctx, pc);
+    tm_since(TM_H_EXHAUST, t_stage);   // with the 3->2 join
+}
+
+// Fold one finished batch into this worker's telemetry shard.
+static void tm_batch(const BatchJob &job) {
+    if (!tm_global.enabled) return;
+    uint64_t qc = job.qc_hits + job.l2_qc_hits, mid = job.mid_hits + job.l2_mid_hits;
+    tm_add(TM_TARGETS, job.targets.size());
+    tm_add(TM_BATCHES);
+    tm_add(TM_QC_HITS, qc);
+    tm_add(TM_MID_PASS, mid);
+    tm_add(TM_MID_REJECT, qc - mid);
+    tm_add(TM_LEARNED_REJECT, job.learned_rejects);
+    tm_add(TM_EXHAUST_DISPATCHED, job.exhaust_full + job.exhaust_reduced + job.l2_exhaust);
+    tm_add(TM_EXHAUST_CONFIRMED, job.exhaust_confirmed);
+    tm_add(TM_FOUND, job.found + job.l2_found);
+}
+
+// ============================================================
+// Self-test: bit-sliced executor against the scalar reference
+// ============================================================
+
+// exec_batch on the first N lanes of in against h_exec_instruction_ref.
+template<int N>
+static void check_state_batch(const Z80State* in, uint16_t op, uint16_t imm, long &checked, long &bad) {
+    Z80StateBatch<N> b;
+    b.load(in);
+    exec_batch(op, imm, b);
+    for (int l=0; l<N; l++) {
+        Z80State ref=in[l], got=b.get(l);
+        h_exec_instruction_ref(ref, op, imm);
+        checked++;
+        if ((memcmp(ref.r, got.r, 8)!=0 || ref.sp!=got.sp) && bad++<10) {
+            char d[64]; disasm(op, imm, d, sizeof(d));
+            fprintf(stderr,"BATCH MISMATCH N=%d op %u (%s): in A=%02X F=%02X -> ref A=%02X F=%02X, got A=%02X F=%02X\n",
+                N, op, d, in[l].r[REG_A], in[l].r[REG_F], ref.r[REG_A], ref.r[REG_F], got.r[REG_A], got.r[REG_F]);
+        }
+    }
+}
+
+// Per-vector fingerprint straight from h_exec_seq, for checking the batched ones.
+static void ref_fingerprint(const Z80State* vecs, int nv, const uint16_t* ops, const uint16_t* imms, int n, uint8_t* out) {
+    for (int v=0; v<nv; v++) {
+        Z80State s=vecs[v];
+        h_exec_seq(s, ops, imms, n);
+        uint8_t* o=out+v*FP_SIZE;
+        memcpy(o, s.r, 8);
+        o[8]=(uint8_t)(s.sp>>8); o[9]=(uint8_t)s.sp;
+    }
+}
+
+static int run_self_test() {
+    std::mt19937 rng(0x5A80);
+    std::vector<Z80State> in(BS_LANES);
+    long checked=0, bad=0;
+    for (uint16_t op=0; op<OP_COUNT; op++) {
+        int nimm = is_imm8(op) ? 256 : is_imm16(op) ? 64 : 1;
+        for (int ii=0; ii<nimm; ii++) {
+            uint16_t imm = is_imm8(op) ? (uint16_t)ii : is_imm16(op) ? (uint16_t)rng() : 0;
+            for (int round=0; round<2; round++) {
+                for (int l=0; l<BS_LANES; l++) {
+                    for (int r=0; r<8; r++) in[l].r[r]=(uint8_t)rng();
+                    in[l].sp=(uint16_t)rng();
+                    if (round==0) in[l].r[REG_A]=(uint8_t)l;  // every A value once
+                }
+                BsState bs;
+                bs_set_lanes(bs, in.data());
+                bs_exec_instruction(bs, op, imm);
+                for (int l=0; l<BS_LANES; l++) {
+                    Z80State ref=in[l];
+                    h_exec_instruction(ref, op, imm);
+                    Z80State got=bs_get_lane(bs, l);
+                    checked++;
+                    if (memcmp(ref.r, got.r, 8)!=0 || ref.sp!=got.sp) {
+                        if (bad++<10) {
+                            char d[64]; disasm(op, imm, d, sizeof(d));
+                            fprintf(stderr,"MISMATCH op %u (%s): in A=%02X F=%02X -> ref A=%02X F=%02X, got A=%02X F=%02X\n",
+                                op, d, in[l].r[REG_A], in[l].r[REG_F], ref.r[REG_A], ref.r[REG_F], got.r[REG_A], got.r[REG_F]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    fprintf(stderr,"Executor: %ld lane-steps checked, %ld mismatches\n", checked, bad);
+
+    // SoA batches at the widths the fingerprints and sweeps use.
+    long bchecked=0, bbad=0;
+    for (uint16_t op=0; op<OP_COUNT; op++) {
+        int nimm = is_imm8(op) ? 256 : is_imm16(op) ? 64 : 1;
+        for (int ii=0; ii<nimm; ii++) {
+            uint16_t imm = is_imm8(op) ? (uint16_t)ii : is_imm16(op) ? (uint16_t)rng() : 0;
+            for (int l=0; l<BS_LANES; l++) {
+                for (int r=0; r<8; r++) in[l].r[r]=(uint8_t)rng();
+                in[l].sp=(uint16_t)rng();
+            }
+            check_state_batch<NUM_VECTORS>(in.data(), op, imm, bchecked, bbad);
+            check_state_batch<MID_VECTORS>(in.data(), op, imm, bchecked, bbad);
+            if (ii<4) check_state_batch<256>(in.data(), op, imm, bchecked, bbad);
+        }
+    }
+    fprintf(stderr,"State batches: %ld lane-steps checked, %ld mismatches\n", bchecked, bbad);
+
+    // (A,F) tables against the branchy path; the checks below then run on tables.
+    long lbad = aflut_init() ? aflut_verify() : 1;
+    fprintf(stderr,"A/F tables: %.1f KB, %ld mismatches\n", aflut_bytes/1024.0, lbad);
+
+    // Flag demand masks: a flag outside h_flags_written passes through, and
+    // toggling an input flag outside h_flags_read changes nothing but itself.
+    long fchecked=0, fbad=0;
+    for (uint16_t op=0; op<OP_COUNT; op++) {
+        uint8_t w=h_flags_written(op), rd=h_flags_read(op);
+        for (int round=0; round<256; round++) {
+            Z80State in;
+            for (int r=0;r<8;r++) in.r[r]=(uint8_t)rng();
+            in.sp=(uint16_t)rng();
+            uint16_t imm=is_imm8(op) ? (uint16_t)(rng()&0xFF) : is_imm16(op) ? (uint16_t)rng() : 0;
+            Z80State out=in;
+            h_exec_instruction_ref(out,op,imm);
+            bool ok=((out.r[REG_F]^in.r[REG_F]) & ~w)==0;
+            for (int b=0; b<8; b++) {
+                uint8_t bit=(uint8_t)(1u<<b);
+                if (rd & bit) continue;
+                Z80State in2=in, out2;
+                in2.r[REG_F]^=bit;
+                out2=in2;
+                h_exec_instruction_ref(out2,op,imm);
+                out2.r[REG_F]^=(w & bit) ? 0 : bit;
+                if (memcmp(out.r,out2.r,8)!=0 || out.sp!=out2.sp) ok=false;
+            }
+            fchecked++;
+            if (!ok && fbad++<10) {
+                char d[64]; disasm(op,imm,d,sizeof(d));
+                fprintf(stderr,"FLAG MASK MISMATCH op %u (%s): written %02X read %02X\n", op, d, w, rd);
+            }
+        }
+    }
+    fprintf(stderr,"Flag demand: %ld states checked, %ld mismatches\n", fchecked, fbad);
+
+    // JIT: every opcode, then random sequences, against h_exec_seq.
+    bool jit = jit_available();
+    long jchecked=0, jbad=0;
+#if Z80_JIT
+    for (int k=0; jit && k<OP_COUNT+2000; k++) {
+        uint16_t ops[4], imms[4]; int n;
+        if (k<OP_COUNT) { n=1; ops[0]=(uint16_t)k; }
+        else { n=1+(int)(rng()%4); for (int j=0;j<n;j++) ops[j]=(uint16_t)(rng()%OP_COUNT); }
+        for (int j=0;j<n;j++) imms[j]=is_imm8(ops[j]) ? (uint16_t)(rng()&0xFF) : is_imm16(ops[j]) ? (uint16_t)rng() : 0;
+        JitFn fn=jit_compile_seq(ops,imms,n);
+        if (!fn) { jbad++; continue; }
+        for (int round=0; round<256; round++) {
+            JitCtx c; memset(&c,0,sizeof(c));
+            Z80State ref;
+            for (int r=0;r<8;r++) ref.r[r]=c.in[r]=(uint8_t)rng();
+            ref.sp=c.sp=(uint16_t)rng();
+            h_exec_seq(ref,ops,imms,n);
+            fn(&c);
+            jchecked++;
+            if (memcmp(ref.r,c.out,8)!=0 || ref.sp!=c.out_sp) {
+                if (jbad++<10) {
+                    char d[64]; disasm(ops[0],imms[0],d,sizeof(d));
+                    fprintf(stderr,"JIT MISMATCH (%d ops, first %s): ref A=%02X F=%02X, got A=%02X F=%02X\n",
+                        n, d, ref.r[REG_A], ref.r[REG_F], c.out[REG_A], c.out[REG_F]);
+                }
+            }
+        }
+    }
+#endif
+    if (jit) fprintf(stderr,"JIT: %ld states checked, %ld mismatches\n", jchecked, jbad);
+    else fprintf(stderr,"JIT: not available on this host, interpreter fallback\n");
+
+    // Prefix cache: a walk that rewrites a random suffix each step, with and
+    // without MidCheck in between, against per-vector scalar fingerprints.
+    long pchecked=0, pbadfp=0;
+    {
+        PrefixCache pc;
+        uint16_t ops[PREFIX_MAX_LEN]={}, imms[PREFIX_MAX_LEN]={};
+        int n=1;
+        for (int k=0; k<20000; k++) {
+            int from=(int)(rng()%n);
+            n=1+(int)(rng()%PREFIX_MAX_LEN);
+            for (int j=from; j<n; j++) {
+                ops[j]=(uint16_t)(rng()%OP_COUNT);
+                imms[j]=is_imm8(ops[j]) ? (uint16_t)(rng()&0xFF) : is_imm16(ops[j]) ? (uint16_t)rng() : 0;
+            }
+            uint8_t a[MID_FP_LEN], b[MID_FP_LEN];
+            pc.set(ops,imms,n);
+            pc.fingerprint(a); ref_fingerprint(h_test_vectors,NUM_VECTORS,ops,imms,n,b);
+            bool ok = memcmp(a,b,FP_LEN)==0;
+            h_fingerprint(ops,imms,n,a);
+            ok = ok && memcmp(a,b,FP_LEN)==0;
+            if (k&1) {
+                pc.mid_fingerprint(a); ref_fingerprint(h_mid_vectors,MID_VECTORS,ops,imms,n,b);
+                ok = ok && memcmp(a,b,MID_FP_LEN)==0;
+                h_mid_fingerprint(ops,imms,n,a);
+                ok = ok && memcmp(a,b,MID_FP_LEN)==0;
+                ok = ok && pc.midcheck(ops,imms,n,0) && pc.midcheck(ops,imms,n-1,0)==h_midcheck(ops,imms,n,ops,imms,n-1,0);
+            }
+            pchecked++;
+            if (!ok) pbadfp++;
+        }
+    }
+    fprintf(stderr,"Prefix cache: %ld targets checked, %ld mismatches\n", pchecked, pbadfp);
+
+    // ExhaustiveCheck verdicts: random pairs (mostly inequivalent) and
+    // QuickCheck-matched pairs (mostly equivalent), cheap domains only.
+    std::vector<Inst> insts = enumerate_instructions_8();
+    CandTable ct;
+    build_cand_table(ct, insts, 0);
+    long pairs=0, eq=0, vbad=0;
+    uint32_t hits[256];
+    for (long tries=0; pairs<4000 && tries<2000000; tries++) {
+        const Inst &t0=insts[rng()%insts.size()], &t1=insts[rng()%insts.size()];
+        uint16_t to[2]={t0.op,t1.op}, ti[2]={t0.imm,t1.imm};
+        if (should_prune(to,ti,2)) continue;
+        uint16_t co[1], ci[1];
+        if (pairs&1) {
+            const Inst &c0=insts[rng()%insts.size()];
+            co[0]=c0.op; ci[0]=c0.imm;
+        } else {
+            uint8_t fp[FP_LEN];
+            h_fingerprint(to,ti,2,fp);
+            if (fp_index_probe(ct.qc,fp,256,hits,256)==0) continue;
+            co[0]=insts[hits[0]].op; ci[0]=insts[hits[0]].imm;
+        }
+        uint16_t reads=regs_read(to,2)|regs_read(co,1);
+        if (__builtin_popcount(reads&(RMASK_B|RMASK_C|RMASK_D|RMASK_E|RMASK_H|RMASK_L))>1 || (reads&RMASK_SP)) continue;
+        static const uint8_t dfs[4] = {0x00, 0x28, 0xD7, 0xFF};
+        uint8_t df = dfs[(pairs>>1)&3];
+        bool a=cpu_exhaustive_check(to,ti,2,co,ci,1,df), b=bs_exhaustive_check(to,ti,2,co,ci,1,df);
+        bool c=bdd_exhaustive_check(to,ti,2,co,ci,1,df), d=jit_exhaustive_check(to,ti,2,co,ci,1,df);
+        pairs++; eq+=a;
+        if (a!=b || a!=c || a!=d) vbad++;
+    }
+    fprintf(stderr,"ExhaustiveCheck: %ld pairs (%ld equivalent), %ld verdict mismatches\n", pairs, eq, vbad);
+
+    // BDD proofs on 3+ register / SP domains: every refutation must come with
+    // a real counterexample, and nothing the proof accepts may fail sampling.
+    std::vector<Inst> pool = insts;
+    for (uint16_t op=OP_LD_RR_NN_START; op<OP_ADC_HL_START; op++)
+        for (uint16_t v : {0x0000, 0x0001, 0x00FF, 0x8000, 0xFFFF}) pool.push_back({op, v});
+    long proofs=0, proved=0, pbad=0;
+    for (long tries=0; proofs<500 && tries<20000000; tries++) {
+        uint16_t to[3], ti[3];
+        for (int j=0; j<3; j++) { const Inst &x=pool[rng()%pool.size()]; to[j]=x.op; ti[j]=x.imm; }
+        if (should_prune(to,ti,3)) continue;
+        uint8_t fp[FP_LEN];
+        h_fingerprint(to,ti,3,fp);
+        if (fp_index_probe(ct.qc,fp,256,hits,256)==0) continue;
+        uint16_t co[1]={insts[hits[0]].op}, ci[1]={insts[hits[0]].imm};
+        int extra[6]; bool sweep_sp;
+        int nextra = sweep_domain(to,3,co,1,extra,&sweep_sp);
+        if (nextra<=2 && !sweep_sp) continue;
+        Z80State cex;
+        uint8_t df = (proofs&1) ? 0x28 : 0;
+        int v = bdd_prove_equivalent(to,ti,3,co,ci,1,df,extra,nextra,sweep_sp,&cex);
+        proofs++;
+        if (v==1) {
+            proved++;
+            if (nextra<=3 && !(sweep_sp && nextra>1) && !bs_exhaustive_check(to,ti,3,co,ci,1,df)) pbad++;
+        } else if (v==0) {
+            Z80State x=cex, y=cex;
+            h_exec_seq(x,to,ti,3); h_exec_seq(y,co,ci,1);
+            if (h_states_equal(x,y,df)) pbad++;
+        }
+    }
+    fprintf(stderr,"BDD proofs (3+ regs/SP): %ld pairs (%ld equivalent), %ld failures\n", proofs, proved, pbad);
+
+    long sbad = sym_verify(insts, rng);
+    long kbad = known_verify(insts, rng);
+    long tbad = trace_verify(insts, rng);
+    long dbad = liveness_verify(insts, rng);
+    long ybad = symimm_verify(rng);
+    long obad = vec_verify(insts, rng);
+    long ebad = learned_verify(insts, ct, rng);
+    long mbad = tm_verify();
+    return (bad||bbad||lbad||fbad||jbad||pbadfp||vbad||pbad||sbad||kbad||tbad||dbad||ybad||obad||ebad||mbad) ? 1 : 0;
+}
+
+// ============================================================
+// Main — enumerate on this thread, verify on the pool, commit in order
+// ============================================================
+int main(int argc, char** argv) {
+    int max_target=2; uint8_t dead_flags=0;
+    int first_op_start=0, first_op_end=-1;
+    int nthreads=(int)std::thread::hardware_concurrency();
+    bool no_exhaust=false;
+    const char* len2_db_path=NULL;
+    const char* coord_path=NULL;
+    const char* known_path=NULL;
+    bool keep_subsumed=false;
+    bool scalar_exhaust=false, no_bdd=false, use_jit=false;
+    bool no_af_lut=false, binary=false, symmetry=false, symbolic=false;
+    const char* learned_path=NULL;
+    bool no_learn=false;
+    const char* status_path=NULL;
+    const char* status_prom_path=NULL;
+    int status_interval=5;
+
+    for (int i=1;i<argc;i++) {
+        if (!strcmp(argv[i],"--max-target")&&i+1<argc) max_target=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--dead-flags")&&i+1<argc) dead_flags=(uint8_t)strtoul(argv[++i],NULL,0);
+        else if (!strcmp(argv[i],"--threads")&&i+1<argc) nthreads=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--first-op-start")&&i+1<argc) first_op_start=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--first-op-end")&&i+1<argc) first_op_end=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--no-exhaust")) no_exhaust=true;
+        else if (!strcmp(argv[i],"--len2-db")&&i+1<argc) len2_db_path=argv[++i];
+        else if (!strcmp(argv[i],"--scalar-exhaust")) scalar_exhaust=true;
+        else if (!strcmp(argv[i],"--no-bdd")) no_bdd=true;
+        else if (!strcmp(argv[i],"--jit")) use_jit=true;
+        else if (!strcmp(argv[i],"--no-af-lut")) no_af_lut=true;
+        else if (!strcmp(argv[i],"--af-lut-check")) h_af_lut_check=true;
+        else if (!strcmp(argv[i],"--coordinator")&&i+1<argc) coord_path=argv[++i];
+        else if (!strcmp(argv[i],"--binary")) binary=true;
+        else if (!strcmp(argv[i],"--symmetry")) symmetry=true;
+        else if (!strcmp(argv[i],"--known-rules")&&i+1<argc) known_path=argv[++i];
+        else if (!strcmp(argv[i],"--keep-subsumed")) keep_subsumed=true;
+        else if (!strcmp(argv[i],"--symbolic-imm")) symbolic=true;
+        else if (!strcmp(argv[i],"--learned-vectors")&&i+1<argc) learned_path=argv[++i];
+        else if (!strcmp(argv[i],"--no-learn")) no_learn=true;
+        else if (!strcmp(argv[i],"--status")&&i+1<argc) status_path=argv[++i];
+        else if (!strcmp(argv[i],"--status-prom")&&i+1<argc) status_prom_path=argv[++i];
+        else if (!strcmp(argv[i],"--status-interval")&&i+1<argc) status_interval=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--test")) { init_tables(); sym_init(); symimm_init(); return run_self_test(); }
+        else if (!strcmp(argv[i],"--help")) {
+            fprintf(stderr,"Usage: z80search_cpu [OPTIONS]\n"
+                "  --max-target N        Max target sequence length (default: 2)\n"
+                "  --dead-flags 0xNN     Flag mask for dead flags\n"
+                "  --threads N           Worker threads (default: all cores)\n"
+                "  --first-op-start M    Start outer loop at instruction index M\n"
+                "  --first-op-end N      End outer loop at instruction index N\n"
+                "  --no-exhaust          Skip ExhaustiveCheck, output MidCheck survivors\n"
+                "  --len2-db FILE        Also search 3->2 rewrites against a z80len2db file\n"
+                "  --no-bdd              Bit-sliced sweep instead of BDD proofs (3+ regs/SP sampled)\n"
+                "  --scalar-exhaust      ExhaustiveCheck one state at a time (reference)\n"
+                "  --jit                 ExhaustiveCheck on x86-64 code compiled per pair (sampled 3+ regs/SP)\n"
+                "  --no-af-lut           Branchy flag arithmetic instead of (A,F) tables\n"
+                "  --af-lut-check        Cross-check every (A,F) table lookup against the branchy path\n"
+                "  --coordinator PATH    Search units from a z80coord socket (it sets dead flags and ranges)\n"
+                "  --binary              Write fixed-size binary records (z80results converts to JSONL)\n"
+                "  --symmetry            Search one target per register renaming, expand its rules to the rest\n"
+                "  --known-rules FILE    Skip length-3 targets with a window shortened by these length-2 rules\n"
+                "  --keep-subsumed       With --known-rules, count those targets but still search them\n"
+                "  --symbolic-imm        Immediates as symbols: templates, concrete search only where none holds\n"
+                "  --learned-vectors F   Preload counterexample vectors from F, save the learned set there at exit\n"
+                "  --no-learn            Do not learn MidCheck vectors from ExhaustiveCheck counterexamples\n"
+                "  --status FILE         Rewrite FILE with live counters, rates, latencies and ETA as JSON\n"
+                "  --status-prom FILE    The same in Prometheus text format\n"
+                "  --status-interval S   Seconds between status rewrites (default: 5)\n"
+                "  --test                Check the bit-sliced executor, (A,F) tables, JIT and prefix cache against the scalar one\n");
+            return 0;
+        }
+    }
+    if (nthreads<1) nthreads=1;
+
+    init_tables();
+    if (!no_af_lut) aflut_init();
+    if (use_jit && !jit_available()) fprintf(stderr,"Warning: --jit needs x86-64, using the interpreter\n");
+
+    if (symbolic && (coord_path || symmetry || len2_db_path || binary)) {
+        fprintf(stderr,"--symbolic-imm does not combine with --coordinator, --symmetry, --len2-db or --binary\n");
+        return 1;
+    }
+    std::vector<Inst> all_insts = symbolic ? enumerate_instructions_sym() : enumerate_instructions_8();
+    fprintf(stderr,"Instruction set: %zu instructions (8-bit%s)\n", all_insts.size(), symbolic ? ", symbolic immediates" : "");
+    if (first_op_end<0) first_op_end=(int)all_insts.size();
+
+    CoordWorker cw;
+    if (coord_path) {
+        uint32_t features = (len2_db_path ? COORD_FEAT_LEN2_JOIN : 0) |
+                            (known_path && !keep_subsumed ? COORD_FEAT_SUBSUME : 0);
+        if (!coord_connect(cw, coord_path, "cpu", features, (uint32_t)all_insts.size(), (uint32_t)nthreads+1)) return 1;
+        dead_flags=cw.cfg.dead_flags; no_exhaust=cw.cfg.no_exhaust; binary=cw.cfg.binary;
+        symmetry=cw.cfg.symmetry;
+    }
+    if (symmetry && len2_db_path) {
+        fprintf(stderr,"--symmetry does not cover --len2-db (pair replacements break the renaming)\n");
+        return 1;
+    }
+    if (symmetry) sym_init();
+    KnownRules known;
+    if (known_path && !known_load(known, known_path, dead_flags, symmetry)) return 1;
+    if (known_path && max_target<3 && !coord_path) fprintf(stderr,"Warning: --known-rules only applies to length-3 targets (--max-target 3)\n");
+    TargetFilter filter;
+    filter.symmetry=symmetry;
+    filter.dead_flags=dead_flags;
+    filter.known=known_path ? &known : NULL;
+    filter.keep_subsumed=keep_subsumed;
+
+    CandTable ct;
+    build_cand_table(ct, symbolic ? enumerate_instructions_8() : all_insts, dead_flags);
+    SymImmTable symtab;
+    SymImmStats symst;
+    if (symbolic) { symimm_init(); symimm_build_table(symtab, dead_flags, no_exhaust); }
+    L2Db l2db;
+    if (len2_db_path) {
+        if (!l2db_open(l2db, len2_db_path, true)) return 1;
+        fprintf(stderr,"Length-2 DB: %s (%lu sequences)\n", len2_db_path, (unsigned long)l2db.hdr->count);
+        if (max_target<3) fprintf(stderr,"Warning: --len2-db only applies to length-3 targets (--max-target 3)\n");
+    }
+    bool learn = !no_exhaust && !no_learn;
+    SearchCtx ctx = {&ct, dead_flags, no_exhaust, binary, len2_db_path ? &l2db : NULL, learn,
+                     scalar_exhaust ? cpu_exhaustive_check : use_jit ? jit_exhaustive_check :
+                     no_bdd ? bs_exhaustive_check : bdd_exhaustive_check};
+
+    tm_start(status_path, status_prom_path, status_interval, "z80search_cpu", BATCH_SIZE);
+    WorkPool pool(nthreads);
+    ResultWriter writer(stdout);
+    if (binary && !coord_path) {
+        ResultFileHeader rh;
+        result_header_init(rh, "z80search_cpu", dead_flags);
+        writer.write(&rh, sizeof(rh));
+    }
+    size_t max_inflight = (size_t)nthreads*INFLIGHT_PER_THREAD;
+    tm_gauge(TM_G_MAX_INFLIGHT, (int64_t)max_inflight);
+
+    uint64_t total_found=0, total_targets=0, total_qc_hits=0, total_mid_hits=0;
+    uint64_t total_exhaust_full=0, total_exhaust_reduced=0, total_batches=0;
+    uint64_t total_l2_qc_hits=0, total_l2_mid_hits=0, total_l2_found=0;
+    VecOrder vec_order;
+    VecStats vec_stats;
+    LearnedSet learned;
+    if (learned_path && learned_load(learned, learned_path))
+        fprintf(stderr,"Learned vectors: %s (%lu loaded)\n", learned_path, (unsigned long)learned.loaded);
+    std::shared_ptr<const LearnedTable> learned_tab;
+    if (learn) learned_tab = learned_table(learned, ct.insts, dead_flags);
+    uint64_t committed=0;
+    time_t start_time = time(NULL);
+
+    if (coord_path)
+        fprintf(stderr,"Starting CPU worker: coordinator=%s, dead_flags=0x%02X, threads=%d\n",
+                coord_path, dead_flags, nthreads);
+    else
+        fprintf(stderr,"Starting CPU search: max_target=%d, dead_flags=0x%02X, threads=%d, ops=[%d,%d)%s\n",
+                max_target, dead_flags, nthreads, first_op_start, first_op_end, symmetry ? ", symmetry" : symbolic ? ", symbolic immediates" : "");
+
+    std::deque<std::pair<std::shared_ptr<BatchJob>, std::future<void>>> inflight;
+    std::vector<BatchTarget> batch;
+    batch.reserve(BATCH_SIZE);
+    std::string batch_templates;   // --symbolic-imm lines, written ahead of the batch's results
+
+    // Coordinator units in flight, oldest first. Batches never span units, so
+    // committed batches belong to the front unit; it is reported once it is
+    // fully enumerated and all of its batches are committed.
+    struct UnitState { CoordResult r; std::string out; uint64_t batches_left; bool enumerated; };
+    std::deque<UnitState> units;
+    bool coord_ok=true;
+    auto finish_units = [&]() {
+        while (!units.empty() && units.front().enumerated && units.front().batches_left==0) {
+            coord_ok = coord_ok && coord_send_result(cw, units.front().r, units.front().out);
+            units.pop_front();
+        }
+    };
+
+    // Commit the oldest in-flight batch: wait, write its JSONL, fold counters.
+    auto commit_one = [&]() {
+        auto &front = inflight.front();
+        front.second.wait();
+        BatchJob &job = *front.first;
+        if (coord_path) {
+            UnitState &u = units.front();
+            u.out += job.out;
+            u.r.qc_hits += job.qc_hits; u.r.mid_hits += job.mid_hits;
+            u.r.exhaust += job.exhaust_full + job.exhaust_reduced;
+            u.r.found += job.found + job.l2_found;
+            u.batches_left--;
+        } else writer.write(job.out);
+        tm_since(TM_H_COMMIT, job.queued);
+        total_qc_hits += job.qc_hits; total_mid_hits += job.mid_hits;
+        total_exhaust_full += job.exhaust_full; total_exhaust_reduced += job.exhaust_reduced;
+        total_found += job.found + job.l2_found;
+        total_l2_qc_hits += job.l2_qc_hits; total_l2_mid_hits += job.l2_mid_hits; total_l2_found += job.l2_found;
+        vec_stats.merge(job.vec);
+        if (learned_commit(learned, job.learn, committed)) learned_tab = learned_table(learned, ct.insts, dead_flags);
+        if (++committed % VEC_REORDER_BATCHES == 0) vec_reorder(vec_order, vec_stats);
+        inflight.pop_front();
+        tm_gauge(TM_G_INFLIGHT, (int64_t)inflight.size());
+        tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending());
+        if (coord_path) finish_units();
+    };
+
+    auto flush_batch = [&]() {
+        if (batch.empty() && batch_templates.empty()) return;
+        total_batches++;
+        if (coord_path) { units.back().batches_left++; units.back().r.batches++; }
+        auto job = std::make_shared<BatchJob>();
+        job->targets.swap(batch);
+        job->out.swap(batch_templates);
+        job->order = vec_order;
+        learned_begin(job->learn, learned_tab);
+        batch.reserve(BATCH_SIZE);
+        std::future<void> fut = job->done.get_future();
+        job->queued = tm_now();
+        pool.submit([job, &ctx]() {
+            tm_since(TM_H_QUEUE, job->queued);
+            TmTime t0 = tm_now();
+            run_batch(*job, ctx);
+            tm_since(TM_H_BATCH, t0);
+            tm_batch(*job);
+            job->done.set_value();
+        });
+        inflight.emplace_back(job, std::move(fut));
+        tm_gauge(TM_G_INFLIGHT, (int64_t)inflight.size());
+        while (inflight.size()>=max_inflight) commit_one();
+    };
+
+    auto drain = [&]() { flush_batch(); while (!inflight.empty()) commit_one(); };
+
+    // Coordinator worker: units are enumerated back to back so the pool stays
+    // fed across unit boundaries; finished work is reported before blocking.
+    if (coord_path) {
+        CoordUnit u;
+        while (coord_ok) {
+            if (!coord_unit_ready(cw)) drain();
+            if (!coord_ok || !coord_next_unit(cw, u)) break;
+            units.push_back({});
+            units.back().r.seq = u.seq;
+            coord_enumerate_unit(all_insts, u, filter, [&](const BatchTarget &bt) {
+                units.back().r.targets++; total_targets++;
+                batch.push_back(bt);
+                if ((int)batch.size()>=BATCH_SIZE) flush_batch();
+            });
+            flush_batch();
+            units.back().enumerated = true;
+            finish_units();
+        }
+        drain();
+        coord_close(cw);
+        if (!coord_ok) { writer.flush(); tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending()); tm_stop(); fprintf(stderr,"coordinator: lost connection, exiting\n"); return 1; }
+    }
+
+    // Enumerate targets (same order and pruning as z80_search_v2.cu)
+    for (int target_len=2; target_len<=max_target && !coord_path; target_len++) {
+        fprintf(stderr,"=== Target length %d ===\n", target_len);
+        uint64_t targets_this=0, found_before=total_found;
+        time_t len_start=time(NULL), last_report=len_start;
+        tm_length(target_len, first_op_end-first_op_start, 0);
+        auto push = [&](const BatchTarget &bt) {
+            targets_this++; total_targets++;
+            batch.push_back(bt);
+            if ((int)batch.size()>=BATCH_SIZE) flush_batch();
+        };
+        // --symbolic-imm: templates for a symbolic target, its uncovered instances as targets
+        auto enqueue = [&](const BatchTarget &bt) {
+            if (symbolic && symimm_search(symtab, bt, symst, batch_templates, [&](const BatchTarget &inst) {
+                    BatchTarget b;
+                    if (filter_target(filter,b,inst.ops,inst.imms,inst.len)) push(b);
+                }))
+                return;
+            push(bt);
+        };
+
+        if (target_len==2) {
+            for (int i0=first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+                tm_gauge(TM_G_DONE, i0-first_op_start);
+                time_t now=time(NULL);
+                if (now-last_report>=10) {
+                    last_report=now;
+                    double pct=100.0*(i0-first_op_start)/(first_op_end-first_op_start);
+                    double el=difftime(now,start_time), eta=(pct>0.1)?el*(100.0/pct-1.0):0;
+                    fprintf(stderr,"  [%.1f%%] op %d/%d | targets:%lu | QC:%lu Mid:%lu Ex:%lu | found:%lu | %lds, ETA %lds\n",
+                        pct,i0,first_op_end,(unsigned long)total_targets,
+                        (unsigned long)total_qc_hits,(unsigned long)total_mid_hits,
+                        (unsigned long)(total_exhaust_full+total_exhaust_reduced),(unsigned long)total_found,
+                        (long)el,(long)eta);
+                }
+                for (size_t i1=0; i1<all_insts.size(); i1++) {
+                    uint16_t to[2]={all_insts[i0].op,all_insts[i1].op};
+                    uint16_t ti[2]={all_insts[i0].imm,all_insts[i1].imm};
+                    BatchTarget bt;
+                    if (!filter_target(filter,bt,to,ti,2)) continue;
+                    enqueue(bt);
+                }
+            }
+        } else if (target_len==3) {
+            for (int i0=first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+                tm_gauge(TM_G_DONE, i0-first_op_start);
+                time_t now=time(NULL);
+                if (now-last_report>=10) {
+                    last_report=now;
+                    double pct=100.0*(i0-first_op_start)/(first_op_end-first_op_start);
+                    double el=difftime(now,start_time), eta=(pct>0.1)?el*(100.0/pct-1.0):0;
+                    fprintf(stderr,"  [%.1f%%] op %d/%d | targets:%lu | found:%lu | %lds, ETA %lds\n",
+                        pct,i0,first_op_end,(unsigned long)total_targets,
+                        (unsigned long)total_found,(long)el,(long)eta);
+                }
+                for (size_t i1=0; i1<all_insts.size(); i1++) {
+                    uint16_t po[2]={all_insts[i0].op,all_insts[i1].op};
+                    uint16_t pi[2]={all_insts[i0].imm,all_insts[i1].imm};
+                    if (!filter_prefix(filter,po,pi,2,all_insts.size())) continue;
+                    for (size_t i2=0; i2<all_insts.size(); i2++) {
+                        uint16_t to[3]={all_insts[i0].op,all_insts[i1].op,all_insts[i2].op};
+                        uint16_t ti[3]={all_insts[i0].imm,all_insts[i1].imm,all_insts[i2].imm};
+                        BatchTarget bt;
+                        if (!filter_target(filter,bt,to,ti,3)) continue;
+                        enqueue(bt);
+                    }
+                }
+            }
+        }
+        drain();
+        tm_gauge(TM_G_DONE, first_op_end-first_op_start);
+        time_t len_end=time(NULL);
+        fprintf(stderr,"  Length %d done: %lu targets, %lu found (%lds)\n",
+            target_len,(unsigned long)targets_this,(unsigned long)(total_found-found_before),(long)(len_end-len_start));
+    }
+
+    // the last status shows the writer drained
+    bool flushed = writer.flush();
+    tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending());
+    tm_stop();
+    if (!flushed) { fprintf(stderr,"Error: cannot write results to stdout\n"); return 1; }
+    time_t end_time=time(NULL);
+    fprintf(stderr,"\n=== DONE (CPU pipeline, %d threads) ===\n", nthreads);
+    fprintf(stderr,"Targets tested:     %lu\n",(unsigned long)total_targets);
+    filter_report(filter);
+    if (known_path)
+        fprintf(stderr,"Subsumed targets:   %lu%s\n",(unsigned long)filter.subsumed,keep_subsumed ? " (kept)" : "");
+    fprintf(stderr,"Batches processed:  %lu\n",(unsigned long)total_batches);
+    fprintf(stderr,"QuickCheck hits:    %lu\n",(unsigned long)total_qc_hits);
+    fprintf(stderr,"MidCheck survivors: %lu\n",(unsigned long)total_mid_hits);
+    vec_report(vec_order, vec_stats);
+    if (learn) learned_report(learned);
+    fprintf(stderr,"ExhaustiveCheck:    %lu (full:%lu reduced:%lu)\n",(unsigned long)(total_exhaust_full+total_exhaust_reduced),
+            (unsigned long)total_exhaust_full,(unsigned long)total_exhaust_reduced);
+    if (len2_db_path)
+        fprintf(stderr,"Length-2 DB:        QC:%lu Mid:%lu found:%lu\n",
+                (unsigned long)total_l2_qc_hits,(unsigned long)total_l2_mid_hits,(unsigned long)total_l2_found);
+    fprintf(stderr,"Results found:      %lu\n",(unsigned long)total_found);
+    if (symbolic) symimm_report(symst);
+    fprintf(stderr,"Total time:         %lds\n",(long)(end_time-start_time));
+    if (total_qc_hits>0 && !symmetry) fprintf(stderr,"False positive rate: %.1f%% (QC->confirmed)\n",100.0*(1.0-(double)(total_found-total_l2_found)/total_qc_hits));
+    if (len2_db_path) l2db_close(l2db);
+    if (learn && learned_path && !learned_save(learned, learned_path)) {
+        fprintf(stderr,"Error: cannot write learned vectors to %s\n", learned_path);
+        return 1;
+    }
+    return 0;
+}
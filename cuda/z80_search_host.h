@@ -0,0 +1,614 @@
+// Host-side search helpers shared by the standalone search drivers.
+// Included by z80_search_v2.cu and z80_search_cpu.cpp so both backends
+// enumerate, prune, verify and format results identically.
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_bitslice.h"
+#include "z80_bdd.h"
+#include "z80_fp_index.h"
+
+// ============================================================
+// Host-side tables (verbatim from v1)
+// ============================================================
+static bool is_imm8(uint16_t op) {
+    if (op >= 49 && op <= 55) return true;
+    if (op >= 56 && op < 120 && ((op - 56) % 8) == 7) return true;
+    return false;
+}
+static bool is_imm16(uint16_t op) { return op >= 382 && op <= 385; }
+
+static int byte_size(uint16_t op) {
+    if (op >= 144 && op <= 367) return 2;
+    if (op == 142) return 2;
+    if (op >= 386 && op <= 393) return 2;
+    if (op >= 382 && op <= 385) return 3;
+    if (is_imm8(op)) return 2;
+    return 1;
+}
+
+static int tstates(uint16_t op) {
+    if (op < 49) return 4;
+    if (op < 56) return 7;
+    if (op < 120) { if ((op - 56) % 8 == 7) return 7; return 4; }
+    if (op < 134) return 4;
+    if (op <= 141) return 4;
+    if (op == 142) return 8;
+    if (op == 143) return 4;
+    if (op < 200) return 8;
+    if (op < 368) return 8;
+    if (op < 376) return 6;
+    if (op < 380) return 11;
+    if (op == 380) return 4;
+    if (op == 381) return 6;
+    if (op < 386) return 10;
+    return 15;
+}
+
+static const char* reg_names[8] = {"A", "F", "B", "C", "D", "E", "H", "L"};
+static const char* pair_names[4] = {"BC", "DE", "HL", "SP"};
+static const char* alu_names[8] = {"ADD A,", "ADC A,", "SUB", "SBC A,", "AND", "XOR", "OR", "CP"};
+static const char* cb_names[7] = {"RLC", "RRC", "RL", "RR", "SLA", "SRA", "SRL"};
+
+// Names of the symbolic immediates IMM_SYM + i (z80_symimm.h), by width.
+static const char* imm_sym_names[2][IMM_SYMS] = {{"n", "m", "k"}, {"nn", "mm", "kk"}};
+
+static void disasm(uint16_t op, uint16_t imm, char* buf, int bufsz) {
+    if (imm >= IMM_SYM && (is_imm8(op) || is_imm16(op))) {
+        disasm(op, 0, buf, bufsz);
+        char* p = strrchr(buf, ' ');   // the immediate is the last operand
+        snprintf(p + 1, bufsz - (int)(p + 1 - buf), "%s", imm_sym_names[is_imm16(op)][(imm - IMM_SYM) % IMM_SYMS]);
+        return;
+    }
+    if (op < 49) { snprintf(buf, bufsz, "LD %s, %s", reg_names[LD_DST_H[op/7]], reg_names[LD_FULL_SRC_H[op]]); return; }
+    if (op < 56) { snprintf(buf, bufsz, "LD %s, 0x%02X", reg_names[IMM_REG_H[op-49]], imm & 0xFF); return; }
+    if (op < 120) { int a=(op-56)/8, s=(op-56)%8; if(s<7) snprintf(buf,bufsz,"%s %s",alu_names[a],reg_names[ALU_SRC_H[s]]); else snprintf(buf,bufsz,"%s 0x%02X",alu_names[a],imm&0xFF); return; }
+    if (op < 127) { snprintf(buf, bufsz, "INC %s", reg_names[INCDEC_REG_H[op-120]]); return; }
+    if (op < 134) { snprintf(buf, bufsz, "DEC %s", reg_names[INCDEC_REG_H[op-127]]); return; }
+    if (op==134) { snprintf(buf,bufsz,"RLCA"); return; } if (op==135) { snprintf(buf,bufsz,"RRCA"); return; }
+    if (op==136) { snprintf(buf,bufsz,"RLA"); return; }  if (op==137) { snprintf(buf,bufsz,"RRA"); return; }
+    if (op==138) { snprintf(buf,bufsz,"DAA"); return; }  if (op==139) { snprintf(buf,bufsz,"CPL"); return; }
+    if (op==140) { snprintf(buf,bufsz,"SCF"); return; }  if (op==141) { snprintf(buf,bufsz,"CCF"); return; }
+    if (op==142) { snprintf(buf,bufsz,"NEG"); return; }  if (op==143) { snprintf(buf,bufsz,"NOP"); return; }
+    if (op>=144&&op<=192) { int c=(op-144)/7,r=CB_REG_H[(op-144)%7]; snprintf(buf,bufsz,"%s %s",cb_names[c],reg_names[r]); return; }
+    if (op==193) { snprintf(buf,bufsz,"SLL A"); return; }
+    if (op>=194&&op<200) { snprintf(buf,bufsz,"SLL %s",reg_names[CB_REG_H[(op-194)+1]]); return; }
+    if (op>=200&&op<256) { int i=op-200; snprintf(buf,bufsz,"BIT %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
+    if (op>=256&&op<312) { int i=op-256; snprintf(buf,bufsz,"RES %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
+    if (op>=312&&op<368) { int i=op-312; snprintf(buf,bufsz,"SET %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
+    if (op>=368&&op<372) { snprintf(buf,bufsz,"INC %s",pair_names[op-368]); return; }
+    if (op>=372&&op<376) { snprintf(buf,bufsz,"DEC %s",pair_names[op-372]); return; }
+    if (op>=376&&op<380) { snprintf(buf,bufsz,"ADD HL, %s",pair_names[op-376]); return; }
+    if (op==380) { snprintf(buf,bufsz,"EX DE, HL"); return; }
+    if (op==381) { snprintf(buf,bufsz,"LD SP, HL"); return; }
+    if (op>=382&&op<386) { snprintf(buf,bufsz,"LD %s, 0x%04X",pair_names[op-382],imm); return; }
+    if (op>=386&&op<390) { snprintf(buf,bufsz,"ADC HL, %s",pair_names[op-386]); return; }
+    if (op>=390&&op<394) { snprintf(buf,bufsz,"SBC HL, %s",pair_names[op-390]); return; }
+    snprintf(buf,bufsz,"OP(%d)",op);
+}
+
+// ============================================================
+// Register dependency (verbatim from v1)
+// ============================================================
+#define RMASK_A 0x001u
+#define RMASK_F 0x002u
+#define RMASK_B 0x004u
+#define RMASK_C 0x008u
+#define RMASK_D 0x010u
+#define RMASK_E 0x020u
+#define RMASK_H 0x040u
+#define RMASK_L 0x080u
+#define RMASK_SP 0x100u
+
+static uint16_t op_reads(uint16_t op) {
+    if (op<49) { return 1u<<LD_FULL_SRC_H[op]; }
+    if (op<56) return 0;
+    if (op<120) { int ao=(op-56)/8,si=(op-56)%8; uint16_t m=0; if(si<7)m|=(1u<<ALU_SRC_H[si]); if(ao==1||ao==3)m|=RMASK_F; m|=RMASK_A; return m; }
+    if (op<127) return 1u<<INCDEC_REG_H[op-120];
+    if (op<134) return 1u<<INCDEC_REG_H[op-127];
+    if (op==OP_RLCA||op==OP_RRCA) return RMASK_A;
+    if (op==OP_RLA||op==OP_RRA) return RMASK_A|RMASK_F;
+    if (op==OP_DAA) return RMASK_A|RMASK_F;
+    if (op==OP_CPL||op==OP_NEG) return RMASK_A;
+    if (op==OP_SCF||op==OP_CCF) return RMASK_F;
+    if (op==OP_NOP) return 0;
+    if (op>=144&&op<=192) { int co=(op-144)/7; uint8_t rg=CB_REG_H[(op-144)%7]; uint16_t m=1u<<rg; if(co==2||co==3)m|=RMASK_F; return m; }
+    if (op==OP_SLL_A) return RMASK_A;
+    if (op>=194&&op<200) return 1u<<CB_REG_H[(op-194)+1];
+    if (op>=200&&op<368) { int idx=(op>=312)?op-312:(op>=256)?op-256:op-200; return 1u<<CB_REG_H[idx%7]; }
+    if (op>=368&&op<376) { int p=(op-368)%4; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
+    if (op>=376&&op<380) { int p=op-376; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return RMASK_H|RMASK_L|pm[p]; }
+    if (op==380) return RMASK_D|RMASK_E|RMASK_H|RMASK_L;
+    if (op==381) return RMASK_H|RMASK_L;
+    if (op>=382&&op<386) return 0;
+    if (op>=386&&op<394) { int p=(op>=390)?op-390:op-386; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return RMASK_H|RMASK_L|RMASK_F|pm[p]; }
+    return 0;
+}
+
+static uint16_t op_writes(uint16_t op) {
+    if (op<49) return 1u<<LD_DST_H[op/7];
+    if (op<56) return 1u<<IMM_REG_H[op-49];
+    if (op<120) { int ao=(op-56)/8; if(ao==7)return RMASK_F; return RMASK_A|RMASK_F; }
+    if (op<134) return (1u<<INCDEC_REG_H[op<127?op-120:op-127])|RMASK_F;
+    if (op>=134&&op<=137) return RMASK_A|RMASK_F;
+    if (op==OP_DAA||op==OP_CPL||op==OP_NEG) return RMASK_A|RMASK_F;
+    if (op==OP_SCF||op==OP_CCF) return RMASK_F;
+    if (op==OP_NOP) return 0;
+    if (op>=144&&op<=199) { uint8_t rg; if(op<=192)rg=CB_REG_H[(op-144)%7]; else if(op==193)rg=REG_A; else rg=CB_REG_H[(op-194)+1]; return(1u<<rg)|RMASK_F; }
+    if (op>=200&&op<256) return RMASK_F;
+    if (op>=256&&op<368) { int idx=(op>=312)?op-312:op-256; return 1u<<CB_REG_H[idx%7]; }
+    if (op>=368&&op<376) { int p=(op-368)%4; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
+    if (op>=376&&op<380) return RMASK_H|RMASK_L|RMASK_F;
+    if (op==380) return RMASK_D|RMASK_E|RMASK_H|RMASK_L;
+    if (op==381) return RMASK_SP;
+    if (op>=382&&op<386) { int p=op-382; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
+    if (op>=386&&op<394) return RMASK_H|RMASK_L|RMASK_F;
+    return 0;
+}
+
+// Pruning
+static bool is_self_load(uint16_t op) { return op==6||op==8||op==16||op==24||op==32||op==40||op==48; }
+static uint32_t inst_key(uint16_t op, uint16_t imm) { return ((uint32_t)op<<16)|imm; }
+static bool are_independent(uint16_t op1, uint16_t op2) {
+    uint16_t aR=op_reads(op1),aW=op_writes(op1),bR=op_reads(op2),bW=op_writes(op2);
+    return (aW&bR)==0&&(aR&bW)==0&&(aW&bW)==0;
+}
+// Why the enumerator skipped a target (first reason found), for the drivers'
+// pruning breakdown.
+enum PruneReason { PRUNE_NONE, PRUNE_NOP, PRUNE_SELF_LOAD, PRUNE_DEAD_WRITE, PRUNE_ORDER,
+                   PRUNE_DEAD_INST, PRUNE_SYMMETRY, PRUNE_REASONS };
+static const char* const prune_reason_names[PRUNE_REASONS] = {
+    "", "NOP", "self-load", "dead write", "order", "dead instruction", "symmetry" };
+
+// NOP, self-loads and dead writes; unlike the trace normal form below these do
+// not depend on opcode numbering, so register renaming preserves them.
+static int prune_reason_local(const uint16_t* ops, const uint16_t* imms, int n) {
+    (void)imms;
+    for (int i=0;i<n;i++) {
+        if (ops[i]==OP_NOP) return PRUNE_NOP;
+        if (is_self_load(ops[i])) return PRUNE_SELF_LOAD;
+        if (i+1<n) { uint16_t w1=op_writes(ops[i]); if(w1){uint16_t r2=op_reads(ops[i+1]),w2=op_writes(ops[i+1]),dead=w1&w2&~RMASK_F&~r2; if(dead)return PRUNE_DEAD_WRITE;} }
+    }
+    return PRUNE_NONE;
+}
+static bool should_prune_local(const uint16_t* ops, const uint16_t* imms, int n) {
+    return prune_reason_local(ops,imms,n)!=PRUNE_NONE;
+}
+// Trace normal form: sequences that differ only by commuting independent
+// instructions are one computation, and only the lexicographically least
+// (by inst_key) is searched. A sequence is that least form iff no
+// instruction is smaller than an earlier one it commutes with together with
+// everything in between (Anisimov-Knuth), so a canonical prefix stays
+// canonical with (op,imm) appended iff this holds; depth-first enumeration
+// checks each new position once.
+static bool trace_extends_canonical(const uint16_t* ops, const uint16_t* imms, int n, uint16_t op, uint16_t imm) {
+    uint32_t k=inst_key(op,imm);
+    for (int j=n-1;j>=0&&are_independent(ops[j],op);j--) if (k<inst_key(ops[j],imms[j])) return false;
+    return true;
+}
+static bool trace_canonical(const uint16_t* ops, const uint16_t* imms, int n) {
+    for (int i=1;i<n;i++) if (!trace_extends_canonical(ops,imms,i,ops[i],imms[i])) return false;
+    return true;
+}
+static int prune_reason(const uint16_t* ops, const uint16_t* imms, int n) {
+    int r=prune_reason_local(ops,imms,n);
+    return r!=PRUNE_NONE ? r : trace_canonical(ops,imms,n) ? PRUNE_NONE : PRUNE_ORDER;
+}
+static bool should_prune(const uint16_t* ops, const uint16_t* imms, int n) {
+    return prune_reason(ops,imms,n)!=PRUNE_NONE;
+}
+
+// Backward liveness over the whole sequence: index of the first instruction
+// none of whose results is observed (every register it writes is written
+// again before any read, every flag likewise or in dead_flags at the end),
+// or -1. Such a sequence equals a shorter one, so neither a target nor a
+// replacement needs it. Renaming registers preserves the answer.
+static int dead_instruction(const uint16_t* ops, int n, uint8_t dead_flags) {
+    uint16_t live=(uint16_t)~RMASK_F;
+    uint8_t live_flags=(uint8_t)~dead_flags;
+    int dead=-1;
+    for (int i=n-1;i>=0;i--) {
+        uint16_t w=op_writes(ops[i])&~RMASK_F;
+        uint8_t fw=h_flags_written(ops[i]);
+        if (!(w&live) && !(fw&live_flags)) dead=i;
+        live=(uint16_t)((live&~w)|(op_reads(ops[i])&~RMASK_F));
+        live_flags=(uint8_t)((live_flags&~fw)|h_flags_read(ops[i]));
+    }
+    return dead;
+}
+
+// Register reads helper
+static uint16_t regs_read(const uint16_t* ops, int n) { uint16_t m=0; for(int i=0;i<n;i++)m|=op_reads(ops[i]); return m; }
+
+// Host-side helpers for CPU ExhaustiveCheck fallback
+static void h_set_reg_by_offset(Z80State &s, int offset, uint8_t val) {
+    switch (offset) {
+        case 2: s.r[REG_B]=val; break; case 3: s.r[REG_C]=val; break;
+        case 4: s.r[REG_D]=val; break; case 5: s.r[REG_E]=val; break;
+        case 6: s.r[REG_H]=val; break; case 7: s.r[REG_L]=val; break;
+    }
+}
+
+static const uint8_t h_rep_values[32] = {
+    0x00,0x01,0x02,0x0F,0x10,0x1F,0x20,0x3F,
+    0x40,0x55,0x7E,0x7F,0x80,0x81,0xAA,0xBF,
+    0xC0,0xD5,0xE0,0xEF,0xF0,0xF7,0xFE,0xFF,
+    0x03,0x07,0x11,0x33,0x77,0xBB,0xDD,0xEE,
+};
+static const uint16_t h_rep_sp[16] = {
+    0x0000,0x0001,0x00FF,0x0100,0x7FFE,0x7FFF,0x8000,0x8001,
+    0xFFFE,0xFFFF,0x1234,0x5678,0xABCD,0xDEAD,0xBEEF,0xCAFE,
+};
+
+// CPU ExhaustiveCheck — used for reduced-sweep pairs (nextra>2 or sweep_sp)
+// where CPU is faster than GPU due to early-exit and less launch overhead.
+static bool cpu_exhaustive_check(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags
+) {
+    uint16_t reads = regs_read(t_ops,t_n)|regs_read(c_ops,c_n);
+    int extra[6]; int nextra=0;
+    if (reads&RMASK_B) extra[nextra++]=2;
+    if (reads&RMASK_C) extra[nextra++]=3;
+    if (reads&RMASK_D) extra[nextra++]=4;
+    if (reads&RMASK_E) extra[nextra++]=5;
+    if (reads&RMASK_H) extra[nextra++]=6;
+    if (reads&RMASK_L) extra[nextra++]=7;
+    bool sweep_sp = (reads&RMASK_SP)!=0;
+
+    for (int a=0;a<256;a++) {
+        for (int carry=0;carry<=1;carry++) {
+            if (nextra==0 && !sweep_sp) {
+                Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
+                Z80State st=s, sc=s;
+                h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
+                if (!h_states_equal(st,sc,dead_flags)) return false;
+                continue;
+            }
+            if (nextra==1 && !sweep_sp) {
+                for (int r=0;r<256;r++) {
+                    Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
+                    h_set_reg_by_offset(s,extra[0],(uint8_t)r);
+                    Z80State st=s, sc=s;
+                    h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
+                    if (!h_states_equal(st,sc,dead_flags)) return false;
+                }
+                continue;
+            }
+            if (nextra==2 && !sweep_sp) {
+                for (int r1=0;r1<256;r1++) {
+                    for (int r2=0;r2<256;r2++) {
+                        Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
+                        h_set_reg_by_offset(s,extra[0],(uint8_t)r1);
+                        h_set_reg_by_offset(s,extra[1],(uint8_t)r2);
+                        Z80State st=s, sc=s;
+                        h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
+                        if (!h_states_equal(st,sc,dead_flags)) return false;
+                    }
+                }
+                continue;
+            }
+            // Reduced sweep (3+ regs or SP): use rep_values
+            auto do_sweep = [&](auto& self, Z80State s, int ri) -> bool {
+                if (ri>=nextra) {
+                    if (sweep_sp) {
+                        for (int si=0;si<16;si++) {
+                            Z80State s2=s; s2.sp=h_rep_sp[si];
+                            Z80State st=s2, sc=s2;
+                            h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
+                            if (!h_states_equal(st,sc,dead_flags)) return false;
+                        }
+                        return true;
+                    }
+                    Z80State st=s, sc=s;
+                    h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
+                    return h_states_equal(st,sc,dead_flags);
+                }
+                for (int vi=0;vi<32;vi++) {
+                    Z80State s2=s;
+                    h_set_reg_by_offset(s2,extra[ri],h_rep_values[vi]);
+                    if (!self(self,s2,ri+1)) return false;
+                }
+                return true;
+            };
+            Z80State base={}; base.r[REG_A]=(uint8_t)a; base.r[REG_F]=(uint8_t)carry;
+            if (!do_sweep(do_sweep,base,0)) return false;
+        }
+    }
+    return true;
+}
+
+// ExhaustiveCheck input domain: the extra registers read (REG_B..REG_L) and
+// whether SP is read.
+static int sweep_domain(const uint16_t* t_ops, int t_n, const uint16_t* c_ops, int c_n,
+                        int extra[6], bool* sweep_sp) {
+    uint16_t reads = regs_read(t_ops,t_n)|regs_read(c_ops,c_n);
+    int nextra=0;
+    if (reads&RMASK_B) extra[nextra++]=REG_B;
+    if (reads&RMASK_C) extra[nextra++]=REG_C;
+    if (reads&RMASK_D) extra[nextra++]=REG_D;
+    if (reads&RMASK_E) extra[nextra++]=REG_E;
+    if (reads&RMASK_H) extra[nextra++]=REG_H;
+    if (reads&RMASK_L) extra[nextra++]=REG_L;
+    *sweep_sp = (reads&RMASK_SP)!=0;
+    return nextra;
+}
+
+// Same domain and verdict as cpu_exhaustive_check, on the bit-sliced
+// executor (256 A values per pass).
+static bool bs_exhaustive_check(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags
+) {
+    int extra[6]; bool sweep_sp;
+    int nextra = sweep_domain(t_ops,t_n,c_ops,c_n,extra,&sweep_sp);
+    return bs_exhaustive_sweep(t_ops,t_imms,t_n,c_ops,c_imms,c_n,dead_flags,
+                               extra,nextra,sweep_sp,h_rep_values,h_rep_sp);
+}
+
+// ExhaustiveCheck as a proof: a BDD over every input bit of the domain, so
+// 3+ registers and SP are covered completely instead of by rep_values. Falls
+// back to the bit-sliced sweep if the BDD exceeds its node budget.
+static bool bdd_exhaustive_check(
+    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
+    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+    uint8_t dead_flags
+) {
+    int extra[6]; bool sweep_sp;
+    int nextra = sweep_domain(t_ops,t_n,c_ops,c_n,extra,&sweep_sp);
+    int v = bdd_prove_equivalent(t_ops,t_imms,t_n,c_ops,c_imms,c_n,dead_flags,extra,nextra,sweep_sp);
+    if (v>=0) return v==1;
+    return bs_exhaustive_sweep(t_ops,t_imms,t_n,c_ops,c_imms,c_n,dead_flags,
+                               extra,nextra,sweep_sp,h_rep_values,h_rep_sp);
+}
+
+// Instruction enumeration
+struct Inst { uint16_t op, imm; };
+static std::vector<Inst> enumerate_instructions_8() {
+    std::vector<Inst> result;
+    for (uint16_t op=0; op<OP_COUNT; op++) {
+        if (is_imm16(op)) continue;
+        if (is_imm8(op)) { for(int imm=0;imm<256;imm++) result.push_back({op,(uint16_t)imm}); }
+        else result.push_back({op,0});
+    }
+    return result;
+}
+
+// Every opcode once, immediate operands symbolic (IMM_SYM; --symbolic-imm).
+static std::vector<Inst> enumerate_instructions_sym() {
+    std::vector<Inst> result;
+    for (uint16_t op=0; op<OP_COUNT; op++)
+        result.push_back({op, (uint16_t)(is_imm8(op) || is_imm16(op) ? IMM_SYM : 0)});
+    return result;
+}
+
+// A candidate with no observable effect under dead_flags equals the empty
+// sequence, and so does every target it matches. Such candidates stay out of
+// the QuickCheck index, except one stand-in for all of them: the cheapest
+// (bytes, then T-states, then first) that names none of B..L, so --symmetry
+// renamings leave it alone. A target equal to the empty sequence thus gets
+// exactly one rule, to the stand-in, instead of one per dead candidate or
+// none. -1 if no candidate is dead.
+static int dead_stand_in(const std::vector<Inst> &insts, uint8_t dead_flags) {
+    const uint16_t bl=RMASK_B|RMASK_C|RMASK_D|RMASK_E|RMASK_H|RMASK_L;
+    int best=-1;
+    for (size_t i=0; i<insts.size(); i++) {
+        uint16_t co[1]={insts[i].op}, cm[1]={insts[i].imm};
+        if (cm[0]>=IMM_SYM || should_prune(co,cm,1) || dead_instruction(co,1,dead_flags)<0) continue;
+        if ((op_reads(co[0])|op_writes(co[0]))&bl) continue;
+        if (best<0 || byte_size(co[0])<byte_size(insts[best].op) ||
+            (byte_size(co[0])==byte_size(insts[best].op) && tstates(co[0])<tstates(insts[best].op))) best=(int)i;
+    }
+    return best;
+}
+
+// Whether candidate i of insts stays out of the QuickCheck index.
+static bool cand_skipped(const std::vector<Inst> &insts, size_t i, int stand_in, uint8_t dead_flags) {
+    uint16_t co[1]={insts[i].op}, cm[1]={insts[i].imm};
+    if (should_prune(co,cm,1)) return true;
+    return (int)i!=stand_in && dead_instruction(co,1,dead_flags)>=0;
+}
+
+// Batch target
+struct BatchTarget {
+    uint16_t ops[3], imms[3];
+    int len, bytes;
+    bool orbit;   // --symmetry representative: rules expand to its renamings (z80_symmetry.h)
+};
+
+// Format one confirmed rule as a JSONL line (including the trailing newline).
+// Every backend emits through this so their outputs are byte-identical.
+static int format_result_jsonl_seq(char* out, size_t outsz, const BatchTarget &bt,
+                                   const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
+                                   uint8_t dead_flags) {
+    char sbuf[256], rbuf[192], p[3][64];
+    for (int j=0;j<bt.len;j++) disasm(bt.ops[j],bt.imms[j],p[j],sizeof(p[j]));
+    if (bt.len==2) snprintf(sbuf,sizeof(sbuf),"%s : %s",p[0],p[1]);
+    else if (bt.len==3) snprintf(sbuf,sizeof(sbuf),"%s : %s : %s",p[0],p[1],p[2]);
+    else snprintf(sbuf,sizeof(sbuf),"%s",p[0]);
+    int cb=0, csaved=0, rn=0;
+    for (int j=0;j<c_n;j++) {
+        disasm(c_ops[j],c_imms[j],p[j],sizeof(p[j]));
+        rn+=snprintf(rbuf+rn,sizeof(rbuf)-rn,j?" : %s":"%s",p[j]);
+        cb+=byte_size(c_ops[j]);
+        csaved-=tstates(c_ops[j]);
+    }
+    int bsaved=bt.bytes-cb;
+    for (int j=0;j<bt.len;j++) csaved+=tstates(bt.ops[j]);
+    int n=snprintf(out,outsz,"{\"source_asm\":\"%s\",\"replacement_asm\":\"%s\","
+                   "\"source_bytes\":%d,\"replacement_bytes\":%d,"
+                   "\"bytes_saved\":%d,\"cycles_saved\":%d",
+                   sbuf, rbuf, bt.bytes, cb, bsaved, csaved);
+    if (dead_flags) n+=snprintf(out+n,outsz-n,",\"dead_flags\":\"0x%02X\"",dead_flags);
+    n+=snprintf(out+n,outsz-n,"}\n");
+    return n;
+}
+
+// Single-instruction replacement, the common case.
+static int format_result_jsonl(char* out, size_t outsz, const BatchTarget &bt,
+                               uint16_t cop, uint16_t cimm, uint8_t dead_flags) {
+    return format_result_jsonl_seq(out, outsz, bt, &cop, &cimm, 1, dead_flags);
+}
+
+// ============================================================
+// Resident candidate set
+// Candidate fingerprints are deterministic, so z80_search_cpu.cpp computes
+// them once (dead flags pre-masked) instead of re-executing them per target
+// as on GPU; the self-checks of the headers use the same table.
+// ============================================================
+struct CandTable {
+    std::vector<Inst> insts;
+    FpIndex qc;                   // QuickCheck fingerprints, hashed
+    std::vector<uint8_t> mfps;    // count * MID_FP_LEN
+    uint32_t count = 0;
+};
+
+static void mask_fp_flags(uint8_t* fp, int nvec, uint8_t dead_flags) {
+    if (!dead_flags) return;
+    for (int v=0; v<nvec; v++) fp[v*FP_SIZE+1] &= (uint8_t)~dead_flags;
+}
+
+static void build_cand_table(CandTable &ct, const std::vector<Inst> &insts, uint8_t dead_flags) {
+    ct.insts = insts;
+    ct.count = (uint32_t)insts.size();
+    ct.mfps.resize((size_t)ct.count*MID_FP_LEN);
+    std::vector<uint32_t> packed(ct.count);
+    std::vector<uint8_t> bytes(ct.count);
+    int stand_in = dead_stand_in(insts, dead_flags);
+    for (uint32_t ci=0; ci<ct.count; ci++) {
+        uint16_t co[1]={insts[ci].op}, cm[1]={insts[ci].imm};
+        h_mid_fingerprint(co, cm, 1, &ct.mfps[(size_t)ci*MID_FP_LEN]);
+        mask_fp_flags(&ct.mfps[(size_t)ci*MID_FP_LEN], MID_VECTORS, dead_flags);
+        packed[ci] = (uint32_t)co[0] | ((uint32_t)cm[0]<<16);
+        bytes[ci] = cand_skipped(insts, ci, stand_in, dead_flags) ? FP_INDEX_SKIP : (uint8_t)byte_size(co[0]);
+    }
+    fp_index_build(ct.qc, packed.data(), bytes.data(), ct.count, dead_flags);
+}
+
+// ============================================================
+// Self-checks of the pruning (z80search_cpu --test)
+// ============================================================
+
+// Of every class of sequences equal up to adjacent swaps of independent
+// instructions, exactly the least by inst_key is trace_canonical. Returns the
+// failure count.
+static long trace_verify(const std::vector<Inst> &insts, std::mt19937 &rng) {
+    long bad=0, classes=0, members=0, adjacent=0;
+    for (int k=0; k<20000; k++) {
+        int n=3+(k&1);
+        std::vector<Inst> w(n);
+        for (int j=0; j<n; j++) w[j]=insts[rng()%insts.size()];
+        auto key = [](const std::vector<Inst> &v) {
+            std::vector<uint32_t> r;
+            for (const Inst &x : v) r.push_back(inst_key(x.op,x.imm));
+            return r;
+        };
+        std::vector<std::vector<Inst>> cls={w};
+        std::vector<std::vector<uint32_t>> seen={key(w)};
+        for (size_t q=0; q<cls.size(); q++)
+            for (int j=0; j+1<n; j++) {
+                if (!are_independent(cls[q][j].op,cls[q][j+1].op)) continue;
+                std::vector<Inst> v=cls[q];
+                std::swap(v[j],v[j+1]);
+                if (std::find(seen.begin(),seen.end(),key(v))!=seen.end()) continue;
+                seen.push_back(key(v));
+                cls.push_back(v);
+            }
+        classes++;
+        members+=cls.size();
+        int canon=0;
+        size_t least=std::min_element(seen.begin(),seen.end())-seen.begin();
+        for (size_t q=0; q<cls.size(); q++) {
+            uint16_t o[4], im[4];
+            bool adj=true;
+            for (int j=0; j<n; j++) { o[j]=cls[q][j].op; im[j]=cls[q][j].imm; }
+            for (int j=0; j+1<n; j++)
+                if (are_independent(o[j],o[j+1]) && inst_key(o[j],im[j])>inst_key(o[j+1],im[j+1])) adj=false;
+            adjacent+=adj;
+            if (!trace_canonical(o,im,n)) continue;
+            canon++;
+            if (q!=least) bad++;
+        }
+        if (canon!=1) bad++;
+    }
+    fprintf(stderr,"Trace form: %ld classes of %ld sequences, %ld adjacent-order survivors, %ld failures\n",
+            classes, members, adjacent, bad);
+    return bad;
+}
+
+// Removing the instruction dead_instruction names leaves an equivalent
+// sequence under the dead flags. Returns the failure count.
+static long liveness_verify(const std::vector<Inst> &insts, std::mt19937 &rng) {
+    long bad=0, dead=0, far=0, singles=0;
+    for (uint8_t df : {(uint8_t)0x00, (uint8_t)0x28, (uint8_t)0xFF}) {
+        for (const Inst &x : insts) {
+            uint16_t o[1]={x.op};
+            if (dead_instruction(o,1,df)<0) continue;
+            singles++;
+            for (int k=0; k<64; k++) {
+                Z80State s, t;
+                for (int r=0; r<8; r++) s.r[r]=(uint8_t)rng();
+                s.sp=(uint16_t)rng();
+                t=s;
+                h_exec_instruction(t,x.op,x.imm);
+                if (!h_states_equal(s,t,df)) { bad++; break; }
+            }
+        }
+        for (long k=0, found=0; found<300 && k<2000000; k++) {
+            int n=2+(int)(k&1);
+            uint16_t o[3], im[3];
+            for (int j=0; j<n; j++) {
+                // mostly 8-bit loads and ALU ops, where overwrites are common
+                const Inst &x=insts[rng()%(k&2 ? insts.size() : 900)];
+                o[j]=x.op; im[j]=x.imm;
+            }
+            int d=dead_instruction(o,n,df);
+            if (d<0 || should_prune(o,im,n)) continue;
+            found++; dead++;
+            far+=(n==3 && d==0);
+            uint16_t co[2], ci[2];
+            for (int j=0, c=0; j<n; j++) if (j!=d) { co[c]=o[j]; ci[c]=im[j]; c++; }
+            if (!bdd_exhaustive_check(o,im,n,co,ci,n-1,df) && bad++<5) {
+                char a[3][64];
+                for (int j=0; j<n; j++) disasm(o[j],im[j],a[j],sizeof(a[j]));
+                fprintf(stderr,"  NOT DEAD: instruction %d of %s : %s%s%s (dead 0x%02X)\n", d, a[0], a[1],
+                        n==3 ? " : " : "", n==3 ? a[2] : "", df);
+            }
+        }
+    }
+    // Under 0xFF the index holds one dead candidate, the stand-in, and every
+    // target it matches does nothing observable.
+    CandTable ct;
+    build_cand_table(ct, insts, 0xFF);
+    int si=dead_stand_in(insts, 0xFF);
+    long empty=0;
+    for (long k=0; k<200000 && si>=0; k++) {
+        const Inst &a=insts[rng()%900], &b=insts[rng()%900];
+        uint16_t o[2]={a.op,b.op}, im[2]={a.imm,b.imm};
+        uint8_t fp[FP_LEN];
+        uint32_t hits[256];
+        h_fingerprint(o,im,2,fp);
+        int nh=fp_index_probe(ct.qc,fp,256,hits,256);
+        for (int j=0; j<nh; j++) {
+            uint16_t co[1]={insts[hits[j]].op}, ci[1]={insts[hits[j]].imm};
+            if (dead_instruction(co,1,0xFF)<0) continue;
+            if ((int)hits[j]!=si) { bad++; continue; }
+            if (!bdd_exhaustive_check(o,im,2,co,ci,1,0xFF)) continue;
+            empty++;
+            if (!bdd_exhaustive_check(o,im,2,co,ci,0,0xFF)) bad++;   // equal to the empty sequence
+        }
+    }
+    if (si<0 || !empty) bad++;
+    fprintf(stderr,"Liveness: %ld dead single instructions, %ld sequences with one (%ld first of three), "
+            "%ld targets to the stand-in, %ld failures\n", singles, dead, far, empty, bad);
+    return bad;
+}
@@ -1,16 +1,36 @@
 // Z80 Standalone GPU Superoptimizer Search — v2 Batched Pipeline
 //
 // 3-stage GPU pipeline:
-//   Stage 1: Batched QuickCheck (512 targets x N candidates, 8 test vectors)
+//   Stage 1: Batched QuickCheck (host fingerprint-index probe per target;
+//            --gpu-qc runs the 512 targets x N candidates kernel instead)
 //   Stage 2: MidCheck (survivors only, 24 additional test vectors)
-//   Stage 3: GPU ExhaustiveCheck (256 threads/block, full input sweep)
+//   Stage 3: GPU ExhaustiveCheck (256 threads/block, full input sweep); its
+//            counterexamples become extra vectors that later MidCheck
+//            survivors are compared on first, on the host (z80_learned.h)
 //
 // Build: nvcc -O2 -o z80search_v2 z80_search_v2.cu
+//        (add -Xcompiler -march=native for the AVX2 host-side ExhaustiveCheck)
 // Usage: ./z80search_v2 --max-target 2 [--dead-flags 0x28] [--gpu-id N]
-//                       [--first-op-start M] [--first-op-end N]
+//                       [--first-op-start M] [--first-op-end N] [--gpu-qc]
+//                       [--no-af-lut] [--af-lut-check] [--no-flag-demand]
+//                       [--resume FILE [--checkpoint-every SEC]] [--binary] [--symmetry]
+//                       [--known-rules len2.jsonl [--keep-subsumed]]
+//                       [--learned-vectors FILE | --no-learn]
+//                       [--status FILE] [--status-prom FILE] [--status-interval S]
 //
-// Output: JSONL to stdout (one result per line)
-// Progress: stderr
+// Output: JSONL to stdout (one result per line), or with --binary the
+//         fixed-record stream of z80_results.h (render with z80results)
+// Progress: stderr, and with --status/--status-prom a periodically rewritten
+//           status file (z80_telemetry.h)
+//
+// Long sweeps: run with --resume FILE and stdout appended to a file; rerun
+// the same command after a crash and it picks up from the last checkpoint
+// (see z80_checkpoint.h):
+//   ./z80search_v2 --max-target 3 --resume len3.ckpt >> len3.jsonl
+//
+// Load-balanced sweeps: run as a worker of z80coord (z80_coord.cpp), which
+// hands out small units and merges the JSONL:
+//   ./z80search_v2 --coordinator /tmp/z80.sock --gpu-id 1
 
 #include <cstdlib>
 #include <cstdio>
@@ -21,6 +41,16 @@
 #include <algorithm>
 
 #include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_fp_index.h"
+#include "z80_aflut.h"
+#include "z80_checkpoint.h"
+#include "z80_coord.h"
+#include "z80_results.h"
+#include "z80_symmetry.h"
+#include "z80_subsume.h"
+#include "z80_learned.h"
+#include "z80_telemetry.h"
 
 // ============================================================
 // Pipeline tuning constants
@@ -90,57 +120,63 @@ static void upload_tables_cuda() {
 // ============================================================
 __device__ inline uint8_t bsel(bool cond, uint8_t a, uint8_t b) { return cond ? a : b; }
 
-__device__ void alu_add(Z80State &s, uint8_t val) {
+// `need` is the set of F bits a later instruction or the final compare will
+// look at (see h_flag_demand).  Flag terms outside it are skipped, which saves
+// the divergent __constant__ lookups; the bits they would have set are left 0.
+#define FLAG_IF(bits, expr) ((need & (bits)) ? (uint8_t)(expr) : (uint8_t)0)
+#define SZ53 (FLAG_S | FLAG_Z | FLAG_3 | FLAG_5)
+
+__device__ void alu_add(Z80State &s, uint8_t val, uint8_t need = 0xFF) {
     uint16_t r = (uint16_t)s.r[REG_A] + val;
     uint8_t lookup = ((s.r[REG_A] & 0x88) >> 3) | ((val & 0x88) >> 2) | (uint8_t)((r & 0x88) >> 1);
     s.r[REG_A] = (uint8_t)r;
-    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | d_halfcarry_add[lookup & 0x07] | d_overflow_add[lookup >> 4] | d_sz53[s.r[REG_A]];
+    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_IF(FLAG_H, d_halfcarry_add[lookup & 0x07]) | FLAG_IF(FLAG_V, d_overflow_add[lookup >> 4]) | FLAG_IF(SZ53, d_sz53[s.r[REG_A]]);
 }
-__device__ void alu_adc(Z80State &s, uint8_t val) {
+__device__ void alu_adc(Z80State &s, uint8_t val, uint8_t need = 0xFF) {
     uint16_t r = (uint16_t)s.r[REG_A] + val + (s.r[REG_F] & FLAG_C);
     uint8_t lookup = (uint8_t)(((uint16_t)(s.r[REG_A]) & 0x88) >> 3 | ((uint16_t)(val) & 0x88) >> 2 | (r & 0x88) >> 1);
     s.r[REG_A] = (uint8_t)r;
-    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | d_halfcarry_add[lookup & 0x07] | d_overflow_add[lookup >> 4] | d_sz53[s.r[REG_A]];
+    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_IF(FLAG_H, d_halfcarry_add[lookup & 0x07]) | FLAG_IF(FLAG_V, d_overflow_add[lookup >> 4]) | FLAG_IF(SZ53, d_sz53[s.r[REG_A]]);
 }
-__device__ void alu_sub(Z80State &s, uint8_t val) {
+__device__ void alu_sub(Z80State &s, uint8_t val, uint8_t need = 0xFF) {
     uint16_t r = (uint16_t)s.r[REG_A] - val;
     uint8_t lookup = ((s.r[REG_A] & 0x88) >> 3) | ((val & 0x88) >> 2) | (uint8_t)((r & 0x88) >> 1);
     s.r[REG_A] = (uint8_t)r;
-    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_N | d_halfcarry_sub[lookup & 0x07] | d_overflow_sub[lookup >> 4] | d_sz53[s.r[REG_A]];
+    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_N | FLAG_IF(FLAG_H, d_halfcarry_sub[lookup & 0x07]) | FLAG_IF(FLAG_V, d_overflow_sub[lookup >> 4]) | FLAG_IF(SZ53, d_sz53[s.r[REG_A]]);
 }
-__device__ void alu_sbc(Z80State &s, uint8_t val) {
+__device__ void alu_sbc(Z80State &s, uint8_t val, uint8_t need = 0xFF) {
     uint16_t r = (uint16_t)s.r[REG_A] - val - (s.r[REG_F] & FLAG_C);
     uint8_t lookup = ((s.r[REG_A] & 0x88) >> 3) | ((val & 0x88) >> 2) | (uint8_t)((r & 0x88) >> 1);
     s.r[REG_A] = (uint8_t)r;
-    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_N | d_halfcarry_sub[lookup & 0x07] | d_overflow_sub[lookup >> 4] | d_sz53[s.r[REG_A]];
+    s.r[REG_F] = bsel(r & 0x100, FLAG_C, 0) | FLAG_N | FLAG_IF(FLAG_H, d_halfcarry_sub[lookup & 0x07]) | FLAG_IF(FLAG_V, d_overflow_sub[lookup >> 4]) | FLAG_IF(SZ53, d_sz53[s.r[REG_A]]);
 }
-__device__ void alu_and(Z80State &s, uint8_t val) { s.r[REG_A] &= val; s.r[REG_F] = FLAG_H | d_sz53p[s.r[REG_A]]; }
-__device__ void alu_xor(Z80State &s, uint8_t val) { s.r[REG_A] ^= val; s.r[REG_F] = d_sz53p[s.r[REG_A]]; }
-__device__ void alu_or(Z80State &s, uint8_t val) { s.r[REG_A] |= val; s.r[REG_F] = d_sz53p[s.r[REG_A]]; }
-__device__ void alu_cp(Z80State &s, uint8_t val) {
+__device__ void alu_and(Z80State &s, uint8_t val, uint8_t need = 0xFF) { s.r[REG_A] &= val; s.r[REG_F] = FLAG_H | FLAG_IF(SZ53 | FLAG_P, d_sz53p[s.r[REG_A]]); }
+__device__ void alu_xor(Z80State &s, uint8_t val, uint8_t need = 0xFF) { s.r[REG_A] ^= val; s.r[REG_F] = FLAG_IF(SZ53 | FLAG_P, d_sz53p[s.r[REG_A]]); }
+__device__ void alu_or(Z80State &s, uint8_t val, uint8_t need = 0xFF) { s.r[REG_A] |= val; s.r[REG_F] = FLAG_IF(SZ53 | FLAG_P, d_sz53p[s.r[REG_A]]); }
+__device__ void alu_cp(Z80State &s, uint8_t val, uint8_t need = 0xFF) {
     uint16_t r = (uint16_t)s.r[REG_A] - val;
     uint8_t lookup = ((s.r[REG_A] & 0x88) >> 3) | ((val & 0x88) >> 2) | (uint8_t)((r & 0x88) >> 1);
     s.r[REG_F] = bsel(r & 0x100, FLAG_C, bsel(r != 0, (uint8_t)0, FLAG_Z)) | FLAG_N |
-                 d_halfcarry_sub[lookup & 0x07] | d_overflow_sub[lookup >> 4] | (val & (FLAG_3 | FLAG_5)) | (uint8_t)(r & FLAG_S);
+                 FLAG_IF(FLAG_H, d_halfcarry_sub[lookup & 0x07]) | FLAG_IF(FLAG_V, d_overflow_sub[lookup >> 4]) | (val & (FLAG_3 | FLAG_5)) | (uint8_t)(r & FLAG_S);
 }
-__device__ void alu_inc(Z80State &s, int reg) {
+__device__ void alu_inc(Z80State &s, int reg, uint8_t need = 0xFF) {
     s.r[reg]++;
-    s.r[REG_F] = (s.r[REG_F] & FLAG_C) | bsel(s.r[reg] == 0x80, FLAG_V, 0) | bsel((s.r[reg] & 0x0F) != 0, (uint8_t)0, FLAG_H) | d_sz53[s.r[reg]];
+    s.r[REG_F] = (s.r[REG_F] & FLAG_C) | bsel(s.r[reg] == 0x80, FLAG_V, 0) | bsel((s.r[reg] & 0x0F) != 0, (uint8_t)0, FLAG_H) | FLAG_IF(SZ53, d_sz53[s.r[reg]]);
 }
-__device__ void alu_dec(Z80State &s, int reg) {
+__device__ void alu_dec(Z80State &s, int reg, uint8_t need = 0xFF) {
     s.r[REG_F] = (s.r[REG_F] & FLAG_C) | bsel((s.r[reg] & 0x0F) != 0, (uint8_t)0, FLAG_H) | FLAG_N;
     s.r[reg]--;
-    s.r[REG_F] |= bsel(s.r[reg] == 0x7F, FLAG_V, 0) | d_sz53[s.r[reg]];
+    s.r[REG_F] |= bsel(s.r[reg] == 0x7F, FLAG_V, 0) | FLAG_IF(SZ53, d_sz53[s.r[reg]]);
 }
 
-__device__ uint8_t cb_rlc(Z80State &s, uint8_t v) { v = (v << 1) | (v >> 7); s.r[REG_F] = (v & FLAG_C) | d_sz53p[v]; return v; }
-__device__ uint8_t cb_rrc(Z80State &s, uint8_t v) { s.r[REG_F] = v & FLAG_C; v = (v >> 1) | (v << 7); s.r[REG_F] |= d_sz53p[v]; return v; }
-__device__ uint8_t cb_rl(Z80State &s, uint8_t v) { uint8_t o = v; v = (v << 1) | (s.r[REG_F] & FLAG_C); s.r[REG_F] = (o >> 7) | d_sz53p[v]; return v; }
-__device__ uint8_t cb_rr(Z80State &s, uint8_t v) { uint8_t o = v; v = (v >> 1) | (s.r[REG_F] << 7); s.r[REG_F] = (o & FLAG_C) | d_sz53p[v]; return v; }
-__device__ uint8_t cb_sla(Z80State &s, uint8_t v) { s.r[REG_F] = v >> 7; v <<= 1; s.r[REG_F] |= d_sz53p[v]; return v; }
-__device__ uint8_t cb_sra(Z80State &s, uint8_t v) { s.r[REG_F] = v & FLAG_C; v = (v & 0x80) | (v >> 1); s.r[REG_F] |= d_sz53p[v]; return v; }
-__device__ uint8_t cb_srl(Z80State &s, uint8_t v) { s.r[REG_F] = v & FLAG_C; v >>= 1; s.r[REG_F] |= d_sz53p[v]; return v; }
-__device__ uint8_t cb_sll(Z80State &s, uint8_t v) { s.r[REG_F] = v >> 7; v = (v << 1) | 0x01; s.r[REG_F] |= d_sz53p[v]; return v; }
+__device__ uint8_t cb_rlc(Z80State &s, uint8_t v, uint8_t need = 0xFF) { v = (v << 1) | (v >> 7); s.r[REG_F] = (v & FLAG_C) | FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_rrc(Z80State &s, uint8_t v, uint8_t need = 0xFF) { s.r[REG_F] = v & FLAG_C; v = (v >> 1) | (v << 7); s.r[REG_F] |= FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_rl(Z80State &s, uint8_t v, uint8_t need = 0xFF) { uint8_t o = v; v = (v << 1) | (s.r[REG_F] & FLAG_C); s.r[REG_F] = (o >> 7) | FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_rr(Z80State &s, uint8_t v, uint8_t need = 0xFF) { uint8_t o = v; v = (v >> 1) | (s.r[REG_F] << 7); s.r[REG_F] = (o & FLAG_C) | FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_sla(Z80State &s, uint8_t v, uint8_t need = 0xFF) { s.r[REG_F] = v >> 7; v <<= 1; s.r[REG_F] |= FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_sra(Z80State &s, uint8_t v, uint8_t need = 0xFF) { s.r[REG_F] = v & FLAG_C; v = (v & 0x80) | (v >> 1); s.r[REG_F] |= FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_srl(Z80State &s, uint8_t v, uint8_t need = 0xFF) { s.r[REG_F] = v & FLAG_C; v >>= 1; s.r[REG_F] |= FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
+__device__ uint8_t cb_sll(Z80State &s, uint8_t v, uint8_t need = 0xFF) { s.r[REG_F] = v >> 7; v = (v << 1) | 0x01; s.r[REG_F] |= FLAG_IF(SZ53 | FLAG_P, d_sz53p[v]); return v; }
 
 __device__ void exec_bit(Z80State &s, uint8_t val, int bit) {
     s.r[REG_F] = (s.r[REG_F] & FLAG_C) | FLAG_H | (val & (FLAG_3 | FLAG_5));
@@ -201,22 +237,22 @@ __device__ void set_pair(Z80State &s, int pair, uint16_t val) {
     }
 }
 
-__device__ void exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
+__device__ void exec_instruction(Z80State &s, uint16_t op, uint16_t imm, uint8_t need = 0xFF) {
     if (op < 49) { s.r[LD_DST[op / 7]] = s.r[LD_FULL_SRC[op]]; return; }
     if (op < 56) { s.r[IMM_REG[op - 49]] = (uint8_t)imm; return; }
     if (op < 120) {
         int alu_op = (op - 56) / 8, src_idx = (op - 56) % 8;
         uint8_t val = (src_idx < 7) ? s.r[ALU_SRC[src_idx]] : (uint8_t)imm;
         switch (alu_op) {
-            case 0: alu_add(s, val); break; case 1: alu_adc(s, val); break;
-            case 2: alu_sub(s, val); break; case 3: alu_sbc(s, val); break;
-            case 4: alu_and(s, val); break; case 5: alu_xor(s, val); break;
-            case 6: alu_or(s, val); break;  case 7: alu_cp(s, val); break;
+            case 0: alu_add(s, val, need); break; case 1: alu_adc(s, val, need); break;
+            case 2: alu_sub(s, val, need); break; case 3: alu_sbc(s, val, need); break;
+            case 4: alu_and(s, val, need); break; case 5: alu_xor(s, val, need); break;
+            case 6: alu_or(s, val, need); break;  case 7: alu_cp(s, val, need); break;
         }
         return;
     }
-    if (op < 127) { alu_inc(s, INCDEC_REG[op - 120]); return; }
-    if (op < 134) { alu_dec(s, INCDEC_REG[op - 127]); return; }
+    if (op < 127) { alu_inc(s, INCDEC_REG[op - 120], need); return; }
+    if (op < 134) { alu_dec(s, INCDEC_REG[op - 127], need); return; }
     if (op == OP_RLCA) { s.r[REG_A] = (s.r[REG_A] << 1) | (s.r[REG_A] >> 7); s.r[REG_F] = (s.r[REG_F] & (FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & (FLAG_C | FLAG_3 | FLAG_5)); return; }
     if (op == OP_RRCA) { s.r[REG_F] = (s.r[REG_F] & (FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & FLAG_C); s.r[REG_A] = (s.r[REG_A] >> 1) | (s.r[REG_A] << 7); s.r[REG_F] |= s.r[REG_A] & (FLAG_3 | FLAG_5); return; }
     if (op == OP_RLA) { uint8_t o = s.r[REG_A]; s.r[REG_A] = (s.r[REG_A] << 1) | (s.r[REG_F] & FLAG_C); s.r[REG_F] = (s.r[REG_F] & (FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & (FLAG_3 | FLAG_5)) | (o >> 7); return; }
@@ -225,11 +261,11 @@ __device__ void exec_instruction(Z80State &s, uint16_t op, uint16_t imm) {
     if (op == OP_CPL) { s.r[REG_A] ^= 0xFF; s.r[REG_F] = (s.r[REG_F] & (FLAG_C | FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & (FLAG_3 | FLAG_5)) | FLAG_N | FLAG_H; return; }
     if (op == OP_SCF) { s.r[REG_F] = (s.r[REG_F] & (FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & (FLAG_3 | FLAG_5)) | FLAG_C; return; }
     if (op == OP_CCF) { uint8_t c = s.r[REG_F] & FLAG_C; s.r[REG_F] = (s.r[REG_F] & (FLAG_P | FLAG_Z | FLAG_S)) | (s.r[REG_A] & (FLAG_3 | FLAG_5)); if (c) s.r[REG_F] |= FLAG_H; else s.r[REG_F] |= FLAG_C; return; }
-    if (op == OP_NEG) { uint8_t o = s.r[REG_A]; s.r[REG_A] = 0; alu_sub(s, o); return; }
+    if (op == OP_NEG) { uint8_t o = s.r[REG_A]; s.r[REG_A] = 0; alu_sub(s, o, need); return; }
     if (op == OP_NOP) return;
-    if (op >= OP_CB_START && op <= 192) { int cb_op = (op - OP_CB_START) / 7; int reg = CB_REG[(op - OP_CB_START) % 7]; switch (cb_op) { case 0: s.r[reg] = cb_rlc(s, s.r[reg]); break; case 1: s.r[reg] = cb_rrc(s, s.r[reg]); break; case 2: s.r[reg] = cb_rl(s, s.r[reg]); break; case 3: s.r[reg] = cb_rr(s, s.r[reg]); break; case 4: s.r[reg] = cb_sla(s, s.r[reg]); break; case 5: s.r[reg] = cb_sra(s, s.r[reg]); break; case 6: s.r[reg] = cb_srl(s, s.r[reg]); break; } return; }
-    if (op == OP_SLL_A) { s.r[REG_A] = cb_sll(s, s.r[REG_A]); return; }
-    if (op >= OP_SLL_B_START && op < 200) { int reg = CB_REG[(op - OP_SLL_B_START) + 1]; s.r[reg] = cb_sll(s, s.r[reg]); return; }
+    if (op >= OP_CB_START && op <= 192) { int cb_op = (op - OP_CB_START) / 7; int reg = CB_REG[(op - OP_CB_START) % 7]; switch (cb_op) { case 0: s.r[reg] = cb_rlc(s, s.r[reg], need); break; case 1: s.r[reg] = cb_rrc(s, s.r[reg], need); break; case 2: s.r[reg] = cb_rl(s, s.r[reg], need); break; case 3: s.r[reg] = cb_rr(s, s.r[reg], need); break; case 4: s.r[reg] = cb_sla(s, s.r[reg], need); break; case 5: s.r[reg] = cb_sra(s, s.r[reg], need); break; case 6: s.r[reg] = cb_srl(s, s.r[reg], need); break; } return; }
+    if (op == OP_SLL_A) { s.r[REG_A] = cb_sll(s, s.r[REG_A], need); return; }
+    if (op >= OP_SLL_B_START && op < 200) { int reg = CB_REG[(op - OP_SLL_B_START) + 1]; s.r[reg] = cb_sll(s, s.r[reg], need); return; }
     if (op >= OP_BIT_START && op < OP_RES_START) { int idx = op - OP_BIT_START; exec_bit(s, s.r[CB_REG[idx % 7]], idx / 7); return; }
     if (op >= OP_RES_START && op < OP_SET_START) { int idx = op - OP_RES_START; s.r[CB_REG[idx % 7]] &= ~(1u << (idx / 7)); return; }
     if (op >= OP_SET_START && op < OP_16INC_START) { int idx = op - OP_SET_START; s.r[CB_REG[idx % 7]] |= (1u << (idx / 7)); return; }
@@ -369,9 +405,15 @@ struct ExhaustPair {
     uint8_t  sweep_sp;
     uint8_t  use_full;
     uint8_t  dead_flags;
-    uint8_t  _pad;
+    uint8_t  c_need[1];   // per-instruction flag demand (h_flag_demand)
+    uint8_t  t_need[3];
+    uint8_t  _pad[3];
 };
 
+// LIVE is the F mask compared at the end, fixed at compile time for the common
+// --dead-flags settings so the compare folds away; LIVE < 0 reads it from the
+// pair.  Each instruction only computes the flags in its t_need/c_need entry.
+template <int LIVE>
 __global__ void exhaustive_check_gpu(
     const ExhaustPair* __restrict__ pairs,
     uint32_t* __restrict__ results
@@ -384,15 +426,15 @@ __global__ void exhaustive_check_gpu(
     __syncthreads();
 
     ExhaustPair ep = pairs[pair_idx];
-    uint8_t dfm = ep.dead_flags;
+    uint8_t dfm = LIVE < 0 ? ep.dead_flags : (uint8_t)~LIVE;
 
     // Macros for executing target/candidate sequences
     #define EXEC_TARGET(st) do { \
         for (int _i = 0; _i < ep.t_len; _i++) \
-            exec_instruction(st, ep.t_ops[_i], ep.t_imms[_i]); \
+            exec_instruction(st, ep.t_ops[_i], ep.t_imms[_i], ep.t_need[_i]); \
     } while(0)
 
-    #define EXEC_CAND(sc) exec_instruction(sc, ep.c_ops[0], ep.c_imms[0])
+    #define EXEC_CAND(sc) exec_instruction(sc, ep.c_ops[0], ep.c_imms[0], ep.c_need[0])
 
     if (ep.nextra == 0 && !ep.sweep_sp) {
         for (int carry = 0; carry <= 1; carry++) {
@@ -486,154 +528,8 @@ done:
     }
 }
 
-// ============================================================
-// Host-side tables (verbatim from v1)
-// ============================================================
-static bool is_imm8(uint16_t op) {
-    if (op >= 49 && op <= 55) return true;
-    if (op >= 56 && op < 120 && ((op - 56) % 8) == 7) return true;
-    return false;
-}
-static bool is_imm16(uint16_t op) { return op >= 382 && op <= 385; }
-
-static int byte_size(uint16_t op) {
-    if (op >= 144 && op <= 367) return 2;
-    if (op == 142) return 2;
-    if (op >= 386 && op <= 393) return 2;
-    if (op >= 382 && op <= 385) return 3;
-    if (is_imm8(op)) return 2;
-    return 1;
-}
-
-static int tstates(uint16_t op) {
-    if (op < 49) return 4;
-    if (op < 56) return 7;
-    if (op < 120) { if ((op - 56) % 8 == 7) return 7; return 4; }
-    if (op < 134) return 4;
-    if (op <= 141) return 4;
-    if (op == 142) return 8;
-    if (op == 143) return 4;
-    if (op < 200) return 8;
-    if (op < 368) return 8;
-    if (op < 376) return 6;
-    if (op < 380) return 11;
-    if (op == 380) return 4;
-    if (op == 381) return 6;
-    if (op < 386) return 10;
-    return 15;
-}
-
-static const char* reg_names[8] = {"A", "F", "B", "C", "D", "E", "H", "L"};
-static const char* pair_names[4] = {"BC", "DE", "HL", "SP"};
-static const char* alu_names[8] = {"ADD A,", "ADC A,", "SUB", "SBC A,", "AND", "XOR", "OR", "CP"};
-static const char* cb_names[7] = {"RLC", "RRC", "RL", "RR", "SLA", "SRA", "SRL"};
-
-static void disasm(uint16_t op, uint16_t imm, char* buf, int bufsz) {
-    if (op < 49) { snprintf(buf, bufsz, "LD %s, %s", reg_names[LD_DST_H[op/7]], reg_names[LD_FULL_SRC_H[op]]); return; }
-    if (op < 56) { snprintf(buf, bufsz, "LD %s, 0x%02X", reg_names[IMM_REG_H[op-49]], imm & 0xFF); return; }
-    if (op < 120) { int a=(op-56)/8, s=(op-56)%8; if(s<7) snprintf(buf,bufsz,"%s %s",alu_names[a],reg_names[ALU_SRC_H[s]]); else snprintf(buf,bufsz,"%s 0x%02X",alu_names[a],imm&0xFF); return; }
-    if (op < 127) { snprintf(buf, bufsz, "INC %s", reg_names[INCDEC_REG_H[op-120]]); return; }
-    if (op < 134) { snprintf(buf, bufsz, "DEC %s", reg_names[INCDEC_REG_H[op-127]]); return; }
-    if (op==134) { snprintf(buf,bufsz,"RLCA"); return; } if (op==135) { snprintf(buf,bufsz,"RRCA"); return; }
-    if (op==136) { snprintf(buf,bufsz,"RLA"); return; }  if (op==137) { snprintf(buf,bufsz,"RRA"); return; }
-    if (op==138) { snprintf(buf,bufsz,"DAA"); return; }  if (op==139) { snprintf(buf,bufsz,"CPL"); return; }
-    if (op==140) { snprintf(buf,bufsz,"SCF"); return; }  if (op==141) { snprintf(buf,bufsz,"CCF"); return; }
-    if (op==142) { snprintf(buf,bufsz,"NEG"); return; }  if (op==143) { snprintf(buf,bufsz,"NOP"); return; }
-    if (op>=144&&op<=192) { int c=(op-144)/7,r=CB_REG_H[(op-144)%7]; snprintf(buf,bufsz,"%s %s",cb_names[c],reg_names[r]); return; }
-    if (op==193) { snprintf(buf,bufsz,"SLL A"); return; }
-    if (op>=194&&op<200) { snprintf(buf,bufsz,"SLL %s",reg_names[CB_REG_H[(op-194)+1]]); return; }
-    if (op>=200&&op<256) { int i=op-200; snprintf(buf,bufsz,"BIT %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
-    if (op>=256&&op<312) { int i=op-256; snprintf(buf,bufsz,"RES %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
-    if (op>=312&&op<368) { int i=op-312; snprintf(buf,bufsz,"SET %d, %s",i/7,reg_names[CB_REG_H[i%7]]); return; }
-    if (op>=368&&op<372) { snprintf(buf,bufsz,"INC %s",pair_names[op-368]); return; }
-    if (op>=372&&op<376) { snprintf(buf,bufsz,"DEC %s",pair_names[op-372]); return; }
-    if (op>=376&&op<380) { snprintf(buf,bufsz,"ADD HL, %s",pair_names[op-376]); return; }
-    if (op==380) { snprintf(buf,bufsz,"EX DE, HL"); return; }
-    if (op==381) { snprintf(buf,bufsz,"LD SP, HL"); return; }
-    if (op>=382&&op<386) { snprintf(buf,bufsz,"LD %s, 0x%04X",pair_names[op-382],imm); return; }
-    if (op>=386&&op<390) { snprintf(buf,bufsz,"ADC HL, %s",pair_names[op-386]); return; }
-    if (op>=390&&op<394) { snprintf(buf,bufsz,"SBC HL, %s",pair_names[op-390]); return; }
-    snprintf(buf,bufsz,"OP(%d)",op);
-}
-
-// ============================================================
-// Register dependency (verbatim from v1)
-// ============================================================
-#define RMASK_A 0x001u
-#define RMASK_F 0x002u
-#define RMASK_B 0x004u
-#define RMASK_C 0x008u
-#define RMASK_D 0x010u
-#define RMASK_E 0x020u
-#define RMASK_H 0x040u
-#define RMASK_L 0x080u
-#define RMASK_SP 0x100u
-
-static uint16_t op_reads(uint16_t op) {
-    if (op<49) { return 1u<<LD_FULL_SRC_H[op]; }
-    if (op<56) return 0;
-    if (op<120) { int ao=(op-56)/8,si=(op-56)%8; uint16_t m=0; if(si<7)m|=(1u<<ALU_SRC_H[si]); if(ao==1||ao==3)m|=RMASK_F; m|=RMASK_A; return m; }
-    if (op<127) return 1u<<INCDEC_REG_H[op-120];
-    if (op<134) return 1u<<INCDEC_REG_H[op-127];
-    if (op==OP_RLCA||op==OP_RRCA) return RMASK_A;
-    if (op==OP_RLA||op==OP_RRA) return RMASK_A|RMASK_F;
-    if (op==OP_DAA) return RMASK_A|RMASK_F;
-    if (op==OP_CPL||op==OP_NEG) return RMASK_A;
-    if (op==OP_SCF||op==OP_CCF) return RMASK_F;
-    if (op==OP_NOP) return 0;
-    if (op>=144&&op<=192) { int co=(op-144)/7; uint8_t rg=CB_REG_H[(op-144)%7]; uint16_t m=1u<<rg; if(co==2||co==3)m|=RMASK_F; return m; }
-    if (op==OP_SLL_A) return RMASK_A;
-    if (op>=194&&op<200) return 1u<<CB_REG_H[(op-194)+1];
-    if (op>=200&&op<368) { int idx=(op>=312)?op-312:(op>=256)?op-256:op-200; return 1u<<CB_REG_H[idx%7]; }
-    if (op>=368&&op<376) { int p=(op-368)%4; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
-    if (op>=376&&op<380) { int p=op-376; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return RMASK_H|RMASK_L|pm[p]; }
-    if (op==380) return RMASK_D|RMASK_E|RMASK_H|RMASK_L;
-    if (op==381) return RMASK_H|RMASK_L;
-    if (op>=382&&op<386) return 0;
-    if (op>=386&&op<394) { int p=(op>=390)?op-390:op-386; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return RMASK_H|RMASK_L|RMASK_F|pm[p]; }
-    return 0;
-}
-
-static uint16_t op_writes(uint16_t op) {
-    if (op<49) return 1u<<LD_DST_H[op/7];
-    if (op<56) return 1u<<IMM_REG_H[op-49];
-    if (op<120) { int ao=(op-56)/8; if(ao==7)return RMASK_F; return RMASK_A|RMASK_F; }
-    if (op<134) return (1u<<INCDEC_REG_H[op<127?op-120:op-127])|RMASK_F;
-    if (op>=134&&op<=137) return RMASK_A|RMASK_F;
-    if (op==OP_DAA||op==OP_CPL||op==OP_NEG) return RMASK_A|RMASK_F;
-    if (op==OP_SCF||op==OP_CCF) return RMASK_F;
-    if (op==OP_NOP) return 0;
-    if (op>=144&&op<=199) { uint8_t rg; if(op<=192)rg=CB_REG_H[(op-144)%7]; else if(op==193)rg=REG_A; else rg=CB_REG_H[(op-194)+1]; return(1u<<rg)|RMASK_F; }
-    if (op>=200&&op<256) return RMASK_F;
-    if (op>=256&&op<368) { int idx=(op>=312)?op-312:op-256; return 1u<<CB_REG_H[idx%7]; }
-    if (op>=368&&op<376) { int p=(op-368)%4; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
-    if (op>=376&&op<380) return RMASK_H|RMASK_L|RMASK_F;
-    if (op==380) return RMASK_D|RMASK_E|RMASK_H|RMASK_L;
-    if (op==381) return RMASK_SP;
-    if (op>=382&&op<386) { int p=op-382; static const uint16_t pm[4]={RMASK_B|RMASK_C,RMASK_D|RMASK_E,RMASK_H|RMASK_L,RMASK_SP}; return pm[p]; }
-    if (op>=386&&op<394) return RMASK_H|RMASK_L|RMASK_F;
-    return 0;
-}
-
-// Pruning
-static bool is_self_load(uint16_t op) { return op==6||op==8||op==16||op==24||op==32||op==40||op==48; }
-static uint32_t inst_key(uint16_t op, uint16_t imm) { return ((uint32_t)op<<16)|imm; }
-static bool are_independent(uint16_t op1, uint16_t op2) {
-    uint16_t aR=op_reads(op1),aW=op_writes(op1),bR=op_reads(op2),bW=op_writes(op2);
-    return (aW&bR)==0&&(aR&bW)==0&&(aW&bW)==0;
-}
-static bool should_prune(const uint16_t* ops, const uint16_t* imms, int n) {
-    for (int i=0;i<n;i++) {
-        if (ops[i]==OP_NOP) return true;
-        if (is_self_load(ops[i])) return true;
-        if (i+1<n) { uint16_t w1=op_writes(ops[i]); if(w1){uint16_t r2=op_reads(ops[i+1]),w2=op_writes(ops[i+1]),dead=w1&w2&~RMASK_F&~r2; if(dead)return true;} }
-    }
-    for (int i=0;i+1<n;i++) { if(are_independent(ops[i],ops[i+1])&&inst_key(ops[i],imms[i])>inst_key(ops[i+1],imms[i+1])) return true; }
-    return false;
-}
-
-// Register reads helper
-static uint16_t regs_read(const uint16_t* ops, int n) { uint16_t m=0; for(int i=0;i<n;i++)m|=op_reads(ops[i]); return m; }
+// --no-flag-demand: every instruction computes all of F, to diff against the default
+static bool h_no_flag_demand = false;
 
 // Build ExhaustPair struct for GPU kernel 3
 static ExhaustPair build_exhaust_pair(
@@ -645,6 +541,13 @@ static ExhaustPair build_exhaust_pair(
     for (int i=0; i<t_n && i<3; i++) { ep.t_ops[i]=t_ops[i]; ep.t_imms[i]=t_imms[i]; }
     ep.c_ops[0]=c_ops[0]; ep.c_imms[0]=c_imms[0];
     ep.t_len=(uint8_t)t_n; ep.c_len=(uint8_t)c_n; ep.dead_flags=dead_flags;
+    if (h_no_flag_demand) {
+        memset(ep.t_need, 0xFF, sizeof ep.t_need);
+        memset(ep.c_need, 0xFF, sizeof ep.c_need);
+    } else {
+        h_flag_demand(ep.t_ops, ep.t_len, (uint8_t)~dead_flags, ep.t_need);
+        h_flag_demand(ep.c_ops, ep.c_len, (uint8_t)~dead_flags, ep.c_need);
+    }
     uint16_t reads = regs_read(t_ops,t_n)|regs_read(c_ops,c_n);
     ep.nextra=0;
     if (reads&RMASK_B) ep.extra[ep.nextra++]=2;
@@ -658,130 +561,18 @@ static ExhaustPair build_exhaust_pair(
     return ep;
 }
 
-// Host-side helpers for CPU ExhaustiveCheck fallback
-static void h_set_reg_by_offset(Z80State &s, int offset, uint8_t val) {
-    switch (offset) {
-        case 2: s.r[REG_B]=val; break; case 3: s.r[REG_C]=val; break;
-        case 4: s.r[REG_D]=val; break; case 5: s.r[REG_E]=val; break;
-        case 6: s.r[REG_H]=val; break; case 7: s.r[REG_L]=val; break;
-    }
-}
-
-static const uint8_t h_rep_values[32] = {
-    0x00,0x01,0x02,0x0F,0x10,0x1F,0x20,0x3F,
-    0x40,0x55,0x7E,0x7F,0x80,0x81,0xAA,0xBF,
-    0xC0,0xD5,0xE0,0xEF,0xF0,0xF7,0xFE,0xFF,
-    0x03,0x07,0x11,0x33,0x77,0xBB,0xDD,0xEE,
-};
-static const uint16_t h_rep_sp[16] = {
-    0x0000,0x0001,0x00FF,0x0100,0x7FFE,0x7FFF,0x8000,0x8001,
-    0xFFFE,0xFFFF,0x1234,0x5678,0xABCD,0xDEAD,0xBEEF,0xCAFE,
-};
-
-// CPU ExhaustiveCheck — used for reduced-sweep pairs (nextra>2 or sweep_sp)
-// where CPU is faster than GPU due to early-exit and less launch overhead.
-static bool cpu_exhaustive_check(
-    const uint16_t* t_ops, const uint16_t* t_imms, int t_n,
-    const uint16_t* c_ops, const uint16_t* c_imms, int c_n,
-    uint8_t dead_flags
-) {
-    uint16_t reads = regs_read(t_ops,t_n)|regs_read(c_ops,c_n);
-    int extra[6]; int nextra=0;
-    if (reads&RMASK_B) extra[nextra++]=2;
-    if (reads&RMASK_C) extra[nextra++]=3;
-    if (reads&RMASK_D) extra[nextra++]=4;
-    if (reads&RMASK_E) extra[nextra++]=5;
-    if (reads&RMASK_H) extra[nextra++]=6;
-    if (reads&RMASK_L) extra[nextra++]=7;
-    bool sweep_sp = (reads&RMASK_SP)!=0;
-
-    for (int a=0;a<256;a++) {
-        for (int carry=0;carry<=1;carry++) {
-            if (nextra==0 && !sweep_sp) {
-                Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
-                Z80State st=s, sc=s;
-                h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
-                if (!h_states_equal(st,sc,dead_flags)) return false;
-                continue;
-            }
-            if (nextra==1 && !sweep_sp) {
-                for (int r=0;r<256;r++) {
-                    Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
-                    h_set_reg_by_offset(s,extra[0],(uint8_t)r);
-                    Z80State st=s, sc=s;
-                    h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
-                    if (!h_states_equal(st,sc,dead_flags)) return false;
-                }
-                continue;
-            }
-            if (nextra==2 && !sweep_sp) {
-                for (int r1=0;r1<256;r1++) {
-                    for (int r2=0;r2<256;r2++) {
-                        Z80State s={}; s.r[REG_A]=(uint8_t)a; s.r[REG_F]=(uint8_t)carry;
-                        h_set_reg_by_offset(s,extra[0],(uint8_t)r1);
-                        h_set_reg_by_offset(s,extra[1],(uint8_t)r2);
-                        Z80State st=s, sc=s;
-                        h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
-                        if (!h_states_equal(st,sc,dead_flags)) return false;
-                    }
-                }
-                continue;
-            }
-            // Reduced sweep (3+ regs or SP): use rep_values
-            auto do_sweep = [&](auto& self, Z80State s, int ri) -> bool {
-                if (ri>=nextra) {
-                    if (sweep_sp) {
-                        for (int si=0;si<16;si++) {
-                            Z80State s2=s; s2.sp=h_rep_sp[si];
-                            Z80State st=s2, sc=s2;
-                            h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
-                            if (!h_states_equal(st,sc,dead_flags)) return false;
-                        }
-                        return true;
-                    }
-                    Z80State st=s, sc=s;
-                    h_exec_seq(st,t_ops,t_imms,t_n); h_exec_seq(sc,c_ops,c_imms,c_n);
-                    return h_states_equal(st,sc,dead_flags);
-                }
-                for (int vi=0;vi<32;vi++) {
-                    Z80State s2=s;
-                    h_set_reg_by_offset(s2,extra[ri],h_rep_values[vi]);
-                    if (!self(self,s2,ri+1)) return false;
-                }
-                return true;
-            };
-            Z80State base={}; base.r[REG_A]=(uint8_t)a; base.r[REG_F]=(uint8_t)carry;
-            if (!do_sweep(do_sweep,base,0)) return false;
-        }
-    }
-    return true;
-}
-
-// Instruction enumeration
-struct Inst { uint16_t op, imm; };
-static std::vector<Inst> enumerate_instructions_8() {
-    std::vector<Inst> result;
-    for (uint16_t op=0; op<OP_COUNT; op++) {
-        if (is_imm16(op)) continue;
-        if (is_imm8(op)) { for(int imm=0;imm<256;imm++) result.push_back({op,(uint16_t)imm}); }
-        else result.push_back({op,0});
-    }
-    return result;
-}
-
-// Batch target
-struct BatchTarget {
-    uint16_t ops[3], imms[3];
-    int len, bytes;
-};
-
 // ============================================================
 // Main — 3-stage batched pipeline
 // ============================================================
 int main(int argc, char** argv) {
     int max_target=2; uint8_t dead_flags=0; int gpu_id=0;
     int first_op_start=0, first_op_end=-1;
-    bool no_exhaust=false;
+    bool no_exhaust=false, gpu_qc=false, no_af_lut=false, binary=false, symmetry=false;
+    const char* resume_path=nullptr; int ckpt_every=60;
+    const char* coord_path=nullptr;
+    const char* known_path=nullptr; bool keep_subsumed=false;
+    const char* learned_path=nullptr; bool no_learn=false;
+    const char* status_path=nullptr; const char* status_prom_path=nullptr; int status_interval=5;
 
     for (int i=1;i<argc;i++) {
         if (!strcmp(argv[i],"--max-target")&&i+1<argc) max_target=atoi(argv[++i]);
@@ -790,6 +581,22 @@ int main(int argc, char** argv) {
         else if (!strcmp(argv[i],"--first-op-start")&&i+1<argc) first_op_start=atoi(argv[++i]);
         else if (!strcmp(argv[i],"--first-op-end")&&i+1<argc) first_op_end=atoi(argv[++i]);
         else if (!strcmp(argv[i],"--no-exhaust")) no_exhaust=true;
+        else if (!strcmp(argv[i],"--gpu-qc")) gpu_qc=true;
+        else if (!strcmp(argv[i],"--no-af-lut")) no_af_lut=true;
+        else if (!strcmp(argv[i],"--af-lut-check")) h_af_lut_check=true;
+        else if (!strcmp(argv[i],"--no-flag-demand")) h_no_flag_demand=true;
+        else if (!strcmp(argv[i],"--resume")&&i+1<argc) resume_path=argv[++i];
+        else if (!strcmp(argv[i],"--checkpoint-every")&&i+1<argc) ckpt_every=atoi(argv[++i]);
+        else if (!strcmp(argv[i],"--coordinator")&&i+1<argc) coord_path=argv[++i];
+        else if (!strcmp(argv[i],"--binary")) binary=true;
+        else if (!strcmp(argv[i],"--symmetry")) symmetry=true;
+        else if (!strcmp(argv[i],"--known-rules")&&i+1<argc) known_path=argv[++i];
+        else if (!strcmp(argv[i],"--keep-subsumed")) keep_subsumed=true;
+        else if (!strcmp(argv[i],"--learned-vectors")&&i+1<argc) learned_path=argv[++i];
+        else if (!strcmp(argv[i],"--no-learn")) no_learn=true;
+        else if (!strcmp(argv[i],"--status")&&i+1<argc) status_path=argv[++i];
+        else if (!strcmp(argv[i],"--status-prom")&&i+1<argc) status_prom_path=argv[++i];
+        else if (!strcmp(argv[i],"--status-interval")&&i+1<argc) status_interval=atoi(argv[++i]);
         else if (!strcmp(argv[i],"--help")) {
             fprintf(stderr,"Usage: z80search_v2 [OPTIONS]\n"
                 "  --max-target N        Max target sequence length (default: 2)\n"
@@ -797,16 +604,38 @@ int main(int argc, char** argv) {
                 "  --gpu-id N            CUDA device ID (default: 0)\n"
                 "  --first-op-start M    Start outer loop at instruction index M\n"
                 "  --first-op-end N      End outer loop at instruction index N\n"
-                "  --no-exhaust          Skip ExhaustiveCheck, output MidCheck survivors\n");
+                "  --no-exhaust          Skip ExhaustiveCheck, output MidCheck survivors\n"
+                "  --gpu-qc              Brute-force QuickCheck kernel instead of the fingerprint index\n"
+                "  --no-af-lut           Branchy flag arithmetic instead of (A,F) tables on the host\n"
+                "  --af-lut-check        Cross-check every (A,F) table lookup against the branchy path\n"
+                "  --no-flag-demand      Compute every F bit in the GPU ExhaustiveCheck (output must match)\n"
+                "  --resume FILE         Checkpoint to FILE and resume from it if it exists\n"
+                "                        (stdout must be appended to the same file each run)\n"
+                "  --checkpoint-every S  Seconds between checkpoints (default: 60)\n"
+                "  --coordinator PATH    Search units from a z80coord socket (it sets dead flags and ranges)\n"
+                "  --binary              Write fixed-size binary records (z80results converts to JSONL)\n"
+                "  --symmetry            Search one target per register renaming, expand its rules to the rest\n"
+                "  --known-rules FILE    Skip length-3 targets with a window shortened by these length-2 rules\n"
+                "  --keep-subsumed       With --known-rules, count those targets but still search them\n"
+                "  --learned-vectors F   Preload counterexample vectors from F, save the learned set there at exit\n"
+                "  --no-learn            Do not learn MidCheck vectors from ExhaustiveCheck counterexamples\n"
+                "  --status FILE         Rewrite FILE with live counters, rates, latencies and ETA as JSON\n"
+                "  --status-prom FILE    The same in Prometheus text format\n"
+                "  --status-interval S   Seconds between status rewrites (default: 5)\n");
             return 0;
         }
     }
+    if (coord_path && resume_path) {
+        fprintf(stderr,"--resume does not apply to --coordinator workers (the coordinator owns progress)\n");
+        return 1;
+    }
 
     cudaSetDevice(gpu_id);
     cudaDeviceProp prop; cudaGetDeviceProperties(&prop, gpu_id);
     fprintf(stderr,"GPU %d: %s (%.1f GB, SM %d.%d)\n", gpu_id, prop.name, prop.totalGlobalMem/1e9, prop.major, prop.minor);
 
     init_tables();
+    if (!no_af_lut) aflut_init();
     upload_tables_cuda();
 
     std::vector<Inst> all_insts = enumerate_instructions_8();
@@ -814,10 +643,37 @@ int main(int argc, char** argv) {
     fprintf(stderr,"Instruction set: %u instructions (8-bit)\n", cand_count);
     if (first_op_end<0) first_op_end=(int)all_insts.size();
 
+    CoordWorker cw;
+    if (coord_path) {
+        uint32_t features = known_path && !keep_subsumed ? COORD_FEAT_SUBSUME : 0;
+        if (!coord_connect(cw, coord_path, "v2", features, cand_count, 2)) return 1;
+        dead_flags=cw.cfg.dead_flags; no_exhaust=cw.cfg.no_exhaust; binary=cw.cfg.binary;
+        symmetry=cw.cfg.symmetry;
+    }
+    if (symmetry) sym_init();
+    KnownRules known;
+    if (known_path && !known_load(known, known_path, dead_flags, symmetry)) return 1;
+    TargetFilter filter;
+    filter.symmetry=symmetry;
+    filter.dead_flags=dead_flags;
+    filter.known=known_path ? &known : nullptr;
+    filter.keep_subsumed=keep_subsumed;
+    static_assert(sizeof(SweepCheckpoint::total_pruned) >= sizeof(filter.pruned), "checkpoint prune counters");
+
     std::vector<uint32_t> cand_packed(cand_count);
     for (size_t i=0; i<all_insts.size(); i++)
         cand_packed[i] = (uint32_t)all_insts[i].op | ((uint32_t)all_insts[i].imm<<16);
 
+    // QuickCheck index: candidate fingerprints hashed once, one probe per target
+    FpIndex qc_index;
+    int dead_cand = dead_stand_in(all_insts, dead_flags);
+    {
+        std::vector<uint8_t> cand_bytes(cand_count);
+        for (uint32_t i=0; i<cand_count; i++)
+            cand_bytes[i] = cand_skipped(all_insts,i,dead_cand,dead_flags) ? FP_INDEX_SKIP : (uint8_t)byte_size(all_insts[i].op);
+        fp_index_build(qc_index, cand_packed.data(), cand_bytes.data(), cand_count, dead_flags);
+    }
+
     // GPU allocations
     uint32_t bitmap_words = (cand_count+31)/32;
     uint32_t *d_candidates, *d_hit_bitmap;
@@ -848,58 +704,170 @@ int main(int argc, char** argv) {
     uint32_t *h_eresults = (uint32_t*)malloc(max_exhaust_pairs*sizeof(uint32_t));
 
     uint64_t total_found=0, total_targets=0, total_qc_hits=0, total_mid_hits=0, total_exhaust=0, total_cpu_exhaust=0, total_batches=0;
-    time_t start_time = time(NULL);
+    uint64_t targets_this=0, found_before=0;
+
+    // Counterexample-learned vectors: pairs are checked against the current
+    // table on the host before ExhaustiveCheck, new counterexamples folded in
+    // after each batch.
+    bool learn = !no_exhaust && !no_learn;
+    LearnedSet learned;
+    LearnedBatch learn_batch;
+    if (learn && learned_path && learned_load(learned, learned_path))
+        fprintf(stderr,"Learned vectors: %s (%lu loaded)\n", learned_path, (unsigned long)learned.loaded);
+    std::shared_ptr<const LearnedTable> learned_tab;
+    if (learn) learned_tab = learned_table(learned, all_insts, dead_flags);
+    time_t start_time = time(NULL), len_start = start_time;
+
+    // Checkpoint/resume: the cursor is the next target to enumerate.
+    SweepCheckpoint ck;
+    ckpt_init(ck);
+    ck.max_target=max_target; ck.first_op_start=first_op_start; ck.first_op_end=first_op_end;
+    ck.cand_count=cand_count; ck.dead_flags=dead_flags; ck.no_exhaust=no_exhaust; ck.binary=binary;
+    ck.symmetry=symmetry;
+    ck.subsume=known_path && !keep_subsumed;
+    ck.known_hash=ck.subsume ? known.hash : 0;
+    int cur_len=2, cur_i0=first_op_start, cur_i1=0, cur_i2=0;
+    uint64_t out_bytes=0;
+    if (resume_path) {
+        SweepCheckpoint saved;
+        int r = ckpt_load(resume_path, saved);
+        if (r<0) return 1;
+        if (r==1) {
+            if (saved.max_target!=ck.max_target || saved.first_op_start!=ck.first_op_start ||
+                saved.first_op_end!=ck.first_op_end || saved.cand_count!=ck.cand_count ||
+                saved.dead_flags!=ck.dead_flags || saved.no_exhaust!=ck.no_exhaust || saved.binary!=ck.binary ||
+                saved.symmetry!=ck.symmetry || saved.subsume!=ck.subsume || saved.known_hash!=ck.known_hash) {
+                fprintf(stderr,"checkpoint: '%s' is for a different run (max_target=%d dead_flags=0x%02X ops=[%d,%d)%s%s%s%s)\n",
+                        resume_path, saved.max_target, saved.dead_flags, saved.first_op_start, saved.first_op_end,
+                        saved.no_exhaust ? " --no-exhaust" : "", saved.binary ? " --binary" : "",
+                        saved.symmetry ? " --symmetry" : "", saved.subsume ? " --known-rules" : "");
+                return 1;
+            }
+            if (!ckpt_rewind_output(stdout, saved.out_bytes)) return 1;
+            if (saved.done) { fprintf(stderr,"checkpoint: '%s': sweep already complete\n", resume_path); return 0; }
+            cur_len=saved.target_len; cur_i0=saved.i0; cur_i1=saved.i1; cur_i2=saved.i2;
+            out_bytes=saved.out_bytes;
+            total_found=saved.total_found; total_targets=saved.total_targets;
+            total_qc_hits=saved.total_qc_hits; total_mid_hits=saved.total_mid_hits;
+            total_exhaust=saved.total_exhaust; total_cpu_exhaust=saved.total_cpu_exhaust;
+            total_batches=saved.total_batches; filter.subsumed=saved.total_subsumed;
+            memcpy(filter.pruned, saved.total_pruned, sizeof(filter.pruned));
+            targets_this=saved.targets_this; found_before=saved.found_before;
+            start_time-=saved.elapsed; len_start-=saved.len_elapsed;
+            fprintf(stderr,"Resuming from %s: length %d at (%d,%d,%d), %lu targets, %lu found\n",
+                    resume_path, cur_len, cur_i0, cur_i1, cur_i2,
+                    (unsigned long)total_targets, (unsigned long)total_found);
+        } else {
+            int64_t sz = ckpt_output_size(stdout);
+            out_bytes = sz>0 ? (uint64_t)sz : 0;
+        }
+    }
+    // Results go to stdout through a writer thread; a fresh binary stream
+    // starts with its header.
+    ResultWriter writer(stdout);
+    if (binary && !coord_path && out_bytes==0) {
+        ResultFileHeader rh;
+        result_header_init(rh, "z80search_v2", dead_flags);
+        writer.write(&rh, sizeof(rh));
+        out_bytes += sizeof(rh);
+    }
+    time_t last_ckpt = time(NULL);
+    auto save_checkpoint = [&](int len, int i0, int i1, int i2, bool done) {
+        time_t now=time(NULL);
+        ck.target_len=len; ck.i0=i0; ck.i1=i1; ck.i2=i2; ck.done=done;
+        ck.out_bytes=out_bytes;
+        ck.total_found=total_found; ck.total_targets=total_targets;
+        ck.total_qc_hits=total_qc_hits; ck.total_mid_hits=total_mid_hits;
+        ck.total_exhaust=total_exhaust; ck.total_cpu_exhaust=total_cpu_exhaust;
+        ck.total_batches=total_batches; ck.total_subsumed=filter.subsumed;
+        memcpy(ck.total_pruned, filter.pruned, sizeof(filter.pruned));
+        ck.targets_this=targets_this; ck.found_before=found_before;
+        ck.elapsed=(int64_t)(now-start_time); ck.len_elapsed=(int64_t)(now-len_start);
+        if (!writer.flush() || !ckpt_save(resume_path, ck, stdout))
+            fprintf(stderr,"checkpoint: cannot write '%s'\n", resume_path);
+        if (learn && learned_path && !learned_save(learned, learned_path))
+            fprintf(stderr,"checkpoint: cannot write learned vectors to '%s'\n", learned_path);
+        last_ckpt=now;
+    };
+    // Called right after a flush, so the batch is empty.
+    auto maybe_checkpoint = [&](int len, int i0, int i1, int i2) {
+        if (resume_path && time(NULL)-last_ckpt>=ckpt_every) save_checkpoint(len, i0, i1, i2, false);
+    };
 
-    fprintf(stderr,"Starting v2 search: max_target=%d, dead_flags=0x%02X, gpu=%d, ops=[%d,%d)\n",
-            max_target, dead_flags, gpu_id, first_op_start, first_op_end);
+    tm_start(status_path, status_prom_path, status_interval, "z80search_v2", BATCH_SIZE);
+    if (coord_path)
+        fprintf(stderr,"Starting v2 worker: coordinator=%s, dead_flags=0x%02X, gpu=%d\n", coord_path, dead_flags, gpu_id);
+    else
+        fprintf(stderr,"Starting v2 search: max_target=%d, dead_flags=0x%02X, gpu=%d, ops=[%d,%d)%s\n",
+                max_target, dead_flags, gpu_id, first_op_start, first_op_end, symmetry ? ", symmetry" : "");
 
     std::vector<BatchTarget> batch;
     batch.reserve(BATCH_SIZE);
 
+    // Target states after each prefix, carried across batches
+    PrefixCache prefix;
+
+    // A batch's results, handed to the writer (or, for coordinator workers,
+    // the unit's output) once the batch is done
+    std::string batch_out;
+    std::string* unit_sink=nullptr;
+
     // Flush one batch through 3-stage pipeline
-    auto flush_batch = [&]() {
+    auto run_stages = [&]() {
         if (batch.empty()) return;
         uint32_t bc = (uint32_t)batch.size();
         total_batches++;
+        TmTime t_stage = tm_now();
 
         // CPU: compute fingerprints
         for (uint32_t bi=0; bi<bc; bi++) {
-            h_fingerprint(batch[bi].ops, batch[bi].imms, batch[bi].len, h_fps+bi*FP_LEN);
-            h_mid_fingerprint(batch[bi].ops, batch[bi].imms, batch[bi].len, h_mfps+bi*MID_FP_LEN);
+            prefix.set(batch[bi].ops, batch[bi].imms, batch[bi].len);
+            prefix.fingerprint(h_fps+bi*FP_LEN);
+            prefix.mid_fingerprint(h_mfps+bi*MID_FP_LEN);
         }
-        cudaMemcpy(d_target_fps, h_fps, bc*FP_LEN, cudaMemcpyHostToDevice);
         cudaMemcpy(d_target_mid_fps, h_mfps, bc*MID_FP_LEN, cudaMemcpyHostToDevice);
-        cudaMemset(d_hit_bitmap, 0, bc*bitmap_words*sizeof(uint32_t));
 
-        // Stage 1: Batched QuickCheck
-        uint32_t total_threads = bc * cand_count;
-        int grid1 = (total_threads+BLOCK_SIZE-1)/BLOCK_SIZE;
-        quickcheck_batched<<<grid1, BLOCK_SIZE>>>(d_candidates, d_target_fps, d_hit_bitmap,
-            cand_count, bc, bitmap_words, dead_flags);
-        cudaDeviceSynchronize();
-        cudaMemcpy(h_bitmap, d_hit_bitmap, bc*bitmap_words*sizeof(uint32_t), cudaMemcpyDeviceToHost);
-
-        // Collect QC hits
+        // Stage 1: QuickCheck — index probe (same hit order as the bitmap walk)
         uint32_t mid_count=0;
-        for (uint32_t bi=0; bi<bc; bi++) {
-            int tbytes = batch[bi].bytes;
-            for (uint32_t w=0; w<bitmap_words && mid_count<max_mid_pairs; w++) {
-                uint32_t bits = h_bitmap[bi*bitmap_words+w];
-                while (bits && mid_count<max_mid_pairs) {
-                    int bit = __builtin_ctz(bits);
-                    bits &= bits-1;
-                    uint32_t ci = w*32+bit;
-                    if (ci>=cand_count) break;
-                    int cb = byte_size(all_insts[ci].op);
-                    if (cb>=tbytes) continue;
-                    uint16_t co[1]={all_insts[ci].op}, cm[1]={all_insts[ci].imm};
-                    if (should_prune(co,cm,1)) continue;
-                    h_mpairs[mid_count++] = {(uint16_t)bi, (uint16_t)ci};
+        if (!gpu_qc) {
+            uint32_t hits[256];
+            for (uint32_t bi=0; bi<bc && mid_count<max_mid_pairs; bi++) {
+                int nh = fp_index_probe(qc_index, h_fps+bi*FP_LEN, batch[bi].bytes, hits, 256);
+                for (int k=0; k<nh && mid_count<max_mid_pairs; k++)
+                    h_mpairs[mid_count++] = {(uint16_t)bi, (uint16_t)hits[k]};
+            }
+        } else {
+            cudaMemcpy(d_target_fps, h_fps, bc*FP_LEN, cudaMemcpyHostToDevice);
+            cudaMemset(d_hit_bitmap, 0, bc*bitmap_words*sizeof(uint32_t));
+            uint32_t total_threads = bc * cand_count;
+            int grid1 = (total_threads+BLOCK_SIZE-1)/BLOCK_SIZE;
+            quickcheck_batched<<<grid1, BLOCK_SIZE>>>(d_candidates, d_target_fps, d_hit_bitmap,
+                cand_count, bc, bitmap_words, dead_flags);
+            cudaDeviceSynchronize();
+            cudaMemcpy(h_bitmap, d_hit_bitmap, bc*bitmap_words*sizeof(uint32_t), cudaMemcpyDeviceToHost);
+
+            // Collect QC hits
+            for (uint32_t bi=0; bi<bc; bi++) {
+                int tbytes = batch[bi].bytes;
+                for (uint32_t w=0; w<bitmap_words && mid_count<max_mid_pairs; w++) {
+                    uint32_t bits = h_bitmap[bi*bitmap_words+w];
+                    while (bits && mid_count<max_mid_pairs) {
+                        int bit = __builtin_ctz(bits);
+                        bits &= bits-1;
+                        uint32_t ci = w*32+bit;
+                        if (ci>=cand_count) break;
+                        int cb = byte_size(all_insts[ci].op);
+                        if (cb>=tbytes) continue;
+                        if (cand_skipped(all_insts,ci,dead_cand,dead_flags)) continue;
+                        h_mpairs[mid_count++] = {(uint16_t)bi, (uint16_t)ci};
+                    }
                 }
             }
         }
         total_qc_hits += mid_count;
+        tm_since(TM_H_QC, t_stage);
         if (mid_count==0) { batch.clear(); return; }
+        t_stage = tm_now();
 
         // Stage 2: MidCheck
         cudaMemcpy(d_mid_pairs, h_mpairs, mid_count*sizeof(MidPair), cudaMemcpyHostToDevice);
@@ -918,45 +886,43 @@ int main(int argc, char** argv) {
             mid_survivors.push_back({mp.target_idx, mp.cand_idx});
         }
         total_mid_hits += (uint64_t)mid_survivors.size();
+        tm_since(TM_H_MID, t_stage);
         if (mid_survivors.empty()) { batch.clear(); return; }
+        t_stage = tm_now();
 
-        // Helper: output one result as JSONL
-        auto emit_jsonl = [&](BatchTarget &bt, uint16_t cop, uint16_t cimm) {
-            int cb=byte_size(cop);
-            total_found++;
-            char sbuf[256], rbuf[64], p[3][64];
-            for (int j=0;j<bt.len;j++) disasm(bt.ops[j],bt.imms[j],p[j],sizeof(p[j]));
-            disasm(cop,cimm,rbuf,sizeof(rbuf));
-            if (bt.len==2) snprintf(sbuf,sizeof(sbuf),"%s : %s",p[0],p[1]);
-            else if (bt.len==3) snprintf(sbuf,sizeof(sbuf),"%s : %s : %s",p[0],p[1],p[2]);
-            else snprintf(sbuf,sizeof(sbuf),"%s",p[0]);
-            int bsaved=bt.bytes-cb, csaved=0;
-            for (int j=0;j<bt.len;j++) csaved+=tstates(bt.ops[j]);
-            csaved-=tstates(cop);
-            printf("{\"source_asm\":\"%s\",\"replacement_asm\":\"%s\","
-                   "\"source_bytes\":%d,\"replacement_bytes\":%d,"
-                   "\"bytes_saved\":%d,\"cycles_saved\":%d",
-                   sbuf, rbuf, bt.bytes, cb, bsaved, csaved);
-            if (dead_flags) printf(",\"dead_flags\":\"0x%02X\"",dead_flags);
-            printf("}\n"); fflush(stdout);
+        // Helper: output one result (JSONL line or binary record)
+        auto emit_result = [&](BatchTarget &bt, uint16_t cop, uint16_t cimm) {
+            size_t nb;
+            total_found += append_result_orbit(unit_sink ? *unit_sink : batch_out, binary, bt, cop, cimm, dead_flags, &nb);
+            out_bytes += nb;
         };
 
         if (no_exhaust) {
             // --no-exhaust: output all MidCheck survivors without ExhaustiveCheck
             for (auto &inf : mid_survivors) {
-                emit_jsonl(batch[inf.bi], all_insts[inf.ci].op, all_insts[inf.ci].imm);
+                emit_result(batch[inf.bi], all_insts[inf.ci].op, all_insts[inf.ci].imm);
             }
         } else {
-            // Stage 3: split into GPU (full sweep) and CPU (reduced sweep)
-            uint32_t exhaust_count=0;
+            // Stage 3: split into GPU (full sweep) and CPU (reduced sweep).
+            // Learned vectors drop pairs after the split, so it does not
+            // depend on them.
+            learned_begin(learn_batch, learned_tab);
+            uint8_t t_out[LEARN_MAX*FP_SIZE];
+            uint32_t t_bi = UINT32_MAX;
+            uint32_t exhaust_count=0, full_count=0;
             std::vector<EInfo> gpu_einfo;
             std::vector<EInfo> cpu_einfo;
             for (auto &inf : mid_survivors) {
+                BatchTarget &bt = batch[inf.bi];
                 uint16_t co[1]={all_insts[inf.ci].op}, cm[1]={all_insts[inf.ci].imm};
-                ExhaustPair ep = build_exhaust_pair(
-                    batch[inf.bi].ops, batch[inf.bi].imms, batch[inf.bi].len,
-                    co, cm, 1, dead_flags);
-                if (ep.use_full && exhaust_count<max_exhaust_pairs) {
+                ExhaustPair ep = build_exhaust_pair(bt.ops, bt.imms, bt.len, co, cm, 1, dead_flags);
+                bool gpu = ep.use_full && full_count<max_exhaust_pairs;
+                full_count += gpu;
+                if (learn_batch.active()) {
+                    if (inf.bi != t_bi) { learned_run(learn_batch, bt.ops, bt.imms, bt.len, dead_flags, t_out); t_bi = inf.bi; }
+                    if (learned_reject(learn_batch, t_out, learned_cand(learn_batch, inf.ci))) { tm_add(TM_LEARNED_REJECT); continue; }
+                }
+                if (gpu) {
                     h_epairs[exhaust_count] = ep;
                     gpu_einfo.push_back(inf);
                     exhaust_count++;
@@ -968,36 +934,101 @@ int main(int argc, char** argv) {
             // Stage 3a: GPU ExhaustiveCheck (full-sweep pairs)
             if (exhaust_count>0) {
                 cudaMemcpy(d_exhaust_pairs, h_epairs, exhaust_count*sizeof(ExhaustPair), cudaMemcpyHostToDevice);
-                exhaustive_check_gpu<<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results);
+                switch (dead_flags) {
+                    case 0x00: exhaustive_check_gpu<0xFF><<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results); break;
+                    case 0x28: exhaustive_check_gpu<0xD7><<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results); break;
+                    case 0xD7: exhaustive_check_gpu<0x28><<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results); break;
+                    case 0xFF: exhaustive_check_gpu<0x00><<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results); break;
+                    default:   exhaustive_check_gpu<-1><<<exhaust_count, EXHAUST_BLOCK>>>(d_exhaust_pairs, d_exhaust_results); break;
+                }
                 cudaDeviceSynchronize();
                 cudaMemcpy(h_eresults, d_exhaust_results, exhaust_count*sizeof(uint32_t), cudaMemcpyDeviceToHost);
                 total_exhaust += exhaust_count;
                 for (uint32_t ei=0; ei<exhaust_count; ei++) {
-                    if (!h_eresults[ei]) continue;
-                    emit_jsonl(batch[gpu_einfo[ei].bi], all_insts[gpu_einfo[ei].ci].op, all_insts[gpu_einfo[ei].ci].imm);
+                    BatchTarget &bt = batch[gpu_einfo[ei].bi];
+                    uint16_t co[1]={all_insts[gpu_einfo[ei].ci].op}, cm[1]={all_insts[gpu_einfo[ei].ci].imm};
+                    if (h_eresults[ei]) { emit_result(bt, co[0], cm[0]); tm_add(TM_EXHAUST_CONFIRMED); }
+                    // the kernel only says no; the host proof finds the input
+                    else if (learn) learned_capture(learn_batch, bt.ops, bt.imms, bt.len, co, cm, 1, dead_flags);
                 }
             }
 
-            // Stage 3b: CPU ExhaustiveCheck (reduced-sweep pairs)
+            // Stage 3b: CPU ExhaustiveCheck (3+ registers or SP: BDD proof)
             for (auto &inf : cpu_einfo) {
                 BatchTarget &bt = batch[inf.bi];
                 uint16_t co[1]={all_insts[inf.ci].op}, cm[1]={all_insts[inf.ci].imm};
                 total_cpu_exhaust++;
-                if (cpu_exhaustive_check(bt.ops, bt.imms, bt.len, co, cm, 1, dead_flags))
-                    emit_jsonl(bt, co[0], cm[0]);
+                if (bdd_exhaustive_check(bt.ops, bt.imms, bt.len, co, cm, 1, dead_flags)) {
+                    emit_result(bt, co[0], cm[0]);
+                    tm_add(TM_EXHAUST_CONFIRMED);
+                } else if (learn) learned_capture(learn_batch, bt.ops, bt.imms, bt.len, co, cm, 1, dead_flags);
             }
+            if (learn && learned_commit(learned, learn_batch, total_batches))
+                learned_tab = learned_table(learned, all_insts, dead_flags);
+            tm_since(TM_H_EXHAUST, t_stage);
         }
+        if (!batch_out.empty()) { writer.write(batch_out); batch_out.clear(); }
         batch.clear();
     };
+    // The stages, plus the batch's telemetry (counters as deltas of the totals)
+    auto flush_batch = [&]() {
+        if (!tm_global.enabled) { run_stages(); return; }
+        if (batch.empty()) return;
+        uint64_t n=batch.size(), q0=total_qc_hits, m0=total_mid_hits;
+        uint64_t e0=total_exhaust+total_cpu_exhaust, f0=total_found;
+        TmTime t0 = tm_now();
+        run_stages();
+        tm_since(TM_H_BATCH, t0);
+        tm_add(TM_TARGETS, n);
+        tm_add(TM_BATCHES);
+        tm_add(TM_QC_HITS, total_qc_hits-q0);
+        tm_add(TM_MID_PASS, total_mid_hits-m0);
+        tm_add(TM_MID_REJECT, (total_qc_hits-q0)-(total_mid_hits-m0));
+        tm_add(TM_EXHAUST_DISPATCHED, total_exhaust+total_cpu_exhaust-e0);
+        tm_add(TM_FOUND, total_found-f0);
+        tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending());
+    };
+
+    // Coordinator worker: one unit at a time (a second is queued to hide the
+    // round trip), counters reported per unit
+    if (coord_path) {
+        CoordUnit u;
+        std::string unit_out;
+        unit_sink=&unit_out;
+        bool ok=true;
+        while (ok && coord_next_unit(cw, u)) {
+            CoordResult r={};
+            r.seq=u.seq;
+            uint64_t t0=total_targets, b0=total_batches, q0=total_qc_hits, m0=total_mid_hits;
+            uint64_t e0=total_exhaust+total_cpu_exhaust, f0=total_found;
+            coord_enumerate_unit(all_insts, u, filter, [&](const BatchTarget &bt) {
+                total_targets++;
+                batch.push_back(bt);
+                if ((int)batch.size()>=BATCH_SIZE) flush_batch();
+            });
+            flush_batch();
+            r.targets=total_targets-t0; r.batches=total_batches-b0;
+            r.qc_hits=total_qc_hits-q0; r.mid_hits=total_mid_hits-m0;
+            r.exhaust=total_exhaust+total_cpu_exhaust-e0; r.found=total_found-f0;
+            ok = coord_send_result(cw, r, unit_out);
+            unit_out.clear();
+        }
+        coord_close(cw);
+        if (!ok) { writer.flush(); tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending()); tm_stop(); fprintf(stderr,"coordinator: lost connection, exiting\n"); return 1; }
+    }
 
     // Enumerate targets
-    for (int target_len=2; target_len<=max_target; target_len++) {
+    for (int target_len=cur_len; target_len<=max_target && !coord_path; target_len++) {
         fprintf(stderr,"=== Target length %d ===\n", target_len);
-        uint64_t targets_this=0, found_before=total_found;
-        time_t len_start=time(NULL), last_report=len_start;
+        // Only the first length entered can start mid-way (from a checkpoint).
+        bool at_cursor = target_len==cur_len;
+        if (!at_cursor) { targets_this=0; found_before=total_found; len_start=time(NULL); }
+        time_t last_report=time(NULL);
+        tm_length(target_len, first_op_end-first_op_start, at_cursor ? cur_i0-first_op_start : 0);
 
         if (target_len==2) {
-            for (int i0=first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+            for (int i0=at_cursor?cur_i0:first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+                tm_gauge(TM_G_DONE, i0-first_op_start);
                 time_t now=time(NULL);
                 if (now-last_report>=10) {
                     last_report=now;
@@ -1009,20 +1040,19 @@ int main(int argc, char** argv) {
                         (unsigned long)total_exhaust,(unsigned long)total_found,
                         (long)el,(long)eta);
                 }
-                for (size_t i1=0; i1<all_insts.size(); i1++) {
+                for (int i1=(at_cursor&&i0==cur_i0)?cur_i1:0; i1<(int)all_insts.size(); i1++) {
                     uint16_t to[2]={all_insts[i0].op,all_insts[i1].op};
                     uint16_t ti[2]={all_insts[i0].imm,all_insts[i1].imm};
-                    if (should_prune(to,ti,2)) continue;
+                    BatchTarget bt;
+                    if (!filter_target(filter,bt,to,ti,2)) continue;
                     targets_this++; total_targets++;
-                    BatchTarget bt; bt.ops[0]=to[0]; bt.ops[1]=to[1]; bt.ops[2]=0;
-                    bt.imms[0]=ti[0]; bt.imms[1]=ti[1]; bt.imms[2]=0;
-                    bt.len=2; bt.bytes=byte_size(to[0])+byte_size(to[1]);
                     batch.push_back(bt);
-                    if ((int)batch.size()>=BATCH_SIZE) flush_batch();
+                    if ((int)batch.size()>=BATCH_SIZE) { flush_batch(); maybe_checkpoint(2, i0, i1+1, 0); }
                 }
             }
         } else if (target_len==3) {
-            for (int i0=first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+            for (int i0=at_cursor?cur_i0:first_op_start; i0<first_op_end && i0<(int)all_insts.size(); i0++) {
+                tm_gauge(TM_G_DONE, i0-first_op_start);
                 time_t now=time(NULL);
                 if (now-last_report>=10) {
                     last_report=now;
@@ -1032,43 +1062,61 @@ int main(int argc, char** argv) {
                         pct,i0,first_op_end,(unsigned long)total_targets,
                         (unsigned long)total_found,(long)el,(long)eta);
                 }
-                for (size_t i1=0; i1<all_insts.size(); i1++) {
-                    for (size_t i2=0; i2<all_insts.size(); i2++) {
+                for (int i1=(at_cursor&&i0==cur_i0)?cur_i1:0; i1<(int)all_insts.size(); i1++) {
+                    uint16_t po[2]={all_insts[i0].op,all_insts[i1].op};
+                    uint16_t pi[2]={all_insts[i0].imm,all_insts[i1].imm};
+                    if (!filter_prefix(filter,po,pi,2,all_insts.size())) continue;
+                    for (int i2=(at_cursor&&i0==cur_i0&&i1==cur_i1)?cur_i2:0; i2<(int)all_insts.size(); i2++) {
                         uint16_t to[3]={all_insts[i0].op,all_insts[i1].op,all_insts[i2].op};
                         uint16_t ti[3]={all_insts[i0].imm,all_insts[i1].imm,all_insts[i2].imm};
-                        if (should_prune(to,ti,3)) continue;
-                        targets_this++; total_targets++;
                         BatchTarget bt;
-                        bt.ops[0]=to[0]; bt.ops[1]=to[1]; bt.ops[2]=to[2];
-                        bt.imms[0]=ti[0]; bt.imms[1]=ti[1]; bt.imms[2]=ti[2];
-                        bt.len=3; bt.bytes=byte_size(to[0])+byte_size(to[1])+byte_size(to[2]);
+                        if (!filter_target(filter,bt,to,ti,3)) continue;
+                        targets_this++; total_targets++;
                         batch.push_back(bt);
-                        if ((int)batch.size()>=BATCH_SIZE) flush_batch();
+                        if ((int)batch.size()>=BATCH_SIZE) { flush_batch(); maybe_checkpoint(3, i0, i1, i2+1); }
                     }
                 }
             }
         }
         flush_batch();
+        tm_gauge(TM_G_DONE, first_op_end-first_op_start);
         time_t len_end=time(NULL);
         fprintf(stderr,"  Length %d done: %lu targets, %lu found (%lds)\n",
             target_len,(unsigned long)targets_this,(unsigned long)(total_found-found_before),(long)(len_end-len_start));
+        if (resume_path) {
+            targets_this=0; found_before=total_found; len_start=len_end;
+            save_checkpoint(target_len+1, first_op_start, 0, 0, target_len==max_target);
+        }
     }
 
+    // the last status shows the writer drained
+    bool flushed = writer.flush();
+    tm_gauge(TM_G_WRITER_BYTES, (int64_t)writer.pending());
+    tm_stop();
+    if (!flushed) { fprintf(stderr,"Error: cannot write results to stdout\n"); return 1; }
     time_t end_time=time(NULL);
     fprintf(stderr,"\n=== DONE (v2 batched pipeline) ===\n");
     fprintf(stderr,"Targets tested:     %lu\n",(unsigned long)total_targets);
+    filter_report(filter);
+    if (known_path)
+        fprintf(stderr,"Subsumed targets:   %lu%s\n",(unsigned long)filter.subsumed,keep_subsumed ? " (kept)" : "");
     fprintf(stderr,"Batches processed:  %lu\n",(unsigned long)total_batches);
     fprintf(stderr,"QuickCheck hits:    %lu\n",(unsigned long)total_qc_hits);
     fprintf(stderr,"MidCheck survivors: %lu\n",(unsigned long)total_mid_hits);
+    if (learn) learned_report(learned);
     fprintf(stderr,"ExhaustiveCheck:    %lu (GPU:%lu CPU:%lu)\n",(unsigned long)(total_exhaust+total_cpu_exhaust),(unsigned long)total_exhaust,(unsigned long)total_cpu_exhaust);
     fprintf(stderr,"Results found:      %lu\n",(unsigned long)total_found);
     fprintf(stderr,"Total time:         %lds\n",(long)(end_time-start_time));
-    if (total_qc_hits>0) fprintf(stderr,"False positive rate: %.1f%% (QC->confirmed)\n",100.0*(1.0-(double)total_found/total_qc_hits));
+    if (total_qc_hits>0 && !symmetry) fprintf(stderr,"False positive rate: %.1f%% (QC->confirmed)\n",100.0*(1.0-(double)total_found/total_qc_hits));
 
     free(h_fps); free(h_mfps); free(h_bitmap);
     free(h_mpairs); free(h_msurv); free(h_epairs); free(h_eresults);
     cudaFree(d_candidates); cudaFree(d_target_fps); cudaFree(d_target_mid_fps);
     cudaFree(d_hit_bitmap); cudaFree(d_mid_pairs); cudaFree(d_mid_survived);
     cudaFree(d_exhaust_pairs); cudaFree(d_exhaust_results);
+    if (learn && learned_path && !learned_save(learned, learned_path)) {
+        fprintf(stderr,"Error: cannot write learned vectors to %s\n", learned_path);
+        return 1;
+    }
     return 0;
 }
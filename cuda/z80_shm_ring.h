@@ -0,0 +1,228 @@
+// Shared-memory message rings between a server and its client process.
+//
+// The client creates the region (a memfd, or any file it can map shared),
+// hands the fd to the server child and names it in the handshake; after
+// that, requests and responses travel through two single-producer,
+// single-consumer rings in the region instead of the pipes. Sending is a
+// copy into the ring and a store; a futex wake is only issued when the other
+// side is asleep, and a side that finds its ring empty (or full) spins
+// briefly before it sleeps, so a busy client and server exchange small
+// messages without a system call.
+//
+// Region layout (little-endian uint32 words, byte offsets):
+//   0      magic SHM_MAGIC, version, ring_bytes
+//   64     ring 0 control: client -> server
+//   320    ring 1 control: server -> client
+//   4096   ring 0 data, ring_bytes; then ring 1 data, ring_bytes
+// Ring control, one cache line per writer:
+//   +0 head (producer's byte count)   +4 closed (set by the producer)
+//   +64 tail (consumer's byte count)
+//   +128 data_seq, data_waiters, data_efd     (consumer sleeps on data_seq)
+//   +192 space_seq, space_waiters, space_efd  (producer sleeps on space_seq)
+// A sleeper that should not block in FUTEX_WAIT (a Go client: it would hold
+// up the runtime's scheduler) sets the efd word to an eventfd, numbered as
+// in the other process, which then wakes it by writing the eventfd instead.
+// Counts run mod 2^32 over a power-of-two ring. A record is a uint32 word
+// (length, SHM_MORE if the message continues in the next record) and the
+// payload, padded to 8 bytes; SHM_WRAP means "continue at the ring's start".
+// Records are at most half the ring, so longer messages are fragmented.
+//
+// A producer marks its ring closed when it is done; the consumer sees end of
+// stream once the ring is also empty. A side that dies cannot do that, so
+// waits time out every SHM_POLL_MS and ask the peer check (a pipe to the peer
+// that hangs up when it exits) whether to give up.
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SHM_MAGIC     0x5248535Au   // "ZSHR"
+#define SHM_VERSION   1
+#define SHM_DATA_OFF  4096
+#define SHM_MIN_RING  (64u << 10)
+#define SHM_MAX_RING  (1u << 30)
+#define SHM_MORE      0x80000000u
+#define SHM_WRAP      0xFFFFFFFFu
+#define SHM_POLL_MS   100
+
+// Ring control words (uint32 index into the control block)
+// (a sequence word is followed by its waiters and efd words)
+enum { SHM_HEAD = 0, SHM_CLOSED = 1, SHM_TAIL = 16, SHM_DATA_SEQ = 32, SHM_SPACE_SEQ = 48 };
+
+struct ShmRing {
+    uint32_t* ctl = nullptr;
+    uint8_t* data = nullptr;
+    uint32_t cap = 0;
+    int peer_fd = -1;      // polled on timeouts; hangup or error: peer gone
+    bool peer_out = false; // peer_fd is ours to write (else to read)
+};
+
+struct ShmRegion {
+    void* base = nullptr;
+    size_t size = 0;
+    ShmRing tx, rx;
+};
+
+static size_t shm_region_size(uint32_t ring_bytes) { return SHM_DATA_OFF + 2 * (size_t)ring_bytes; }
+
+static bool shm_ring_bytes_ok(uint32_t ring_bytes) {
+    return ring_bytes >= SHM_MIN_RING && ring_bytes <= SHM_MAX_RING && (ring_bytes & (ring_bytes - 1)) == 0;
+}
+
+static inline uint32_t shm_load(const uint32_t* p) { return __atomic_load_n(p, __ATOMIC_SEQ_CST); }
+static inline void shm_store(uint32_t* p, uint32_t v) { __atomic_store_n(p, v, __ATOMIC_SEQ_CST); }
+static inline void shm_pause() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Map fd's region; the client side (server = false) also initialises it.
+static bool shm_region_map(int fd, uint32_t ring_bytes, bool server, ShmRegion &r) {
+    if (!shm_ring_bytes_ok(ring_bytes)) return false;
+    size_t size = shm_region_size(ring_bytes);
+    if (!server && ftruncate(fd, (off_t)size) != 0) return false;
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) return false;
+    uint32_t* h = (uint32_t*)base;
+    if (!server) {
+        memset(base, 0, SHM_DATA_OFF);
+        h[1] = SHM_VERSION; h[2] = ring_bytes;
+        shm_store(&h[0], SHM_MAGIC);
+    } else if (shm_load(&h[0]) != SHM_MAGIC || h[1] != SHM_VERSION || h[2] != ring_bytes) {
+        munmap(base, size);
+        return false;
+    }
+    r.base = base; r.size = size;
+    ShmRing rings[2];
+    for (int i = 0; i < 2; i++) {
+        rings[i].ctl = (uint32_t*)((uint8_t*)base + 64 + 256 * i);
+        rings[i].data = (uint8_t*)base + SHM_DATA_OFF + (size_t)ring_bytes * i;
+        rings[i].cap = ring_bytes;
+    }
+    r.tx = rings[server ? 1 : 0];
+    r.rx = rings[server ? 0 : 1];
+    return true;
+}
+
+// Client side: a fresh memfd-backed region; the fd is for the child.
+static bool shm_region_create(uint32_t ring_bytes, int &fd, ShmRegion &r) {
+    fd = (int)syscall(SYS_memfd_create, "z80-shm-ring", 0);
+    if (fd < 0) return false;
+    if (!shm_region_map(fd, ring_bytes, false, r)) { close(fd); fd = -1; return false; }
+    return true;
+}
+
+static void shm_region_unmap(ShmRegion &r) {
+    if (r.base) munmap(r.base, r.size);
+    r = ShmRegion();
+}
+
+static bool shm_peer_gone(const ShmRing &rg) {
+    if (rg.peer_fd < 0) return false;
+    struct pollfd p = {rg.peer_fd, (short)(rg.peer_out ? 0 : POLLIN), 0};
+    return poll(&p, 1, 0) > 0 && (p.revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL));
+}
+
+// Sleep on control word seq until ready(); false if the peer went away first.
+template <typename F>
+static bool shm_wait(const ShmRing &rg, int seq, F ready) {
+    static const int spins = std::thread::hardware_concurrency() > 1 ? 2000 : 0;
+    for (int i = 0; i < spins; i++) {
+        if (ready()) return true;
+        shm_pause();
+    }
+    uint32_t* w = &rg.ctl[seq];
+    while (true) {
+        uint32_t s = shm_load(w);
+        if (ready()) return true;
+        __atomic_fetch_add(&w[1], 1, __ATOMIC_SEQ_CST);
+        struct timespec ts = {0, SHM_POLL_MS * 1000000L};
+        long rc = syscall(SYS_futex, w, FUTEX_WAIT, s, &ts, nullptr, 0);
+        __atomic_fetch_sub(&w[1], 1, __ATOMIC_SEQ_CST);
+        if (rc != 0 && errno == ETIMEDOUT && !ready() && shm_peer_gone(rg)) return false;
+    }
+}
+
+static void shm_wake(const ShmRing &rg, int seq) {
+    uint32_t* w = &rg.ctl[seq];
+    __atomic_fetch_add(w, 1, __ATOMIC_SEQ_CST);
+    if (!shm_load(&w[1])) return;
+    if (uint32_t efd = shm_load(&w[2])) {
+        uint64_t one = 1;
+        if (write((int)efd, &one, sizeof(one)) < 0) {}   // only fails if the sleeper is gone
+    } else {
+        syscall(SYS_futex, w, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+// Producer: one message, fragmented if it is over half the ring. False if
+// the ring is closed or the peer is gone.
+static bool shm_send(ShmRing &rg, const void* p, size_t n) {
+    uint32_t* ctl = rg.ctl;
+    const uint8_t* src = (const uint8_t*)p;
+    size_t max_frag = rg.cap / 2 - 8;
+    do {
+        uint32_t frag = (uint32_t)std::min(n, max_frag);
+        uint32_t rec = (4 + frag + 7) & ~7u;
+        uint32_t head = ctl[SHM_HEAD], pos = head & (rg.cap - 1);
+        uint32_t skip = rg.cap - pos < rec ? rg.cap - pos : 0;
+        bool ok = shm_wait(rg, SHM_SPACE_SEQ, [&] {
+            return shm_load(&ctl[SHM_CLOSED]) || rg.cap - (head - shm_load(&ctl[SHM_TAIL])) >= skip + rec;
+        });
+        if (!ok || shm_load(&ctl[SHM_CLOSED])) return false;
+        if (skip) { *(uint32_t*)&rg.data[pos] = SHM_WRAP; pos = 0; }
+        *(uint32_t*)&rg.data[pos] = frag | (n > frag ? SHM_MORE : 0);
+        memcpy(&rg.data[pos + 4], src, frag);
+        shm_store(&ctl[SHM_HEAD], head + skip + rec);
+        shm_wake(rg, SHM_DATA_SEQ);
+        src += frag; n -= frag;
+    } while (n);
+    return true;
+}
+
+// Producer: no more messages.
+static void shm_close(ShmRing &rg) {
+    shm_store(&rg.ctl[SHM_CLOSED], 1);
+    shm_wake(rg, SHM_DATA_SEQ);
+    shm_wake(rg, SHM_SPACE_SEQ);
+}
+
+// Consumer: the next message into out. 1, 0 at end of stream, -1 if the
+// stream ends inside a message or the peer is gone.
+static int shm_recv(ShmRing &rg, std::string &out) {
+    uint32_t* ctl = rg.ctl;
+    out.clear();
+    while (true) {
+        uint32_t tail = ctl[SHM_TAIL];
+        bool ok = shm_wait(rg, SHM_DATA_SEQ, [&] {
+            return shm_load(&ctl[SHM_HEAD]) != tail || shm_load(&ctl[SHM_CLOSED]);
+        });
+        if (!ok) return -1;
+        if (shm_load(&ctl[SHM_HEAD]) == tail) return out.empty() ? 0 : -1;
+        uint32_t pos = tail & (rg.cap - 1);
+        uint32_t w = *(const uint32_t*)&rg.data[pos];
+        uint32_t adv;
+        if (w == SHM_WRAP) {
+            adv = rg.cap - pos;
+        } else {
+            uint32_t len = w & ~SHM_MORE;
+            out.append((const char*)&rg.data[pos + 4], len);
+            adv = (4 + len + 7) & ~7u;
+        }
+        shm_store(&ctl[SHM_TAIL], tail + adv);
+        shm_wake(rg, SHM_SPACE_SEQ);
+        if (w != SHM_WRAP && !(w & SHM_MORE)) return 1;
+    }
+}
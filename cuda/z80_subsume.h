@@ -0,0 +1,387 @@
+// Subsumption pruning against already-discovered rules (--known-rules), and
+// the enumerator's target filter that applies it.
+//
+// A length-3 target with a length-2 window that a known rule already
+// shortens is itself shortened by applying that rule, so a 3->1 rule for it
+// adds little to the output. --known-rules loads a previous run's length-2
+// rules (its JSONL, or a --binary record stream) into an open-addressed set
+// keyed on the window's two inst_keys, and the enumerator drops every
+// length-3 target containing one before QuickCheck. --keep-subsumed still
+// searches them (and only counts them) for completeness runs.
+//
+// A rule found with dead flags D applies inside the target only where D is
+// dead: rules with D outside the run's --dead-flags are not loaded, and a
+// rule for the leading window also needs the third instruction not to read
+// D. Of several rules for one window the set keeps the one with the fewest
+// dead flags.
+//
+// Under --symmetry the set is closed under register renaming (rules of 8-bit
+// instructions only; pair replacements never match a window writing at most
+// one of B..L), so an orbit representative is subsumed exactly when every
+// renaming it stands for is.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_results.h"
+#include "z80_symmetry.h"
+
+#define KNOWN_EMPTY (~0ull)
+
+struct KnownRules {
+    std::vector<uint64_t> keys;   // inst_key(first) << 32 | inst_key(second); KNOWN_EMPTY if free
+    std::vector<uint8_t> dead;    // dead flags of the window's rule
+    std::vector<uint64_t> sorted; // the same keys in order: windows by first instruction
+    uint64_t mask = 0;
+    size_t count = 0;
+    uint64_t hash = 0;            // of the windows and their dead flags (checkpoints)
+};
+
+static uint64_t known_key(const uint16_t* ops, const uint16_t* imms) {
+    return (uint64_t)inst_key(ops[0], imms[0]) << 32 | inst_key(ops[1], imms[1]);
+}
+
+static size_t known_slot(const KnownRules &kr, uint64_t key) {
+    return (size_t)(((key ^ key >> 29) * 0x9E3779B97F4A7C15ull) >> 20 & kr.mask);
+}
+
+// Dead flags of the known rule for a window, or -1 if none.
+static int known_find(const KnownRules &kr, const uint16_t* ops, const uint16_t* imms) {
+    if (!kr.count) return -1;
+    uint64_t key = known_key(ops, imms);
+    for (size_t s = known_slot(kr, key); ; s = (s + 1) & kr.mask) {
+        if (kr.keys[s] == key) return kr.dead[s];
+        if (kr.keys[s] == KNOWN_EMPTY) return -1;
+    }
+}
+
+static void known_build(KnownRules &kr, std::vector<std::pair<uint64_t, uint8_t>> &rules) {
+    std::sort(rules.begin(), rules.end(), [](const std::pair<uint64_t, uint8_t> &a, const std::pair<uint64_t, uint8_t> &b) {
+        if (a.first != b.first) return a.first < b.first;
+        return __builtin_popcount(a.second) < __builtin_popcount(b.second);
+    });
+    rules.erase(std::unique(rules.begin(), rules.end(), [](const std::pair<uint64_t, uint8_t> &a,
+                                                           const std::pair<uint64_t, uint8_t> &b) {
+        return a.first == b.first;
+    }), rules.end());
+    size_t size = 1024;
+    while (size < rules.size() * 2) size <<= 1;
+    kr.keys.assign(size, KNOWN_EMPTY);
+    kr.dead.assign(size, 0);
+    kr.mask = size - 1;
+    kr.count = rules.size();
+    kr.sorted.resize(rules.size());
+    for (size_t i = 0; i < rules.size(); i++) kr.sorted[i] = rules[i].first;
+    kr.hash = 14695981039346656037ull;
+    for (const auto &r : rules) {
+        kr.hash = (kr.hash ^ r.first ^ (uint64_t)r.second << 56) * 1099511628211ull;
+        size_t s = known_slot(kr, r.first);
+        while (kr.keys[s] != KNOWN_EMPTY) s = (s + 1) & kr.mask;
+        kr.keys[s] = r.first;
+        kr.dead[s] = r.second;
+    }
+}
+
+// Windows collected while loading. c_op is the rule's replacement when that
+// is a single instruction (0xFFFF otherwise), for the renaming closure.
+struct KnownLoader {
+    std::vector<std::pair<uint64_t, uint8_t>> rules;
+    uint8_t run_dead;
+    bool closure;
+    uint64_t read = 0, dead_mismatch = 0, templates = 0;
+
+    void add(const uint16_t* ops, const uint16_t* imms, uint16_t c_op, uint8_t dead) {
+        rules.push_back({known_key(ops, imms), dead});
+        if (!closure || ops[0] >= SYM_OPS || ops[1] >= SYM_OPS || c_op >= SYM_OPS) return;
+        uint16_t seq[3] = {ops[0], ops[1], c_op}, canon[3];
+        int nregs = sym_canonicalize(seq, 3, canon);
+        sym_for_each_image(canon, 3, nregs, [&](const uint16_t* img, const uint8_t*) {
+            if (img[0] < SYM_OPS && img[1] < SYM_OPS) rules.push_back({known_key(img, imms), dead});
+            return true;
+        });
+    }
+};
+
+// Instruction text as disasm prints it -> instruction.
+static std::unordered_map<std::string, Inst> known_text_map() {
+    std::unordered_map<std::string, Inst> m;
+    char d[64];
+    for (const Inst &x : enumerate_instructions_8()) {
+        disasm(x.op, x.imm, d, sizeof(d));
+        m[d] = x;
+    }
+    return m;
+}
+
+// Value of "field":"..." in a JSONL line.
+static bool known_json_str(const std::string &line, const char* field, std::string &out) {
+    std::string pat = std::string("\"") + field + "\":\"";
+    size_t p = line.find(pat);
+    if (p == std::string::npos) return false;
+    p += pat.size();
+    size_t e = line.find('"', p);
+    if (e == std::string::npos) return false;
+    out.assign(line, p, e - p);
+    return true;
+}
+
+static bool known_load_jsonl(KnownLoader &ld, FILE* f, const char* path) {
+    std::unordered_map<std::string, Inst> text = known_text_map();
+    std::string line, src, rep, df;
+    char buf[1024];
+    uint64_t bad = 0;
+    while (fgets(buf, sizeof(buf), f)) {
+        line = buf;
+        if (line.find_first_not_of(" \t\r\n") == std::string::npos) continue;
+        ld.read++;
+        if (line.find("\"template\":true") != std::string::npos) { ld.templates++; continue; }   // --symbolic-imm
+        if (!known_json_str(line, "source_asm", src) || !known_json_str(line, "replacement_asm", rep)) { bad++; continue; }
+        size_t sep = src.find(" : ");
+        if (sep == std::string::npos || src.find(" : ", sep + 3) != std::string::npos) continue;   // not length 2
+        auto a = text.find(src.substr(0, sep)), b = text.find(src.substr(sep + 3));
+        if (a == text.end() || b == text.end()) { bad++; continue; }
+        uint8_t dead = known_json_str(line, "dead_flags", df) ? (uint8_t)strtoul(df.c_str(), NULL, 0) : 0;
+        if (dead & ~ld.run_dead) { ld.dead_mismatch++; continue; }
+        auto c = text.find(rep);
+        uint16_t ops[2] = {a->second.op, b->second.op}, imms[2] = {a->second.imm, b->second.imm};
+        ld.add(ops, imms, c == text.end() ? 0xFFFF : c->second.op, dead);
+    }
+    if (bad) fprintf(stderr, "%s: %lu lines not understood, ignored\n", path, (unsigned long)bad);
+    return true;
+}
+
+static bool known_load_binary(KnownLoader &ld, FILE* f, const char* path) {
+    ResultFileHeader h;
+    if (fread(&h, 1, sizeof(h), f) != sizeof(h) || h.version != RESULT_VERSION ||
+        h.record_size != sizeof(ResultRecord) || h.op_count != OP_COUNT) {
+        fprintf(stderr, "%s: unsupported result stream (version, record size or opcode count differ)\n", path);
+        return false;
+    }
+    ResultRecord r;
+    while (fread(&r, 1, sizeof(r), f) == sizeof(r)) {
+        ld.read++;
+        if (r.t_len != 2) continue;
+        if (r.dead_flags & ~ld.run_dead) { ld.dead_mismatch++; continue; }
+        ld.add(r.t_ops, r.t_imms, r.c_len == 1 ? r.c_ops[0] : 0xFFFF, r.dead_flags);
+    }
+    return true;
+}
+
+// Load the length-2 rules of a driver's output (JSONL or --binary records)
+// that hold under run_dead. closure: also every register renaming of them
+// (needs sym_init()).
+static bool known_load(KnownRules &kr, const char* path, uint8_t run_dead, bool closure) {
+    FILE* f = fopen(path, "rb");
+    if (!f) { perror(path); return false; }
+    KnownLoader ld;
+    ld.run_dead = run_dead;
+    ld.closure = closure;
+    char magic[8] = {};
+    size_t got = fread(magic, 1, sizeof(magic), f);
+    rewind(f);
+    bool ok = got == sizeof(magic) && !memcmp(magic, RESULT_MAGIC, 8) ? known_load_binary(ld, f, path)
+                                                                     : known_load_jsonl(ld, f, path);
+    fclose(f);
+    if (!ok) return false;
+    known_build(kr, ld.rules);
+    fprintf(stderr, "Known rules: %s (%lu rules, %lu length-2 windows%s, %lu need dead flags outside 0x%02X)\n",
+            path, (unsigned long)ld.read, (unsigned long)kr.count, closure ? " with renamings" : "",
+            (unsigned long)ld.dead_mismatch, run_dead);
+    if (ld.templates)
+        fprintf(stderr, "Known rules: %lu templates ignored (only concrete rules subsume)\n", (unsigned long)ld.templates);
+    return true;
+}
+
+// Whether a known rule shortens a length-2 window of the target.
+static bool known_subsumes(const KnownRules &kr, const uint16_t* ops, const uint16_t* imms, int n) {
+    if (n < 3) return false;
+    for (int i = n - 2; i >= 0; i--) {
+        int d = known_find(kr, ops + i, imms + i);
+        if (d < 0) continue;
+        if (i + 2 == n || !(d & h_flags_read(ops[i + 2]))) return true;
+    }
+    return false;
+}
+
+// What the enumerator searches: make_batch_target's pruning and symmetry
+// reduction, whole-sequence liveness (dead_instruction under the run's dead
+// flags, from length 3 on), then subsumption by known rules. pruned[] counts the targets each
+// PruneReason removed, including whole subtrees skipped by filter_prefix.
+//
+// The enumerator varies the last instruction fastest, so the filter keeps the
+// leading window's lookup and a bitmap of the instructions that complete a
+// known window after the middle one; a target then costs one bit test
+// instead of two probes into a table far larger than the cache.
+struct TargetFilter {
+    bool symmetry = false;
+    uint8_t dead_flags = 0;
+    const KnownRules* known = nullptr;   // --known-rules, if given
+    bool keep_subsumed = false;          // --keep-subsumed: count, but still search
+    uint64_t subsumed = 0;
+    uint64_t pruned[PRUNE_REASONS] = {};
+
+    uint32_t lead_first = ~0u, lead_second = ~0u;
+    int lead_dead = -1;
+    uint32_t mid = ~0u;
+    std::vector<uint64_t> mid_bits;      // op << 8 | imm of instructions after mid
+    std::vector<uint32_t> mid_set;       // bits set, to clear on the next mid
+};
+
+static bool filter_subsumes(TargetFilter &f, const uint16_t* ops, const uint16_t* imms, int n) {
+    if (n != 3 || imms[2] > 0xFF) return known_subsumes(*f.known, ops, imms, n);
+    const KnownRules &kr = *f.known;
+    uint32_t k1 = inst_key(ops[1], imms[1]);
+    if (k1 != f.mid) {
+        if (f.mid_bits.empty()) f.mid_bits.assign((OP_COUNT << 8) / 64 + 1, 0);
+        for (uint32_t b : f.mid_set) f.mid_bits[b >> 6] = 0;
+        f.mid_set.clear();
+        uint64_t lo = (uint64_t)k1 << 32;
+        for (auto it = std::lower_bound(kr.sorted.begin(), kr.sorted.end(), lo);
+             it != kr.sorted.end() && *it >> 32 == k1; ++it) {
+            uint32_t b = (uint32_t)(*it >> 16 & 0xFFFF) << 8 | (uint32_t)(*it & 0xFF);
+            if ((*it & 0xFF00) == 0) { f.mid_bits[b >> 6] |= 1ull << (b & 63); f.mid_set.push_back(b); }
+        }
+        f.mid = k1;
+    }
+    uint32_t b = (uint32_t)ops[2] << 8 | imms[2];
+    if (f.mid_bits[b >> 6] >> (b & 63) & 1) return true;
+    uint32_t k0 = inst_key(ops[0], imms[0]);
+    if (k0 != f.lead_first || k1 != f.lead_second) {
+        f.lead_first = k0; f.lead_second = k1;
+        f.lead_dead = known_find(kr, ops, imms);
+    }
+    return f.lead_dead >= 0 && !(f.lead_dead & h_flags_read(ops[2]));
+}
+
+// Whether any extension of a length-n prefix can pass filter_target; if not,
+// its `subtree` targets are counted as pruned. The pruning rules only look
+// back from each position, and an instruction dead with everything live
+// after the prefix stays dead whatever follows, so a pruned prefix prunes its
+// whole subtree and depth-first enumeration skips it at once. Under
+// --symmetry a representative the trace form drops can stand for renamings
+// it keeps, so only the local rules apply there.
+static bool filter_prefix(TargetFilter &f, const uint16_t* ops, const uint16_t* imms, int n, uint64_t subtree) {
+    int r = f.symmetry ? prune_reason_local(ops, imms, n) : prune_reason(ops, imms, n);
+    if (r == PRUNE_NONE && dead_instruction(ops, n, 0) >= 0) r = PRUNE_DEAD_INST;
+    if (r == PRUNE_NONE) return true;
+    f.pruned[r] += subtree;
+    return false;
+}
+
+static bool filter_target(TargetFilter &f, BatchTarget &bt, const uint16_t* ops, const uint16_t* imms, int n) {
+    int r;
+    if (!make_batch_target(bt, ops, imms, n, f.symmetry, &r)) { f.pruned[r]++; return false; }
+    // Length 2 keeps its dead instructions: "CP n : AND 0xFF -> AND A" is the
+    // only place a one-instruction rewrite turns up. A longer target with one
+    // is covered by the length-2 rules once the instruction is deleted.
+    if (n >= 3 && dead_instruction(ops, n, f.dead_flags) >= 0) { f.pruned[PRUNE_DEAD_INST]++; return false; }
+    if (f.known && filter_subsumes(f, ops, imms, n)) {
+        f.subsumed++;
+        return f.keep_subsumed;
+    }
+    return true;
+}
+
+// "Pruned targets:" summary line with the per-reason breakdown.
+static void filter_report(const TargetFilter &f) {
+    uint64_t total = 0;
+    std::string why;
+    char part[64];
+    for (int r = PRUNE_NONE + 1; r < PRUNE_REASONS; r++) {
+        if (!f.pruned[r]) continue;
+        total += f.pruned[r];
+        snprintf(part, sizeof(part), "%s%s %lu", why.empty() ? "" : ", ", prune_reason_names[r], (unsigned long)f.pruned[r]);
+        why += part;
+    }
+    fprintf(stderr, "Pruned targets:     %lu%s%s%s\n", (unsigned long)total,
+            why.empty() ? "" : " (", why.c_str(), why.empty() ? "" : ")");
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// Rules load the same from JSONL and binary records, and every length-3
+// target the set drops reduces by its window's rule. Returns the failure count.
+static long known_verify(const std::vector<Inst> &insts, std::mt19937 &rng) {
+    long bad=0, checked=0, dropped=0;
+    size_t n=insts.size();
+    for (uint8_t df : {(uint8_t)0x00, (uint8_t)0xFF}) {
+        CandTable ct;
+        build_cand_table(ct, insts, df);
+        struct Rule { uint16_t ops[2], imms[2], cop, cimm; };
+        std::vector<Rule> rules;
+        std::string jsonl, bin;
+        ResultFileHeader rh;
+        result_header_init(rh, "z80search_cpu", df);
+        bin.append((const char*)&rh, sizeof(rh));
+        for (long tries=0; rules.size()<40 && tries<200000; tries++) {
+            BatchTarget bt;
+            const Inst &a=insts[rng()%n], &b=insts[rng()%n];
+            uint16_t to[2]={a.op,b.op}, ti[2]={a.imm,b.imm};
+            if (!make_batch_target(bt,to,ti,2,false)) continue;
+            uint32_t hits[256];
+            uint8_t fp[FP_LEN];
+            h_fingerprint(bt.ops,bt.imms,2,fp);
+            int nh=fp_index_probe(ct.qc,fp,bt.bytes,hits,256);
+            for (int k=0; k<nh; k++) {
+                uint16_t co[1]={ct.insts[hits[k]].op}, ci[1]={ct.insts[hits[k]].imm};
+                if (!h_midcheck(to,ti,2,co,ci,1,df) || !bdd_exhaustive_check(to,ti,2,co,ci,1,df)) continue;
+                rules.push_back({{to[0],to[1]},{ti[0],ti[1]},co[0],ci[0]});
+                append_result(jsonl, false, bt, co, ci, 1, df);
+                append_result(bin, true, bt, co, ci, 1, df);
+                break;
+            }
+        }
+        KnownRules kj, kb, none;
+        for (int form=0; form<2; form++) {
+            FILE* f=tmpfile();
+            const std::string &data = form ? bin : jsonl;
+            fwrite(data.data(), 1, data.size(), f);
+            fflush(f);
+            char path[64];
+            snprintf(path, sizeof(path), "/proc/self/fd/%d", fileno(f));
+            if (!known_load(form ? kb : kj, path, df, false)) bad++;
+            if (df && (!known_load(none, path, 0x00, false) || none.count)) bad++;   // rules need dead flags
+            fclose(f);
+        }
+        if (kj.count!=kb.count || kj.keys!=kb.keys || kj.dead!=kb.dead) bad++;
+        TargetFilter tf;
+        tf.known=&kj;
+        for (const Rule &r : rules) {
+            for (int k=0; k<20; k++) {
+                const Inst &x=insts[rng()%n];
+                bool tail=k&1;
+                uint16_t to[3], ti[3], co[2], ci[2];
+                int w=tail?1:0, o=tail?0:2;
+                to[w]=r.ops[0]; ti[w]=r.imms[0]; to[w+1]=r.ops[1]; ti[w+1]=r.imms[1];
+                to[o]=x.op; ti[o]=x.imm;
+                co[tail]=r.cop; ci[tail]=r.cimm; co[!tail]=x.op; ci[!tail]=x.imm;
+                bool want=tail || !(df & h_flags_read(x.op));   // else only another window can drop it
+                checked++;
+                bool got=known_subsumes(kj,to,ti,3);
+                if (filter_subsumes(tf,to,ti,3)!=got) bad++;   // the enumerator's cached path
+                if (!want) { if (got && known_find(kj,to+1,ti+1)<0) bad++; continue; }
+                if (!got) { bad++; continue; }
+                dropped++;
+                if (!bdd_exhaustive_check(to,ti,3,co,ci,2,df) && bad++<5) {
+                    char d[3][64];
+                    for (int j=0; j<3; j++) disasm(to[j],ti[j],d[j],sizeof(d[j]));
+                    fprintf(stderr,"  SUBSUMED BUT NOT REDUCIBLE: %s : %s : %s (dead 0x%02X)\n", d[0], d[1], d[2], df);
+                }
+            }
+        }
+    }
+    fprintf(stderr,"Subsumption: %ld length-3 targets around known windows, %ld dropped, %ld failures\n", checked, dropped, bad);
+    return bad;
+}
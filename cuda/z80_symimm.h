@@ -0,0 +1,391 @@
+// Symbolic immediates for rule search (--symbolic-imm).
+//
+// The plain enumeration expands every imm8 instruction into 256 concrete
+// ones and leaves LD rr,nn out, although most rules hold for every value of
+// the operand or a simple range of them. In this mode the enumerator takes
+// each opcode once (enumerate_instructions_sym) and the immediates of a
+// target are free symbols n, m, k (nn, mm, kk for 16 bits), numbered in
+// textual order. A symbolic target runs the same three stages with the
+// symbols as extra inputs:
+//   QuickCheck / MidCheck: every test vector also binds the symbols
+//     (symimm_vals), against the concrete candidates plus one candidate per
+//     immediate opcode and symbol, so "XOR n : XOR m"-style replacements that
+//     reuse an operand are found as well;
+//   ExhaustiveCheck: bdd_prove_symbolic, with the symbols' bits as BDD
+//     variables, quantifies the machine state out and leaves the operand
+//     values for which the pair is equivalent.
+// Rules that hold for every value are written as templates. A target with one
+// 8-bit symbol also gets the concrete QuickCheck of each of its 256
+// instances: a replacement hit for several values is proved for its
+// condition ("imm_condition"), and only the instances with a hit that no
+// template explains are expanded and searched as usual, so for these targets
+// the output is exactly the plain run's with template instances folded.
+// With more symbols a template holding for every value covers the target,
+// dropping instance-specific alternatives to it; otherwise every instance is
+// expanded. Targets with a 16-bit symbol have no concrete expansion.
+//
+// Symbols are independent: "XOR n : XOR n" (both operands equal) is not a
+// template, its instances are found concretely.
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_fp_index.h"
+#include "z80_symmetry.h"
+
+#define SYMIMM_MAX_RANGES 8   // longer conditions are left to concrete expansion
+
+// Symbol values bound by each QuickCheck vector, then each MidCheck vector.
+static uint16_t symimm_vals[NUM_VECTORS + MID_VECTORS][IMM_SYMS];
+
+// Fill symimm_vals: edge values first, then pseudo-random ones; the symbols of
+// one vector never share a low byte, so independent symbols are not mistaken
+// for equal ones.
+static void symimm_init() {
+    static const uint16_t edges[4][IMM_SYMS] = {
+        {0x0000, 0xFFFF, 0x0180}, {0xFFFF, 0x0001, 0x7F00}, {0x8080, 0x7F01, 0x00FE}, {0x0101, 0x8000, 0xFF7F}};
+    uint64_t x = 0x9E3779B97F4A7C15ull;
+    for (int v = 0; v < NUM_VECTORS + MID_VECTORS; v++) {
+        int row = v < NUM_VECTORS ? v : v - NUM_VECTORS;
+        for (int i = 0; i < IMM_SYMS; i++) {
+            uint16_t val;
+            bool clash;
+            do {
+                if (row < 4) val = edges[row][i];
+                else {
+                    x += 0x9E3779B97F4A7C15ull;
+                    uint64_t z = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+                    val = (uint16_t)((z ^ (z >> 27)) >> 16);
+                }
+                clash = false;
+                for (int j = 0; j < i; j++) clash |= (uint8_t)symimm_vals[v][j] == (uint8_t)val;
+            } while (clash && row >= 4);
+            symimm_vals[v][i] = val;
+        }
+    }
+}
+
+static int imm_bits(uint16_t op) { return is_imm16(op) ? 16 : is_imm8(op) ? 8 : 0; }
+
+// Number the symbolic operands of a target in order (imms IMM_SYM + i);
+// returns how many there are, bits[i] gets each one's width.
+static int symimm_number(BatchTarget &bt, int bits[IMM_SYMS]) {
+    int ns = 0;
+    for (int j = 0; j < bt.len; j++)
+        if (bt.imms[j] >= IMM_SYM) { bits[ns] = imm_bits(bt.ops[j]); bt.imms[j] = (uint16_t)(IMM_SYM + ns++); }
+    return ns;
+}
+
+// Concrete immediates for one binding of the symbols.
+static void symimm_bind(const uint16_t* ops, const uint16_t* imms, int n, const uint16_t* vals, uint16_t* out) {
+    for (int j = 0; j < n; j++)
+        out[j] = imms[j] < IMM_SYM ? imms[j] : (uint16_t)(vals[imms[j] - IMM_SYM] & (is_imm16(ops[j]) ? 0xFFFF : 0xFF));
+}
+
+// Fingerprint (A F B C D E H L SPhi SPlo per vector) with vector v binding
+// the symbols to vals[v].
+static void symimm_fingerprint(const Z80State* vecs, const uint16_t (*vals)[IMM_SYMS], int nvec,
+                               const uint16_t* ops, const uint16_t* imms, int n, uint8_t* fp) {
+    uint16_t b[3];
+    for (int v = 0; v < nvec; v++) {
+        Z80State s = vecs[v];
+        symimm_bind(ops, imms, n, vals[v], b);
+        h_exec_seq(s, ops, b, n);
+        uint8_t* o = fp + v * FP_SIZE;
+        memcpy(o, s.r, 8);
+        o[8] = (uint8_t)(s.sp >> 8); o[9] = (uint8_t)s.sp;
+    }
+}
+
+// Candidates: the concrete instruction set, then every immediate opcode once
+// per symbol.
+struct SymImmTable {
+    std::vector<Inst> insts;
+    FpIndex qc;
+    std::vector<uint8_t> mfps;    // count * MID_FP_LEN, dead flags masked
+    uint8_t dead_flags = 0;
+    bool no_exhaust = false;
+};
+
+static void symimm_mask(uint8_t* fp, int nvec, uint8_t dead_flags) {
+    for (int v = 0; v < nvec; v++) fp[v * FP_SIZE + 1] &= (uint8_t)~dead_flags;
+}
+
+static void symimm_build_table(SymImmTable &t, uint8_t dead_flags, bool no_exhaust) {
+    t.insts = enumerate_instructions_8();
+    for (uint16_t op = 0; op < OP_COUNT; op++)
+        if (imm_bits(op))
+            for (int i = 0; i < IMM_SYMS; i++) t.insts.push_back({op, (uint16_t)(IMM_SYM + i)});
+    uint32_t count = (uint32_t)t.insts.size();
+    std::vector<uint8_t> fps((size_t)count * FP_LEN), bytes(count);
+    t.mfps.resize((size_t)count * MID_FP_LEN);
+    int stand_in = dead_stand_in(t.insts, dead_flags);
+    for (uint32_t ci = 0; ci < count; ci++) {
+        uint16_t co[1] = {t.insts[ci].op}, cm[1] = {t.insts[ci].imm};
+        symimm_fingerprint(h_test_vectors, symimm_vals, NUM_VECTORS, co, cm, 1, &fps[(size_t)ci * FP_LEN]);
+        symimm_fingerprint(h_mid_vectors, symimm_vals + NUM_VECTORS, MID_VECTORS, co, cm, 1, &t.mfps[(size_t)ci * MID_FP_LEN]);
+        symimm_mask(&t.mfps[(size_t)ci * MID_FP_LEN], MID_VECTORS, dead_flags);
+        bytes[ci] = cand_skipped(t.insts, ci, stand_in, dead_flags) ? FP_INDEX_SKIP : (uint8_t)byte_size(co[0]);
+    }
+    fp_index_build_fps(t.qc, fps.data(), bytes.data(), count, dead_flags);
+    t.dead_flags = dead_flags;
+    t.no_exhaust = no_exhaust;
+}
+
+struct SymImmStats {
+    uint64_t targets = 0, qc_hits = 0, mid_hits = 0, proofs = 0;
+    uint64_t templates = 0, conditional = 0;
+    uint64_t covered = 0, no_hits = 0, expanded = 0;   // instances
+    uint64_t unexpanded = 0;                           // targets with a 16-bit symbol
+};
+
+// A template found for a symbolic target: the replacement, and for a
+// conditional one the values of symbol 0 it holds for.
+struct SymImmRule {
+    uint16_t op, imm;
+    std::vector<uint8_t> cond;    // empty: every value
+};
+
+// Prove a QuickCheck/MidCheck survivor; false if it is no template (never
+// equivalent, a condition that is not kept, or over the BDD budget). A
+// conditional template must use the symbol: "LD A, n : RES 0, A" ->
+// "LD A, 0x02" for n=0x02-0x03 is two concrete rules, not a template.
+static bool symimm_prove(const SymImmTable &t, const BatchTarget &bt, int ns, const int* bits,
+                         SymImmStats &st, SymImmRule &r) {
+    r.cond.clear();
+    if (t.no_exhaust) return true;
+    uint16_t co[1] = {r.op}, ci[1] = {r.imm};
+    int extra[6]; bool sweep_sp;
+    int nextra = sweep_domain(bt.ops, bt.len, co, 1, extra, &sweep_sp);
+    if (ns == 1) r.cond.resize((size_t)1 << bits[0]);
+    st.proofs++;
+    int v = bdd_prove_symbolic(bt.ops, bt.imms, bt.len, co, ci, 1, t.dead_flags, extra, nextra, sweep_sp,
+                               ns == 1 ? bits[0] : 0, ns == 1 ? r.cond.data() : nullptr);
+    if (v == 1) { r.cond.clear(); return true; }
+    if (v != 2 || ns != 1 || r.imm < IMM_SYM) return false;   // conditions are kept for one symbol only
+    int ranges = 0, values = 0;
+    for (size_t x = 0; x < r.cond.size(); x++) {
+        ranges += r.cond[x] && (x == 0 || !r.cond[x - 1]);
+        values += r.cond[x];
+    }
+    return values > 1 && ranges <= SYMIMM_MAX_RANGES;
+}
+
+static bool symimm_holds(const SymImmRule &r, uint16_t op, uint16_t imm, uint16_t x) {
+    return r.op == op && (r.imm == imm || (r.imm == IMM_SYM && imm == x)) && (r.cond.empty() || r.cond[x]);
+}
+
+// Templates for one numbered target: the symbolic QuickCheck, MidCheck and
+// proof. For one 8-bit symbol also the concrete QuickCheck of every value:
+// replacements using the value that are hit for several values are proved
+// for their condition, and covered[x] is 1 when every hit of value x is a
+// template holding for it and 2 when it has none, so expanding only the
+// values at 0 loses no rule. Otherwise covered is left empty.
+static void symimm_find(const SymImmTable &t, const BatchTarget &bt, int ns, const int* bits,
+                        SymImmStats &st, std::vector<SymImmRule> &rules, std::vector<uint8_t> &covered) {
+    rules.clear();
+    covered.clear();
+    st.targets++;
+    uint8_t fp[FP_LEN], mfp[MID_FP_LEN];
+    bool have_mfp = false;
+    symimm_fingerprint(h_test_vectors, symimm_vals, NUM_VECTORS, bt.ops, bt.imms, bt.len, fp);
+    uint32_t hits[256];
+    int nh = fp_index_probe(t.qc, fp, bt.bytes, hits, 256);
+    for (int h = 0; h < nh; h++) {
+        const Inst &c = t.insts[hits[h]];
+        if (c.imm >= IMM_SYM && (c.imm - IMM_SYM >= ns || imm_bits(c.op) != bits[c.imm - IMM_SYM])) continue;
+        st.qc_hits++;
+        if (!have_mfp) {
+            symimm_fingerprint(h_mid_vectors, symimm_vals + NUM_VECTORS, MID_VECTORS, bt.ops, bt.imms, bt.len, mfp);
+            symimm_mask(mfp, MID_VECTORS, t.dead_flags);
+            have_mfp = true;
+        }
+        if (memcmp(mfp, &t.mfps[(size_t)hits[h] * MID_FP_LEN], MID_FP_LEN) != 0) continue;
+        st.mid_hits++;
+        SymImmRule r = {c.op, c.imm, {}};
+        if (symimm_prove(t, bt, ns, bits, st, r)) rules.push_back(r);
+    }
+    if (ns != 1 || bits[0] != 8) return;
+
+    std::vector<std::pair<Inst, uint16_t>> inst_hits;   // (hit, value)
+    std::vector<std::pair<Inst, int>> votes;            // template-form replacement, values hit
+    auto vote = [&](uint16_t op, uint16_t imm) {
+        for (auto &v : votes) if (v.first.op == op && v.first.imm == imm) { v.second++; return; }
+        votes.push_back({{op, imm}, 1});
+    };
+    for (uint16_t x = 0; x < 256; x++) {
+        uint16_t vals[IMM_SYMS] = {x}, ti[3];
+        symimm_bind(bt.ops, bt.imms, bt.len, vals, ti);
+        symimm_fingerprint(h_test_vectors, symimm_vals, NUM_VECTORS, bt.ops, ti, bt.len, fp);
+        nh = fp_index_probe(t.qc, fp, bt.bytes, hits, 256);
+        for (int h = 0; h < nh; h++) {
+            const Inst &c = t.insts[hits[h]];
+            if (c.imm >= IMM_SYM) continue;
+            inst_hits.push_back({c, x});
+            bool known = false;
+            for (const SymImmRule &r : rules) known |= symimm_holds(r, c.op, c.imm, x);
+            if (!known && imm_bits(c.op) == 8 && c.imm == x) vote(c.op, IMM_SYM);
+        }
+    }
+    if (!t.no_exhaust)
+        for (auto &v : votes) {
+            if (v.second < 2) continue;
+            SymImmRule r = {v.first.op, v.first.imm, {}};
+            if (symimm_prove(t, bt, ns, bits, st, r)) rules.push_back(r);
+        }
+    covered.assign(256, 2);   // 2: no hit at all
+    for (auto &ih : inst_hits) {
+        bool known = false;
+        for (const SymImmRule &r : rules) known |= symimm_holds(r, ih.first.op, ih.first.imm, ih.second);
+        uint8_t &cv = covered[ih.second];
+        cv = !known ? 0 : cv == 2 ? 1 : cv;
+    }
+}
+
+// One template as a JSONL line: the usual fields with the symbols in the
+// assembly text, "template":true, and for a conditional one
+// "imm_condition":"n=0x01-0x7F,0x81-0xFF".
+static void symimm_append(std::string &out, const BatchTarget &bt, const int* bits, const SymImmRule &r,
+                          uint8_t dead_flags) {
+    char line[1024];
+    int n = format_result_jsonl(line, sizeof(line), bt, r.op, r.imm, dead_flags) - 2;   // drop "}\n"
+    n += snprintf(line + n, sizeof(line) - n, ",\"template\":true");
+    if (!r.cond.empty()) {
+        int w = bits[0] / 4;
+        n += snprintf(line + n, sizeof(line) - n, ",\"imm_condition\":\"%s=", imm_sym_names[bits[0] == 16][0]);
+        bool first = true;
+        for (size_t x = 0; x < r.cond.size(); x++) {
+            if (!r.cond[x] || (x && r.cond[x - 1])) continue;
+            size_t e = x;
+            while (e + 1 < r.cond.size() && r.cond[e + 1]) e++;
+            n += snprintf(line + n, sizeof(line) - n, first ? "0x%0*zX" : ",0x%0*zX", w, x);
+            if (e > x) n += snprintf(line + n, sizeof(line) - n, "-0x%0*zX", w, e);
+            first = false;
+        }
+        n += snprintf(line + n, sizeof(line) - n, "\"");
+    }
+    n += snprintf(line + n, sizeof(line) - n, "}\n");
+    out.append(line, n);
+}
+
+// Call expand(instance) for every concrete instance of the target not
+// covered (covered per value of one symbol, or by a template holding for
+// every value), symbol 0 varying slowest.
+template <class F>
+static void symimm_expand(const BatchTarget &bt, int ns, const int* bits, const std::vector<SymImmRule> &rules,
+                          const std::vector<uint8_t> &covered, SymImmStats &st, F &&expand) {
+    for (int i = 0; i < ns; i++) if (bits[i] == 16) { st.unexpanded++; return; }
+    uint64_t total = 1ull << (8 * ns);
+    if (covered.empty())
+        for (const SymImmRule &r : rules) if (r.cond.empty()) { st.covered += total; return; }
+    for (uint64_t x = 0; x < total; x++) {
+        uint16_t vals[IMM_SYMS];
+        for (int i = 0; i < ns; i++) vals[i] = (uint16_t)((x >> (8 * (ns - 1 - i))) & 0xFF);
+        if (!covered.empty() && covered[x]) { (covered[x] == 1 ? st.covered : st.no_hits)++; continue; }
+        BatchTarget inst = bt;
+        symimm_bind(bt.ops, bt.imms, bt.len, vals, inst.imms);
+        st.expanded++;
+        expand(inst);
+    }
+}
+
+// A target of the symbolic enumeration: false if it has no symbols (search
+// it as usual), else its templates go to out and the instances they do not
+// cover to expand.
+template <class F>
+static bool symimm_search(const SymImmTable &t, BatchTarget bt, SymImmStats &st, std::string &out, F &&expand) {
+    int bits[IMM_SYMS];
+    int ns = symimm_number(bt, bits);
+    if (!ns) return false;
+    std::vector<SymImmRule> rules;
+    std::vector<uint8_t> covered;
+    symimm_find(t, bt, ns, bits, st, rules, covered);
+    for (const SymImmRule &r : rules) {
+        symimm_append(out, bt, bits, r, t.dead_flags);
+        st.templates++;
+        st.conditional += !r.cond.empty();
+    }
+    symimm_expand(bt, ns, bits, rules, covered, st, expand);
+    return true;
+}
+
+static void symimm_report(const SymImmStats &st) {
+    fprintf(stderr, "Symbolic targets:   %lu (QC:%lu Mid:%lu proofs:%lu)\n", (unsigned long)st.targets,
+            (unsigned long)st.qc_hits, (unsigned long)st.mid_hits, (unsigned long)st.proofs);
+    fprintf(stderr, "Templates found:    %lu (%lu conditional)\n", (unsigned long)st.templates, (unsigned long)st.conditional);
+    fprintf(stderr, "Concrete instances: %lu expanded, %lu covered by templates, %lu without QuickCheck hits\n",
+            (unsigned long)st.expanded, (unsigned long)st.covered, (unsigned long)st.no_hits);
+    fprintf(stderr, "16-bit operands:    %lu targets not expanded\n", (unsigned long)st.unexpanded);
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// Templates for sampled length-2 targets hold exactly where their condition
+// says, and every instance is expanded, covered or without hits. Returns the
+// failure count.
+static long symimm_verify(std::mt19937 &rng) {
+    SymImmTable tab;
+    symimm_build_table(tab, 0x00, false);
+    std::vector<Inst> sym = enumerate_instructions_sym();
+    SymImmStats st;
+    long targets=0, instances=0, bad=0;
+    bool res7=false, sbc=false;
+    auto run = [&](const Inst &a, const Inst &b) {
+        uint16_t to[2]={a.op,b.op}, ti[2]={a.imm,b.imm};
+        BatchTarget bt;
+        if (!make_batch_target(bt,to,ti,2,false)) return;
+        int bits[IMM_SYMS];
+        int ns=symimm_number(bt,bits);
+        if (!ns) return;
+        targets++;
+        std::vector<SymImmRule> rules;
+        std::vector<uint8_t> covered;
+        symimm_find(tab,bt,ns,bits,st,rules,covered);
+        st.templates+=rules.size();
+        for (const SymImmRule &r : rules) {
+            char sa[64], sb[64], ra[64];
+            disasm(bt.ops[0],bt.imms[0],sa,sizeof(sa)); disasm(bt.ops[1],bt.imms[1],sb,sizeof(sb));
+            disasm(r.op,r.imm,ra,sizeof(ra));
+            std::string txt=std::string(sa)+" : "+sb+" -> "+ra;
+            res7 |= txt=="LD A, n : RES 7, A -> LD A, n" && r.cond.size()==256 && r.cond[0x7F] && !r.cond[0x80];
+            sbc |= txt=="LD HL, nn : SBC HL, HL -> SBC HL, HL" && r.cond.empty();
+            bool all = ns==1 && bits[0]==8;
+            for (int k=0; k<(all ? 256 : 8); k++) {
+                uint16_t vals[IMM_SYMS], bi[2], ci[1], rm[1]={r.imm};
+                for (int i=0; i<IMM_SYMS; i++) vals[i]=all ? (uint16_t)k : (uint16_t)rng();
+                symimm_bind(bt.ops,bt.imms,2,vals,bi);
+                symimm_bind(&r.op,rm,1,vals,ci);
+                bool want = r.cond.empty() || r.cond[vals[0] & (r.cond.size()-1)];
+                instances++;
+                if (bdd_exhaustive_check(bt.ops,bi,2,&r.op,ci,1,0x00)!=want && bad++<5)
+                    fprintf(stderr,"  TEMPLATE WRONG: %s for value 0x%X\n", txt.c_str(), vals[0]);
+            }
+        }
+        SymImmStats es;
+        symimm_expand(bt,ns,bits,rules,covered,es,[](const BatchTarget &){});
+        if (!es.unexpanded && es.expanded+es.covered+es.no_hits!=1ull<<(8*ns)) bad++;
+    };
+    auto named = [&](const char* text) {
+        char d[64];
+        for (const Inst &x : sym) { disasm(x.op,x.imm,d,sizeof(d)); if (!strcmp(d,text)) return x; }
+        return sym[0];
+    };
+    run(named("LD A, n"),named("RES 7, A"));
+    run(named("LD HL, nn"),named("SBC HL, HL"));
+    for (const Inst &a : sym)
+        for (const Inst &b : sym)
+            if ((a.imm>=IMM_SYM || b.imm>=IMM_SYM) && rng()%16==0) run(a,b);
+    if (!res7 || !sbc) bad++;
+    fprintf(stderr,"Symbolic immediates: %ld targets, %lu templates, %ld instances proved, %ld failures\n",
+            targets, (unsigned long)st.templates, instances, bad);
+    return bad;
+}
@@ -0,0 +1,351 @@
+// Register-renaming symmetry reduction for target enumeration (--symmetry).
+//
+// The 8-bit instructions treat B, C, D, E, H and L uniformly, so renaming
+// registers in a target and its replacement yields another valid rule.
+// Targets are grouped into orbits under permutations of those six registers;
+// only the representative whose register operands, read left to right, are
+// lexicographically minimal (first new register B, next C, ...) is searched,
+// and each rule found for it is written out once per renaming that the
+// enumerator would itself have searched (should_prune false).
+//
+// The instructions that name register pairs break the symmetry: INC BC is
+// not INC CB, and nothing renames ADD HL,HL. Such a rule can only match a
+// target that writes both halves of a pair, so the reduction applies to
+// targets of 8-bit instructions writing at most one of B..L; everything
+// else is searched as before. It also assumes single-instruction
+// replacements (the len-2 join finds INC BC : DEC BC-style pairs).
+//
+// Rules of an orbit are emitted together, so the output is the unreduced
+// run's set of lines in a different order. Renamings can start with a first
+// instruction outside the representative's --first-op shard or coordinator
+// unit, so shards split the rules differently; their union is unchanged.
+// Used by z80_search_v2.cu, z80_search_cpu.cpp and z80_coord.h through
+// make_batch_target and append_result_orbit.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+#include "z80_results.h"
+
+#define SYM_OPS 368   // ops below this name at most two 8-bit registers; the rest name pairs
+#define SYM_BL  (RMASK_B|RMASK_C|RMASK_D|RMASK_E|RMASK_H|RMASK_L)
+
+// How the enumerator treats a target under --symmetry.
+enum { SYM_PLAIN,     // outside the reduction: search as usual
+       SYM_SKIP,      // covered by its orbit's representative (or nothing to search)
+       SYM_ORBIT };   // representative: search, then emit every renaming
+
+struct SymOp { uint8_t nslots, slot[2]; };   // register operands in textual order
+static SymOp sym_ops[SYM_OPS];
+static int16_t sym_op_tab[SYM_OPS][8][8];    // op with its slots set to (r0, r1); -1 if none
+
+// Register operands of op, taken from its disassembly ("LD H, B" -> H, B).
+static int sym_tokens(uint16_t op, std::string toks[8]) {
+    char d[64];
+    disasm(op, 0, d, sizeof(d));
+    int n = 0;
+    for (char* p = d; *p && n < 8; ) {
+        if (*p == ' ' || *p == ',') { p++; continue; }
+        char* e = p;
+        while (*e && *e != ' ' && *e != ',') e++;
+        toks[n++].assign(p, e - p);
+        p = e;
+    }
+    return n;
+}
+
+static int sym_reg_of(const std::string &t) {
+    for (int r = REG_B; r <= REG_L; r++) if (t == reg_names[r]) return r;
+    return -1;
+}
+
+// Build the renaming tables; needs init_tables() first.
+static void sym_init() {
+    std::map<std::string, uint16_t> by_text;
+    std::string toks[SYM_OPS][8];
+    int ntok[SYM_OPS];
+    for (uint16_t op = 0; op < SYM_OPS; op++) {
+        ntok[op] = sym_tokens(op, toks[op]);
+        std::string s;
+        for (int i = 0; i < ntok[op]; i++) s += toks[op][i] + " ";
+        by_text[s] = op;
+        sym_ops[op].nslots = 0;
+        for (int i = 0; i < ntok[op]; i++) {
+            int r = sym_reg_of(toks[op][i]);
+            if (r >= 0) sym_ops[op].slot[sym_ops[op].nslots++] = (uint8_t)r;
+        }
+    }
+    for (uint16_t op = 0; op < SYM_OPS; op++) {
+        for (int a = 0; a < 8; a++) for (int b = 0; b < 8; b++) sym_op_tab[op][a][b] = -1;
+        for (int a = REG_B; a <= REG_L; a++) for (int b = REG_B; b <= REG_L; b++) {
+            int want[2] = {a, b}, k = 0;
+            std::string s;
+            for (int i = 0; i < ntok[op]; i++)
+                s += (sym_reg_of(toks[op][i]) >= 0 ? std::string(reg_names[want[k++]]) : toks[op][i]) + " ";
+            auto it = by_text.find(s);
+            if (it != by_text.end()) sym_op_tab[op][a][b] = (int16_t)it->second;
+        }
+    }
+}
+
+// op with every register r renamed to perm[r]; -1 if that is no instruction.
+static int sym_rename(uint16_t op, const uint8_t perm[8]) {
+    if (op >= SYM_OPS) return -1;
+    const SymOp &s = sym_ops[op];
+    if (s.nslots == 0) return op;
+    int a = perm[s.slot[0]], b = s.nslots > 1 ? perm[s.slot[1]] : REG_B;
+    return sym_op_tab[op][a][b];
+}
+
+// 8-bit instructions only, writing at most one of B..L (see above).
+static bool sym_eligible(const uint16_t* ops, int n) {
+    uint16_t w = 0;
+    for (int i = 0; i < n; i++) {
+        if (ops[i] >= SYM_OPS) return false;
+        w |= op_writes(ops[i]);
+    }
+    return __builtin_popcount(w & SYM_BL) <= 1;
+}
+
+// Registers first appear in the order B, C, D, ...; *nregs gets how many are used.
+static bool sym_canonical(const uint16_t* ops, int n, int* nregs = nullptr) {
+    int next = REG_B;
+    for (int i = 0; i < n; i++) {
+        const SymOp &s = sym_ops[ops[i]];
+        for (int j = 0; j < s.nslots; j++) {
+            if (s.slot[j] < next) continue;
+            if (s.slot[j] != next) return false;
+            next++;
+        }
+    }
+    if (nregs) *nregs = next - REG_B;
+    return true;
+}
+
+// Rename registers in order of first use to B, C, D, ... (the orbit's
+// representative, possibly pruned); returns the number of registers used.
+static int sym_canonicalize(const uint16_t* ops, int n, uint16_t* out) {
+    uint8_t perm[8] = {REG_A, REG_F, 0, 0, 0, 0, 0, 0};
+    int next = REG_B;
+    for (int i = 0; i < n; i++) {
+        const SymOp &s = sym_ops[ops[i]];
+        for (int j = 0; j < s.nslots; j++)
+            if (!perm[s.slot[j]]) perm[s.slot[j]] = (uint8_t)next++;
+    }
+    int used = next - REG_B;
+    for (int r = REG_B; r <= REG_L; r++) if (!perm[r]) perm[r] = (uint8_t)next++;
+    for (int i = 0; i < n; i++) out[i] = (uint16_t)sym_rename(ops[i], perm);
+    return used;
+}
+
+// Call f(ops', perm) for every distinct renaming of a canonical target using
+// nregs registers, the identity first; f returns false to stop. perm extends
+// the renaming to all six registers (unused ones in order), for replacements
+// that read a register the target does not.
+template <class F>
+static void sym_for_each_image(const uint16_t* ops, int n, int nregs, F &&f) {
+    int p[6] = {REG_B, REG_C, REG_D, REG_E, REG_H, REG_L};
+    do {
+        if (!std::is_sorted(p + nregs, p + 6)) continue;
+        uint8_t perm[8] = {REG_A, REG_F};
+        for (int r = 0; r < 6; r++) perm[REG_B + r] = (uint8_t)p[r];
+        uint16_t img[3];
+        for (int i = 0; i < n; i++) img[i] = (uint16_t)sym_rename(ops[i], perm);
+        if (!f((const uint16_t*)img, (const uint8_t*)perm)) return;
+    } while (std::next_permutation(p, p + 6));
+}
+
+// Whether any renaming of a canonical target passes should_prune. Equal
+// opcodes are never independent, so the trace normal form never compares
+// immediates and the answer is cached per opcode triple (the enumerator
+// meets each once per immediate). Enumerating thread only.
+static bool sym_any_image_kept(const uint16_t* ops, const uint16_t* imms, int n, int nregs) {
+    static uint32_t cache[1 << 16];
+    uint32_t key = 1;
+    for (int i = 0; i < n; i++) key = key << 9 | ops[i];
+    uint32_t &slot = cache[(key * 0x9E3779B1u) >> 16];
+    if (slot >> 1 == key) return slot & 1;
+    bool any = false;
+    sym_for_each_image(ops, n, nregs, [&](const uint16_t* img, const uint8_t*) {
+        any = !should_prune(img, imms, n);
+        return !any;
+    });
+    slot = key << 1 | any;
+    return any;
+}
+
+// The trace normal form of should_prune depends on opcode numbering, so a
+// representative it drops may still stand for renamings it keeps.
+static int sym_classify(const uint16_t* ops, const uint16_t* imms, int n) {
+    if (!sym_eligible(ops, n)) return SYM_PLAIN;
+    int nregs;
+    if (!sym_canonical(ops, n, &nregs)) return SYM_SKIP;
+    if (!should_prune(ops, imms, n)) return SYM_ORBIT;
+    if (should_prune_local(ops, imms, n)) return SYM_SKIP;
+    return sym_any_image_kept(ops, imms, n, nregs) ? SYM_ORBIT : SYM_SKIP;
+}
+
+// Fill bt with the target if the enumerator should search it; otherwise
+// *reason (if given) gets a PruneReason.
+static bool make_batch_target(BatchTarget &bt, const uint16_t* ops, const uint16_t* imms, int n, bool symmetry,
+                              int* reason = nullptr) {
+    int sc = symmetry ? sym_classify(ops, imms, n) : SYM_PLAIN;
+    if (sc != SYM_ORBIT) {
+        int r = prune_reason(ops, imms, n);
+        if (sc == SYM_SKIP && r == PRUNE_NONE) r = PRUNE_SYMMETRY;
+        if (r != PRUNE_NONE) { if (reason) *reason = r; return false; }
+    }
+    bt.bytes = 0;
+    for (int j = 0; j < 3; j++) {
+        bt.ops[j] = j < n ? ops[j] : 0;
+        bt.imms[j] = j < n ? imms[j] : 0;
+        if (j < n) bt.bytes += byte_size(ops[j]);
+    }
+    bt.len = n;
+    bt.orbit = sc == SYM_ORBIT;
+    return true;
+}
+
+// Append a confirmed single-instruction rule; for an orbit representative,
+// the rule for each renaming the plain search would have tried instead.
+// Returns the number of rules written; *nbytes gets the bytes added.
+static uint64_t append_result_orbit(std::string &out, bool binary, const BatchTarget &bt,
+                                    uint16_t cop, uint16_t cimm, uint8_t dead_flags, size_t* nbytes) {
+    int nregs;
+    if (!bt.orbit || cop >= SYM_OPS || !sym_canonical(bt.ops, bt.len, &nregs)) {
+        *nbytes = append_result(out, binary, bt, &cop, &cimm, 1, dead_flags);
+        return 1;
+    }
+    uint64_t count = 0;
+    *nbytes = 0;
+    sym_for_each_image(bt.ops, bt.len, nregs, [&](const uint16_t* img, const uint8_t* perm) {
+        if (should_prune(img, bt.imms, bt.len)) return true;
+        BatchTarget t = bt;
+        memcpy(t.ops, img, bt.len * sizeof(uint16_t));
+        uint16_t c = (uint16_t)sym_rename(cop, perm);
+        *nbytes += append_result(out, binary, t, &c, &cimm, 1, dead_flags);
+        count++;
+        return true;
+    });
+    return count;
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// Confirmed single-instruction replacements of one target, as JSONL lines.
+static void sym_direct_rules(const CandTable &ct, const BatchTarget &bt, uint8_t df, std::vector<std::string> &out) {
+    uint8_t fp[FP_LEN], mfp[MID_FP_LEN];
+    uint32_t hits[256];
+    h_fingerprint(bt.ops, bt.imms, bt.len, fp);
+    int nh = fp_index_probe(ct.qc, fp, bt.bytes, hits, 256);
+    if (!nh) return;
+    h_mid_fingerprint(bt.ops, bt.imms, bt.len, mfp);
+    mask_fp_flags(mfp, MID_VECTORS, df);
+    for (int k=0; k<nh; k++) {
+        if (memcmp(mfp, &ct.mfps[(size_t)hits[k]*MID_FP_LEN], MID_FP_LEN)!=0) continue;
+        uint16_t co[1]={ct.insts[hits[k]].op}, ci[1]={ct.insts[hits[k]].imm};
+        if (!bdd_exhaustive_check(bt.ops, bt.imms, bt.len, co, ci, 1, df)) continue;
+        char line[512];
+        format_result_jsonl(line, sizeof(line), bt, co[0], ci[0], df);
+        out.push_back(line);
+    }
+}
+
+// Every length-2 target is searched once, as itself or as a renaming of one
+// representative, and sampled representatives expand to exactly the rules
+// their renamings have when searched directly. Returns the failure count.
+static long sym_verify(const std::vector<Inst> &insts, std::mt19937 &rng) {
+    long bad=0;
+    std::vector<int> index((size_t)OP_COUNT*256, -1);
+    for (size_t i=0; i<insts.size(); i++) index[(size_t)insts[i].op*256+insts[i].imm]=(int)i;
+    size_t n=insts.size();
+    std::vector<uint8_t> seen(n*n, 0);
+    uint64_t plain=0, searched=0;
+    for (size_t i0=0; i0<n; i0++) {
+        for (size_t i1=0; i1<n; i1++) {
+            uint16_t to[2]={insts[i0].op,insts[i1].op}, ti[2]={insts[i0].imm,insts[i1].imm};
+            plain += !should_prune(to,ti,2);
+            BatchTarget bt;
+            if (!make_batch_target(bt,to,ti,2,true)) continue;
+            searched++;
+            auto mark = [&](const uint16_t* ops) {
+                if (should_prune(ops,ti,2)) return true;
+                uint8_t &m = seen[(size_t)index[ops[0]*256+ti[0]]*n + index[ops[1]*256+ti[1]]];
+                if (m++) bad++;
+                return true;
+            };
+            int nregs=0;
+            if (bt.orbit && sym_canonical(to,2,&nregs))
+                sym_for_each_image(to,2,nregs,[&](const uint16_t* img, const uint8_t*) { return mark(img); });
+            else mark(to);
+        }
+    }
+    uint64_t covered=0;
+    for (size_t i0=0; i0<n; i0++)
+        for (size_t i1=0; i1<n; i1++) {
+            uint16_t to[2]={insts[i0].op,insts[i1].op}, ti[2]={insts[i0].imm,insts[i1].imm};
+            bool want=!should_prune(to,ti,2), got=seen[i0*n+i1]!=0;
+            covered+=got;
+            if (want!=got) bad++;
+        }
+    fprintf(stderr,"Symmetry: %lu length-2 targets as %lu searched (%.2fx), %lu covered\n",
+            (unsigned long)plain, (unsigned long)searched, (double)plain/searched, (unsigned long)covered);
+
+    long reps=0, rules=0;
+    for (uint8_t df : {(uint8_t)0x00, (uint8_t)0xFF}) {
+        CandTable ct;
+        build_cand_table(ct, insts, df);
+        for (long tries=0, found=0; found<60 && tries<200000; tries++) {
+            int len=2+(int)(tries&1);
+            uint16_t to[3], ti[3];
+            for (int j=0; j<len; j++) { const Inst &x=insts[rng()%n]; to[j]=x.op; ti[j]=x.imm; }
+            BatchTarget bt;
+            if (!make_batch_target(bt,to,ti,len,true) || !bt.orbit) continue;
+            std::vector<std::string> rep, expanded, direct;
+            sym_direct_rules(ct, bt, df, rep);
+            if (rep.empty() && (tries&7)) continue;
+            found += !rep.empty();
+            reps++;
+            uint32_t hits[256];
+            uint8_t fp[FP_LEN];
+            h_fingerprint(bt.ops,bt.imms,bt.len,fp);
+            int nh=fp_index_probe(ct.qc,fp,bt.bytes,hits,256);
+            std::string out;
+            for (int k=0; k<nh; k++) {
+                uint16_t co[1]={ct.insts[hits[k]].op}, ci[1]={ct.insts[hits[k]].imm};
+                if (!h_midcheck(bt.ops,bt.imms,bt.len,co,ci,1,df) ||
+                    !bdd_exhaustive_check(bt.ops,bt.imms,bt.len,co,ci,1,df)) continue;
+                size_t nb;
+                append_result_orbit(out, false, bt, co[0], ci[0], df, &nb);
+            }
+            for (size_t a=0, b; a<out.size(); a=b+1) { b=out.find('\n',a); expanded.push_back(out.substr(a,b-a+1)); }
+            int nregs=0;
+            sym_canonical(bt.ops,bt.len,&nregs);
+            sym_for_each_image(bt.ops,bt.len,nregs,[&](const uint16_t* img, const uint8_t*) {
+                if (should_prune(img,bt.imms,bt.len)) return true;
+                BatchTarget t=bt;
+                memcpy(t.ops,img,bt.len*sizeof(uint16_t));
+                sym_direct_rules(ct, t, df, direct);
+                return true;
+            });
+            std::sort(expanded.begin(),expanded.end());
+            std::sort(direct.begin(),direct.end());
+            rules+=direct.size();
+            if (expanded!=direct && bad++<5)
+                fprintf(stderr,"  SYMMETRY MISMATCH: %zu expanded vs %zu direct rules, first %s",
+                        expanded.size(), direct.size(), direct.empty() ? "(none)\n" : direct[0].c_str());
+        }
+    }
+    fprintf(stderr,"Symmetry: %ld representatives expand to %ld rules, %ld failures\n", reps, rules, bad);
+    return bad;
+}
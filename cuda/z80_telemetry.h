@@ -0,0 +1,388 @@
+// Live search telemetry: per-stage counters and rates, batch fill, queue
+// depths, per-stage latency histograms and an ETA, for dashboards that should
+// not have to parse the [x%] lines on stderr.
+//
+// Every thread that records gets its own cache-line-aligned shard of
+// counters and histograms, which only it writes (relaxed load, add, store:
+// no locked instruction, no shared line), so recording costs a few
+// nanoseconds. Nothing is summed until a snapshot is taken: a background
+// thread does that every tm_start interval and rewrites the status files
+// (a temporary file renamed over the old one, so a scraper never sees half
+// of one). tm_stop writes a last one with "done": true.
+//   --status FILE        JSON
+//   --status-prom FILE   Prometheus text format (node_exporter's textfile
+//                        collector picks it up from a *.prom file)
+// Gauges (queue depths, progress through the outer loop) are set by the
+// enumerating thread. Without tm_start every call returns at its first test.
+//
+// Histogram buckets are powers of two in microseconds: bucket k counts
+// samples below 2^k us (k = 0..TM_BUCKETS-2), the last one the rest.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#define TM_BUCKETS 28   // up to 2^26 us (~67 s), then +Inf
+
+// Counters (pairs, for the check stages; 3->2 join pairs included)
+enum {
+    TM_TARGETS,            // targets enumerated into batches
+    TM_BATCHES,
+    TM_QC_HITS,            // (target, candidate) pairs out of QuickCheck
+    TM_MID_PASS, TM_MID_REJECT,
+    TM_LEARNED_REJECT,     // MidCheck survivors dropped on learned vectors
+    TM_EXHAUST_DISPATCHED, TM_EXHAUST_CONFIRMED,
+    TM_FOUND,              // result lines (symmetry orbits expanded)
+    TM_COUNTERS
+};
+static const char* const tm_counter_names[TM_COUNTERS] = {
+    "targets", "batches", "qc_hits", "mid_pass", "mid_reject", "learned_reject",
+    "exhaust_dispatched", "exhaust_confirmed", "found"};
+
+// Latency histograms, per batch
+enum {
+    TM_H_QUEUE,     // queued until a worker starts it (pool binaries)
+    TM_H_QC, TM_H_MID, TM_H_EXHAUST,
+    TM_H_BATCH,     // all stages
+    TM_H_COMMIT,    // queued until its results are committed in order (pool binaries)
+    TM_HISTS
+};
+static const char* const tm_hist_names[TM_HISTS] = {"queue", "qc", "mid", "exhaust", "batch", "commit"};
+
+// Gauges
+enum {
+    TM_G_INFLIGHT,        // batches queued or running, not yet committed
+    TM_G_MAX_INFLIGHT,
+    TM_G_WRITER_BYTES,    // results waiting for the stdout writer
+    TM_G_TARGET_LEN,
+    TM_G_DONE, TM_G_TOTAL,// outer-loop position, for progress and ETA
+    TM_GAUGES
+};
+static const char* const tm_gauge_names[TM_GAUGES] = {
+    "inflight_batches", "max_inflight_batches", "writer_pending_bytes", "target_len", "progress_done",
+    "progress_total"};
+
+struct alignas(64) TmShard {
+    uint64_t c[TM_COUNTERS] = {};
+    uint64_t h[TM_HISTS][TM_BUCKETS] = {};
+    uint64_t h_sum_us[TM_HISTS] = {};
+};
+
+struct TmSnapshot {
+    uint64_t c[TM_COUNTERS] = {};
+    uint64_t h[TM_HISTS][TM_BUCKETS] = {};
+    uint64_t h_sum_us[TM_HISTS] = {};
+    int64_t g[TM_GAUGES] = {};
+    double elapsed = 0;
+    double len_elapsed = 0;   // since tm_length
+    int64_t len_done0 = 0;    // TM_G_DONE at tm_length
+};
+
+struct Telemetry {
+    bool enabled = false;
+    std::string json_path, prom_path, binary;
+    int batch_size = 1;
+    std::chrono::steady_clock::time_point start;
+    std::mutex mu;                       // shards, stop
+    std::vector<std::unique_ptr<TmShard>> shards;
+    std::atomic<int64_t> g[TM_GAUGES] = {};
+    std::atomic<int64_t> len_start_ns{0}, len_done0{0};
+    std::condition_variable cv;
+    bool stop = false;
+    std::thread thread;
+};
+
+static Telemetry tm_global;
+
+static TmShard &tm_shard() {
+    static thread_local TmShard* s = nullptr;
+    if (!s) {
+        std::lock_guard<std::mutex> lk(tm_global.mu);
+        tm_global.shards.emplace_back(new TmShard());
+        s = tm_global.shards.back().get();
+    }
+    return *s;
+}
+
+static inline void tm_bump(uint64_t &w, uint64_t n) {
+    __atomic_store_n(&w, __atomic_load_n(&w, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline void tm_add(int counter, uint64_t n = 1) {
+    if (!tm_global.enabled || !n) return;
+    tm_bump(tm_shard().c[counter], n);
+}
+
+static inline void tm_gauge(int gauge, int64_t v) {
+    if (tm_global.enabled) tm_global.g[gauge].store(v, std::memory_order_relaxed);
+}
+
+// A new target length starts, total outer-loop steps of which done are
+// already behind it (a resumed checkpoint); the ETA counts from here.
+static void tm_length(int len, int64_t total, int64_t done) {
+    if (!tm_global.enabled) return;
+    tm_gauge(TM_G_TARGET_LEN, len);
+    tm_gauge(TM_G_TOTAL, total);
+    tm_gauge(TM_G_DONE, done);
+    tm_global.len_done0.store(done, std::memory_order_relaxed);
+    tm_global.len_start_ns.store(std::chrono::steady_clock::now().time_since_epoch().count(),
+                                 std::memory_order_relaxed);
+}
+
+typedef std::chrono::steady_clock::time_point TmTime;
+static inline TmTime tm_now() { return tm_global.enabled ? std::chrono::steady_clock::now() : TmTime(); }
+
+// One latency sample: from t0 to now.
+static inline void tm_since(int hist, TmTime t0) {
+    if (!tm_global.enabled) return;
+    uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    int b = us ? 64 - __builtin_clzll(us) : 0;   // us < 2^b
+    TmShard &s = tm_shard();
+    tm_bump(s.h[hist][b < TM_BUCKETS - 1 ? b : TM_BUCKETS - 1], 1);
+    tm_bump(s.h_sum_us[hist], us);
+}
+
+static void tm_snapshot(TmSnapshot &o) {
+    o = TmSnapshot();
+    {
+        std::lock_guard<std::mutex> lk(tm_global.mu);
+        for (auto &s : tm_global.shards) {
+            for (int i = 0; i < TM_COUNTERS; i++) o.c[i] += __atomic_load_n(&s->c[i], __ATOMIC_RELAXED);
+            for (int i = 0; i < TM_HISTS; i++) {
+                o.h_sum_us[i] += __atomic_load_n(&s->h_sum_us[i], __ATOMIC_RELAXED);
+                for (int b = 0; b < TM_BUCKETS; b++) o.h[i][b] += __atomic_load_n(&s->h[i][b], __ATOMIC_RELAXED);
+            }
+        }
+    }
+    for (int i = 0; i < TM_GAUGES; i++) o.g[i] = tm_global.g[i].load(std::memory_order_relaxed);
+    auto now = std::chrono::steady_clock::now();
+    o.elapsed = std::chrono::duration<double>(now - tm_global.start).count();
+    auto len_start = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(
+        tm_global.len_start_ns.load(std::memory_order_relaxed)));
+    o.len_elapsed = len_start > tm_global.start ? std::chrono::duration<double>(now - len_start).count() : o.elapsed;
+    o.len_done0 = tm_global.len_done0.load(std::memory_order_relaxed);
+}
+
+static double tm_progress(const TmSnapshot &s) {
+    return s.g[TM_G_TOTAL] > 0 ? (double)s.g[TM_G_DONE] / s.g[TM_G_TOTAL] : 0;
+}
+
+// Seconds left in the current length at its average rate so far; -1 until
+// 0.1% of it is done since tm_length.
+static double tm_eta(const TmSnapshot &s) {
+    int64_t total = s.g[TM_G_TOTAL], done = s.g[TM_G_DONE], ran = done - s.len_done0;
+    if (total <= 0 || ran * 1000 <= total) return -1;
+    return s.len_elapsed * (double)(total - done) / ran;
+}
+
+static double tm_batch_fill(const TmSnapshot &s) {
+    return s.c[TM_BATCHES] ? (double)s.c[TM_TARGETS] / ((double)s.c[TM_BATCHES] * tm_global.batch_size) : 0;
+}
+
+static double tm_bucket_le_seconds(int b) { return (double)(1ull << b) * 1e-6; }
+
+static void tm_format_json(const TmSnapshot &s, const TmSnapshot &prev, bool done, std::string &out) {
+    char buf[256];
+    double dt = s.elapsed - prev.elapsed;
+    snprintf(buf, sizeof(buf), "{\"binary\": \"%s\", \"pid\": %ld, \"time\": %ld, \"done\": %s, \"elapsed_s\": %.1f,\n",
+             tm_global.binary.c_str(), (long)getpid(), (long)time(NULL), done ? "true" : "false", s.elapsed);
+    out = buf;
+    snprintf(buf, sizeof(buf), " \"progress\": %.6f, \"eta_s\": %.0f, \"batch_fill\": %.4f,\n",
+             tm_progress(s), tm_eta(s), tm_batch_fill(s));
+    out += buf;
+    out += " \"counters\": {";
+    for (int i = 0; i < TM_COUNTERS; i++) {
+        snprintf(buf, sizeof(buf), "%s\"%s\": %llu", i ? ", " : "", tm_counter_names[i], (unsigned long long)s.c[i]);
+        out += buf;
+    }
+    // per second since prev (the final status: over the whole run)
+    out += "},\n \"rates\": {";
+    for (int i = 0; i < TM_COUNTERS; i++) {
+        snprintf(buf, sizeof(buf), "%s\"%s\": %.1f", i ? ", " : "", tm_counter_names[i],
+                 dt > 0 ? (double)(s.c[i] - prev.c[i]) / dt : 0.0);
+        out += buf;
+    }
+    out += "},\n \"gauges\": {";
+    for (int i = 0; i < TM_GAUGES; i++) {
+        snprintf(buf, sizeof(buf), "%s\"%s\": %lld", i ? ", " : "", tm_gauge_names[i], (long long)s.g[i]);
+        out += buf;
+    }
+    // buckets: [upper bound in us (-1: +Inf), count], empty ones left out
+    out += "},\n \"latency_us\": {";
+    for (int i = 0; i < TM_HISTS; i++) {
+        uint64_t n = 0;
+        for (int b = 0; b < TM_BUCKETS; b++) n += s.h[i][b];
+        snprintf(buf, sizeof(buf), "%s\n  \"%s\": {\"count\": %llu, \"sum\": %llu, \"buckets\": [", i ? "," : "",
+                 tm_hist_names[i], (unsigned long long)n, (unsigned long long)s.h_sum_us[i]);
+        out += buf;
+        bool first = true;
+        for (int b = 0; b < TM_BUCKETS; b++) {
+            if (!s.h[i][b]) continue;
+            snprintf(buf, sizeof(buf), "%s[%lld, %llu]", first ? "" : ", ",
+                     b < TM_BUCKETS - 1 ? (long long)(1ull << b) : -1ll, (unsigned long long)s.h[i][b]);
+            out += buf;
+            first = false;
+        }
+        out += "]}";
+    }
+    out += "}}\n";
+}
+
+static void tm_format_prom(const TmSnapshot &s, bool done, std::string &out) {
+    char buf[1024];
+    std::string lbl = "binary=\"" + tm_global.binary + "\"";
+    out.clear();
+    for (int i = 0; i < TM_COUNTERS; i++) {
+        snprintf(buf, sizeof(buf), "# TYPE z80search_%s_total counter\nz80search_%s_total{%s} %llu\n",
+                 tm_counter_names[i], tm_counter_names[i], lbl.c_str(), (unsigned long long)s.c[i]);
+        out += buf;
+    }
+    for (int i = 0; i < TM_GAUGES; i++) {
+        snprintf(buf, sizeof(buf), "# TYPE z80search_%s gauge\nz80search_%s{%s} %lld\n",
+                 tm_gauge_names[i], tm_gauge_names[i], lbl.c_str(), (long long)s.g[i]);
+        out += buf;
+    }
+    snprintf(buf, sizeof(buf),
+             "# TYPE z80search_progress_ratio gauge\nz80search_progress_ratio{%s} %.6f\n"
+             "# TYPE z80search_eta_seconds gauge\nz80search_eta_seconds{%s} %.0f\n"
+             "# TYPE z80search_batch_fill_ratio gauge\nz80search_batch_fill_ratio{%s} %.4f\n"
+             "# TYPE z80search_elapsed_seconds gauge\nz80search_elapsed_seconds{%s} %.1f\n"
+             "# TYPE z80search_done gauge\nz80search_done{%s} %d\n",
+             lbl.c_str(), tm_progress(s), lbl.c_str(), tm_eta(s), lbl.c_str(), tm_batch_fill(s),
+             lbl.c_str(), s.elapsed, lbl.c_str(), done ? 1 : 0);
+    out += buf;
+    out += "# TYPE z80search_stage_latency_seconds histogram\n";
+    for (int i = 0; i < TM_HISTS; i++) {
+        uint64_t cum = 0;
+        for (int b = 0; b < TM_BUCKETS; b++) {
+            cum += s.h[i][b];
+            if (b < TM_BUCKETS - 1) {
+                snprintf(buf, sizeof(buf), "z80search_stage_latency_seconds_bucket{%s,stage=\"%s\",le=\"%g\"} %llu\n",
+                         lbl.c_str(), tm_hist_names[i], tm_bucket_le_seconds(b), (unsigned long long)cum);
+            } else {
+                snprintf(buf, sizeof(buf), "z80search_stage_latency_seconds_bucket{%s,stage=\"%s\",le=\"+Inf\"} %llu\n",
+                         lbl.c_str(), tm_hist_names[i], (unsigned long long)cum);
+            }
+            out += buf;
+        }
+        snprintf(buf, sizeof(buf),
+                 "z80search_stage_latency_seconds_sum{%s,stage=\"%s\"} %.6f\n"
+                 "z80search_stage_latency_seconds_count{%s,stage=\"%s\"} %llu\n",
+                 lbl.c_str(), tm_hist_names[i], s.h_sum_us[i] * 1e-6, lbl.c_str(), tm_hist_names[i],
+                 (unsigned long long)cum);
+        out += buf;
+    }
+}
+
+// Replace path with data (through path.tmp and a rename).
+static bool tm_write_file(const std::string &path, const std::string &data) {
+    std::string tmp = path + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "w");
+    if (!f) return false;
+    bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    return ok && rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+static void tm_write(const TmSnapshot &s, const TmSnapshot &prev, bool done) {
+    std::string out;
+    if (!tm_global.json_path.empty()) {
+        tm_format_json(s, prev, done, out);
+        if (!tm_write_file(tm_global.json_path, out)) fprintf(stderr, "Warning: cannot write %s\n", tm_global.json_path.c_str());
+    }
+    if (!tm_global.prom_path.empty()) {
+        tm_format_prom(s, done, out);
+        if (!tm_write_file(tm_global.prom_path, out)) fprintf(stderr, "Warning: cannot write %s\n", tm_global.prom_path.c_str());
+    }
+}
+
+// Start recording and rewriting the status file(s) every interval seconds.
+// Call before any worker threads record.
+static void tm_start(const char* json_path, const char* prom_path, int interval, const char* binary, int batch_size) {
+    if (!json_path && !prom_path) return;
+    Telemetry &t = tm_global;
+    t.json_path = json_path ? json_path : "";
+    t.prom_path = prom_path ? prom_path : "";
+    t.binary = binary;
+    t.batch_size = batch_size;
+    t.start = std::chrono::steady_clock::now();
+    t.enabled = true;
+    if (interval < 1) interval = 1;
+    t.thread = std::thread([interval]() {
+        TmSnapshot prev, cur;
+        std::unique_lock<std::mutex> lk(tm_global.mu);
+        while (!tm_global.stop) {
+            tm_global.cv.wait_for(lk, std::chrono::seconds(interval));
+            if (tm_global.stop) break;
+            lk.unlock();
+            tm_snapshot(cur);
+            tm_write(cur, prev, false);
+            prev = cur;
+            lk.lock();
+        }
+    });
+}
+
+// Stop the writer thread and write the final status.
+static void tm_stop() {
+    Telemetry &t = tm_global;
+    if (!t.enabled) return;
+    {
+        std::lock_guard<std::mutex> lk(t.mu);
+        t.stop = true;
+    }
+    t.cv.notify_all();
+    t.thread.join();
+    TmSnapshot s;
+    tm_snapshot(s);
+    tm_write(s, TmSnapshot(), true);
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// Shards from several threads sum in a snapshot, into the right buckets, and
+// render as a cumulative Prometheus histogram. Returns the failure count.
+static long tm_verify() {
+    long bad=0;
+    tm_global.enabled=true;
+    tm_global.start=std::chrono::steady_clock::now();
+    std::vector<std::thread> ts;
+    for (int t=0; t<4; t++) ts.emplace_back([t]() {
+        for (int k=0; k<1000; k++) {
+            tm_add(TM_TARGETS, 3);
+            tm_add(TM_MID_PASS, t);
+            tm_since(TM_H_QC, std::chrono::steady_clock::now()-std::chrono::microseconds(1500));
+        }
+    });
+    for (auto &t : ts) t.join();
+    tm_since(TM_H_MID, std::chrono::steady_clock::now()-std::chrono::seconds(100));
+    TmSnapshot s;
+    tm_snapshot(s);
+    if (s.c[TM_TARGETS]!=12000 || s.c[TM_MID_PASS]!=6000 || s.c[TM_FOUND]!=0) bad++;
+    uint64_t n=0, low=0;
+    for (int b=0; b<TM_BUCKETS; b++) { n+=s.h[TM_H_QC][b]; if (b<11) low+=s.h[TM_H_QC][b]; }
+    if (n!=4000 || low!=0 || s.h_sum_us[TM_H_QC]<4000*1500) bad++;
+    if (s.h[TM_H_MID][TM_BUCKETS-1]!=1) bad++;
+    std::string prom;
+    tm_format_prom(s, false, prom);
+    if (prom.find("z80search_stage_latency_seconds_bucket{binary=\"\",stage=\"qc\",le=\"+Inf\"} 4000\n")==std::string::npos ||
+        prom.find("z80search_stage_latency_seconds_bucket{binary=\"\",stage=\"qc\",le=\"0.001024\"} 0\n")==std::string::npos ||
+        prom.find("z80search_targets_total{binary=\"\"} 12000\n")==std::string::npos) bad++;
+    tm_global.enabled=false;
+    tm_global.shards.clear();
+    fprintf(stderr,"Telemetry: %lu samples from 4 threads, %ld failures\n", (unsigned long)n, bad);
+    return bad;
+}
@@ -0,0 +1,196 @@
+// Adaptive MidCheck vector order.
+//
+// MidCheck compares a target and a candidate on 24 vectors, and the verdict
+// is the same whichever vector is looked at first. So the comparison walks
+// the vectors in an order per opcode class of the candidate and stops at the
+// first one that differs. Every VEC_SAMPLE-th rejection of a class also
+// compares all 24, which counts how often each vector rejects independently
+// of the order in use; vec_reorder sorts each class by those counts, the
+// most discriminating vector first. Drivers give every batch a copy of the
+// current order and fold its VecStats back in commit order, reordering every
+// VEC_REORDER_BATCHES batches, so results never depend on the schedule.
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "z80_common.h"
+#include "z80_search_host.h"
+
+#define VEC_CLASSES         8
+#define VEC_SAMPLE          16    // every 16th rejection compares all vectors
+#define VEC_REORDER_BATCHES 64
+
+static const char* const vec_class_names[VEC_CLASSES] = {
+    "LD r,r'", "LD r,n", "ALU", "INC/DEC r", "A/flag ops", "CB shifts", "BIT/RES/SET", "16-bit"};
+
+static int vec_class(uint16_t op) {
+    if (op < OP_LD_RN_START) return 0;
+    if (op < OP_ALU_START) return 1;
+    if (op < OP_INC_START) return 2;
+    if (op < OP_RLCA) return 3;
+    if (op < OP_CB_START) return 4;
+    if (op < OP_BIT_START) return 5;
+    if (op < OP_16INC_START) return 6;
+    return 7;
+}
+
+struct VecOrder {
+    uint8_t v[VEC_CLASSES][MID_VECTORS];
+    VecOrder() { for (auto &c : v) for (int i = 0; i < MID_VECTORS; i++) c[i] = (uint8_t)i; }
+};
+
+struct VecStats {
+    uint64_t compared[VEC_CLASSES] = {}, rejected[VEC_CLASSES] = {};
+    uint64_t steps[VEC_CLASSES] = {};            // vectors looked at for the rejections
+    uint64_t sampled[VEC_CLASSES] = {};          // rejections compared on every vector
+    uint64_t fixed_steps[VEC_CLASSES] = {};      // ... and where the fixed order would have stopped
+    uint64_t rejects[VEC_CLASSES][MID_VECTORS] = {};   // ... and which vectors differ
+
+    void merge(const VecStats &o) {
+        for (int c = 0; c < VEC_CLASSES; c++) {
+            compared[c] += o.compared[c]; rejected[c] += o.rejected[c]; steps[c] += o.steps[c];
+            sampled[c] += o.sampled[c]; fixed_steps[c] += o.fixed_steps[c];
+            for (int v = 0; v < MID_VECTORS; v++) rejects[c][v] += o.rejects[c][v];
+        }
+    }
+};
+
+// MidCheck fingerprints of a target and a candidate (dead flags masked)
+// equal, looking at the vectors in the order of the candidate's class;
+// cand(v) gives the candidate's MID_FP_SIZE bytes for vector v, so callers
+// can compute them lazily.
+template <class F>
+static bool vec_compare_with(const VecOrder &o, int cls, const uint8_t* t, F &&cand, VecStats &st) {
+    st.compared[cls]++;
+    for (int i = 0; i < MID_VECTORS; i++) {
+        int v = o.v[cls][i];
+        if (memcmp(t + v * MID_FP_SIZE, cand(v), MID_FP_SIZE) == 0) continue;
+        st.steps[cls] += i + 1;
+        if (st.rejected[cls]++ % VEC_SAMPLE == 0) {
+            st.sampled[cls]++;
+            int first = -1;
+            for (int w = 0; w < MID_VECTORS; w++)
+                if (memcmp(t + w * MID_FP_SIZE, cand(w), MID_FP_SIZE) != 0) {
+                    st.rejects[cls][w]++;
+                    if (first < 0) first = w;
+                }
+            st.fixed_steps[cls] += first + 1;
+        }
+        return false;
+    }
+    return true;
+}
+
+static bool vec_compare(const VecOrder &o, int cls, const uint8_t* t, const uint8_t* c, VecStats &st) {
+    return vec_compare_with(o, cls, t, [c](int v) { return c + v * MID_FP_SIZE; }, st);
+}
+
+// MidCheck of a candidate sequence that has no precomputed fingerprint
+// (tmfp: the target's, dead flags masked). The first two vectors asked for
+// come from the scalar executor, and most rejections stop there; the rest
+// are run as one batch.
+static bool vec_midcheck(const VecOrder &o, const uint8_t* tmfp, const uint16_t* ops, const uint16_t* imms, int n,
+                         uint8_t dead_flags, VecStats &st) {
+    uint8_t cmfp[MID_FP_LEN];
+    uint32_t have = 0;
+    int asked = 0;
+    auto cand = [&](int v) -> const uint8_t* {
+        uint8_t* out = cmfp + v * MID_FP_SIZE;
+        if (have >> v & 1) return out;
+        if (asked++ < 2) {
+            Z80State s = h_mid_vectors[v];
+            h_exec_seq(s, ops, imms, n);
+            memcpy(out, s.r, 8);
+            out[8] = (uint8_t)(s.sp >> 8); out[9] = (uint8_t)s.sp;
+            out[1] &= (uint8_t)~dead_flags;
+            have |= 1u << v;
+        } else {
+            h_mid_fingerprint(ops, imms, n, cmfp);
+            for (int w = 0; w < MID_VECTORS; w++) cmfp[w * MID_FP_SIZE + 1] &= (uint8_t)~dead_flags;
+            have = ~0u;
+        }
+        return out;
+    };
+    return vec_compare_with(o, vec_class(ops[0]), tmfp, cand, st);
+}
+
+// Most rejecting vectors first, per class with enough samples; ties keep
+// the fixed order.
+static void vec_reorder(VecOrder &o, const VecStats &st) {
+    for (int c = 0; c < VEC_CLASSES; c++) {
+        if (st.sampled[c] < 32) continue;
+        for (int i = 0; i < MID_VECTORS; i++) o.v[c][i] = (uint8_t)i;
+        std::stable_sort(o.v[c], o.v[c] + MID_VECTORS,
+                         [&](uint8_t a, uint8_t b) { return st.rejects[c][a] > st.rejects[c][b]; });
+    }
+}
+
+static void vec_report(const VecOrder &o, const VecStats &st) {
+    uint64_t rej = 0, steps = 0, sampled = 0, fixed = 0;
+    for (int c = 0; c < VEC_CLASSES; c++) {
+        rej += st.rejected[c]; steps += st.steps[c]; sampled += st.sampled[c]; fixed += st.fixed_steps[c];
+    }
+    if (!rej) return;
+    fprintf(stderr, "MidCheck vectors:   %lu rejections after %.2f vectors (fixed order: %.2f)\n",
+            (unsigned long)rej, (double)steps / rej, sampled ? (double)fixed / sampled : 0.0);
+    for (int c = 0; c < VEC_CLASSES; c++) {
+        if (!st.rejected[c]) continue;
+        fprintf(stderr, "  %-12s %10lu of %10lu rejected, %.2f vectors (fixed %.2f), order:",
+                vec_class_names[c], (unsigned long)st.rejected[c], (unsigned long)st.compared[c],
+                (double)st.steps[c] / st.rejected[c],
+                st.sampled[c] ? (double)st.fixed_steps[c] / st.sampled[c] : 0.0);
+        for (int i = 0; i < 4; i++) {
+            int v = o.v[c][i];
+            fprintf(stderr, " v%d %.0f%%", v, st.sampled[c] ? 100.0 * st.rejects[c][v] / st.sampled[c] : 0.0);
+        }
+        fprintf(stderr, "\n");
+    }
+}
+
+// ============================================================
+// Self-check (z80search_cpu --test)
+// ============================================================
+
+// vec_compare and vec_midcheck agree with h_midcheck under any order, and
+// vec_reorder puts the most rejecting vector first. Returns the failure count.
+static long vec_verify(const std::vector<Inst> &insts, std::mt19937 &rng) {
+    long pairs=0, rejected=0, bad=0;
+    VecOrder order;
+    VecStats st;
+    for (auto &c : order.v) std::shuffle(c, c+MID_VECTORS, rng);
+    for (int round=0; round<2; round++) {
+        for (int k=0; k<20000; k++) {
+            int tn=2+(k&1), cn=1+(k>>1&1);
+            uint16_t to[3], ti[3], co[2], ci[2];
+            // candidates mostly from the 8-bit loads and ALU ops, so some pass
+            for (int j=0; j<tn; j++) { const Inst &x=insts[rng()%900]; to[j]=x.op; ti[j]=x.imm; }
+            for (int j=0; j<cn; j++) { const Inst &x=insts[rng()%900]; co[j]=x.op; ci[j]=x.imm; }
+            if (k%3==0) { co[0]=to[tn-1]; ci[0]=ti[tn-1]; }
+            uint8_t df = (k&4) ? 0x28 : 0x00;
+            uint8_t tm[MID_FP_LEN], cm[MID_FP_LEN];
+            h_mid_fingerprint(to,ti,tn,tm);
+            h_mid_fingerprint(co,ci,cn,cm);
+            for (int v=0; v<MID_VECTORS; v++) { tm[v*MID_FP_SIZE+1]&=(uint8_t)~df; cm[v*MID_FP_SIZE+1]&=(uint8_t)~df; }
+            bool want=h_midcheck(to,ti,tn,co,ci,cn,df);
+            pairs++;
+            rejected+=!want;
+            if (vec_compare(order,vec_class(co[0]),tm,cm,st)!=want) bad++;
+            if (vec_midcheck(order,tm,co,ci,cn,df,st)!=want) bad++;
+        }
+        vec_reorder(order, st);
+        for (int c=0; c<VEC_CLASSES; c++) {
+            if (st.sampled[c]<32) continue;
+            for (int v=0; v<MID_VECTORS; v++) if (st.rejects[c][v]>st.rejects[c][order.v[c][0]]) bad++;
+        }
+    }
+    fprintf(stderr,"MidCheck order: %ld pairs (%ld rejected, %.2f vectors each), %ld failures\n",
+            pairs, rejected, (double)std::accumulate(st.steps,st.steps+VEC_CLASSES,0ull)/
+                             std::max<uint64_t>(1,std::accumulate(st.rejected,st.rejected+VEC_CLASSES,0ull)), bad);
+    return bad;
+}
@@ -0,0 +1,112 @@
+// Work-stealing thread pool for the CPU search backends.
+//
+// Each worker owns a deque: it pops its own newest task (LIFO, cache-warm)
+// and, when empty, steals the oldest task from a sibling (FIFO). Tasks are
+// coarse (one 512-target batch, one query slice), so a mutex per deque is
+// cheaper than a lock-free Chase-Lev deque and keeps this header portable.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+public:
+    explicit WorkPool(int nthreads) : queues_(nthreads > 0 ? nthreads : 1) {
+        for (int i = 0; i < (int)queues_.size(); i++)
+            threads_.emplace_back([this, i] { worker_loop(i); });
+    }
+
+    ~WorkPool() {
+        {
+            std::lock_guard<std::mutex> lk(sleep_mu_);
+            stop_ = true;
+        }
+        sleep_cv_.notify_all();
+        for (auto &t : threads_) t.join();
+    }
+
+    int size() const { return (int)queues_.size(); }
+
+    // Queue a task. Tasks are dealt round-robin; idle workers steal the rest.
+    void submit(std::function<void()> task) {
+        unsigned q = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+        pending_.fetch_add(1, std::memory_order_acq_rel);
+        {
+            std::lock_guard<std::mutex> lk(queues_[q].mu);
+            queues_[q].tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> lk(sleep_mu_);
+            queued_++;
+        }
+        sleep_cv_.notify_one();
+    }
+
+    // Block until every submitted task has finished.
+    void wait_idle() {
+        std::unique_lock<std::mutex> lk(sleep_mu_);
+        idle_cv_.wait(lk, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mu;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool pop_local(int self, std::function<void()> &out) {
+        std::lock_guard<std::mutex> lk(queues_[self].mu);
+        if (queues_[self].tasks.empty()) return false;
+        out = std::move(queues_[self].tasks.back());
+        queues_[self].tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int self, std::function<void()> &out) {
+        int n = (int)queues_.size();
+        for (int k = 1; k < n; k++) {
+            Queue &q = queues_[(self + k) % n];
+            std::lock_guard<std::mutex> lk(q.mu);
+            if (q.tasks.empty()) continue;
+            out = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop(int self) {
+        for (;;) {
+            std::function<void()> task;
+            if (pop_local(self, task) || steal(self, task)) {
+                {
+                    std::lock_guard<std::mutex> lk(sleep_mu_);
+                    queued_--;
+                }
+                task();
+                if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    std::lock_guard<std::mutex> lk(sleep_mu_);
+                    idle_cv_.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(sleep_mu_);
+            sleep_cv_.wait(lk, [this] { return stop_ || queued_ > 0; });
+            if (stop_ && queued_ == 0) return;
+        }
+    }
+
+    std::vector<Queue> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<unsigned> next_{0};
+    std::atomic<long> pending_{0};
+    std::mutex sleep_mu_;
+    std::condition_variable sleep_cv_, idle_cv_;
+    long queued_ = 0;
+    bool stop_ = false;
+};
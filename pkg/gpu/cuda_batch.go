@@ -0,0 +1,371 @@
+package gpu
+
+import (
+	"bufio"
+	"encoding/binary"
+	"fmt"
+	"hash/fnv"
+	"io"
+	"net"
+	"os/exec"
+	"sync"
+
+	"github.com/oisee/z80-optimizer/pkg/inst"
+	"github.com/oisee/z80-optimizer/pkg/search"
+)
+
+// Protocol v2 of the QuickCheck server (see cuda/z80_qc_proto.h): many
+// fingerprints per request, tagged with ids, several requests in flight.
+const (
+	qcMagic     = 0x3243515A // "ZQC2"
+	qcVersion   = 2
+	qcFeatSHM   = 1       // requests and responses on shared-memory rings
+	qcFeatRes   = 2       // upload keyed by content hash, skipped if resident
+	qcShmFD     = 3       // the region's fd in the child (ExtraFiles start at 3)
+	qcRingBytes = 4 << 20 // per direction
+)
+
+// QCSharedMemory makes NewCUDABatchProcess offer the server shared-memory
+// rings for requests and responses; without them, or if the server declines,
+// they go over the pipes.
+var QCSharedMemory = true
+
+// QCQuery is one fingerprint of a batched request, with its own dead-flag mask.
+type QCQuery struct {
+	FP        [search.FingerprintLen]byte
+	DeadFlags search.FlagMask
+}
+
+type qcReply struct {
+	matches [][]uint32
+	err     error
+}
+
+// CUDABatchProcess manages a z80qc --server child speaking protocol v2, or
+// a session with a z80qc_cpu --daemon (DialQCDaemon).
+// QuickCheckBatch is safe for concurrent use: calls from several goroutines
+// are pipelined over the one pipe (or ring), up to the server's in-flight
+// limit, and their responses are matched back by request id.
+type CUDABatchProcess struct {
+	cmd    *exec.Cmd // nil for a daemon session
+	stdin  io.WriteCloser
+	stdout io.ReadCloser
+	shm    *shmRegion    // nil: requests and responses on the pipes
+	idle   chan struct{} // shm: closed when the server's stdout hangs up
+
+	wmu      sync.Mutex // serialize request writes
+	mu       sync.Mutex // guards pending, nextID, err
+	pending  map[uint32]chan qcReply
+	nextID   uint32
+	err      error
+	slots    chan struct{} // in-flight requests
+	maxBatch int
+	count    uint32
+	done     chan struct{} // closed when readLoop returns; nil before it starts
+}
+
+// NewCUDABatchProcess starts the server (CUDABinaryPath), performs the v2
+// handshake and uploads candidates. The server must support v2; a v1-only
+// binary would take the handshake for a candidate count.
+func NewCUDABatchProcess(candidates []inst.Instruction, seqLen int) (*CUDABatchProcess, error) {
+	cmd := exec.Command(CUDABinaryPath, "--server")
+	stdin, err := cmd.StdinPipe()
+	if err != nil {
+		return nil, fmt.Errorf("cuda: stdin pipe: %w", err)
+	}
+	stdout, err := cmd.StdoutPipe()
+	if err != nil {
+		stdin.Close()
+		return nil, fmt.Errorf("cuda: stdout pipe: %w", err)
+	}
+	cmd.Stderr = nil // inherit
+	var region *shmRegion
+	if QCSharedMemory {
+		if region, _ = newSHMRegion(qcRingBytes, qcShmFD); region != nil {
+			cmd.ExtraFiles = region.files()
+		}
+	}
+	err = cmd.Start()
+	if region != nil {
+		region.file.Close() // the child has its own; the mapping stays
+		region.file = nil
+	}
+	if err != nil {
+		stdin.Close()
+		if region != nil {
+			region.unmap()
+		}
+		return nil, fmt.Errorf("cuda: start %s: %w", CUDABinaryPath, err)
+	}
+
+	bp := &CUDABatchProcess{
+		cmd:     cmd,
+		stdin:   stdin,
+		stdout:  stdout,
+		shm:     region,
+		pending: make(map[uint32]chan qcReply),
+		count:   uint32(len(candidates)),
+	}
+	var features uint32
+	if region != nil {
+		features = qcFeatSHM
+	}
+	if err := bp.open(candidates, seqLen, features); err != nil {
+		bp.Close()
+		return nil, err
+	}
+	return bp, nil
+}
+
+// halfCloser makes Close on a daemon connection end only our direction,
+// so the daemon still answers what was sent before it sees EOF.
+type halfCloser struct{ *net.UnixConn }
+
+func (c halfCloser) Close() error { return c.CloseWrite() }
+
+// DialQCDaemon attaches to a z80qc_cpu --daemon listening on socket. The
+// candidates are named by content hash and only uploaded if the daemon does
+// not have them resident already; their queries share its workers fairly
+// with every other client's. Close ends the session, not the daemon.
+func DialQCDaemon(socket string, candidates []inst.Instruction, seqLen int) (*CUDABatchProcess, error) {
+	conn, err := net.DialUnix("unix", nil, &net.UnixAddr{Name: socket, Net: "unix"})
+	if err != nil {
+		return nil, fmt.Errorf("cuda: dial %s: %w", socket, err)
+	}
+	bp := &CUDABatchProcess{
+		stdin:   halfCloser{conn},
+		stdout:  conn,
+		pending: make(map[uint32]chan qcReply),
+		count:   uint32(len(candidates)),
+	}
+	if err := bp.open(candidates, seqLen, qcFeatRes); err != nil {
+		bp.Close()
+		return nil, err
+	}
+	return bp, nil
+}
+
+// open performs the v2 handshake, asking for features, uploads the
+// candidates (unless the server has them resident) and starts readLoop.
+func (bp *CUDABatchProcess) open(candidates []inst.Instruction, seqLen int, features uint32) error {
+	hello := [8]uint32{qcMagic, qcVersion, features}
+	if features&qcFeatSHM != 0 {
+		hello[5], hello[6] = qcShmFD, qcRingBytes
+	}
+	if err := binary.Write(bp.stdin, binary.LittleEndian, hello); err != nil {
+		return fmt.Errorf("cuda: write hello: %w", err)
+	}
+	var reply [8]uint32
+	if err := binary.Read(bp.stdout, binary.LittleEndian, &reply); err != nil {
+		return fmt.Errorf("cuda: read hello: %w", err)
+	}
+	if reply[0] != qcMagic || reply[1] != qcVersion || reply[3] == 0 || reply[4] == 0 {
+		return fmt.Errorf("cuda: server does not speak protocol v2 (reply %#x %d)", reply[0], reply[1])
+	}
+	bp.maxBatch = int(reply[3])
+	bp.slots = make(chan struct{}, reply[4])
+	if bp.shm != nil && reply[2]&qcFeatSHM == 0 {
+		bp.shm.unmap()
+		bp.shm = nil
+	}
+
+	header := [2]uint32{uint32(len(candidates)), uint32(seqLen)}
+	packed := make([]uint32, len(candidates))
+	for i, c := range candidates {
+		packed[i] = uint32(c.Op) | (uint32(c.Imm) << 16)
+	}
+	w := bufio.NewWriter(bp.stdin)
+	if err := binary.Write(w, binary.LittleEndian, header); err != nil {
+		return fmt.Errorf("cuda: write header: %w", err)
+	}
+	upload := true
+	if reply[2]&qcFeatRes != 0 {
+		h := fnv.New64a()
+		binary.Write(h, binary.LittleEndian, header)
+		binary.Write(h, binary.LittleEndian, packed)
+		var resident uint32
+		if err := binary.Write(w, binary.LittleEndian, h.Sum64()); err != nil {
+			return fmt.Errorf("cuda: write hash: %w", err)
+		}
+		if err := w.Flush(); err != nil {
+			return fmt.Errorf("cuda: write hash: %w", err)
+		}
+		if err := binary.Read(bp.stdout, binary.LittleEndian, &resident); err != nil {
+			return fmt.Errorf("cuda: read resident: %w", err)
+		}
+		upload = resident == 0
+	}
+	if upload {
+		if err := binary.Write(w, binary.LittleEndian, packed); err != nil {
+			return fmt.Errorf("cuda: write candidates: %w", err)
+		}
+	}
+	if err := w.Flush(); err != nil {
+		return fmt.Errorf("cuda: write candidates: %w", err)
+	}
+
+	if bp.shm != nil {
+		// nothing more comes down the pipe; it hangs up when the server exits
+		bp.idle = make(chan struct{})
+		go func() {
+			io.Copy(io.Discard, bp.stdout)
+			bp.shm.peerGone()
+			close(bp.idle)
+		}()
+	}
+	bp.done = make(chan struct{})
+	go bp.readLoop()
+	return nil
+}
+
+// MaxBatch is the largest number of queries the server takes per request.
+func (bp *CUDABatchProcess) MaxBatch() int { return bp.maxBatch }
+
+// readLoop hands each response to the request that is waiting for it.
+func (bp *CUDABatchProcess) readLoop() {
+	defer close(bp.done)
+	r := bufio.NewReader(bp.stdout)
+	var msg []byte
+	for {
+		var h [4]uint32 // id, n, total, pad
+		var counts, idx []uint32
+		var err error
+		if bp.shm != nil {
+			if msg, err = bp.shm.rx.recv(msg[:0]); err == nil {
+				err = parseQCResponse(msg, &h, &counts, &idx)
+			}
+		} else if err = binary.Read(r, binary.LittleEndian, &h); err == nil {
+			counts = make([]uint32, h[1])
+			idx = make([]uint32, h[2])
+			if err = binary.Read(r, binary.LittleEndian, counts); err == nil {
+				err = binary.Read(r, binary.LittleEndian, idx)
+			}
+		}
+		if err != nil {
+			bp.fail(fmt.Errorf("cuda: read response: %w", err))
+			return
+		}
+		matches := make([][]uint32, len(counts))
+		off := uint32(0)
+		for i, c := range counts {
+			if off+c > uint32(len(idx)) {
+				bp.fail(fmt.Errorf("cuda: response %d: counts exceed %d indices", h[0], len(idx)))
+				return
+			}
+			if c > 0 {
+				matches[i] = idx[off : off+c]
+			}
+			off += c
+		}
+		bp.mu.Lock()
+		ch, ok := bp.pending[h[0]]
+		delete(bp.pending, h[0])
+		bp.mu.Unlock()
+		if !ok {
+			bp.fail(fmt.Errorf("cuda: response for unknown request %d", h[0]))
+			return
+		}
+		ch <- qcReply{matches: matches}
+	}
+}
+
+// parseQCResponse splits one response message from the rings.
+func parseQCResponse(msg []byte, h *[4]uint32, counts, idx *[]uint32) error {
+	if len(msg) < 16 {
+		return fmt.Errorf("%d-byte response", len(msg))
+	}
+	for i := range h {
+		h[i] = binary.LittleEndian.Uint32(msg[4*i:])
+	}
+	if uint64(len(msg)) != 16+4*(uint64(h[1])+uint64(h[2])) {
+		return fmt.Errorf("response %d: %d bytes for %d counts and %d indices", h[0], len(msg), h[1], h[2])
+	}
+	words := make([]uint32, h[1]+h[2])
+	for i := range words {
+		words[i] = binary.LittleEndian.Uint32(msg[16+4*i:])
+	}
+	*counts, *idx = words[:h[1]], words[h[1]:]
+	return nil
+}
+
+// fail records the first error and wakes every waiting request with it.
+func (bp *CUDABatchProcess) fail(err error) {
+	bp.mu.Lock()
+	defer bp.mu.Unlock()
+	if bp.err == nil {
+		bp.err = err
+	}
+	for id, ch := range bp.pending {
+		ch <- qcReply{err: bp.err}
+		delete(bp.pending, id)
+	}
+}
+
+// QuickCheckBatch sends up to MaxBatch fingerprints in one request and
+// returns, per query, the indices of matching candidates in ascending order.
+func (bp *CUDABatchProcess) QuickCheckBatch(queries []QCQuery) ([][]uint32, error) {
+	if len(queries) > bp.maxBatch {
+		return nil, fmt.Errorf("cuda: %d queries in one request (max %d)", len(queries), bp.maxBatch)
+	}
+	bp.slots <- struct{}{}
+	defer func() { <-bp.slots }()
+
+	ch := make(chan qcReply, 1)
+	bp.mu.Lock()
+	if bp.err != nil {
+		err := bp.err
+		bp.mu.Unlock()
+		return nil, err
+	}
+	id := bp.nextID
+	bp.nextID++
+	bp.pending[id] = ch
+	bp.mu.Unlock()
+
+	buf := make([]byte, 8+len(queries)*(search.FingerprintLen+4))
+	binary.LittleEndian.PutUint32(buf[0:], id)
+	binary.LittleEndian.PutUint32(buf[4:], uint32(len(queries)))
+	off := 8
+	for _, q := range queries {
+		copy(buf[off:], q.FP[:])
+		binary.LittleEndian.PutUint32(buf[off+search.FingerprintLen:], uint32(q.DeadFlags))
+		off += search.FingerprintLen + 4
+	}
+	var err error
+	bp.wmu.Lock()
+	if bp.shm != nil {
+		err = bp.shm.tx.send(buf)
+	} else {
+		_, err = bp.stdin.Write(buf)
+	}
+	bp.wmu.Unlock()
+	if err != nil {
+		bp.fail(fmt.Errorf("cuda: write request: %w", err))
+	}
+
+	rep := <-ch
+	return rep.matches, rep.err
+}
+
+// Close shuts down the server (or ends the daemon session) once it has
+// answered what was sent; requests still waiting after that get an error.
+func (bp *CUDABatchProcess) Close() error {
+	if bp.shm != nil {
+		bp.shm.tx.close()
+	}
+	bp.stdin.Close()
+	if bp.done != nil {
+		<-bp.done // the server exits at EOF, so readLoop ends
+	}
+	if bp.idle != nil {
+		<-bp.idle
+	}
+	if bp.cmd == nil {
+		return bp.stdout.Close()
+	}
+	err := bp.cmd.Wait()
+	if bp.shm != nil {
+		bp.shm.unmap()
+	}
+	return err
+}
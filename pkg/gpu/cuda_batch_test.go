@@ -0,0 +1,183 @@
+package gpu
+
+import (
+	"os"
+	"os/exec"
+	"path/filepath"
+	"reflect"
+	"sync"
+	"testing"
+	"time"
+
+	"github.com/oisee/z80-optimizer/pkg/inst"
+	"github.com/oisee/z80-optimizer/pkg/search"
+)
+
+// Batched answers must equal one-at-a-time v1 answers, whatever the batch
+// sizes and however many goroutines share the process, on the pipes and on
+// the shared-memory rings.
+func TestCUDABatchProcess_MatchesV1(t *testing.T) {
+	requireCUDA(t)
+
+	candidates := search.EnumerateFirstOp()
+	v1, err := NewCUDAProcess(candidates, 1)
+	if err != nil {
+		t.Fatalf("NewCUDAProcess: %v", err)
+	}
+	defer v1.Close()
+
+	var queries []QCQuery
+	for i := 0; i < len(candidates) && len(queries) < 400; i += 97 {
+		fp := search.Fingerprint([]inst.Instruction{candidates[i]})
+		queries = append(queries, QCQuery{FP: fp, DeadFlags: search.FlagMask([]uint8{0x00, 0x28, 0xFF}[len(queries)%3])})
+	}
+	want := make([][]uint32, len(queries))
+	for i, q := range queries {
+		if want[i], err = v1.QuickCheckGPU(q.FP, q.DeadFlags); err != nil {
+			t.Fatalf("QuickCheckGPU: %v", err)
+		}
+	}
+
+	for _, shm := range []bool{false, true} {
+		QCSharedMemory = shm
+		bp, err := NewCUDABatchProcess(candidates, 1)
+		QCSharedMemory = true
+		if err != nil {
+			t.Fatalf("NewCUDABatchProcess: %v", err)
+		}
+		if (bp.shm != nil) != shm {
+			t.Errorf("shared memory: got %v, asked for %v", bp.shm != nil, shm)
+		}
+		var wg sync.WaitGroup
+		for g := 0; g < 4; g++ {
+			wg.Add(1)
+			go func(g int) {
+				defer wg.Done()
+				for lo := g; lo < len(queries); lo += 4 * (g + 1) {
+					hi := lo + g + 1
+					if hi > len(queries) {
+						hi = len(queries)
+					}
+					got, err := bp.QuickCheckBatch(queries[lo:hi])
+					if err != nil {
+						t.Errorf("QuickCheckBatch: %v", err)
+						return
+					}
+					for k := range got {
+						if !reflect.DeepEqual(got[k], want[lo+k]) {
+							t.Errorf("shm=%v query %d: batched %v, v1 %v", shm, lo+k, got[k], want[lo+k])
+						}
+					}
+				}
+			}(g)
+		}
+		wg.Wait()
+		if err := bp.Close(); err != nil {
+			t.Errorf("Close: %v", err)
+		}
+	}
+}
+
+// qcDaemonBinaryPath is the z80qc_cpu binary the daemon test starts.
+var qcDaemonBinaryPath = "cuda/z80qc_cpu"
+
+// Daemon sessions sharing one resident candidate set must answer as a
+// server of their own would.
+func TestDialQCDaemon_MatchesServer(t *testing.T) {
+	requireCUDA(t)
+	if _, err := exec.LookPath(qcDaemonBinaryPath); err != nil {
+		t.Skipf("z80qc_cpu not found at %s (run: g++ -O3 -pthread -o cuda/z80qc_cpu cuda/z80_quickcheck_cpu.cpp)", qcDaemonBinaryPath)
+	}
+	sock := filepath.Join(t.TempDir(), "qc.sock")
+	daemon := exec.Command(qcDaemonBinaryPath, "--daemon", sock, "--threads", "2")
+	if err := daemon.Start(); err != nil {
+		t.Fatalf("start daemon: %v", err)
+	}
+	defer func() {
+		daemon.Process.Kill()
+		daemon.Wait()
+	}()
+	for i := 0; ; i++ {
+		if _, err := os.Stat(sock); err == nil {
+			break
+		}
+		if i == 500 {
+			t.Fatalf("daemon did not create %s", sock)
+		}
+		time.Sleep(10 * time.Millisecond)
+	}
+
+	candidates := search.EnumerateFirstOp()
+	ref, err := NewCUDABatchProcess(candidates, 1)
+	if err != nil {
+		t.Fatalf("NewCUDABatchProcess: %v", err)
+	}
+	defer ref.Close()
+	var queries []QCQuery
+	for i := 0; i < len(candidates) && len(queries) < ref.MaxBatch(); i += 13 {
+		fp := search.Fingerprint([]inst.Instruction{candidates[i]})
+		queries = append(queries, QCQuery{FP: fp, DeadFlags: search.FlagMask([]uint8{0x00, 0x28, 0xFF}[len(queries)%3])})
+	}
+	want, err := ref.QuickCheckBatch(queries)
+	if err != nil {
+		t.Fatalf("QuickCheckBatch: %v", err)
+	}
+
+	var wg sync.WaitGroup
+	for c := 0; c < 3; c++ {
+		wg.Add(1)
+		go func(c int) {
+			defer wg.Done()
+			bp, err := DialQCDaemon(sock, candidates, 1)
+			if err != nil {
+				t.Errorf("DialQCDaemon: %v", err)
+				return
+			}
+			defer bp.Close()
+			for lo := c; lo < len(queries); lo += 50 {
+				hi := lo + 50
+				if hi > len(queries) {
+					hi = len(queries)
+				}
+				got, err := bp.QuickCheckBatch(queries[lo:hi])
+				if err != nil {
+					t.Errorf("QuickCheckBatch: %v", err)
+					return
+				}
+				for k := range got {
+					if !reflect.DeepEqual(got[k], want[lo+k]) {
+						t.Errorf("client %d query %d: daemon %v, server %v", c, lo+k, got[k], want[lo+k])
+					}
+				}
+			}
+		}(c)
+	}
+	wg.Wait()
+}
+
+// Per-request overhead: one query per request on a few candidates.
+func BenchmarkCUDABatchProcess_RoundTrip(b *testing.B) {
+	requireCUDA(b)
+	candidates := search.EnumerateFirstOp()[:64]
+	q := []QCQuery{{FP: search.Fingerprint(candidates[:1])}}
+	for _, shm := range []bool{false, true} {
+		name := "pipes"
+		if shm {
+			name = "shm"
+		}
+		b.Run(name, func(b *testing.B) {
+			QCSharedMemory = shm
+			bp, err := NewCUDABatchProcess(candidates, 1)
+			QCSharedMemory = true
+			if err != nil {
+				b.Fatalf("NewCUDABatchProcess: %v", err)
+			}
+			defer bp.Close()
+			for i := 0; i < b.N; i++ {
+				if _, err := bp.QuickCheckBatch(q); err != nil {
+					b.Fatal(err)
+				}
+			}
+		})
+	}
+}
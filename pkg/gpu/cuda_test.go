@@ -8,7 +8,7 @@ import (
 	"github.com/oisee/z80-optimizer/pkg/search"
 )
 
-func requireCUDA(t *testing.T) {
+func requireCUDA(t testing.TB) {
 	t.Helper()
 	if _, err := exec.LookPath(CUDABinaryPath); err != nil {
 		t.Skipf("CUDA binary not found at %s (run: nvcc -O2 -o cuda/z80qc cuda/z80_quickcheck.cu)", CUDABinaryPath)
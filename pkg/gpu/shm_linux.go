@@ -0,0 +1,228 @@
+//go:build linux
+
+package gpu
+
+import (
+	"encoding/binary"
+	"errors"
+	"io"
+	"math"
+	"os"
+	"runtime"
+	"sync/atomic"
+	"syscall"
+	"unsafe"
+)
+
+// Client side of the shared-memory rings in cuda/z80_shm_ring.h; the
+// region layout, record format and wake-up protocol must match it.
+const (
+	shmMagic   = 0x5248535A // "ZSHR"
+	shmVersion = 1
+	shmDataOff = 4096
+	shmMore    = 0x80000000
+	shmWrap    = 0xFFFFFFFF
+
+	// ring control words; a sequence word is followed by its waiters and efd
+	shmHead     = 0
+	shmClosed   = 1
+	shmTail     = 16
+	shmDataSeq  = 32
+	shmSpaceSeq = 48
+
+	futexWake = 1
+)
+
+var errSHMGone = errors.New("shared-memory peer went away")
+
+var shmSpins = func() int {
+	if runtime.NumCPU() > 1 {
+		return 2000
+	}
+	return 0
+}()
+
+// The client sleeps on eventfds, not futexes: a goroutine blocked in
+// FUTEX_WAIT keeps its P until sysmon notices, while an eventfd read parks
+// it in the netpoller. The server finds them at these fds.
+type shmRing struct {
+	ctl   *[64]uint32
+	data  []byte
+	cap   uint32
+	sleep int      // control word the client sleeps on: data (rx) or space (tx)
+	efd   *os.File // its eventfd
+	gone  *atomic.Bool
+}
+
+type shmRegion struct {
+	mem    []byte
+	file   *os.File // handed to the child; closed once it has it
+	tx, rx shmRing
+	gone   atomic.Bool // set once the server has exited
+}
+
+// newSHMRegion maps a fresh region on tmpfs (the standard library has no
+// memfd_create; an unlinked /dev/shm file is the same memory). The child
+// must get files() as its fds firstFD, firstFD+1, ...
+func newSHMRegion(ringBytes uint32, firstFD int) (*shmRegion, error) {
+	f, err := os.CreateTemp("/dev/shm", "z80qc-")
+	if err != nil {
+		return nil, err
+	}
+	os.Remove(f.Name())
+	size := shmDataOff + 2*int(ringBytes)
+	if err := f.Truncate(int64(size)); err != nil {
+		f.Close()
+		return nil, err
+	}
+	mem, err := syscall.Mmap(int(f.Fd()), 0, size, syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		f.Close()
+		return nil, err
+	}
+	r := &shmRegion{mem: mem, file: f}
+	h := (*[3]uint32)(unsafe.Pointer(&mem[0]))
+	h[1], h[2] = shmVersion, ringBytes
+	for i, rg := range []*shmRing{&r.tx, &r.rx} {
+		rg.ctl = (*[64]uint32)(unsafe.Pointer(&mem[64+256*i]))
+		off := shmDataOff + i*int(ringBytes)
+		rg.data = mem[off : off+int(ringBytes)]
+		rg.cap = ringBytes
+		rg.gone = &r.gone
+		rg.sleep = []int{shmSpaceSeq, shmDataSeq}[i]
+		fd, _, errno := syscall.RawSyscall(syscall.SYS_EVENTFD2, 0, syscall.O_NONBLOCK|syscall.O_CLOEXEC, 0)
+		if errno != 0 {
+			r.unmap()
+			return nil, errno
+		}
+		rg.efd = os.NewFile(fd, "eventfd")
+		rg.ctl[rg.sleep+2] = uint32(firstFD + 1 + i)
+	}
+	atomic.StoreUint32(&h[0], shmMagic)
+	return r, nil
+}
+
+// files are the region and the eventfds, in the order the child expects.
+func (r *shmRegion) files() []*os.File { return []*os.File{r.file, r.tx.efd, r.rx.efd} }
+
+func (r *shmRegion) unmap() {
+	for _, f := range []*os.File{r.file, r.tx.efd, r.rx.efd} {
+		if f != nil {
+			f.Close()
+		}
+	}
+	syscall.Munmap(r.mem)
+}
+
+// peerGone marks the server as exited and wakes anything sleeping on the rings.
+func (r *shmRegion) peerGone() {
+	r.gone.Store(true)
+	one := []byte{1, 0, 0, 0, 0, 0, 0, 0}
+	r.tx.efd.Write(one)
+	r.rx.efd.Write(one)
+}
+
+func (rg *shmRing) wait(ready func() bool) error {
+	for i := 0; i < shmSpins; i++ {
+		if ready() {
+			return nil
+		}
+	}
+	var buf [8]byte
+	for !ready() {
+		if rg.gone.Load() {
+			return errSHMGone
+		}
+		atomic.AddUint32(&rg.ctl[rg.sleep+1], 1)
+		if !ready() {
+			rg.efd.Read(buf[:])
+		}
+		atomic.AddUint32(&rg.ctl[rg.sleep+1], math.MaxUint32) // -1
+	}
+	return nil
+}
+
+// wake the server if it sleeps on seq (a futex).
+func (rg *shmRing) wake(seq int) {
+	atomic.AddUint32(&rg.ctl[seq], 1)
+	if atomic.LoadUint32(&rg.ctl[seq+1]) != 0 {
+		syscall.RawSyscall6(syscall.SYS_FUTEX, uintptr(unsafe.Pointer(&rg.ctl[seq])), futexWake, math.MaxInt32, 0, 0, 0)
+	}
+}
+
+// send writes one message, in records of at most half the ring.
+func (rg *shmRing) send(msg []byte) error {
+	maxFrag := int(rg.cap/2 - 8)
+	for first := true; first || len(msg) > 0; first = false {
+		frag := len(msg)
+		if frag > maxFrag {
+			frag = maxFrag
+		}
+		rec := uint32(4+frag+7) &^ 7
+		head := atomic.LoadUint32(&rg.ctl[shmHead])
+		pos := head & (rg.cap - 1)
+		skip := uint32(0)
+		if rg.cap-pos < rec {
+			skip = rg.cap - pos
+		}
+		if err := rg.wait(func() bool {
+			return rg.cap-(head-atomic.LoadUint32(&rg.ctl[shmTail])) >= skip+rec
+		}); err != nil {
+			return err
+		}
+		if skip != 0 {
+			binary.LittleEndian.PutUint32(rg.data[pos:], shmWrap)
+			pos = 0
+		}
+		w := uint32(frag)
+		if frag < len(msg) {
+			w |= shmMore
+		}
+		binary.LittleEndian.PutUint32(rg.data[pos:], w)
+		copy(rg.data[pos+4:], msg[:frag])
+		atomic.StoreUint32(&rg.ctl[shmHead], head+skip+rec)
+		rg.wake(shmDataSeq)
+		msg = msg[frag:]
+	}
+	return nil
+}
+
+// close tells the server no more requests follow.
+func (rg *shmRing) close() {
+	atomic.StoreUint32(&rg.ctl[shmClosed], 1)
+	rg.wake(shmDataSeq)
+	rg.wake(shmSpaceSeq)
+}
+
+// recv appends the next message to buf; io.EOF once the server has closed
+// the ring and it is empty.
+func (rg *shmRing) recv(buf []byte) ([]byte, error) {
+	start := len(buf)
+	for {
+		tail := atomic.LoadUint32(&rg.ctl[shmTail])
+		if err := rg.wait(func() bool {
+			return atomic.LoadUint32(&rg.ctl[shmHead]) != tail || atomic.LoadUint32(&rg.ctl[shmClosed]) != 0
+		}); err != nil {
+			return buf, err
+		}
+		if atomic.LoadUint32(&rg.ctl[shmHead]) == tail {
+			if len(buf) == start {
+				return buf, io.EOF
+			}
+			return buf, errSHMGone
+		}
+		pos := tail & (rg.cap - 1)
+		w := binary.LittleEndian.Uint32(rg.data[pos:])
+		adv := rg.cap - pos
+		if w != shmWrap {
+			n := w &^ shmMore
+			buf = append(buf, rg.data[pos+4:pos+4+n]...)
+			adv = (4 + n + 7) &^ 7
+		}
+		atomic.StoreUint32(&rg.ctl[shmTail], tail+adv)
+		rg.wake(shmSpaceSeq)
+		if w != shmWrap && w&shmMore == 0 {
+			return buf, nil
+		}
+	}
+}
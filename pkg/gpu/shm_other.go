@@ -0,0 +1,28 @@
+//go:build !linux
+
+package gpu
+
+import (
+	"errors"
+	"os"
+)
+
+// Shared-memory rings need Linux futexes; elsewhere batches use the pipes.
+
+type shmRing struct{}
+
+type shmRegion struct {
+	file   *os.File
+	tx, rx shmRing
+}
+
+func newSHMRegion(uint32, int) (*shmRegion, error) {
+	return nil, errors.New("shared-memory rings need Linux")
+}
+
+func (r *shmRegion) files() []*os.File              { return nil }
+func (r *shmRegion) unmap()                         {}
+func (r *shmRegion) peerGone()                      {}
+func (rg *shmRing) send([]byte) error               { return nil }
+func (rg *shmRing) close()                          {}
+func (rg *shmRing) recv(buf []byte) ([]byte, error) { return buf, nil }